@@ -0,0 +1,63 @@
+#include "../core/Neuron.h"
+#include <chrono>
+#include <iostream>
+
+// Peak live intermediate nodes and step time for plain backward against
+// sqrt(depth) activation checkpointing, over a sweep of MLP depths.
+
+auto elapsed(std::chrono::steady_clock::time_point start) -> double {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+auto plain_step_seconds(MultiLayerPerceptron &mlp,
+                        const std::vector<ValuePtr> &in) -> double {
+  auto start = std::chrono::steady_clock::now();
+  ValuePtr output = mlp(in)[0];
+  ValuePtr loss = output * output;
+  loss->backpropagate();
+  return elapsed(start);
+}
+
+auto checkpointed_step_seconds(MultiLayerPerceptron &mlp,
+                               const std::vector<ValuePtr> &in) -> double {
+  auto start = std::chrono::steady_clock::now();
+  auto forward = mlp.forward_checkpointed(in);
+  ValuePtr loss = forward.outputs()[0] * forward.outputs()[0];
+  loss->backpropagate();
+  forward.backward();
+  return elapsed(start);
+}
+
+int main(int argc, char **argv) {
+  size_t width = argc > 1 ? std::stoul(argv[1]) : 16;
+
+  std::cout << "[\n";
+  const size_t depths[] = {4, 9, 16, 25, 36, 64};
+  for (size_t depth : depths) {
+    std::vector<size_t> layer_sizes(depth, width);
+    layer_sizes.back() = 1;
+    MultiLayerPerceptron mlp(width, layer_sizes);
+    std::vector<ValuePtr> inputs(width, create_value(0.1));
+
+    // A single segment spanning every layer is the plain forward
+    size_t plain_peak = mlp.forward_checkpointed(inputs, depth, true)
+                            .peak_nodes();
+    auto checkpointed = mlp.forward_checkpointed(inputs, 0, true);
+
+    double plain_time = plain_step_seconds(mlp, inputs);
+    double checkpoint_time = checkpointed_step_seconds(mlp, inputs);
+
+    std::cout << "  {\"depth\": " << depth << ", \"width\": " << width
+              << ", \"interval\": " << checkpointed.interval()
+              << ", \"plain_peak_nodes\": " << plain_peak
+              << ", \"checkpointed_peak_nodes\": "
+              << checkpointed.peak_nodes()
+              << ", \"plain_step_ms\": " << plain_time * 1e3
+              << ", \"checkpointed_step_ms\": " << checkpoint_time * 1e3
+              << "}" << (depth == 64 ? "" : ",") << "\n";
+  }
+  std::cout << "]\n";
+  return 0;
+}
@@ -0,0 +1,98 @@
+#include "../core/Neuron.h"
+#include "../core/Train/Checkpoint.hpp"
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <random>
+
+// Training stall per checkpoint: a momentum SGD loop saving every few steps
+// with no checkpoints, asynchronous ones, and synchronous ones (save() then
+// wait(), which is what writing from the loop would cost). Files are fsynced.
+
+int main(int argc, char **argv) {
+  size_t steps = argc > 1 ? std::stoul(argv[1]) : 60;
+  size_t every = argc > 2 ? std::stoul(argv[2]) : 10;
+  std::string root = argc > 3 ? argv[3]
+                              : (std::filesystem::temp_directory_path() /
+                                 "micrograd_checkpoint_bench")
+                                    .string();
+  const size_t num_inputs = 16;
+  ModelShape shape{num_inputs,
+                   {256, 256, 1},
+                   {Activation::Relu, Activation::Relu, Activation::Identity}};
+
+  std::cout << "{\"parameters\": " << shape.parameter_count()
+            << ", \"steps\": " << steps << ", \"every\": " << every
+            << ", \"runs\": [";
+  const char *modes[] = {"none", "async", "sync"};
+  for (int mode = 0; mode < 3; mode++) {
+    std::filesystem::remove_all(root);
+    MultiLayerPerceptron mlp(shape, 3, InitScheme::HeUniform);
+    std::vector<ValuePtr> params = mlp.parameters();
+    std::vector<double> velocity(params.size(), 0.0);
+    std::mt19937_64 gen(7);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::optional<Checkpointer> checkpoints;
+    if (mode > 0) {
+      checkpoints.emplace(CheckpointOptions{root, "bench", 3});
+    }
+    TrainingState state;
+    double stall_seconds = 0.0; // Loop time spent checkpointing
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t step = 0; step < steps; step++) {
+      std::vector<ValuePtr> x;
+      double target = 0.0;
+      for (size_t j = 0; j < num_inputs; j++) {
+        x.push_back(create_value(normal(gen)));
+        target += x.back()->get_value() * (j % 2 ? 0.5 : -0.5);
+      }
+      ValuePtr diff = mlp(x)[0] - create_value(target);
+      (diff * diff)->backpropagate();
+      for (size_t i = 0; i < params.size(); i++) {
+        velocity[i] = 0.9 * velocity[i] + params[i]->get_gradient();
+        params[i]->set_value(params[i]->get_value() - 1e-3 * velocity[i]);
+      }
+
+      if (checkpoints && (step + 1) % every == 0) {
+        auto save_start = std::chrono::steady_clock::now();
+        state.step = step + 1;
+        state.shape = shape;
+        state.parameters = mlp.parameter_values();
+        state.moments = {velocity};
+        state.rng = rng_state(gen);
+        checkpoints->save(state);
+        if (mode == 2) {
+          checkpoints->wait();
+        }
+        stall_seconds += std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - save_start)
+                             .count();
+      }
+    }
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+
+    std::cout << (mode ? ",\n  " : "\n  ") << "{\"mode\": \"" << modes[mode]
+              << "\", \"step_ms\": " << seconds * 1e3 / steps;
+    if (checkpoints) {
+      checkpoints->wait();
+      CheckpointStats stats = checkpoints->stats();
+      // Includes gathering the state from the model, save() alone is
+      // stats.mean_stall_ms()
+      double stall_ms = stall_seconds * 1e3 / stats.saves;
+      std::cout << ", \"checkpoints\": " << stats.written
+                << ", \"superseded\": " << stats.superseded
+                << ", \"bytes\": " << stats.bytes
+                << ", \"stall_ms\": " << stall_ms
+                << ", \"save_ms\": " << stats.mean_stall_ms()
+                << ", \"write_ms\": "
+                << stats.write_seconds * 1e3 / std::max<size_t>(stats.written, 1);
+    }
+    std::cout << "}";
+  }
+  std::cout << "\n]}\n";
+  std::filesystem::remove_all(root);
+  return 0;
+}
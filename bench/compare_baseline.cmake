@@ -0,0 +1,166 @@
+# Runs the training benchmark and compares samples/sec per benchmark against a
+# stored baseline. Fails when any benchmark is slower than the baseline by more
+# than THRESHOLD (a fraction, 0.25 = 25%). Only the fixed-work throughput runs
+# are compared (--throughput-only), each benchmark as the median of REPEAT
+# runs, and the baseline is recorded the same way. Also fails when the
+# baseline came from another build type, since a Debug and a Release build
+# differ by far more than any threshold.
+#
+# The baseline records a host key: host name, CPU model, cache size, logical
+# cores and memory. Without a baseline for this key, or with BUILD_TYPE given
+# and differing from the baseline's, the benchmark is not run and "No
+# baseline for this host" is printed, which ctest reports as a skip.
+# UPDATE_BASELINE records this host's key.
+#
+# cmake -DBENCH=<exe> -DBASELINE=<json> -DOUTPUT=<json> [-DTHRESHOLD=0.25]
+#       [-DREPEAT=5] [-DBUILD_TYPE=<config>] [-DUPDATE_BASELINE=ON]
+#       -P compare_baseline.cmake
+
+if(NOT DEFINED THRESHOLD)
+  set(THRESHOLD 0.25)
+endif()
+if(NOT DEFINED REPEAT)
+  set(REPEAT 5)
+endif()
+
+# CMake math is integer only, so the threshold becomes thousandths. Accepts
+# 0.25, .25, 1 or 1.0; more than three decimals are truncated.
+if(THRESHOLD MATCHES "^\\.?$" OR
+   NOT THRESHOLD MATCHES "^([0-9]*)(\\.([0-9]*))?$")
+  message(FATAL_ERROR
+    "THRESHOLD must be a fraction such as 0.25, got '${THRESHOLD}'")
+endif()
+set(threshold_whole "${CMAKE_MATCH_1}")
+set(threshold_fraction "${CMAKE_MATCH_3}")
+if(threshold_whole STREQUAL "")
+  set(threshold_whole 0)
+endif()
+# The leading 1 keeps a fraction like 025 from reading as octal
+string(SUBSTRING "${threshold_fraction}000" 0 3 threshold_fraction)
+math(EXPR threshold_milli
+  "${threshold_whole} * 1000 + 1${threshold_fraction} - 1000")
+if(threshold_milli GREATER 1000)
+  message(FATAL_ERROR "THRESHOLD must be at most 1, got '${THRESHOLD}'")
+endif()
+
+# A CPU description alone ("1 core Intel(R) Xeon(R) Processor") matches any
+# generic VM, so the key adds the host name, cache size and memory
+cmake_host_system_information(RESULT host_facts
+  QUERY HOSTNAME NUMBER_OF_LOGICAL_CORES TOTAL_PHYSICAL_MEMORY)
+list(GET host_facts 0 host_name)
+list(GET host_facts 1 host_cores)
+list(GET host_facts 2 host_memory)
+set(cpu_model "")
+set(cpu_cache "")
+if(EXISTS /proc/cpuinfo)
+  file(STRINGS /proc/cpuinfo cpu_model REGEX "^model name" LIMIT_COUNT 1)
+  file(STRINGS /proc/cpuinfo cpu_cache REGEX "^cache size" LIMIT_COUNT 1)
+  string(REGEX REPLACE "^[^:]*:[ \t]*" "" cpu_model "${cpu_model}")
+  string(REGEX REPLACE "^[^:]*:[ \t]*" "" cpu_cache "${cpu_cache}")
+endif()
+if(cpu_model STREQUAL "")
+  cmake_host_system_information(RESULT cpu_model QUERY PROCESSOR_DESCRIPTION)
+endif()
+string(CONCAT host "${host_name} / ${cpu_model} / ${cpu_cache} cache / "
+  "${host_cores} cores / ${host_memory} MiB")
+
+if(NOT UPDATE_BASELINE)
+  set(baseline_host "")
+  set(baseline_type "")
+  if(EXISTS ${BASELINE})
+    file(READ ${BASELINE} baseline_json)
+    string(JSON baseline_host ERROR_VARIABLE baseline_host_error
+      GET ${baseline_json} host)
+    string(JSON baseline_type ERROR_VARIABLE baseline_type_error
+      GET ${baseline_json} build_type)
+  endif()
+  # The benchmark writes an empty configuration as None
+  if(DEFINED BUILD_TYPE AND BUILD_TYPE STREQUAL "")
+    set(BUILD_TYPE None)
+  endif()
+  if(NOT baseline_host STREQUAL host OR
+     (DEFINED BUILD_TYPE AND NOT baseline_type STREQUAL BUILD_TYPE))
+    message(STATUS
+      "No baseline for this host (${host}, ${BUILD_TYPE} build) in "
+      "${BASELINE}; refresh it with -DUPDATE_BASELINE=ON to gate here")
+    return()
+  endif()
+endif()
+
+execute_process(
+  COMMAND ${BENCH} --out ${OUTPUT} --repeat ${REPEAT} --throughput-only
+  RESULT_VARIABLE bench_result
+  OUTPUT_QUIET
+)
+if(NOT bench_result EQUAL 0)
+  message(FATAL_ERROR "Benchmark ${BENCH} failed with ${bench_result}")
+endif()
+
+if(UPDATE_BASELINE)
+  # Inserted as text so the file keeps the benchmark's one line per entry
+  file(READ ${OUTPUT} output_json)
+  string(REPLACE "\"" "\\\"" host_json "${host}")
+  string(REGEX REPLACE "^{" "{\n  \"host\": \"${host_json}\","
+    output_json "${output_json}")
+  file(WRITE ${BASELINE} "${output_json}")
+  message(STATUS "Baseline updated: ${BASELINE}")
+  return()
+endif()
+
+file(READ ${BASELINE} baseline_json)
+file(READ ${OUTPUT} current_json)
+
+string(JSON baseline_type ERROR_VARIABLE baseline_type_error
+  GET ${baseline_json} build_type)
+string(JSON current_type GET ${current_json} build_type)
+if(baseline_type_error)
+  set(baseline_type "unknown")
+endif()
+if(NOT baseline_type STREQUAL current_type)
+  message(FATAL_ERROR
+    "Baseline ${BASELINE} is from a ${baseline_type} build, this is a "
+    "${current_type} build. Configure with -DCMAKE_BUILD_TYPE=${baseline_type} "
+    "or refresh the baseline.")
+endif()
+
+string(JSON baseline_count LENGTH ${baseline_json} benchmarks)
+string(JSON current_count LENGTH ${current_json} benchmarks)
+math(EXPR current_last "${current_count} - 1")
+
+set(regressions 0)
+foreach(i RANGE ${current_last})
+  string(JSON name GET ${current_json} benchmarks ${i} name)
+  string(JSON current GET ${current_json} benchmarks ${i} samples_per_sec)
+
+  # Look the benchmark up by name so reordering configs does not break the gate
+  set(baseline "")
+  math(EXPR baseline_last "${baseline_count} - 1")
+  foreach(j RANGE ${baseline_last})
+    string(JSON baseline_name GET ${baseline_json} benchmarks ${j} name)
+    if(baseline_name STREQUAL name)
+      string(JSON baseline GET ${baseline_json} benchmarks ${j} samples_per_sec)
+    endif()
+  endforeach()
+
+  if(baseline STREQUAL "")
+    message(STATUS "${name}: ${current} samples/sec (no baseline)")
+    continue()
+  endif()
+
+  string(REGEX REPLACE "\\..*" "" current_int ${current})
+  string(REGEX REPLACE "\\..*" "" baseline_int ${baseline})
+  math(EXPR floor "${baseline_int} * (1000 - ${threshold_milli}) / 1000")
+
+  if(current_int LESS floor)
+    message(SEND_ERROR
+      "${name}: ${current_int} samples/sec, baseline ${baseline_int} "
+      "(floor ${floor})")
+    math(EXPR regressions "${regressions} + 1")
+  else()
+    message(STATUS "${name}: ${current_int} samples/sec, baseline ${baseline_int}")
+  endif()
+endforeach()
+
+if(regressions GREATER 0)
+  message(FATAL_ERROR "${regressions} training benchmark(s) regressed")
+endif()
@@ -0,0 +1,186 @@
+#include "../core/Tensor/Autotune.hpp"
+#include "../core/Tensor/Conv.hpp"
+#include "../core/Tensor/Gemm.hpp"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+// LeNet-5 on 28x28 images, forward and forward+backward per batch:
+//
+//   conv 6@5x5 pad 2, relu, maxpool 2    -> 6 x 14 x 14
+//   conv 16@5x5, relu, maxpool 2         -> 16 x 5 x 5
+//   dense 400-120, relu, 120-84, relu, 84-10
+//
+// and the second convolution alone, im2col+GEMM against direct loops.
+
+template <typename F> auto time_ms(size_t repeats, F &&step) -> double {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < repeats; i++) {
+    step();
+  }
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+             .count() /
+         repeats;
+}
+
+struct Relu {
+  Tensor mask;
+  auto forward(Tensor x) -> Tensor {
+    mask = Tensor(x.shape());
+    for (size_t i = 0; i < x.size(); i++) {
+      mask.data()[i] = x.data()[i] > 0 ? 1.0 : 0.0;
+      x.data()[i] *= mask.data()[i];
+    }
+    return x;
+  }
+  auto backward(Tensor grad) -> Tensor {
+    for (size_t i = 0; i < grad.size(); i++) {
+      grad.data()[i] *= mask.data()[i];
+    }
+    return grad;
+  }
+};
+
+// y[N, out] = x[N, in] W[in, out] + b
+struct Dense {
+  Tensor weights;
+  Tensor bias;
+  Tensor weight_gradient;
+  Tensor input;
+
+  Dense(size_t in, size_t out, std::mt19937_64 &gen)
+      : weights({in, out}), bias({out}), weight_gradient({in, out}) {
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+    double scale = std::sqrt(6.0 / static_cast<double>(in));
+    for (size_t i = 0; i < weights.size(); i++) {
+      weights.data()[i] = scale * uniform(gen);
+    }
+  }
+
+  auto forward(const Tensor &x) -> Tensor {
+    input = x.reshape({x.dim(0), x.size() / x.dim(0)});
+    Tensor y = matmul(input, weights);
+    for (size_t n = 0; n < y.dim(0); n++) {
+      for (size_t j = 0; j < y.dim(1); j++) {
+        y(n, j) += bias(j);
+      }
+    }
+    return y;
+  }
+
+  auto backward(const Tensor &dy) -> Tensor {
+    size_t batch = dy.dim(0);
+    size_t in = weights.dim(0);
+    size_t out = weights.dim(1);
+    gemm(in, out, batch, {input.data(), 1, in}, {dy.data(), out, 1},
+         weight_gradient.data(), out,
+         gemm_tuner().blocking(GemmShape{in, out, batch}));
+    Tensor dx({batch, in});
+    gemm(batch, in, out, {dy.data(), out, 1}, {weights.data(), 1, out},
+         dx.data(), in, gemm_tuner().blocking(GemmShape{batch, in, out}));
+    return dx;
+  }
+};
+
+struct LeNet {
+  std::mt19937_64 gen{3};
+  Conv2D conv1{1, 6, 5, {1, 2, 1}, 1};
+  Relu relu1;
+  MaxPool2D pool1{2};
+  Conv2D conv2{6, 16, 5, {}, 2};
+  Relu relu2;
+  MaxPool2D pool2{2};
+  Dense fc1{400, 120, gen};
+  Relu relu3;
+  Dense fc2{120, 84, gen};
+  Relu relu4;
+  Dense fc3{84, 10, gen};
+  std::vector<size_t> pooled_shape;
+
+  auto forward(const Tensor &x) -> Tensor {
+    Tensor h = pool1.forward(relu1.forward(conv1.forward(x)));
+    h = pool2.forward(relu2.forward(conv2.forward(h)));
+    pooled_shape = h.shape();
+    h = relu3.forward(fc1.forward(h));
+    h = relu4.forward(fc2.forward(h));
+    return fc3.forward(h);
+  }
+
+  void backward(const Tensor &dy) {
+    Tensor g = fc2.backward(relu4.backward(fc3.backward(dy)));
+    g = fc1.backward(relu3.backward(g)).reshape(pooled_shape);
+    g = conv2.backward(relu2.backward(pool2.backward(g)));
+    conv1.backward(relu1.backward(pool1.backward(g)));
+  }
+};
+
+// The convolution as written down, no lowering
+auto direct_conv(const Tensor &x, Conv2D &conv) -> Tensor {
+  const Tensor &w = conv.weights();
+  size_t k = w.dim(2);
+  size_t oh = x.dim(2) - k + 1;
+  size_t ow = x.dim(3) - k + 1;
+  Tensor out({x.dim(0), w.dim(0), oh, ow});
+  for (size_t n = 0; n < x.dim(0); n++) {
+    for (size_t f = 0; f < w.dim(0); f++) {
+      for (size_t oy = 0; oy < oh; oy++) {
+        for (size_t ox = 0; ox < ow; ox++) {
+          double sum = conv.bias()(f);
+          for (size_t c = 0; c < x.dim(1); c++) {
+            for (size_t ky = 0; ky < k; ky++) {
+              for (size_t kx = 0; kx < k; kx++) {
+                sum += w(f, c, ky, kx) * x(n, c, oy + ky, ox + kx);
+              }
+            }
+          }
+          out(n, f, oy, ox) = sum;
+        }
+      }
+    }
+  }
+  return out;
+}
+
+int main(int argc, char **argv) {
+  size_t repeats = argc > 1 ? std::stoul(argv[1]) : 10;
+  std::mt19937_64 gen(11);
+  std::normal_distribution<double> normal(0.0, 1.0);
+  auto random = [&](std::vector<size_t> shape) {
+    Tensor t(std::move(shape));
+    for (size_t i = 0; i < t.size(); i++) {
+      t.data()[i] = normal(gen);
+    }
+    return t;
+  };
+
+  LeNet net;
+  std::cout << "{\"lenet\": [";
+  for (size_t batch : {1, 16, 64}) {
+    Tensor x = random({batch, 1, 28, 28});
+    Tensor dy = random({batch, 10});
+    net.forward(x); // Sizes the workspaces
+    net.backward(dy);
+    double forward_ms = time_ms(repeats, [&]() { net.forward(x); });
+    double step_ms = time_ms(repeats, [&]() {
+      net.forward(x);
+      net.backward(dy);
+    });
+    std::cout << (batch == 1 ? "\n  " : ",\n  ") << "{\"batch\": " << batch
+              << ", \"forward_ms\": " << forward_ms
+              << ", \"forward_backward_ms\": " << step_ms
+              << ", \"images_per_second\": " << 1e3 * batch / step_ms << "}";
+  }
+
+  Conv2D conv(6, 16, 5);
+  Tensor x = random({16, 6, 14, 14});
+  conv.forward(x);
+  double gemm_ms = time_ms(repeats, [&]() { conv.forward(x); });
+  double direct_ms = time_ms(repeats, [&]() { direct_conv(x, conv); });
+  std::cout << "\n ],\n \"conv2_batch16\": {\"im2col_gemm_ms\": " << gemm_ms
+            << ", \"direct_ms\": " << direct_ms
+            << ", \"workspace_bytes\": " << conv.workspace().capacity
+            << "}}\n";
+  return 0;
+}
@@ -0,0 +1,68 @@
+#include "../core/Embedding/Embedding.hpp"
+#include <chrono>
+#include <iostream>
+#include <random>
+
+// Step time of a sparse embedding update against the table size. The
+// sparse step (lookup, backward, collect, SGD) should stay flat while a
+// dense sweep over the table grows with it.
+
+constexpr size_t kDim = 16;
+constexpr size_t kBatch = 32;
+constexpr size_t kSteps = 50;
+
+auto elapsed(std::chrono::steady_clock::time_point start) -> double {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+int main() {
+  std::cout << "[\n";
+  const size_t sizes[] = {1000, 10000, 100000, 200000};
+  for (size_t rows : sizes) {
+    MemoryArena arena(rows * kDim * sizeof(double) + KB(4));
+    Embedding embedding(arena, rows, kDim, 1);
+    SparseSGD sgd(0.01);
+    std::mt19937_64 gen(7);
+    std::uniform_int_distribution<size_t> pick(0, rows - 1);
+
+    auto start = std::chrono::steady_clock::now();
+    size_t touched = 0;
+    for (size_t step = 0; step < kSteps; step++) {
+      std::vector<size_t> batch(kBatch);
+      for (size_t &row : batch) {
+        row = pick(gen);
+      }
+      ValuePtr loss = create_value(0.0);
+      for (const ValuePtr &feature : embedding(batch)) {
+        loss = loss + feature * feature;
+      }
+      loss->backpropagate();
+      SparseGradient gradient = embedding.collect_gradients();
+      touched += gradient.rows.size();
+      sgd.step(embedding, gradient);
+    }
+    double sparse_us = elapsed(start) / kSteps * 1e6;
+
+    // What a dense optimizer pays per step just to visit every entry
+    start = std::chrono::steady_clock::now();
+    for (size_t step = 0; step < kSteps; step++) {
+      double *table = embedding.row(0);
+      for (size_t i = 0; i < rows * kDim; i++) {
+        table[i] -= 0.01 * table[i];
+      }
+    }
+    double dense_us = elapsed(start) / kSteps * 1e6;
+
+    std::cout << "  {\"rows\": " << rows << ", \"dim\": " << kDim
+              << ", \"batch\": " << kBatch
+              << ", \"rows_touched_per_step\": "
+              << static_cast<double>(touched) / kSteps
+              << ", \"sparse_step_us\": " << sparse_us
+              << ", \"dense_sweep_us\": " << dense_us << "}"
+              << (rows == 200000 ? "" : ",") << "\n";
+  }
+  std::cout << "]\n";
+  return 0;
+}
@@ -0,0 +1,79 @@
+#include "../core/Tensor/Autotune.hpp"
+#include "../core/Tensor/Tensor.h"
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+
+// GEMM time per layer of an MLP's batched forward pass, with the default
+// blocking and with the blocking the autotuner picked for this host. Tuning
+// is read from the cache when it has the shapes; --retune times them again.
+
+template <typename F> auto time_ms(double min_seconds, F &&step) -> double {
+  step();
+  size_t runs = 0;
+  auto start = std::chrono::steady_clock::now();
+  double elapsed = 0.0;
+  do {
+    step();
+    runs++;
+    elapsed = std::chrono::duration<double>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+  } while (elapsed < min_seconds);
+  return elapsed * 1e3 / runs;
+}
+
+int main(int argc, char **argv) {
+  TuneOptions options;
+  size_t batch = 64;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--retune") {
+      options.force = true;
+    } else {
+      batch = std::stoul(arg);
+    }
+  }
+
+  ModelShape shape{256, {512, 512, 10}, {}};
+  TuneReport report = autotune_gemm(shape, batch, options);
+
+  std::mt19937 gen(3);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+  std::cout << "{\"cpu\": \"" << report.cpu_model << "\", \"batch\": " << batch
+            << ", \"tuned\": " << report.tuned
+            << ", \"cached\": " << report.cached
+            << ", \"tune_seconds\": " << report.seconds << ",\n \"layers\": [";
+  std::vector<GemmShape> shapes = mlp_gemm_shapes(shape, batch);
+  for (size_t l = 0; l < shapes.size(); l++) {
+    const GemmShape &s = shapes[l];
+    std::vector<double> a(s.m * s.k);
+    std::vector<double> b(s.k * s.n);
+    std::vector<double> c(s.m * s.n);
+    for (double &x : a) {
+      x = uniform(gen);
+    }
+    for (double &x : b) {
+      x = uniform(gen);
+    }
+    GemmBlocking tuned = gemm_tuner().blocking(s);
+    auto run = [&](const GemmBlocking &blocking) {
+      return time_ms(0.2, [&]() {
+        gemm(s.m, s.n, s.k, {a.data(), s.k, 1}, {b.data(), s.n, 1},
+             c.data(), s.n, blocking);
+      });
+    };
+    double default_ms = run(GemmBlocking());
+    double tuned_ms = run(tuned);
+    double gflops = 2.0 * s.m * s.n * s.k / (tuned_ms * 1e6);
+    std::cout << (l ? ",\n  " : "\n  ") << "{\"m\": " << s.m
+              << ", \"n\": " << s.n << ", \"k\": " << s.k
+              << ", \"blocking\": \"" << to_string(tuned)
+              << "\", \"default_ms\": " << default_ms
+              << ", \"tuned_ms\": " << tuned_ms
+              << ", \"tuned_gflops\": " << gflops << "}";
+  }
+  std::cout << "\n]}\n";
+  return 0;
+}
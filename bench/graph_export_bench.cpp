@@ -0,0 +1,69 @@
+#include "../core/Neuron.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sys/resource.h>
+
+// Builds a ~1M node MLP graph and times streaming it out as DOT, flat and
+// with every neuron collapsed.
+
+auto peak_rss_kb() -> u64 {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return static_cast<u64>(usage.ru_maxrss);
+}
+
+void time_export(const ValuePtr &root, const GraphExportOptions &options,
+                 const char *name, const std::string &path) {
+  u64 rss_before = peak_rss_kb();
+  auto start = std::chrono::steady_clock::now();
+  {
+    std::ofstream file(path);
+    root->write_dot(file, options);
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+  std::ifstream file(path, std::ios::ate);
+  std::cout << "  {\"export\": \"" << name << "\", \"seconds\": " << seconds
+            << ", \"bytes\": " << file.tellg()
+            << ", \"peak_rss_growth_kb\": " << peak_rss_kb() - rss_before
+            << "},\n";
+}
+
+int main(int argc, char **argv) {
+  size_t width = argc > 1 ? std::stoul(argv[1]) : 512;
+  std::string path = argc > 2 ? argv[2] : "graph_export_bench.dot";
+
+  MultiLayerPerceptron mlp(width, {width * 2, width / 2, 1});
+  std::vector<ValuePtr> inputs;
+  for (size_t i = 0; i < width; i++) {
+    inputs.push_back(create_value(i * 0.001));
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  ValuePtr root = mlp(inputs)[0];
+  double build_seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+  size_t nodes = root->topological_order().size();
+
+  std::cout << "[\n  {\"nodes\": " << nodes
+            << ", \"build_seconds\": " << build_seconds << "},\n";
+  time_export(root, GraphExportOptions{}, "flat", path);
+
+  GraphExportOptions collapsed;
+  collapsed.collapse_groups = true;
+  time_export(root, collapsed, "collapsed", path);
+
+  GraphExportOptions limited;
+  limited.max_depth = 64;
+  limited.max_nodes = 100000;
+  time_export(root, limited, "limited", path);
+  std::cout << "  {}\n]\n";
+
+  std::remove(path.c_str());
+  return 0;
+}
@@ -0,0 +1,129 @@
+#include "../core/Train/Hogwild.hpp"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <thread>
+
+// Throughput and convergence of Hogwild SGD (atomic and striped updates)
+// against a synchronous all-reduce over the same batches, plus the raw cost
+// of contended adds into one shared array. Threads only run in parallel
+// with more than one core.
+
+constexpr size_t kFeatures = 16;
+
+auto make_dataset(size_t samples) -> TrainBatch {
+  std::mt19937_64 gen(5);
+  std::normal_distribution<double> normal(0.0, 1.0);
+  TrainBatch data;
+  data.size = samples;
+  for (size_t i = 0; i < samples; i++) {
+    double target = 0.0;
+    for (size_t j = 0; j < kFeatures; j++) {
+      double x = normal(gen);
+      data.inputs.push_back(x);
+      target += x * (j % 3 == 0 ? 0.5 : -0.25);
+    }
+    data.targets.push_back(std::abs(target));
+  }
+  return data;
+}
+
+auto mse(MultiLayerPerceptron &mlp, const TrainBatch &batch) -> ValuePtr {
+  ValuePtr loss = create_value(0.0);
+  std::vector<ValuePtr> x(kFeatures);
+  for (size_t i = 0; i < batch.size; i++) {
+    for (size_t j = 0; j < kFeatures; j++) {
+      x[j] = create_value(batch.inputs[i * kFeatures + j]);
+    }
+    ValuePtr diff = mlp(x)[0] - create_value(batch.targets[i]);
+    loss = loss + diff * diff;
+  }
+  return loss * create_value(1.0 / batch.size);
+}
+
+// Adds per second into a 4096 element array, every thread sweeping all of it
+auto add_rate(size_t threads, AccumulateMode mode) -> double {
+  const size_t size = 4096;
+  const size_t sweeps = 200;
+  SharedAccumulator<double> shared(std::vector<double>(size, 0.0), threads,
+                                   mode);
+  auto start = std::chrono::steady_clock::now();
+  {
+    std::vector<std::jthread> workers;
+    for (size_t t = 0; t < threads; t++) {
+      workers.emplace_back([&, t]() {
+        for (size_t s = 0; s < sweeps; s++) {
+          for (size_t i = 0; i < size; i++) {
+            shared.add(t, i, 1.0);
+          }
+          if (s % 8 == 7) {
+            shared.flush(t);
+          }
+        }
+        shared.flush(t);
+      });
+    }
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  return static_cast<double>(threads * sweeps * size) / seconds;
+}
+
+int main(int argc, char **argv) {
+  size_t samples = argc > 1 ? std::stoul(argv[1]) : 1024;
+  size_t epochs = argc > 2 ? std::stoul(argv[2]) : 3;
+  TrainBatch data = make_dataset(samples);
+  ModelShape shape{kFeatures,
+                   {32, 32, 1},
+                   {Activation::Relu, Activation::Relu, Activation::Identity}};
+
+  struct Mode {
+    const char *name;
+    bool synchronous;
+    AccumulateMode accumulate;
+  };
+  const Mode modes[] = {{"allreduce", true, AccumulateMode::Atomic},
+                        {"hogwild_atomic", false, AccumulateMode::Atomic},
+                        {"hogwild_striped", false, AccumulateMode::Striped}};
+
+  std::cout << "{\"samples\": " << samples << ", \"epochs\": " << epochs
+            << ", \"hardware_threads\": " << std::thread::hardware_concurrency()
+            << ",\n \"runs\": [";
+  bool first = true;
+  for (size_t threads : {1, 2, 4}) {
+    for (const Mode &mode : modes) {
+      MultiLayerPerceptron mlp(shape, 3, InitScheme::HeUniform);
+      HogwildOptions options;
+      options.learning_rate = 0.01;
+      options.threads = threads;
+      options.batch = 4;
+      options.epochs = epochs;
+      options.synchronous = mode.synchronous;
+      options.mode = mode.accumulate;
+      HogwildStats stats = HogwildTrainer(mlp, options).run(data, mse);
+
+      std::cout << (first ? "\n  " : ",\n  ") << "{\"mode\": \"" << mode.name
+                << "\", \"threads\": " << threads
+                << ", \"samples_per_second\": " << stats.samples_per_second()
+                << ", \"epoch_losses\": [";
+      for (size_t e = 0; e < stats.epoch_losses.size(); e++) {
+        std::cout << (e ? ", " : "") << stats.epoch_losses[e];
+      }
+      std::cout << "]}";
+      first = false;
+    }
+  }
+  std::cout << "\n ],\n \"adds_per_second\": [";
+  first = true;
+  for (size_t threads : {1, 2, 4}) {
+    std::cout << (first ? "\n  " : ",\n  ") << "{\"threads\": " << threads
+              << ", \"atomic\": " << add_rate(threads, AccumulateMode::Atomic)
+              << ", \"striped\": "
+              << add_rate(threads, AccumulateMode::Striped) << "}";
+    first = false;
+  }
+  std::cout << "\n ]}\n";
+  return 0;
+}
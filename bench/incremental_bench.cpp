@@ -0,0 +1,118 @@
+#include "../core/Graph/Incremental.hpp"
+#include "../core/Graph/Optimize.hpp"
+#include "../core/Neuron.h"
+#include <chrono>
+#include <iostream>
+#include <random>
+
+// A sensitivity sweep over one sample: perturb one input feature or weight,
+// read the loss and its gradients, put it back. Each perturbation rebuilds
+// the graph, replays a captured tape, or updates an IncrementalTape.
+
+template <typename F> auto time_ms(size_t repeats, F &&step) -> double {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < repeats; i++) {
+    step(i);
+  }
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+             .count() /
+         repeats;
+}
+
+int main(int argc, char **argv) {
+  size_t samples = argc > 1 ? std::stoul(argv[1]) : 64;
+  const size_t num_inputs = 16;
+  const double step = 1e-3;
+
+  MultiLayerPerceptron mlp(ModelShape{num_inputs,
+                                      {64, 64, 1},
+                                      {Activation::Relu, Activation::Relu,
+                                       Activation::Identity}},
+                           3, InitScheme::HeUniform);
+  std::mt19937 gen(7);
+  std::normal_distribution<double> normal(0.0, 1.0);
+  std::vector<ValuePtr> inputs;
+  for (size_t j = 0; j < num_inputs; j++) {
+    inputs.push_back(create_value(normal(gen)));
+  }
+  auto build = [&]() {
+    ValuePtr diff = mlp(inputs)[0] - create_constant(0.5);
+    return diff * diff;
+  };
+
+  Tape tape = optimize(Tape::capture(build()));
+  IncrementalTape graph(tape);
+
+  // Inputs, the first layer's weights and the last hidden layer's weights,
+  // sampled evenly
+  std::vector<ValuePtr> params = mlp.parameters();
+  size_t first = (num_inputs + 1) * 64;
+  size_t second = first + 65 * 64;
+  struct Sweep {
+    const char *name;
+    std::vector<ValuePtr> leaves;
+  };
+  std::vector<Sweep> sweeps{{"input", inputs}, {"layer1", {}}, {"layer2", {}}};
+  for (size_t i = 0; i < samples; i++) {
+    sweeps[1].leaves.push_back(params[i * first / samples]);
+    sweeps[2].leaves.push_back(params[first + i * (second - first) / samples]);
+  }
+
+  std::cout << "{\"nodes\": " << tape.root() + 1 << ", \"sweeps\": [";
+  for (size_t s = 0; s < sweeps.size(); s++) {
+    const std::vector<ValuePtr> &leaves = sweeps[s].leaves;
+    size_t n = leaves.size();
+    auto perturb = [&](size_t i, auto &&evaluate) {
+      double original = leaves[i]->get_value();
+      leaves[i]->set_value(original + step);
+      evaluate();
+      leaves[i]->set_value(original);
+    };
+
+    double rebuild_ms = time_ms(n, [&](size_t i) {
+      perturb(i, [&]() { build()->backpropagate(); });
+    });
+    double tape_ms = time_ms(n, [&](size_t i) {
+      perturb(i, [&]() {
+        tape.forward();
+        tape.backward();
+      });
+    });
+    double tape_forward_ms = time_ms(n, [&](size_t i) {
+      perturb(i, [&]() { tape.forward(); });
+    });
+    double incremental_forward_ms = time_ms(n, [&](size_t i) {
+      u32 leaf = graph.leaf(leaves[i]);
+      double original = leaves[i]->get_value();
+      graph.set_value(leaf, original + step);
+      graph.forward();
+      graph.set_value(leaf, original);
+    });
+    graph.backward(); // Settle the gradients the forward sweep left behind
+
+    size_t forward_nodes = 0;
+    size_t backward_nodes = 0;
+    double incremental_ms = time_ms(n, [&](size_t i) {
+      u32 leaf = graph.leaf(leaves[i]);
+      double original = leaves[i]->get_value();
+      graph.set_value(leaf, original + step);
+      graph.backward();
+      forward_nodes += graph.stats().forward_nodes;
+      backward_nodes += graph.stats().backward_nodes;
+      graph.set_value(leaf, original); // Picked up by the next backward()
+    });
+
+    std::cout << (s == 0 ? "\n  " : ",\n  ") << "{\"perturb\": \""
+              << sweeps[s].name << "\", \"count\": " << n
+              << ", \"rebuild_ms\": " << rebuild_ms
+              << ", \"tape_ms\": " << tape_ms
+              << ", \"incremental_ms\": " << incremental_ms
+              << ", \"tape_forward_ms\": " << tape_forward_ms
+              << ", \"incremental_forward_ms\": " << incremental_forward_ms
+              << ", \"avg_forward_nodes\": " << forward_nodes / n
+              << ", \"avg_backward_nodes\": " << backward_nodes / n << "}";
+  }
+  std::cout << "\n]}\n";
+  return 0;
+}
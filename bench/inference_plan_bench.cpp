@@ -0,0 +1,135 @@
+#include "../core/Serve/BatchEngine.hpp"
+#include "../core/Serve/InferencePlan.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+// Single-sample latency of two 3-layer MLPs, timing every call: the f64
+// layer code, BatchedMLP with a batch of one and the compiled plan with each
+// kernel. The plan is also run from several threads at once, each with its
+// own workspace, to show calls do not serialize on shared state.
+
+constexpr size_t kCalls = 20000;
+constexpr size_t kThreads = 4;
+
+struct Latency {
+  double p50_us = 0.0;
+  double p99_us = 0.0;
+  double mean_us = 0.0;
+};
+
+auto summarize(std::vector<double> &ns) -> Latency {
+  std::sort(ns.begin(), ns.end());
+  Latency latency;
+  latency.p50_us = ns[ns.size() / 2] / 1e3;
+  latency.p99_us = ns[ns.size() * 99 / 100] / 1e3;
+  for (double t : ns) {
+    latency.mean_us += t / 1e3;
+  }
+  latency.mean_us /= static_cast<double>(ns.size());
+  return latency;
+}
+
+// Times kCalls calls of call(sample) per thread, cycling over the samples
+template <typename Call>
+auto measure(size_t threads, size_t samples, Call call) -> Latency {
+  std::vector<std::vector<double>> ns(threads, std::vector<double>(kCalls));
+  auto work = [&](size_t t) {
+    auto run = call(t); // Per-thread state, made before the clock starts
+    for (size_t c = 0; c < kCalls; c++) {
+      auto start = std::chrono::steady_clock::now();
+      run(c % samples);
+      ns[t][c] = std::chrono::duration<double, std::nano>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+    }
+  };
+  std::vector<std::thread> pool;
+  for (size_t t = 1; t < threads; t++) {
+    pool.emplace_back(work, t);
+  }
+  work(0);
+  for (std::thread &thread : pool) {
+    thread.join();
+  }
+  std::vector<double> all;
+  for (const std::vector<double> &per_thread : ns) {
+    all.insert(all.end(), per_thread.begin(), per_thread.end());
+  }
+  return summarize(all);
+}
+
+void print(const char *path, size_t threads, const Latency &latency,
+           bool last) {
+  std::cout << "    {\"path\": \"" << path << "\", \"threads\": " << threads
+            << ", \"p50_us\": " << latency.p50_us
+            << ", \"p99_us\": " << latency.p99_us
+            << ", \"mean_us\": " << latency.mean_us << "}"
+            << (last ? "\n" : ",\n");
+}
+
+void bench(const ModelShape &shape, bool last) {
+  constexpr size_t kSamples = 64;
+  MultiLayerPerceptron mlp(shape, 1, InitScheme::HeNormal);
+  size_t in = shape.inputs;
+  size_t out = shape.layer_sizes.back();
+  std::mt19937_64 gen(2);
+  std::normal_distribution<double> dis(0.0, 1.0);
+  std::vector<double> x64(kSamples * in);
+  for (double &v : x64) {
+    v = dis(gen);
+  }
+  std::vector<f32> x32(x64.begin(), x64.end());
+
+  std::cout << "  {\"shape\": [" << in;
+  for (size_t size : shape.layer_sizes) {
+    std::cout << ", " << size;
+  }
+  std::cout << "], \"paths\": [\n";
+
+  print("f64_layers", 1, measure(1, kSamples, [&](size_t) {
+          return [&, scratch = std::vector<double>(2 * mlp.max_width()),
+                  y = std::vector<double>(out)](size_t s) mutable {
+            mlp.evaluate(x64.data() + s * in, y.data(), scratch.data());
+          };
+        }),
+        false);
+
+  BatchedMLP batched(mlp);
+  print("batched_mlp", 1, measure(1, kSamples, [&](size_t) {
+          return [&, y = std::vector<double>(out)](size_t s) mutable {
+            batched.forward(x64.data() + s * in, 1, y.data());
+          };
+        }),
+        false);
+
+  std::vector<PlanKernel> kernels = {PlanKernel::Scalar};
+  if (plan_avx2_supported()) {
+    kernels.push_back(PlanKernel::Avx2);
+  }
+  for (PlanKernel kernel : kernels) {
+    const InferencePlan plan = InferencePlan::compile(mlp, kernel);
+    const char *name =
+        kernel == PlanKernel::Avx2 ? "plan_avx2" : "plan_scalar";
+    for (size_t threads : {size_t{1}, kThreads}) {
+      print(name, threads, measure(threads, kSamples, [&](size_t) {
+              return [&, workspace = plan.workspace(),
+                      y = std::vector<f32>(out)](size_t s) mutable {
+                plan.run(x32.data() + s * in, y.data(), workspace);
+              };
+            }),
+            kernel == kernels.back() && threads == kThreads);
+    }
+  }
+  std::cout << "  ]}" << (last ? "\n" : ",\n");
+}
+
+int main() {
+  std::cout << "{\"avx2\": " << (plan_avx2_supported() ? "true" : "false")
+            << ", \"calls_per_thread\": " << kCalls << ", \"models\": [\n";
+  bench(ModelShape{16, {32, 32, 4}, {}}, false);
+  bench(ModelShape{64, {256, 256, 10}, {}}, true);
+  std::cout << "]}\n";
+  return 0;
+}
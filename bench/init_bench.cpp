@@ -0,0 +1,71 @@
+#include "../core/Model/Format.hpp"
+#include "../core/Neuron.h"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+// Parameter initialization throughput. Fills a square MLP with about
+// `params` parameters (100M by default, 800MB of doubles) once per thread
+// count and scheme, reporting the wall time of each fill ("buffer").
+//
+// Then builds a seeded MultiLayerPerceptron of about `model_params`
+// parameters (4M by default) and reports that too ("model"). The model
+// makes one Value per parameter on one thread, so its rate, not the
+// buffer's, is what a 100M-parameter model would see.
+
+auto square_shape(size_t params, size_t width) -> ModelShape {
+  ModelShape shape{width, {}, {}};
+  while (shape.parameter_count() < params) {
+    shape.layer_sizes.push_back(width);
+  }
+  return shape;
+}
+
+auto elapsed(std::chrono::steady_clock::time_point start) -> double {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+int main(int argc, char **argv) {
+  size_t params = argc > 1 ? std::stoul(argv[1]) : 100000000;
+  size_t model_params = argc > 2 ? std::stoul(argv[2]) : 4000000;
+  ModelShape shape = square_shape(params, 4096);
+
+  std::vector<double> buffer(shape.parameter_count());
+  size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+
+  std::cout << "[\n";
+  bool first = true;
+  for (InitScheme scheme : {InitScheme::HeUniform, InitScheme::HeNormal}) {
+    for (size_t threads = 1; threads <= hardware; threads *= 2) {
+      auto start = std::chrono::steady_clock::now();
+      initialize_parameters(shape, 1, scheme, buffer.data(), threads);
+      double seconds = elapsed(start);
+
+      std::cout << (first ? "" : ",\n")
+                << "  {\"stage\": \"buffer\", \"parameters\": "
+                << buffer.size() << ", \"scheme\": \""
+                << (scheme == InitScheme::HeUniform ? "he_uniform"
+                                                    : "he_normal")
+                << "\", \"threads\": " << threads
+                << ", \"seconds\": " << seconds
+                << ", \"parameters_per_second\": " << buffer.size() / seconds
+                << "}";
+      first = false;
+    }
+  }
+
+  ModelShape model_shape = square_shape(model_params, 1024);
+  auto start = std::chrono::steady_clock::now();
+  MultiLayerPerceptron mlp(model_shape, 1, InitScheme::HeUniform);
+  double seconds = elapsed(start);
+  size_t built = model_shape.parameter_count();
+  std::cout << ",\n  {\"stage\": \"model\", \"parameters\": " << built
+            << ", \"scheme\": \"he_uniform\", \"threads\": 1"
+            << ", \"seconds\": " << seconds
+            << ", \"parameters_per_second\": " << built / seconds << "}";
+  std::cout << "\n]\n";
+  return 0;
+}
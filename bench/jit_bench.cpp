@@ -0,0 +1,76 @@
+#include "../core/Graph/Jit.hpp"
+#include "../core/Graph/Optimize.hpp"
+#include "../core/Neuron.h"
+#include <chrono>
+#include <iostream>
+#include <random>
+
+// Step time of one minibatch MSE loss graph replayed as an optimized tape
+// and as compiled native code, with the cold (compiler) and warm (disk
+// cache) cost of building the native version.
+
+template <typename F> auto time_ms(size_t repeats, F &&step) -> double {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < repeats; i++) {
+    step();
+  }
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+             .count() /
+         repeats;
+}
+
+int main(int argc, char **argv) {
+  size_t batch = argc > 1 ? std::stoul(argv[1]) : 4;
+  size_t repeats = argc > 2 ? std::stoul(argv[2]) : 100;
+  const size_t num_inputs = 8;
+
+  MultiLayerPerceptron mlp(num_inputs, {16, 16, 1});
+  std::mt19937 gen(7);
+  std::normal_distribution<double> normal(0.0, 1.0);
+
+  std::vector<std::vector<ValuePtr>> inputs(batch);
+  std::vector<double> targets(batch);
+  for (size_t i = 0; i < batch; i++) {
+    for (size_t j = 0; j < num_inputs; j++) {
+      inputs[i].push_back(create_value(normal(gen)));
+    }
+    targets[i] = std::abs(normal(gen));
+  }
+
+  ValuePtr loss = create_constant(0.0);
+  for (size_t i = 0; i < batch; i++) {
+    ValuePtr diff = mlp(inputs[i])[0] - create_constant(targets[i]);
+    loss = loss + diff * diff;
+  }
+  loss = loss * create_constant(1.0 / batch);
+  Tape tape = optimize(Tape::capture(loss));
+
+  JitOptions options;
+  options.cache_dir = std::filesystem::temp_directory_path() / "jit_bench";
+  std::filesystem::remove_all(options.cache_dir);
+
+  CompiledTape cold;
+  double cold_ms =
+      time_ms(1, [&]() { cold = CompiledTape::compile(tape, options); });
+  CompiledTape warm;
+  double warm_ms =
+      time_ms(1, [&]() { warm = CompiledTape::compile(tape, options); });
+
+  double tape_ms = time_ms(repeats, [&]() {
+    tape.forward();
+    tape.backward();
+  });
+  double jit_ms = time_ms(repeats, [&]() { warm.run(); });
+
+  std::cout << "{\"batch\": " << batch << ", \"nodes\": " << tape.size()
+            << ", \"backend\": \""
+            << (warm.backend() == JitBackend::Native ? "native"
+                                                     : "interpreter")
+            << "\", \"cache_hit\": " << (warm.cache_hit() ? "true" : "false")
+            << ",\n \"compile_cold_ms\": " << cold_ms
+            << ", \"compile_warm_ms\": " << warm_ms
+            << ", \"tape_step_ms\": " << tape_ms
+            << ", \"jit_step_ms\": " << jit_ms << "}\n";
+  return 0;
+}
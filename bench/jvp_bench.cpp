@@ -0,0 +1,69 @@
+#include "../core/Forward/Jvp.hpp"
+#include <chrono>
+#include <iostream>
+
+// Cost of K Jacobian-vector products by forward mode relative to the plain
+// forward pass (BatchDual with zero lanes runs the same code on doubles),
+// and of the full input gradient by reverse mode through the graph.
+
+constexpr size_t kInputs = 8;
+constexpr size_t kIterations = 2000;
+
+// Keeps the forward passes from being optimized away
+volatile double g_sink = 0.0;
+
+auto elapsed(std::chrono::steady_clock::time_point start) -> double {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+template <size_t K> auto forward_us(const MultiLayerPerceptron &mlp) -> double {
+  Jvp<K> jvp(mlp);
+  double x[kInputs];
+  double directions[kInputs * (K ? K : 1)] = {};
+  double outputs[1];
+  double tangents[K ? K : 1];
+  for (size_t i = 0; i < kInputs; i++) {
+    x[i] = 0.1 * static_cast<double>(i);
+  }
+  for (size_t k = 0; k < K; k++) {
+    directions[k * K + k] = 1.0;
+  }
+
+  double checksum = 0.0;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t it = 0; it < kIterations; it++) {
+    x[0] = 0.001 * static_cast<double>(it);
+    jvp(x, directions, outputs, tangents);
+    checksum += outputs[0];
+  }
+  double seconds = elapsed(start);
+  g_sink = checksum;
+  return seconds / kIterations * 1e6;
+}
+
+auto reverse_us(MultiLayerPerceptron &mlp) -> double {
+  std::vector<ValuePtr> inputs(kInputs);
+  auto start = std::chrono::steady_clock::now();
+  for (size_t it = 0; it < kIterations / 10; it++) {
+    for (size_t i = 0; i < kInputs; i++) {
+      inputs[i] = create_value(0.1 * static_cast<double>(i));
+    }
+    mlp(inputs)[0]->backpropagate();
+  }
+  return elapsed(start) / (kIterations / 10) * 1e6;
+}
+
+int main() {
+  MultiLayerPerceptron mlp(kInputs, {32, 32, 1}, 1);
+
+  double plain = forward_us<0>(mlp);
+  std::cout << "{\"layers\": [32, 32, 1], \"inputs\": " << kInputs
+            << ", \"plain_forward_us\": " << plain
+            << ", \"jvp_1_us\": " << forward_us<1>(mlp)
+            << ", \"jvp_4_us\": " << forward_us<4>(mlp)
+            << ", \"jvp_8_us\": " << forward_us<8>(mlp)
+            << ", \"reverse_gradient_us\": " << reverse_us(mlp) << "}\n";
+  return 0;
+}
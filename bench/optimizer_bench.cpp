@@ -0,0 +1,75 @@
+#include "../core/Graph/Optimize.hpp"
+#include "../core/Graph/Tape.hpp"
+#include "../core/Neuron.h"
+#include <chrono>
+#include <iostream>
+#include <random>
+
+// Node counts and step times of one minibatch MSE loss graph: rebuilding
+// the Value graph every step, replaying the captured tape, and replaying
+// the peephole-optimized tape.
+
+template <typename F> auto time_ms(size_t repeats, F &&step) -> double {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < repeats; i++) {
+    step();
+  }
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+             .count() /
+         repeats;
+}
+
+int main(int argc, char **argv) {
+  size_t batch = argc > 1 ? std::stoul(argv[1]) : 16;
+  size_t repeats = argc > 2 ? std::stoul(argv[2]) : 10;
+  const size_t num_inputs = 8;
+
+  MultiLayerPerceptron mlp(num_inputs, {32, 32, 1});
+  std::mt19937 gen(7);
+  std::normal_distribution<double> normal(0.0, 1.0);
+
+  std::vector<std::vector<ValuePtr>> inputs(batch);
+  std::vector<double> targets(batch);
+  for (size_t i = 0; i < batch; i++) {
+    for (size_t j = 0; j < num_inputs; j++) {
+      inputs[i].push_back(create_value(normal(gen)));
+    }
+    targets[i] = std::abs(normal(gen));
+  }
+
+  auto build_loss = [&]() {
+    ValuePtr loss = create_constant(0.0);
+    for (size_t i = 0; i < batch; i++) {
+      ValuePtr diff = mlp(inputs[i])[0] - create_constant(targets[i]);
+      loss = loss + diff * diff;
+    }
+    return loss * create_constant(1.0 / batch);
+  };
+
+  ValuePtr loss = build_loss();
+  Tape captured = Tape::capture(loss);
+  OptimizeStats stats;
+  Tape optimized = optimize(captured, &stats);
+
+  double graph_ms = time_ms(repeats, [&]() { build_loss()->backpropagate(); });
+  double tape_ms = time_ms(repeats, [&]() {
+    captured.forward();
+    captured.backward();
+  });
+  double optimized_ms = time_ms(repeats, [&]() {
+    optimized.forward();
+    optimized.backward();
+  });
+
+  std::cout << "{\"batch\": " << batch
+            << ", \"nodes_before\": " << stats.nodes_before
+            << ", \"nodes_after\": " << stats.nodes_after
+            << ", \"folded\": " << stats.folded
+            << ", \"neg_sub\": " << stats.neg_sub << ", \"fma\": " << stats.fma
+            << ", \"cse\": " << stats.cse << ", \"dead\": " << stats.dead
+            << ",\n \"graph_step_ms\": " << graph_ms
+            << ", \"tape_step_ms\": " << tape_ms
+            << ", \"optimized_tape_step_ms\": " << optimized_ms << "}\n";
+  return 0;
+}
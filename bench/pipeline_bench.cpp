@@ -0,0 +1,90 @@
+#include "../core/Train/Pipeline.hpp"
+#include <cmath>
+#include <iostream>
+#include <random>
+
+// Step time of the serial loop against the pipelined trainer on the same
+// data. The loader does some per-sample preprocessing (standardizing and
+// jittering every feature) so there is loading work to hide. The pipeline
+// can only overlap stages when there is more than one core.
+
+constexpr size_t kFeatures = 16;
+
+auto make_loader(size_t steps, size_t batch_size) -> BatchLoader {
+  return [=](size_t step, TrainBatch &batch) {
+    if (step >= steps) {
+      return false;
+    }
+    std::mt19937_64 gen(step);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    batch.size = batch_size;
+    batch.inputs.resize(batch_size * kFeatures);
+    batch.targets.resize(batch_size);
+    for (size_t i = 0; i < batch_size; i++) {
+      double *x = batch.inputs.data() + i * kFeatures;
+      double mean = 0.0;
+      for (size_t j = 0; j < kFeatures; j++) {
+        x[j] = 3.0 + 2.0 * normal(gen);
+        mean += x[j] / kFeatures;
+      }
+      double variance = 0.0;
+      for (size_t j = 0; j < kFeatures; j++) {
+        variance += (x[j] - mean) * (x[j] - mean) / kFeatures;
+      }
+      double target = 0.0;
+      for (size_t j = 0; j < kFeatures; j++) {
+        x[j] = (x[j] - mean) / std::sqrt(variance + 1e-8) +
+               0.01 * normal(gen);
+        target += x[j] * (j % 3 == 0 ? 0.5 : -0.25);
+      }
+      batch.targets[i] = std::abs(target);
+    }
+    return true;
+  };
+}
+
+auto mse(MultiLayerPerceptron &mlp, const TrainBatch &batch) -> ValuePtr {
+  ValuePtr loss = create_value(0.0);
+  std::vector<ValuePtr> x(kFeatures);
+  for (size_t i = 0; i < batch.size; i++) {
+    for (size_t j = 0; j < kFeatures; j++) {
+      x[j] = create_value(batch.inputs[i * kFeatures + j]);
+    }
+    ValuePtr diff = mlp(x)[0] - create_value(batch.targets[i]);
+    loss = loss + diff * diff;
+  }
+  return loss * create_value(1.0 / batch.size);
+}
+
+int main(int argc, char **argv) {
+  size_t steps = argc > 1 ? std::stoul(argv[1]) : 200;
+  size_t batch_size = argc > 2 ? std::stoul(argv[2]) : 16;
+
+  std::cout << "{\"steps\": " << steps << ", \"batch\": " << batch_size
+            << ", \"hardware_threads\": " << std::thread::hardware_concurrency()
+            << ",\n \"runs\": [\n";
+  for (bool pipelined : {false, true}) {
+    MultiLayerPerceptron mlp(
+        ModelShape{kFeatures,
+                   {32, 32, 1},
+                   {Activation::Relu, Activation::Relu, Activation::Identity}},
+        1, InitScheme::HeUniform);
+    PipelinedTrainer trainer(mlp, PipelineOptions{0.01, pipelined});
+    PipelineStats stats = trainer.run(make_loader(steps, batch_size), mse);
+
+    double tail = 0.0;
+    size_t count = std::min<size_t>(20, stats.losses.size());
+    for (size_t i = stats.losses.size() - count; i < stats.losses.size();
+         i++) {
+      tail += stats.losses[i] / count;
+    }
+    std::cout << "  {\"mode\": \"" << (pipelined ? "pipelined" : "serial")
+              << "\", \"step_ms\": " << stats.step_ms()
+              << ", \"load_wait_ms\": " << stats.load_wait_seconds * 1e3
+              << ", \"update_wait_ms\": " << stats.update_wait_seconds * 1e3
+              << ", \"final_loss\": " << tail << "}"
+              << (pipelined ? "\n" : ",\n");
+  }
+  std::cout << "]}\n";
+  return 0;
+}
@@ -0,0 +1,66 @@
+#include "../core/Graph/Optimize.hpp"
+#include "../core/Graph/Plan.hpp"
+#include "../core/Neuron.h"
+#include <chrono>
+#include <iostream>
+#include <random>
+
+// Memory of one minibatch MSE loss tape, a slot per value and gradient
+// against the liveness plan, and the step time of replaying each.
+
+template <typename F> auto time_ms(size_t repeats, F &&step) -> double {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < repeats; i++) {
+    step();
+  }
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+             .count() /
+         repeats;
+}
+
+int main(int argc, char **argv) {
+  size_t repeats = argc > 1 ? std::stoul(argv[1]) : 20;
+  const size_t num_inputs = 16;
+
+  MultiLayerPerceptron mlp(ModelShape{num_inputs,
+                                      {64, 64, 1},
+                                      {Activation::Relu, Activation::Relu,
+                                       Activation::Identity}},
+                           3, InitScheme::HeUniform);
+  std::mt19937 gen(7);
+  std::normal_distribution<double> normal(0.0, 1.0);
+
+  std::cout << "{\"runs\": [";
+  for (size_t batch : {1, 8, 32}) {
+    std::vector<std::vector<ValuePtr>> inputs(batch);
+    ValuePtr loss = create_constant(0.0);
+    for (size_t i = 0; i < batch; i++) {
+      for (size_t j = 0; j < num_inputs; j++) {
+        inputs[i].push_back(create_value(normal(gen)));
+      }
+      ValuePtr diff =
+          mlp(inputs[i])[0] - create_constant(std::abs(normal(gen)));
+      loss = loss + diff * diff;
+    }
+    Tape tape = optimize(Tape::capture(loss * create_constant(1.0 / batch)));
+    PlannedTape planned = PlannedTape::plan(tape);
+    const MemoryPlanStats &stats = planned.stats();
+
+    double tape_ms = time_ms(repeats, [&]() {
+      tape.forward();
+      tape.backward();
+    });
+    double planned_ms = time_ms(repeats, [&]() { planned.run(); });
+
+    std::cout << (batch == 1 ? "\n  " : ",\n  ") << "{\"batch\": " << batch
+              << ", \"nodes\": " << stats.nodes
+              << ", \"naive_bytes\": " << stats.naive_bytes
+              << ", \"planned_bytes\": " << stats.planned_bytes
+              << ", \"in_place\": " << stats.in_place
+              << ", \"tape_step_ms\": " << tape_ms
+              << ", \"planned_step_ms\": " << planned_ms << "}";
+  }
+  std::cout << "\n]}\n";
+  return 0;
+}
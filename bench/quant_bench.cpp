@@ -0,0 +1,198 @@
+#include "../core/Quant/Quantize.hpp"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+// Accuracy against latency for one MLP served four ways: the f64 layer code,
+// an f32 copy of the same weights and the int8 model with the scalar and the
+// AVX2 kernel, per layer and per channel. Errors are against f64 over held
+// out inputs; "top1" is how often the largest output lands on the same index.
+
+constexpr size_t kInputs = 256;
+constexpr size_t kHidden = 512;
+constexpr size_t kOutputs = 10;
+constexpr size_t kCalibration = 512;
+constexpr size_t kTest = 1000;
+
+auto elapsed(std::chrono::steady_clock::time_point start) -> double {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+// The f32 baseline: neuron-major weights, the same summation order as f64
+class Float32MLP {
+public:
+  explicit Float32MLP(const MultiLayerPerceptron &mlp) {
+    for (size_t l = 0; l < mlp.num_layers(); l++) {
+      Dense dense;
+      dense.activation = mlp.layer(l).activation();
+      dense.outputs = mlp.layer(l).size();
+      for (const ValuePtr &p : mlp.layer(l).parameters()) {
+        dense.parameters.push_back(static_cast<f32>(p->get_value()));
+      }
+      dense.inputs = dense.parameters.size() / dense.outputs - 1;
+      _layers.push_back(dense);
+    }
+    _scratch.resize(2 * mlp.max_width());
+  }
+
+  void run(const f32 *inputs, f32 *outputs) {
+    const f32 *current = inputs;
+    size_t width = _scratch.size() / 2;
+    for (size_t l = 0; l < _layers.size(); l++) {
+      const Dense &dense = _layers[l];
+      f32 *out = l + 1 == _layers.size() ? outputs
+                                         : _scratch.data() + (l % 2) * width;
+      for (size_t o = 0; o < dense.outputs; o++) {
+        const f32 *row = dense.parameters.data() + o * (dense.inputs + 1);
+        f32 sum = row[dense.inputs];
+        for (size_t i = 0; i < dense.inputs; i++) {
+          sum += current[i] * row[i];
+        }
+        out[o] = static_cast<f32>(apply_activation(dense.activation, sum));
+      }
+      current = out;
+    }
+  }
+
+private:
+  struct Dense {
+    size_t inputs = 0;
+    size_t outputs = 0;
+    Activation activation = Activation::Relu;
+    std::vector<f32> parameters;
+  };
+  std::vector<Dense> _layers;
+  std::vector<f32> _scratch;
+};
+
+struct Report {
+  double mean_error = 0.0;
+  double max_error = 0.0;
+  double top1 = 0.0;
+  double us_per_sample = 0.0;
+};
+
+auto argmax(const f32 *values) -> size_t {
+  return static_cast<size_t>(std::max_element(values, values + kOutputs) -
+                             values);
+}
+
+template <typename Run>
+auto measure(const std::vector<std::vector<double>> &reference,
+             const std::vector<std::vector<f32>> &inputs, Run run)
+    -> Report {
+  Report report;
+  std::vector<f32> out(kOutputs);
+  size_t agree = 0;
+  for (size_t s = 0; s < inputs.size(); s++) {
+    run(inputs[s].data(), out.data());
+    size_t best = 0;
+    for (size_t o = 0; o < kOutputs; o++) {
+      double error = std::abs(out[o] - reference[s][o]);
+      report.mean_error += error;
+      report.max_error = std::max(report.max_error, error);
+      best = reference[s][o] > reference[s][best] ? o : best;
+    }
+    agree += argmax(out.data()) == best ? 1 : 0;
+  }
+  report.mean_error /= inputs.size() * kOutputs;
+  report.top1 = static_cast<double>(agree) / inputs.size();
+
+  // Timed separately so the error bookkeeping is not in the latency
+  auto start = std::chrono::steady_clock::now();
+  for (const std::vector<f32> &x : inputs) {
+    run(x.data(), out.data());
+  }
+  report.us_per_sample = elapsed(start) / inputs.size() * 1e6;
+  return report;
+}
+
+void print(const char *path, const Report &report, const Report &f64,
+           bool last) {
+  std::cout << "  {\"path\": \"" << path
+            << "\", \"us_per_sample\": " << report.us_per_sample
+            << ", \"speedup_vs_f64\": "
+            << f64.us_per_sample / report.us_per_sample
+            << ", \"mean_abs_error\": " << report.mean_error
+            << ", \"max_abs_error\": " << report.max_error
+            << ", \"top1_agreement\": " << report.top1 << "}"
+            << (last ? "\n" : ",\n");
+}
+
+int main() {
+  ModelShape shape{kInputs,
+                   {kHidden, kHidden, kOutputs},
+                   {Activation::Relu, Activation::Relu, Activation::Identity}};
+  MultiLayerPerceptron mlp(shape, 1, InitScheme::HeNormal);
+
+  std::mt19937_64 gen(2);
+  std::normal_distribution<double> dis(0.0, 1.0);
+  auto draw = [&](size_t count) {
+    std::vector<std::vector<double>> result(count,
+                                            std::vector<double>(kInputs));
+    for (std::vector<double> &x : result) {
+      for (double &v : x) {
+        v = dis(gen);
+      }
+    }
+    return result;
+  };
+  std::vector<std::vector<double>> calibration = draw(kCalibration);
+  std::vector<std::vector<double>> test = draw(kTest);
+
+  std::vector<std::vector<f32>> test_f32;
+  std::vector<std::vector<double>> reference(kTest,
+                                             std::vector<double>(kOutputs));
+  std::vector<double> scratch(2 * mlp.max_width());
+  for (size_t s = 0; s < kTest; s++) {
+    test_f32.emplace_back(test[s].begin(), test[s].end());
+    mlp.evaluate(test[s].data(), reference[s].data(), scratch.data());
+  }
+
+  std::vector<double> in64(kInputs);
+  std::vector<double> out64(kOutputs);
+  Report f64 = measure(reference, test_f32, [&](const f32 *x, f32 *y) {
+    std::copy(x, x + kInputs, in64.begin());
+    mlp.evaluate(in64.data(), out64.data(), scratch.data());
+    std::copy(out64.begin(), out64.end(), y);
+  });
+
+  Float32MLP float32(mlp);
+  Report f32_report = measure(reference, test_f32, [&](const f32 *x, f32 *y) {
+    float32.run(x, y);
+  });
+
+  QuantizedMLP per_layer = QuantizedMLP::quantize(
+      mlp, calibration, QuantGranularity::PerLayer);
+  QuantizedMLP per_channel = QuantizedMLP::quantize(mlp, calibration);
+  auto int8 = [&](const QuantizedMLP &model, QuantKernel kernel) {
+    QuantizedMLP::Workspace workspace = model.workspace();
+    return measure(reference, test_f32, [&](const f32 *x, f32 *y) {
+      model.run(x, y, workspace, kernel);
+    });
+  };
+
+  std::cout << "{\"weight_bytes\": {\"f64\": "
+            << shape.parameter_count() * sizeof(f64)
+            << ", \"f32\": " << shape.parameter_count() * sizeof(f32)
+            << ", \"int8\": " << per_channel.weight_bytes() << "},\n"
+            << " \"avx2\": " << (avx2_supported() ? "true" : "false")
+            << ",\n \"paths\": [\n";
+  print("f64", f64, f64, false);
+  print("f32", f32_report, f64, false);
+  print("int8_per_layer_scalar", int8(per_layer, QuantKernel::Scalar), f64,
+        false);
+  print("int8_per_channel_scalar", int8(per_channel, QuantKernel::Scalar),
+        f64, !avx2_supported());
+  if (avx2_supported()) {
+    print("int8_per_layer_avx2", int8(per_layer, QuantKernel::Avx2), f64,
+          false);
+    print("int8_per_channel_avx2", int8(per_channel, QuantKernel::Avx2), f64,
+          true);
+  }
+  std::cout << "]}\n";
+  return 0;
+}
@@ -0,0 +1,77 @@
+#include "../core/Serve/BatchEngine.hpp"
+#include <chrono>
+#include <iostream>
+#include <random>
+
+// Closed-loop serving: each client thread submits one sample, waits for the
+// answer and submits the next. Compares calling the MLP per request (behind
+// a mutex, as a shared model would be) with the batching engine at a few
+// batch limits, printing throughput and the engine's latency and batch size
+// stats.
+
+constexpr size_t kInputs = 64;
+
+auto elapsed(std::chrono::steady_clock::time_point start) -> double {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+template <typename Serve>
+auto run_clients(size_t clients, size_t requests, Serve serve) -> double {
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (size_t c = 0; c < clients; c++) {
+    threads.emplace_back([&, c] {
+      std::mt19937_64 gen(c);
+      std::normal_distribution<double> dis(0.0, 1.0);
+      std::vector<double> x(kInputs);
+      for (size_t r = 0; r < requests; r++) {
+        for (double &v : x) {
+          v = dis(gen);
+        }
+        serve(x);
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  return clients * requests / elapsed(start);
+}
+
+int main(int argc, char **argv) {
+  size_t clients = argc > 1 ? std::stoul(argv[1]) : 16;
+  size_t requests = argc > 2 ? std::stoul(argv[2]) : 200;
+  MultiLayerPerceptron mlp(ModelShape{kInputs, {256, 256, 10}, {}}, 1,
+                           InitScheme::HeNormal);
+
+  std::mutex model_mutex;
+  std::vector<double> scratch(2 * mlp.max_width());
+  std::vector<double> output(mlp.num_outputs());
+  double direct = run_clients(clients, requests, [&](std::vector<double> &x) {
+    std::lock_guard<std::mutex> lock(model_mutex);
+    mlp.evaluate(x.data(), output.data(), scratch.data());
+  });
+
+  std::cout << "{\"clients\": " << clients
+            << ", \"requests_per_client\": " << requests
+            << ",\n \"direct_requests_per_second\": " << direct
+            << ",\n \"engine\": [\n";
+  const size_t limits[] = {1, 8, 32};
+  for (size_t i = 0; i < 3; i++) {
+    InferenceEngine engine(
+        mlp, BatchingOptions{limits[i], std::chrono::microseconds(200)});
+    double throughput =
+        run_clients(clients, requests, [&](std::vector<double> &x) {
+          engine.submit(x).get();
+        });
+    std::cout << "  {\"max_batch\": " << limits[i]
+              << ", \"requests_per_second\": " << throughput
+              << ", \"stats\": ";
+    write_stats_json(std::cout, engine.stats());
+    std::cout << "}" << (i + 1 < 3 ? ",\n" : "\n");
+  }
+  std::cout << "]}\n";
+  return 0;
+}
@@ -0,0 +1,179 @@
+#include "../core/Sparse/Sparse.hpp"
+#include "../core/Tensor/Tensor.h"
+#include <chrono>
+#include <iostream>
+#include <random>
+
+// Latency of a 256-1024-1024-10 MLP pruned in 4x4 tiles to 50, 80 and 95%
+// sparsity, as dense code and as CSR and 4x4 BSR with the scalar and AVX2
+// kernels. One input at a time the dense baseline is a flat row-major
+// matrix-vector product over the pruned weights; a batch of 64 runs as a
+// tuned matmul. Speedups are against those, not the Value-graph layer code.
+
+constexpr size_t kInputs = 256;
+constexpr size_t kHidden = 1024;
+constexpr size_t kOutputs = 10;
+constexpr size_t kSingle = 200;
+constexpr size_t kBatch = 64;
+constexpr size_t kBatchRuns = 4;
+
+auto elapsed(std::chrono::steady_clock::time_point start) -> double {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+// Plain f64 weights, neuron-major, for the dense baselines
+struct DenseLayer {
+  size_t inputs = 0;
+  size_t outputs = 0;
+  Activation activation = Activation::Relu;
+  std::vector<double> weights; // outputs x inputs
+  std::vector<double> bias;
+  Tensor transposed; // [inputs, outputs] for matmul
+};
+
+auto dense_layers(const MultiLayerPerceptron &mlp) -> std::vector<DenseLayer> {
+  std::vector<DenseLayer> layers;
+  for (size_t l = 0; l < mlp.num_layers(); l++) {
+    std::vector<ValuePtr> params = mlp.layer(l).parameters();
+    DenseLayer layer;
+    layer.outputs = mlp.layer(l).size();
+    layer.inputs = params.size() / layer.outputs - 1;
+    layer.activation = mlp.layer(l).activation();
+    layer.transposed = Tensor({layer.inputs, layer.outputs});
+    for (size_t o = 0; o < layer.outputs; o++) {
+      for (size_t i = 0; i < layer.inputs; i++) {
+        double w = params[o * (layer.inputs + 1) + i]->get_value();
+        layer.weights.push_back(w);
+        layer.transposed.data()[i * layer.outputs + o] = w;
+      }
+      layer.bias.push_back(params[o * (layer.inputs + 1) + layer.inputs]
+                               ->get_value());
+    }
+    layers.push_back(std::move(layer));
+  }
+  return layers;
+}
+
+void dense_single(const std::vector<DenseLayer> &layers, const double *x,
+                  double *y, std::vector<double> &scratch) {
+  const double *current = x;
+  for (size_t l = 0; l < layers.size(); l++) {
+    const DenseLayer &layer = layers[l];
+    double *out = l + 1 == layers.size()
+                      ? y
+                      : scratch.data() + (l % 2) * (scratch.size() / 2);
+    for (size_t o = 0; o < layer.outputs; o++) {
+      const double *row = layer.weights.data() + o * layer.inputs;
+      double sum = layer.bias[o];
+      for (size_t i = 0; i < layer.inputs; i++) {
+        sum += row[i] * current[i];
+      }
+      out[o] = apply_activation(layer.activation, sum);
+    }
+    current = out;
+  }
+}
+
+auto dense_batch(const std::vector<DenseLayer> &layers, const Tensor &x)
+    -> Tensor {
+  Tensor current = x;
+  for (const DenseLayer &layer : layers) {
+    Tensor next = matmul(current, layer.transposed);
+    for (size_t s = 0; s < x.dim(0); s++) {
+      for (size_t o = 0; o < layer.outputs; o++) {
+        double &z = next.data()[s * layer.outputs + o];
+        z = apply_activation(layer.activation, z + layer.bias[o]);
+      }
+    }
+    current = std::move(next);
+  }
+  return current;
+}
+
+// Seconds per sample, one at a time
+template <typename Run> auto time_single(const Tensor &x, Run run) -> double {
+  std::vector<double> y(kOutputs);
+  run(x.data(), y.data()); // Warm up
+  auto start = std::chrono::steady_clock::now();
+  for (size_t s = 0; s < kSingle; s++) {
+    run(x.data() + s % kBatch * kInputs, y.data());
+  }
+  return elapsed(start) / kSingle;
+}
+
+// Seconds per sample in batches of kBatch
+template <typename Run> auto time_batch(Run run) -> double {
+  run();
+  auto start = std::chrono::steady_clock::now();
+  for (size_t r = 0; r < kBatchRuns; r++) {
+    run();
+  }
+  return elapsed(start) / (kBatchRuns * kBatch);
+}
+
+int main() {
+  ModelShape shape{kInputs,
+                   {kHidden, kHidden, kOutputs},
+                   {Activation::Relu, Activation::Relu, Activation::Identity}};
+  std::mt19937_64 gen(2);
+  std::normal_distribution<double> dis(0.0, 1.0);
+  Tensor x({kBatch, kInputs});
+  for (size_t i = 0; i < x.size(); i++) {
+    x.data()[i] = dis(gen);
+  }
+
+  bool avx2 = sparse_avx2_supported();
+  std::vector<SparseKernel> kernels = {SparseKernel::Scalar};
+  if (avx2) {
+    kernels.push_back(SparseKernel::Avx2);
+  }
+
+  std::cout << "{\"avx2\": " << (avx2 ? "true" : "false")
+            << ", \"batch\": " << kBatch << ", \"runs\": [\n";
+  bool first = true;
+  for (double sparsity : {0.5, 0.8, 0.95}) {
+    MultiLayerPerceptron mlp(shape, 1, InitScheme::HeNormal);
+    magnitude_prune(mlp, {sparsity, 4});
+    std::vector<DenseLayer> layers = dense_layers(mlp);
+    std::vector<double> scratch(2 * mlp.max_width());
+
+    double dense_one = time_single(x, [&](const double *in, double *out) {
+      dense_single(layers, in, out, scratch);
+    });
+    double dense_many = time_batch([&] { dense_batch(layers, x); });
+
+    std::vector<double> out(kBatch * kOutputs);
+    for (SparseFormat format : {SparseFormat::Csr, SparseFormat::Bsr}) {
+      SparseMLP sparse = SparseMLP::convert(mlp, format, 4);
+      SparseMLP::Workspace workspace = sparse.workspace(kBatch);
+      for (SparseKernel kernel : kernels) {
+        double one = time_single(x, [&](const double *in, double *y) {
+          sparse.run(in, y, workspace, kernel);
+        });
+        double many = time_batch([&] {
+          sparse.run_batch(x.data(), kBatch, out.data(), workspace, kernel);
+        });
+        std::cout << (first ? "" : ",\n") << "  {\"sparsity\": " << sparsity
+                  << ", \"format\": \""
+                  << (format == SparseFormat::Csr ? "csr" : "bsr4")
+                  << "\", \"kernel\": \""
+                  << (kernel == SparseKernel::Avx2 ? "avx2" : "scalar")
+                  << "\", \"density\": " << sparse.density()
+                  << ", \"weight_bytes\": " << sparse.weight_bytes()
+                  << ", \"dense_bytes\": "
+                  << shape.parameter_count() * sizeof(double)
+                  << ", \"us_single\": " << one * 1e6
+                  << ", \"dense_us_single\": " << dense_one * 1e6
+                  << ", \"speedup_single\": " << dense_one / one
+                  << ", \"us_batched\": " << many * 1e6
+                  << ", \"dense_us_batched\": " << dense_many * 1e6
+                  << ", \"speedup_batched\": " << dense_many / many << "}";
+        first = false;
+      }
+    }
+  }
+  std::cout << "\n]}\n";
+  return 0;
+}
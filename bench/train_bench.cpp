@@ -0,0 +1,398 @@
+#include "../core/Arena/Arena.hpp"
+#include "../core/Neuron.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// End-to-end training throughput: synthetic data, SGD on an MLP, JSON out.
+// Everything is seeded so two runs on the same machine do the same work.
+//
+// Each config is measured twice. Throughput comes from a fixed number of
+// epochs from a fresh model, so every run does exactly the same work, and is
+// the median of --repeat runs. Convergence is a separate run that trains to
+// a loss target or a plateau and reports how long that took; its epoch count
+// varies with the config, so it never feeds the regression gate.
+
+constexpr u64 kDatasetSeed = 1337;
+
+#ifndef MICROGRAD_BUILD_TYPE
+#define MICROGRAD_BUILD_TYPE ""
+#endif
+
+struct Dataset {
+  const char *name;
+  size_t num_samples;
+  size_t num_features;
+  f64 *features; // num_samples x num_features, row major
+  f64 *targets;  // num_samples
+};
+
+// * ------------- Synthetic Datasets ---------------
+
+auto make_moons(MemoryArena &arena, size_t n) -> Dataset {
+  std::mt19937_64 gen(kDatasetSeed);
+  std::uniform_real_distribution<f64> angle(0.0, M_PI);
+  std::normal_distribution<f64> noise(0.0, 0.1);
+
+  Dataset data{"moons", n, 2, arena.push_array<f64>(n * 2),
+               arena.push_array<f64>(n)};
+  for (size_t i = 0; i < n; i++) {
+    f64 t = angle(gen);
+    bool upper = (i % 2) == 0;
+    data.features[i * 2 + 0] =
+        (upper ? std::cos(t) : 1.0 - std::cos(t)) + noise(gen);
+    data.features[i * 2 + 1] =
+        (upper ? std::sin(t) : 0.5 - std::sin(t)) + noise(gen);
+    data.targets[i] = upper ? 1.0 : 0.0;
+  }
+  return data;
+}
+
+auto make_spirals(MemoryArena &arena, size_t n) -> Dataset {
+  std::mt19937_64 gen(kDatasetSeed + 1);
+  std::uniform_real_distribution<f64> radius(0.0, 1.0);
+  std::normal_distribution<f64> noise(0.0, 0.05);
+
+  Dataset data{"spirals", n, 2, arena.push_array<f64>(n * 2),
+               arena.push_array<f64>(n)};
+  for (size_t i = 0; i < n; i++) {
+    f64 r = radius(gen);
+    f64 t = r * 3.0 * M_PI + ((i % 2) ? M_PI : 0.0);
+    data.features[i * 2 + 0] = r * std::cos(t) + noise(gen);
+    data.features[i * 2 + 1] = r * std::sin(t) + noise(gen);
+    data.targets[i] = (i % 2) ? 1.0 : 0.0;
+  }
+  return data;
+}
+
+auto make_regression(MemoryArena &arena, size_t n, size_t d) -> Dataset {
+  std::mt19937_64 gen(kDatasetSeed + 2);
+  std::normal_distribution<f64> normal(0.0, 1.0);
+
+  f64 *true_weights = arena.push_array<f64>(d);
+  for (size_t j = 0; j < d; j++) {
+    true_weights[j] = normal(gen) / std::sqrt(static_cast<f64>(d));
+  }
+
+  Dataset data{"regression", n, d, arena.push_array<f64>(n * d),
+               arena.push_array<f64>(n)};
+  for (size_t i = 0; i < n; i++) {
+    f64 dot = 0.0;
+    for (size_t j = 0; j < d; j++) {
+      f64 x = normal(gen);
+      data.features[i * d + j] = x;
+      dot += x * true_weights[j];
+    }
+    data.targets[i] = dot;
+  }
+  return data;
+}
+
+// * ------------- Training ---------------
+
+// The convergence run trains until its epoch loss reaches target_loss, or
+// until the best epoch loss has not improved by kPlateauTolerance for
+// kPatience epochs, or for at most max_epochs
+constexpr size_t kPatience = 10;
+constexpr f64 kPlateauTolerance = 0.01;
+
+struct BenchConfig {
+  const char *dataset;
+  std::vector<size_t> layer_sizes;
+  size_t num_samples;
+  size_t timed_epochs; // Fixed work of each throughput run
+  size_t max_epochs;
+  size_t batch_size;
+  f64 learning_rate;
+  f64 target_loss;
+};
+
+struct BenchResult {
+  std::string name;
+  std::string dataset;
+  std::vector<size_t> layer_sizes;
+  // Throughput, the median of the timed runs
+  size_t runs;
+  size_t timed_samples;
+  f64 seconds;
+  f64 samples_per_sec;
+  // Convergence, absent with --throughput-only
+  bool converged_run;
+  f64 target_loss;
+  size_t epochs;
+  const char *stop; // "target", "plateau" or "max_epochs"
+  f64 converge_seconds;
+  f64 first_loss; // Mean over the first epoch, to check the loss falls
+  f64 final_loss;
+  // Memory over all of the config's runs
+  u64 peak_rss_kb;
+  bool peak_rss_per_config; // False when VmHWM could not be reset
+  u64 arena_high_water;
+  u64 arena_capacity;
+};
+
+// Writing 5 to clear_refs resets VmHWM to the current RSS (Linux 4.0+), so
+// each config's peak excludes the configs before it
+auto reset_peak_rss() -> bool {
+  std::ofstream clear("/proc/self/clear_refs");
+  clear << "5";
+  clear.flush();
+  return static_cast<bool>(clear);
+}
+
+auto peak_rss_kb() -> u64 {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.rfind("VmHWM:", 0) == 0) {
+      return std::stoull(line.substr(6));
+    }
+  }
+  return 0;
+}
+
+auto make_dataset(MemoryArena &arena, const BenchConfig &config) -> Dataset {
+  if (std::strcmp(config.dataset, "moons") == 0) {
+    return make_moons(arena, config.num_samples);
+  }
+  if (std::strcmp(config.dataset, "spirals") == 0) {
+    return make_spirals(arena, config.num_samples);
+  }
+  return make_regression(arena, config.num_samples, 32);
+}
+
+// Relu hidden layers with He init. The output is a sigmoid for the 0/1
+// classification targets and linear for regression; a relu output dies and
+// leaves the loss flat. Fixed seed so every run trains the same model.
+auto make_model(const BenchConfig &config, const Dataset &data)
+    -> MultiLayerPerceptron {
+  ModelShape shape{data.num_features, config.layer_sizes, {}};
+  shape.activations.assign(config.layer_sizes.size(), Activation::Relu);
+  shape.activations.back() = std::strcmp(config.dataset, "regression") == 0
+                                 ? Activation::Identity
+                                 : Activation::Sigmoid;
+  return MultiLayerPerceptron(shape, 1, InitScheme::HeUniform);
+}
+
+// One epoch of minibatch SGD, returns the mean loss over the epoch
+auto train_epoch(MultiLayerPerceptron &mlp, const std::vector<ValuePtr> &params,
+                 const Dataset &data, const BenchConfig &config,
+                 MemoryArena &scratch_arena) -> f64 {
+  f64 epoch_loss = 0.0;
+  for (size_t first = 0; first < data.num_samples;
+       first += config.batch_size) {
+    PROFILE_SCOPE("step");
+    size_t last = std::min(first + config.batch_size, data.num_samples);
+    {
+      ScratchScope scope(&scratch_arena);
+      std::vector<ValuePtr> inputs(data.num_features);
+
+      ValuePtr loss = create_value(0.0);
+      for (size_t i = first; i < last; i++) {
+        for (size_t j = 0; j < data.num_features; j++) {
+          inputs[j] = create_value(data.features[i * data.num_features + j]);
+        }
+        ValuePtr diff = mlp(inputs)[0] - create_value(data.targets[i]);
+        loss = loss + diff * diff;
+      }
+      // Mean over the samples actually in the batch, the last one may be
+      // short
+      loss = loss * create_value(1.0 / static_cast<f64>(last - first));
+      loss->backpropagate();
+
+      for (const ValuePtr &p : params) {
+        p->set_value(p->get_value() -
+                     config.learning_rate * p->get_gradient());
+      }
+      epoch_loss += loss->get_value() * (last - first);
+    }
+    scratch_arena.end_iteration();
+  }
+  return epoch_loss / data.num_samples;
+}
+
+auto seconds_since(std::chrono::steady_clock::time_point start) -> f64 {
+  return std::chrono::duration<f64>(std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+auto run_config(const BenchConfig &config, size_t repeat, bool converge)
+    -> BenchResult {
+  BenchResult result{};
+  result.peak_rss_per_config = reset_peak_rss();
+
+  MemoryArena data_arena(MB(4));
+  Dataset data = make_dataset(data_arena, config);
+
+  // Per-step graphs live in a scratch arena that starts deliberately small
+  // and sizes itself to the observed peak
+  MemoryArena scratch_arena(KB(64));
+  scratch_arena.enable_adaptive();
+
+  // A single run on a busy machine can lose a quarter of its throughput to
+  // scheduling alone, so report the median of `repeat` identical runs
+  std::vector<f64> timings;
+  for (size_t run = 0; run < repeat; run++) {
+    MultiLayerPerceptron mlp = make_model(config, data);
+    std::vector<ValuePtr> params = mlp.parameters();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t epoch = 0; epoch < config.timed_epochs; epoch++) {
+      train_epoch(mlp, params, data, config, scratch_arena);
+    }
+    timings.push_back(seconds_since(start));
+  }
+  std::sort(timings.begin(), timings.end());
+  size_t middle = timings.size() / 2;
+  result.runs = repeat;
+  result.timed_samples = data.num_samples * config.timed_epochs;
+  result.seconds = timings.size() % 2
+                       ? timings[middle]
+                       : (timings[middle - 1] + timings[middle]) / 2.0;
+  result.samples_per_sec = result.timed_samples / result.seconds;
+
+  result.converged_run = converge;
+  result.target_loss = config.target_loss;
+  result.stop = "max_epochs";
+  if (converge) {
+    MultiLayerPerceptron mlp = make_model(config, data);
+    std::vector<ValuePtr> params = mlp.parameters();
+    f64 best_loss = 0.0;
+    size_t best_epoch = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t epoch = 0; epoch < config.max_epochs; epoch++) {
+      f64 loss = train_epoch(mlp, params, data, config, scratch_arena);
+      result.final_loss = loss;
+      result.epochs = epoch + 1;
+      if (epoch == 0) {
+        result.first_loss = loss;
+      }
+      if (epoch == 0 || loss < best_loss * (1.0 - kPlateauTolerance)) {
+        best_loss = loss;
+        best_epoch = epoch;
+      }
+      if (loss <= config.target_loss) {
+        result.stop = "target";
+        break;
+      }
+      if (epoch - best_epoch >= kPatience) {
+        result.stop = "plateau";
+        break;
+      }
+    }
+    result.converge_seconds = seconds_since(start);
+  }
+
+  std::stringstream name;
+  name << data.name << "/" << data.num_features;
+  for (size_t size : config.layer_sizes) {
+    name << "-" << size;
+  }
+  result.name = name.str();
+  result.dataset = data.name;
+  result.layer_sizes = config.layer_sizes;
+  result.peak_rss_kb = peak_rss_kb();
+  result.arena_high_water = scratch_arena.get_high_water();
+  result.arena_capacity = scratch_arena.capacity;
+  return result;
+}
+
+void write_json(std::ostream &os, const std::vector<BenchResult> &results) {
+  const char *build_type = MICROGRAD_BUILD_TYPE;
+  os << "{\n  \"build_type\": \"" << (*build_type ? build_type : "None")
+     << "\",\n  \"benchmarks\": [\n";
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchResult &r = results[i];
+    os << "    {\"name\": \"" << r.name << "\", \"dataset\": \"" << r.dataset
+       << "\", \"layers\": [";
+    for (size_t l = 0; l < r.layer_sizes.size(); l++) {
+      os << (l ? ", " : "") << r.layer_sizes[l];
+    }
+    os << "], \"runs\": " << r.runs << ", \"samples\": " << r.timed_samples
+       << ", \"seconds\": " << r.seconds
+       << ", \"samples_per_sec\": " << static_cast<u64>(r.samples_per_sec);
+    if (r.converged_run) {
+      os << ", \"target_loss\": " << r.target_loss
+         << ", \"epochs\": " << r.epochs << ", \"stop\": \"" << r.stop
+         << "\", \"converge_seconds\": " << r.converge_seconds
+         << ", \"first_epoch_loss\": " << r.first_loss
+         << ", \"final_loss\": " << r.final_loss;
+    }
+    // Without a VmHWM reset the peak is the process's so far
+    os << (r.peak_rss_per_config ? ", \"peak_rss_kb\": "
+                                 : ", \"process_peak_rss_kb\": ")
+       << r.peak_rss_kb
+       << ", \"arena_high_water_bytes\": " << r.arena_high_water
+       << ", \"arena_capacity_bytes\": " << r.arena_capacity << "}"
+       << (i + 1 < results.size() ? "," : "") << "\n";
+  }
+  os << "  ]\n}\n";
+}
+
+int main(int argc, char **argv) {
+  std::string output_path;
+  std::string trace_path;
+  size_t max_epochs = 0; // 0 keeps each config's own cap
+  size_t repeat = 1;
+  bool converge = true;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+      output_path = argv[++i];
+    } else if (std::strcmp(argv[i], "--max-epochs") == 0 && i + 1 < argc) {
+      max_epochs = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+      trace_path = argv[++i];
+    } else if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+      repeat = std::max<size_t>(1, std::stoul(argv[++i]));
+    } else if (std::strcmp(argv[i], "--throughput-only") == 0) {
+      converge = false;
+    } else {
+      std::cerr << "usage: " << argv[0]
+                << " [--out file.json] [--max-epochs n] [--repeat n]"
+                   " [--throughput-only] [--trace trace.json]\n";
+      return 2;
+    }
+  }
+
+  // Timed epochs are picked so each throughput run takes roughly half a
+  // second in a Release build
+  std::vector<BenchConfig> configs = {
+      {"moons", {16, 16, 1}, 128, 40, 400, 16, 0.05, 0.05},
+      {"moons", {32, 32, 1}, 128, 10, 400, 16, 0.05, 0.05},
+      {"spirals", {32, 32, 1}, 128, 10, 400, 8, 0.1, 0.1},
+      {"regression", {32, 16, 1}, 64, 10, 400, 16, 0.01, 0.05},
+  };
+  if (max_epochs) {
+    for (BenchConfig &config : configs) {
+      config.max_epochs = max_epochs;
+    }
+  }
+
+  if (!trace_path.empty() && !MICROGRAD_PROFILE) {
+    std::cerr << "--trace needs a build with -DMICROGRAD_PROFILE=ON\n";
+  }
+  profile::reset();
+
+  std::vector<BenchResult> results;
+  for (const BenchConfig &config : configs) {
+    results.push_back(run_config(config, repeat, converge));
+  }
+
+  if (!trace_path.empty() && MICROGRAD_PROFILE) {
+    profile::write_chrome_trace(trace_path);
+    profile::write_summary(std::cerr);
+  }
+
+  write_json(std::cout, results);
+  if (!output_path.empty()) {
+    std::ofstream file(output_path);
+    write_json(file, results);
+  }
+  return 0;
+}
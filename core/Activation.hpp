@@ -0,0 +1,90 @@
+#pragma once
+#include "Shared/types.hpp"
+#include <cmath>
+
+// Activation functions a Neuron applies to its weighted sum. Shared by the
+// graph (Value), the forward-mode duals and StaticMLP so all of them compute
+// the same thing.
+enum class Activation : u8 {
+  Relu,
+  LeakyRelu, // Slope kLeakySlope below zero
+  Tanh,
+  Sigmoid,
+  Gelu, // Exact form, z * Phi(z)
+  Identity,
+};
+
+constexpr double kLeakySlope = 0.01;
+
+inline auto activation_name(Activation activation) -> const char * {
+  switch (activation) {
+  case Activation::Relu:
+    return "relu";
+  case Activation::LeakyRelu:
+    return "leaky_relu";
+  case Activation::Tanh:
+    return "tanh";
+  case Activation::Sigmoid:
+    return "sigmoid";
+  case Activation::Gelu:
+    return "gelu";
+  case Activation::Identity:
+    return "identity";
+  }
+  return "unknown";
+}
+
+inline auto apply_activation(Activation activation, double z) -> double {
+  switch (activation) {
+  case Activation::Relu:
+    return z > 0 ? z : 0.0;
+  case Activation::LeakyRelu:
+    return z > 0 ? z : kLeakySlope * z;
+  case Activation::Tanh:
+    return std::tanh(z);
+  case Activation::Sigmoid:
+    return z >= 0 ? 1.0 / (1.0 + std::exp(-z))
+                  : std::exp(z) / (1.0 + std::exp(z));
+  case Activation::Gelu:
+    return 0.5 * z * (1.0 + std::erf(z * M_SQRT1_2));
+  case Activation::Identity:
+    return z;
+  }
+  return z;
+}
+
+// d apply_activation(z) / dz, given z and its output y. Relu and leaky relu
+// use the left derivative at 0, like relu(ValuePtr).
+inline auto activation_derivative(Activation activation, double z, double y)
+    -> double {
+  switch (activation) {
+  case Activation::Relu:
+    return z > 0 ? 1.0 : 0.0;
+  case Activation::LeakyRelu:
+    return z > 0 ? 1.0 : kLeakySlope;
+  case Activation::Tanh:
+    return 1.0 - y * y;
+  case Activation::Sigmoid:
+    return y * (1.0 - y);
+  case Activation::Gelu: {
+    // Phi(z) + z * phi(z)
+    constexpr double kInvSqrt2Pi = 0.3989422804014327;
+    return 0.5 * (1.0 + std::erf(z * M_SQRT1_2)) +
+           z * kInvSqrt2Pi * std::exp(-0.5 * z * z);
+  }
+  case Activation::Identity:
+    return 1.0;
+  }
+  return 1.0;
+}
+
+// * Plain doubles, so the layer code in Neuron.h also runs on them: the
+// * activation alone and the neuron's fused last term act(x * w + c)
+inline auto activate(double z, Activation activation) -> double {
+  return apply_activation(activation, z);
+}
+
+inline auto activate(double x, double w, double c, Activation activation)
+    -> double {
+  return apply_activation(activation, x * w + c);
+}
@@ -1,6 +1,26 @@
 #include "Arena.hpp"
+#include "../Profile/Profile.hpp"
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
+#include <new>
+
+void *arena_oom_throw(MemoryArena *, u64, u64) { throw std::bad_alloc(); }
+
+void *arena_oom_return_null(MemoryArena *, u64, u64) { return nullptr; }
+
+void *arena_oom_overflow(MemoryArena *arena, u64 size, u64 align) {
+  void *block = std::malloc(size + align);
+  if (!block) {
+    throw std::bad_alloc();
+  }
+  arena->overflow_blocks.push_back(block);
+  arena->overflow_bytes += size;
+
+  u64 address = reinterpret_cast<uintptr_t>(block);
+  u64 aligned = (address + align - 1) & ~(align - 1);
+  return reinterpret_cast<void *>(aligned);
+}
 
 MemoryArena::MemoryArena(u64 size) {
   buffer = static_cast<u8 *>(std::malloc(size));
@@ -8,25 +28,41 @@ MemoryArena::MemoryArena(u64 size) {
   pos = 0;
 }
 
-MemoryArena::~MemoryArena() { std::free(buffer); }
+MemoryArena::~MemoryArena() {
+  release_overflow();
+  std::free(buffer);
+}
 
-void *MemoryArena::push(u64 size, u64 align) {
+void *MemoryArena::push(u64 size, u64 align, const char *site) {
 
-  // This is a power of 2 alignment
-  u64 aligned_pos = (pos + align - 1) & ~(align - 1);
+  // This is a power of 2 alignment, applied to the address rather than the
+  // offset since malloc only guarantees 16 byte alignment for the buffer
+  u64 base = reinterpret_cast<uintptr_t>(buffer);
+  u64 aligned_pos = ((base + pos + align - 1) & ~(align - 1)) - base;
 
   // Out of memory
   if (aligned_pos + size > capacity) {
-    return nullptr;
+    void *ptr = oom_handler(this, size, align);
+    iteration_peak = std::max(iteration_peak, pos + overflow_bytes);
+    if (ptr) {
+      record_push(size, site);
+    }
+    return ptr;
   }
 
   void *ptr = buffer + aligned_pos;
   pos = aligned_pos + size;
+  if (pos > high_water) {
+    high_water = pos;
+  }
+  iteration_peak = std::max(iteration_peak, pos + overflow_bytes);
+  record_push(size, site);
+  PROFILE_ARENA_PUSH(size, pos);
   return ptr;
 }
 
-void *MemoryArena::push_zero(u64 size, u64 align) {
-  auto memory = push(size, align);
+void *MemoryArena::push_zero(u64 size, u64 align, const char *site) {
+  auto memory = push(size, align, site);
   if (memory) {
     std::memset(memory, 0, size);
   }
@@ -40,7 +76,10 @@ void MemoryArena::pop(u64 size) {
   }
   pos -= size;
 }
-void MemoryArena::clear() { pos = 0; }
+void MemoryArena::clear() {
+  pos = 0;
+  release_overflow();
+}
 
 // Position
 u64 MemoryArena::get_pos() const { return pos; }
@@ -51,6 +90,8 @@ void MemoryArena::set_pos(u64 new_pos) {
   }
 }
 
+u64 MemoryArena::get_high_water() const { return high_water; }
+
 Arena MemoryArena::mark() { return Arena{this, pos}; }
 
 void MemoryArena::restore(Arena arena) { pos = arena.pos; }
@@ -58,3 +99,135 @@ void MemoryArena::restore(Arena arena) { pos = arena.pos; }
 void Arena::end() {
   arena->restore(*this); // Restore the position we saved
 }
+
+// * ------------- Telemetry ---------------
+
+void MemoryArena::set_oom_handler(OutOfMemoryHandler handler) {
+  oom_handler = handler ? handler : arena_oom_throw;
+}
+
+void MemoryArena::record_push(u64 bytes, const char *site) {
+  alloc_count++;
+  bytes_pushed += bytes;
+  if (site) {
+    record_site(site, bytes);
+  }
+}
+
+void MemoryArena::record_site(const char *site, u64 bytes) {
+  // Site tags are literals, so a pointer match nearly always exists. Only
+  // when none does can an equal string live at another address, e.g. the
+  // same literal in another translation unit.
+  size_t match = site_count;
+  for (size_t i = 0; i < site_count; i++) {
+    if (sites[i].name == site) {
+      match = i;
+      break;
+    }
+  }
+  // Once the table is full the last slot is the "other" bucket, so a miss
+  // lands there after the single pointer scan
+  if (match == site_count && site_count == kMaxArenaSites) {
+    match = kMaxArenaSites - 1;
+  }
+  for (size_t i = 0; match == site_count && i < site_count; i++) {
+    if (std::strcmp(sites[i].name, site) == 0) {
+      match = i;
+    }
+  }
+  if (match < site_count) {
+    sites[match].bytes += bytes;
+    sites[match].count++;
+    return;
+  }
+  if (site_count < kMaxArenaSites - 1) {
+    sites[site_count++] = ArenaSite{site, bytes, 1};
+  } else {
+    sites[site_count++] = ArenaSite{kArenaOtherSite, bytes, 1};
+  }
+}
+
+u64 MemoryArena::site_bytes(const char *site) const {
+  for (size_t i = 0; i < site_count; i++) {
+    if (std::strcmp(sites[i].name, site) == 0) {
+      return sites[i].bytes;
+    }
+  }
+  return 0;
+}
+
+void MemoryArena::reset_stats() {
+  high_water = pos;
+  alloc_count = 0;
+  bytes_pushed = 0;
+  site_count = 0;
+  iteration_peak = pos;
+  iterations = 0;
+}
+
+// * ------------- Sizing ---------------
+
+bool MemoryArena::resize(u64 new_size) {
+  if (pos != 0 || !overflow_blocks.empty()) {
+    return false;
+  }
+  if (new_size == capacity) {
+    return true;
+  }
+  u8 *new_buffer = static_cast<u8 *>(std::malloc(new_size));
+  if (!new_buffer) {
+    return false;
+  }
+  std::free(buffer);
+  buffer = new_buffer;
+  capacity = new_size;
+  return true;
+}
+
+void MemoryArena::enable_adaptive(ArenaSizingPolicy new_policy) {
+  adaptive = true;
+  policy = new_policy;
+  policy.window =
+      std::max<u32>(1, std::min<u32>(policy.window, kMaxPeakWindow));
+  oom_handler = arena_oom_overflow;
+}
+
+u64 MemoryArena::target_capacity() const {
+  u64 window = std::min<u64>(iterations, policy.window);
+  u64 peak = 0;
+  for (u64 i = 0; i < window; i++) {
+    peak = std::max(peak, recent_peaks[i]);
+  }
+  u64 target = static_cast<u64>(peak * policy.headroom);
+  // Keep the buffer 64 byte granular, the allocator rounds up anyway
+  target = (target + 63) & ~u64(63);
+  return std::max(target, policy.min_capacity);
+}
+
+void MemoryArena::end_iteration() {
+  recent_peaks[iterations % policy.window] = iteration_peak;
+  iterations++;
+  iteration_peak = 0;
+  clear();
+
+  if (!adaptive) {
+    return;
+  }
+
+  // Grow as soon as an iteration overflowed. Shrink only once a full window
+  // has been observed (since construction or reset_stats) and all of it
+  // fits in half the buffer, so the size does not oscillate
+  u64 target = target_capacity();
+  bool window_full = iterations >= policy.window;
+  if (target > capacity || (window_full && target * 2 < capacity)) {
+    resize(target);
+  }
+}
+
+void MemoryArena::release_overflow() {
+  for (void *block : overflow_blocks) {
+    std::free(block);
+  }
+  overflow_blocks.clear();
+  overflow_bytes = 0;
+}
@@ -3,12 +3,55 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <new>
+#include <vector>
 
 constexpr u64 KB(u64 x) { return x * 1024; }
 constexpr u64 MB(u64 x) { return x * 1024 * 1024; }
 constexpr u64 GB(u64 x) { return x * 1024 * 1024 * 1024; }
 
+#define ARENA_STRINGIFY_INNER(x) #x
+#define ARENA_STRINGIFY(x) ARENA_STRINGIFY_INNER(x)
+
+// Call-site tag for push(), e.g. arena.push(64, 16, ARENA_SITE)
+#define ARENA_SITE __FILE__ ":" ARENA_STRINGIFY(__LINE__)
+
 struct Arena;
+struct MemoryArena;
+
+// Called when a push does not fit. Returns the memory to use or throws,
+// returning nullptr hands the null back to the caller of push.
+using OutOfMemoryHandler = void *(*)(MemoryArena *arena, u64 size, u64 align);
+
+// Throws std::bad_alloc, the default
+void *arena_oom_throw(MemoryArena *arena, u64 size, u64 align);
+
+// The old behaviour, push returns nullptr
+void *arena_oom_return_null(MemoryArena *arena, u64 size, u64 align);
+
+// Serves the push from a heap side block that lives until the next clear()
+// or end_iteration(). Used by the adaptive policy so an undersized scratch
+// arena survives the iteration and is resized afterwards.
+void *arena_oom_overflow(MemoryArena *arena, u64 size, u64 align);
+
+constexpr size_t kMaxArenaSites = 32;
+// Sites past the first kMaxArenaSites - 1 share this last bucket
+constexpr const char *kArenaOtherSite = "other";
+constexpr size_t kMaxPeakWindow = 64;
+
+struct ArenaSite {
+  const char *name;
+  u64 bytes;
+  u64 count;
+};
+
+// Scratch capacity follows the largest iteration peak over the last `window`
+// iterations, padded by `headroom`
+struct ArenaSizingPolicy {
+  u32 window = 8;
+  f64 headroom = 1.25;
+  u64 min_capacity = KB(4);
+};
 
 struct MemoryArena {
 
@@ -16,6 +59,26 @@ struct MemoryArena {
   u64 capacity;
   u64 pos;
 
+  // Telemetry
+  u64 high_water = 0;
+  u64 alloc_count = 0;
+  u64 bytes_pushed = 0;
+  ArenaSite sites[kMaxArenaSites] = {};
+  size_t site_count = 0;
+
+  OutOfMemoryHandler oom_handler = arena_oom_throw;
+
+  // Overflow blocks handed out by arena_oom_overflow
+  std::vector<void *> overflow_blocks;
+  u64 overflow_bytes = 0;
+
+  // Adaptive sizing
+  bool adaptive = false;
+  ArenaSizingPolicy policy;
+  u64 iteration_peak = 0;
+  u64 recent_peaks[kMaxPeakWindow] = {};
+  u64 iterations = 0;
+
   MemoryArena(u64 size);
   ~MemoryArena();
 
@@ -24,20 +87,25 @@ struct MemoryArena {
   MemoryArena &operator=(const MemoryArena &) = delete;
 
   // Allocation
-  void *push(u64 size, u64 align = 16);
-  void *push_zero(u64 size, u64 align = 16);
+  void *push(u64 size, u64 align = 16, const char *site = nullptr);
+  void *push_zero(u64 size, u64 align = 16, const char *site = nullptr);
 
-  template <typename T> T *push_array(u64 count) {
-    return static_cast<T *>(push(sizeof(T) * count, alignof(T)));
+  template <typename T> T *push_array(u64 count, const char *site = nullptr) {
+    return static_cast<T *>(push(sizeof(T) * count, alignof(T), site));
   }
 
-  template <typename T> T *push_array_zero(u64 count) {
-    return static_cast<T *>(push_zero(sizeof(T) * count, alignof(T)));
+  template <typename T>
+  T *push_array_zero(u64 count, const char *site = nullptr) {
+    return static_cast<T *>(push_zero(sizeof(T) * count, alignof(T), site));
   }
 
-  template <typename T> T *push_struct() { return push_array<T>(1); }
+  template <typename T> T *push_struct(const char *site = nullptr) {
+    return push_array<T>(1, site);
+  }
 
-  template <typename T> T *push_struct_zero() { return push_array_zero<T>(1); }
+  template <typename T> T *push_struct_zero(const char *site = nullptr) {
+    return push_array_zero<T>(1, site);
+  }
 
   // Deallocation
   void pop(u64 size);
@@ -46,10 +114,37 @@ struct MemoryArena {
   // Position
   u64 get_pos() const;
   void set_pos(u64 new_pos);
+  u64 get_high_water() const;
 
   // Scoping
   Arena mark();
   void restore(Arena arena);
+
+  // * ------------- Telemetry ---------------
+  void set_oom_handler(OutOfMemoryHandler handler);
+  u64 site_bytes(const char *site) const;
+  void reset_stats();
+
+  // * ------------- Sizing ---------------
+
+  // Swap the buffer for one of new_size bytes. Only legal while nothing is
+  // allocated, returns false otherwise.
+  bool resize(u64 new_size);
+
+  // Turn this into a self-sizing scratch arena: overflow is served from side
+  // blocks and end_iteration() resizes to the observed peak
+  void enable_adaptive(ArenaSizingPolicy new_policy = ArenaSizingPolicy());
+
+  // Close a training iteration: record its peak, release everything and, if
+  // adaptive, resize to the policy's target capacity
+  void end_iteration();
+
+  u64 target_capacity() const;
+
+private:
+  void record_push(u64 bytes, const char *site);
+  void record_site(const char *site, u64 bytes);
+  void release_overflow();
 };
 
 struct Arena {
@@ -58,3 +153,41 @@ struct Arena {
 
   void end();
 };
+
+// Allocator for std::allocate_shared and friends. Deallocation is a no-op,
+// memory comes back when the arena is cleared. Throws std::bad_alloc when
+// the push fails, whatever the arena's handler, since standard containers
+// never expect a null allocation.
+template <typename T> struct ArenaAllocator {
+  using value_type = T;
+
+  MemoryArena *arena;
+  const char *site;
+
+  ArenaAllocator(MemoryArena *arena_in, const char *site_in = nullptr)
+      : arena(arena_in), site(site_in) {}
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U> &other)
+      : arena(other.arena), site(other.site) {}
+
+  T *allocate(size_t n) {
+    void *memory = arena->push(sizeof(T) * n, alignof(T), site);
+    if (memory == nullptr) {
+      throw std::bad_alloc();
+    }
+    return static_cast<T *>(memory);
+  }
+
+  void deallocate(T *, size_t) {}
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+  return a.arena == b.arena;
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+  return a.arena != b.arena;
+}
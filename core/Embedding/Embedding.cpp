@@ -0,0 +1,114 @@
+#include "Embedding.hpp"
+#include "../Model/Format.hpp"
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+namespace {
+
+// Rows are stored as u32 in lookups, slots and SparseGradient::rows
+auto checked_rows(size_t num_rows) -> size_t {
+  if (num_rows > UINT32_MAX) {
+    throw std::invalid_argument("Embedding tables hold at most 2^32 - 1 rows");
+  }
+  return num_rows;
+}
+
+} // namespace
+
+Embedding::Embedding(MemoryArena &arena, size_t num_rows, size_t dim,
+                     u64 seed)
+    : _num_rows(checked_rows(num_rows)), _dim(dim), _slot(num_rows, kNoSlot) {
+  _table = arena.push_array<double>(num_rows * dim, ARENA_SITE);
+
+  // Row r as neuron r of a layer over dim inputs
+  for (size_t r = 0; r < num_rows; r++) {
+    for (size_t j = 0; j < dim; j++) {
+      _table[r * dim + j] = initial_parameter(seed, InitScheme::Uniform, 0, r,
+                                              j, dim, num_rows);
+    }
+  }
+}
+
+auto Embedding::operator()(size_t row_index) -> std::vector<ValuePtr> {
+  if (row_index >= _num_rows) {
+    throw std::out_of_range("Embedding row out of range");
+  }
+
+  const double *values = row(row_index);
+  std::vector<ValuePtr> leaves(_dim);
+  for (size_t j = 0; j < _dim; j++) {
+    leaves[j] = create_value(values[j]);
+  }
+  _lookups.push_back(Lookup{static_cast<u32>(row_index), leaves});
+  return leaves;
+}
+
+auto Embedding::operator()(const std::vector<size_t> &rows)
+    -> std::vector<ValuePtr> {
+  std::vector<ValuePtr> features;
+  features.reserve(rows.size() * _dim);
+  for (size_t row_index : rows) {
+    std::vector<ValuePtr> leaves = (*this)(row_index);
+    features.insert(features.end(), leaves.begin(), leaves.end());
+  }
+  return features;
+}
+
+auto Embedding::collect_gradients() -> SparseGradient {
+  SparseGradient gradient;
+  gradient.dim = _dim;
+
+  for (const Lookup &lookup : _lookups) {
+    u32 &slot = _slot[lookup.row];
+    if (slot == kNoSlot) {
+      slot = static_cast<u32>(gradient.rows.size());
+      gradient.rows.push_back(lookup.row);
+      gradient.values.resize(gradient.values.size() + _dim, 0.0);
+    }
+    double *block = gradient.values.data() + slot * _dim;
+    for (size_t j = 0; j < _dim; j++) {
+      block[j] += lookup.leaves[j]->get_gradient();
+    }
+  }
+
+  for (u32 row_index : gradient.rows) {
+    _slot[row_index] = kNoSlot;
+  }
+  // Drops the leaves, which may live in a scratch arena about to be cleared
+  _lookups.clear();
+  return gradient;
+}
+
+void SparseSGD::step(Embedding &embedding,
+                     const SparseGradient &gradient) const {
+  for (size_t i = 0; i < gradient.rows.size(); i++) {
+    double *values = embedding.row(gradient.rows[i]);
+    const double *grad = gradient.row_gradient(i);
+    for (size_t j = 0; j < gradient.dim; j++) {
+      values[j] -= _learning_rate * grad[j];
+    }
+  }
+}
+
+SparseAdagrad::SparseAdagrad(MemoryArena &arena, const Embedding &embedding,
+                             double learning_rate, double epsilon)
+    : _dim(embedding.dim()), _learning_rate(learning_rate),
+      _epsilon(epsilon) {
+  _accumulators = arena.push_array_zero<double>(
+      embedding.num_rows() * embedding.dim(), ARENA_SITE);
+}
+
+void SparseAdagrad::step(Embedding &embedding,
+                         const SparseGradient &gradient) {
+  for (size_t i = 0; i < gradient.rows.size(); i++) {
+    double *values = embedding.row(gradient.rows[i]);
+    double *accumulators = _accumulators + gradient.rows[i] * _dim;
+    const double *grad = gradient.row_gradient(i);
+    for (size_t j = 0; j < _dim; j++) {
+      accumulators[j] += grad[j] * grad[j];
+      values[j] -=
+          _learning_rate * grad[j] / (std::sqrt(accumulators[j]) + _epsilon);
+    }
+  }
+}
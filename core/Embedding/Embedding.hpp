@@ -0,0 +1,105 @@
+#pragma once
+#include "../Arena/Arena.hpp"
+#include "../Value.h"
+#include <vector>
+
+// Lookup table for categorical features. A one-hot input through Neuron
+// spends a multiply on every row of the table; Embedding gathers the rows
+// that are asked for instead, and only those rows ever see a gradient.
+//
+//   MemoryArena tables(MB(8));
+//   Embedding embedding(tables, 10000, 16, seed);
+//   SparseSGD sgd(0.05);
+//
+//   auto features = embedding({user, item});   // 2 * 16 leaf Values
+//   ... build the loss on features, loss->backpropagate() ...
+//   sgd.step(embedding, embedding.collect_gradients());
+//
+// Work per step is proportional to the rows looked up, never to the size
+// of the table.
+
+// Gradient of the rows touched since the last collect, one dim-wide block
+// per distinct row in first-touch order
+struct SparseGradient {
+  size_t dim = 0;
+  std::vector<u32> rows;
+  std::vector<double> values; // rows.size() * dim
+
+  auto row_gradient(size_t i) const -> const double * {
+    return values.data() + i * dim;
+  }
+};
+
+class Embedding {
+public:
+  // The table lives in `arena`, which must outlive the Embedding. Rows start
+  // uniform in [-1, 1] from the same Philox draws as the dense parameters
+  // (see initial_parameter in Model/Format.hpp), row r as neuron r.
+  // Throws std::invalid_argument for more than UINT32_MAX rows.
+  Embedding(MemoryArena &arena, size_t num_rows, size_t dim, u64 seed);
+
+  Embedding(const Embedding &) = delete;
+  Embedding &operator=(const Embedding &) = delete;
+
+  // * Leaves holding a copy of the row, remembered for collect_gradients().
+  // * Throws std::out_of_range for a row past the table.
+  auto operator()(size_t row) -> std::vector<ValuePtr>;
+
+  // * Rows concatenated, rows.size() * dim() leaves
+  auto operator()(const std::vector<size_t> &rows) -> std::vector<ValuePtr>;
+
+  // * Sums the gradients of every lookup since the last call, by row, and
+  // * forgets those lookups. Call after backpropagating.
+  auto collect_gradients() -> SparseGradient;
+
+  auto row(size_t row) -> double * { return _table + row * _dim; }
+  auto row(size_t row) const -> const double * { return _table + row * _dim; }
+
+  auto num_rows() const -> size_t { return _num_rows; }
+  auto dim() const -> size_t { return _dim; }
+
+private:
+  struct Lookup {
+    u32 row;
+    std::vector<ValuePtr> leaves;
+  };
+
+  static constexpr u32 kNoSlot = ~u32(0);
+
+  double *_table;
+  size_t _num_rows;
+  size_t _dim;
+
+  std::vector<Lookup> _lookups;
+
+  // Row to its block in the SparseGradient being built. Sized once with the
+  // table, only the touched entries are ever written back to kNoSlot.
+  std::vector<u32> _slot;
+};
+
+// * Plain SGD applied to the rows in the gradient only
+class SparseSGD {
+public:
+  explicit SparseSGD(double learning_rate) : _learning_rate(learning_rate) {}
+
+  void step(Embedding &embedding, const SparseGradient &gradient) const;
+
+private:
+  double _learning_rate;
+};
+
+// * Adagrad with per-row state, the usual choice for embeddings since rare
+// * rows keep a large step size. State is updated for touched rows only.
+class SparseAdagrad {
+public:
+  SparseAdagrad(MemoryArena &arena, const Embedding &embedding,
+                double learning_rate, double epsilon = 1e-8);
+
+  void step(Embedding &embedding, const SparseGradient &gradient);
+
+private:
+  double *_accumulators; // One per table entry
+  size_t _dim;
+  double _learning_rate;
+  double _epsilon;
+};
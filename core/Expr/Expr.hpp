@@ -0,0 +1,269 @@
+#pragma once
+#include "../Value.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Expression templates for scalar expressions over Values.
+//
+// The operators on ValuePtr build one node per operation. Wrapping the
+// operands in expr::var() instead builds the expression as a type, and
+// expr::evaluate() turns the whole of it into a single Custom node whose
+// forward and backward are inlined from that type:
+//
+//   auto d = expr::var(y) - expr::var(t);
+//   ValuePtr loss = expr::evaluate(d * d); // one node, inputs y and t
+//
+// Subexpressions used twice, like d above, are computed twice. The node keeps
+// the intermediate results of the forward pass for its backward, so
+// set_value() on an input is not seen until the expression is evaluated again.
+
+namespace expr {
+
+// CRTP base, the operators below only match expression types so the eager
+// ValuePtr operators keep their meaning
+template <typename Derived> struct Expr {
+  auto self() -> Derived & { return static_cast<Derived &>(*this); }
+  auto self() const -> const Derived & {
+    return static_cast<const Derived &>(*this);
+  }
+};
+
+// * ------------- Terminals ---------------
+
+class Var : public Expr<Var> {
+public:
+  explicit Var(ValuePtr value) : _value(std::move(value)) {}
+
+  auto forward() -> double { return _value->get_value(); }
+
+  void backward(double gradient) { _value->accumulate_gradient(gradient); }
+
+  void inputs(std::vector<ValuePtr> &out) const {
+    if (std::find(out.begin(), out.end(), _value) == out.end()) {
+      out.push_back(_value);
+    }
+  }
+
+private:
+  ValuePtr _value;
+};
+
+class Const : public Expr<Const> {
+public:
+  explicit Const(double value) : _value(value) {}
+
+  auto forward() -> double { return _value; }
+  void backward(double) {}
+  void inputs(std::vector<ValuePtr> &) const {}
+
+private:
+  double _value;
+};
+
+inline auto var(ValuePtr value) -> Var { return Var(std::move(value)); }
+
+inline auto constant(double value) -> Const { return Const(value); }
+
+// * ------------- Operations ---------------
+
+// Each node caches its operands' forward results for the backward pass
+
+template <typename L, typename R> class Add : public Expr<Add<L, R>> {
+public:
+  Add(L left, R right) : _left(std::move(left)), _right(std::move(right)) {}
+
+  auto forward() -> double { return _left.forward() + _right.forward(); }
+
+  void backward(double gradient) {
+    _left.backward(gradient);
+    _right.backward(gradient);
+  }
+
+  void inputs(std::vector<ValuePtr> &out) const {
+    _left.inputs(out);
+    _right.inputs(out);
+  }
+
+private:
+  L _left;
+  R _right;
+};
+
+template <typename L, typename R> class Sub : public Expr<Sub<L, R>> {
+public:
+  Sub(L left, R right) : _left(std::move(left)), _right(std::move(right)) {}
+
+  auto forward() -> double { return _left.forward() - _right.forward(); }
+
+  void backward(double gradient) {
+    _left.backward(gradient);
+    _right.backward(-gradient);
+  }
+
+  void inputs(std::vector<ValuePtr> &out) const {
+    _left.inputs(out);
+    _right.inputs(out);
+  }
+
+private:
+  L _left;
+  R _right;
+};
+
+template <typename L, typename R> class Mul : public Expr<Mul<L, R>> {
+public:
+  Mul(L left, R right) : _left(std::move(left)), _right(std::move(right)) {}
+
+  auto forward() -> double {
+    _a = _left.forward();
+    _b = _right.forward();
+    return _a * _b;
+  }
+
+  void backward(double gradient) {
+    _left.backward(_b * gradient);
+    _right.backward(_a * gradient);
+  }
+
+  void inputs(std::vector<ValuePtr> &out) const {
+    _left.inputs(out);
+    _right.inputs(out);
+  }
+
+private:
+  L _left;
+  R _right;
+  double _a = 0.0;
+  double _b = 0.0;
+};
+
+template <typename L, typename R> class Div : public Expr<Div<L, R>> {
+public:
+  Div(L left, R right) : _left(std::move(left)), _right(std::move(right)) {}
+
+  auto forward() -> double {
+    double a = _left.forward();
+    double b = _right.forward();
+    // Same guard as inverse()
+    if (std::abs(b) < 0.0001) {
+      throw std::invalid_argument("Division by zero in inverse operation");
+    }
+    _inverse = 1.0 / b;
+    _result = a * _inverse;
+    return _result;
+  }
+
+  void backward(double gradient) {
+    _left.backward(gradient * _inverse);
+    _right.backward(-gradient * _result * _inverse);
+  }
+
+  void inputs(std::vector<ValuePtr> &out) const {
+    _left.inputs(out);
+    _right.inputs(out);
+  }
+
+private:
+  L _left;
+  R _right;
+  double _inverse = 0.0;
+  double _result = 0.0;
+};
+
+template <typename E> class Neg : public Expr<Neg<E>> {
+public:
+  explicit Neg(E operand) : _operand(std::move(operand)) {}
+
+  auto forward() -> double { return -_operand.forward(); }
+  void backward(double gradient) { _operand.backward(-gradient); }
+  void inputs(std::vector<ValuePtr> &out) const { _operand.inputs(out); }
+
+private:
+  E _operand;
+};
+
+template <typename E> class Relu : public Expr<Relu<E>> {
+public:
+  explicit Relu(E operand) : _operand(std::move(operand)) {}
+
+  auto forward() -> double {
+    double x = _operand.forward();
+    _active = x > 0;
+    return _active ? x : 0.0;
+  }
+
+  void backward(double gradient) {
+    if (_active) {
+      _operand.backward(gradient);
+    }
+  }
+
+  void inputs(std::vector<ValuePtr> &out) const { _operand.inputs(out); }
+
+private:
+  E _operand;
+  bool _active = false;
+};
+
+// * ------------- Operators ---------------
+
+#define EXPR_BINARY_OPERATOR(op, Node)                                         \
+  template <typename L, typename R>                                            \
+  auto operator op(const Expr<L> &left, const Expr<R> &right)->Node<L, R> {    \
+    return Node<L, R>(left.self(), right.self());                              \
+  }                                                                            \
+  template <typename L>                                                        \
+  auto operator op(const Expr<L> &left, double right)->Node<L, Const> {        \
+    return Node<L, Const>(left.self(), Const(right));                          \
+  }                                                                            \
+  template <typename R>                                                        \
+  auto operator op(double left, const Expr<R> &right)->Node<Const, R> {        \
+    return Node<Const, R>(Const(left), right.self());                          \
+  }                                                                            \
+  template <typename L>                                                        \
+  auto operator op(const Expr<L> &left, const ValuePtr &right)->Node<L, Var> { \
+    return Node<L, Var>(left.self(), Var(right));                              \
+  }                                                                            \
+  template <typename R>                                                        \
+  auto operator op(const ValuePtr &left, const Expr<R> &right)->Node<Var, R> { \
+    return Node<Var, R>(Var(left), right.self());                              \
+  }
+
+EXPR_BINARY_OPERATOR(+, Add)
+EXPR_BINARY_OPERATOR(-, Sub)
+EXPR_BINARY_OPERATOR(*, Mul)
+EXPR_BINARY_OPERATOR(/, Div)
+
+#undef EXPR_BINARY_OPERATOR
+
+template <typename E> auto operator-(const Expr<E> &operand) -> Neg<E> {
+  return Neg<E>(operand.self());
+}
+
+template <typename E> auto relu(const Expr<E> &operand) -> Relu<E> {
+  return Relu<E>(operand.self());
+}
+
+// * ------------- Evaluation ---------------
+
+// * One Custom node for the whole expression. Its inputs are the distinct
+// * Values the expression reads, and backward pushes the gradient straight
+// * into them.
+template <typename E> auto evaluate(const Expr<E> &expression) -> ValuePtr {
+  PROFILE_OP(profile::Op::Fused);
+  E body = expression.self();
+  double value = body.forward();
+
+  std::vector<ValuePtr> inputs;
+  body.inputs(inputs);
+  return create_fused(value, std::move(inputs),
+                      [body = std::move(body)](double gradient) mutable {
+                        body.backward(gradient);
+                      });
+}
+
+} // namespace expr
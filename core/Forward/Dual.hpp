@@ -0,0 +1,183 @@
+#pragma once
+#include "../Activation.hpp"
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+
+// Forward-mode automatic differentiation.
+//
+// A BatchDual carries a value and K tangents, the derivatives of that value
+// along K input directions. Arithmetic on it propagates all K lanes at once
+// and records nothing, so a forward pass over BatchDuals computes K
+// Jacobian-vector products for roughly (1 + K) times the cost of the plain
+// pass. Lanes are a fixed-size array and every lane loop has a constant trip
+// count, which the compiler unrolls and vectorizes.
+//
+// Neuron, Layer and MultiLayerPerceptron accept BatchDual inputs directly,
+// see ScalarTraits in Neuron.h and Forward/Jvp.hpp.
+
+template <typename T, size_t K> struct BatchDual {
+  using Scalar = T;
+
+  T value;
+  std::array<T, K> tangent;
+
+  BatchDual() : BatchDual(T(0)) {}
+
+  // Constants have zero tangents
+  BatchDual(T value_in) : value(value_in) { tangent.fill(T(0)); }
+
+  // An input whose tangent is 1 in `lane` and 0 elsewhere
+  static auto variable(T value_in, size_t lane) -> BatchDual {
+    BatchDual result(value_in);
+    result.tangent[lane] = T(1);
+    return result;
+  }
+};
+
+// A single tangent lane
+template <typename T> using Dual = BatchDual<T, 1>;
+
+// * ------------- Arithmetic ---------------
+
+template <typename T, size_t K>
+auto operator+(const BatchDual<T, K> &a, const BatchDual<T, K> &b)
+    -> BatchDual<T, K> {
+  BatchDual<T, K> out(a.value + b.value);
+  for (size_t k = 0; k < K; k++) {
+    out.tangent[k] = a.tangent[k] + b.tangent[k];
+  }
+  return out;
+}
+
+template <typename T, size_t K>
+auto operator-(const BatchDual<T, K> &a, const BatchDual<T, K> &b)
+    -> BatchDual<T, K> {
+  BatchDual<T, K> out(a.value - b.value);
+  for (size_t k = 0; k < K; k++) {
+    out.tangent[k] = a.tangent[k] - b.tangent[k];
+  }
+  return out;
+}
+
+template <typename T, size_t K>
+auto operator*(const BatchDual<T, K> &a, const BatchDual<T, K> &b)
+    -> BatchDual<T, K> {
+  BatchDual<T, K> out(a.value * b.value);
+  for (size_t k = 0; k < K; k++) {
+    out.tangent[k] = a.tangent[k] * b.value + a.value * b.tangent[k];
+  }
+  return out;
+}
+
+template <typename T, size_t K>
+auto operator-(const BatchDual<T, K> &a) -> BatchDual<T, K> {
+  BatchDual<T, K> out(-a.value);
+  for (size_t k = 0; k < K; k++) {
+    out.tangent[k] = -a.tangent[k];
+  }
+  return out;
+}
+
+// Mixed with plain scalars, which is how parameters enter the layer code.
+// These skip the multiplications by the constant's zero tangents. The scalar
+// is not deduced, so double parameters also work with float lanes.
+
+template <typename T, size_t K>
+auto operator+(const BatchDual<T, K> &a,
+               typename BatchDual<T, K>::Scalar b) -> BatchDual<T, K> {
+  BatchDual<T, K> out = a;
+  out.value += b;
+  return out;
+}
+
+template <typename T, size_t K>
+auto operator+(typename BatchDual<T, K>::Scalar a,
+               const BatchDual<T, K> &b) -> BatchDual<T, K> {
+  return b + a;
+}
+
+template <typename T, size_t K>
+auto operator-(const BatchDual<T, K> &a,
+               typename BatchDual<T, K>::Scalar b) -> BatchDual<T, K> {
+  BatchDual<T, K> out = a;
+  out.value -= b;
+  return out;
+}
+
+template <typename T, size_t K>
+auto operator-(typename BatchDual<T, K>::Scalar a,
+               const BatchDual<T, K> &b) -> BatchDual<T, K> {
+  return -b + a;
+}
+
+template <typename T, size_t K>
+auto operator*(const BatchDual<T, K> &a,
+               typename BatchDual<T, K>::Scalar b) -> BatchDual<T, K> {
+  BatchDual<T, K> out(a.value * b);
+  for (size_t k = 0; k < K; k++) {
+    out.tangent[k] = a.tangent[k] * b;
+  }
+  return out;
+}
+
+template <typename T, size_t K>
+auto operator*(typename BatchDual<T, K>::Scalar a,
+               const BatchDual<T, K> &b) -> BatchDual<T, K> {
+  return b * a;
+}
+
+// * ------------- Functions ---------------
+
+// * a * b + c
+template <typename T, size_t K>
+auto fma(const BatchDual<T, K> &a, const BatchDual<T, K> &b,
+         const BatchDual<T, K> &c) -> BatchDual<T, K> {
+  BatchDual<T, K> out(a.value * b.value + c.value);
+  for (size_t k = 0; k < K; k++) {
+    out.tangent[k] = a.tangent[k] * b.value + a.value * b.tangent[k] +
+                     c.tangent[k];
+  }
+  return out;
+}
+
+template <typename T, size_t K>
+auto inverse(const BatchDual<T, K> &a) -> BatchDual<T, K> {
+  // Same guard as inverse(ValuePtr)
+  if (std::abs(a.value) < 0.0001) {
+    throw std::invalid_argument("Division by zero in inverse operation");
+  }
+  T inv = T(1) / a.value;
+  BatchDual<T, K> out(inv);
+  for (size_t k = 0; k < K; k++) {
+    out.tangent[k] = -inv * inv * a.tangent[k];
+  }
+  return out;
+}
+
+// Derivative 0 at the kink, matching relu(ValuePtr)
+template <typename T, size_t K>
+auto relu(const BatchDual<T, K> &a) -> BatchDual<T, K> {
+  return a.value > 0 ? a : BatchDual<T, K>(T(0));
+}
+
+template <typename T, size_t K>
+auto activate(const BatchDual<T, K> &z, Activation activation)
+    -> BatchDual<T, K> {
+  T y = static_cast<T>(apply_activation(activation, z.value));
+  T slope = static_cast<T>(activation_derivative(activation, z.value, y));
+  BatchDual<T, K> out(y);
+  for (size_t k = 0; k < K; k++) {
+    out.tangent[k] = slope * z.tangent[k];
+  }
+  return out;
+}
+
+// * activation(x * w + c), the last term of a Neuron
+template <typename T, size_t K>
+auto activate(const BatchDual<T, K> &x, typename BatchDual<T, K>::Scalar w,
+              const BatchDual<T, K> &c, Activation activation)
+    -> BatchDual<T, K> {
+  return activate(x * w + c, activation);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "../Neuron.h"
+#include "Dual.hpp"
+#include <vector>
+
+// Jacobian-vector products of a MultiLayerPerceptron by forward mode. The
+// buffers are sized once in the constructor, so each product runs the
+// network on BatchDuals without allocating or touching the graph.
+//
+//   Jvp<2> jvp(mlp);
+//   jvp(x, directions, outputs, tangents);
+//
+// directions[i * K + k] is the k-th direction's component along input i and
+// tangents[o * K + k] receives d output o / d direction k.
+template <size_t K, typename T = double> class Jvp {
+public:
+  using Lanes = BatchDual<T, K>;
+
+  explicit Jvp(const MultiLayerPerceptron &mlp)
+      : _mlp(mlp), _inputs(mlp.num_inputs()), _outputs(mlp.num_outputs()),
+        _scratch(2 * mlp.max_width()) {}
+
+  void operator()(const T *x, const T *directions, T *outputs, T *tangents) {
+    for (size_t i = 0; i < _inputs.size(); i++) {
+      _inputs[i].value = x[i];
+      for (size_t k = 0; k < K; k++) {
+        _inputs[i].tangent[k] = directions[i * K + k];
+      }
+    }
+
+    _mlp.evaluate(_inputs.data(), _outputs.data(), _scratch.data());
+
+    for (size_t o = 0; o < _outputs.size(); o++) {
+      outputs[o] = _outputs[o].value;
+      for (size_t k = 0; k < K; k++) {
+        tangents[o * K + k] = _outputs[o].tangent[k];
+      }
+    }
+  }
+
+private:
+  const MultiLayerPerceptron &_mlp;
+  std::vector<Lanes> _inputs;
+  std::vector<Lanes> _outputs;
+  std::vector<Lanes> _scratch;
+};
@@ -0,0 +1,245 @@
+#include "Incremental.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+// d node / d input k, from the node's input values and its own value y
+auto partial(const TapeNode &node, const double *in, double y, u8 k)
+    -> double {
+  switch (node.op) {
+  case ValueOp::Add:
+    return 1.0;
+  case ValueOp::Sub:
+    return k == 0 ? 1.0 : -1.0;
+  case ValueOp::Mul:
+    return in[1 - k];
+  case ValueOp::Neg:
+    return -1.0;
+  case ValueOp::Fma:
+    return k == 0 ? in[1] : k == 1 ? in[0] : 1.0;
+  case ValueOp::Inverse:
+    return -y * y;
+  case ValueOp::Relu:
+    return y > 0 ? 1.0 : 0.0;
+  case ValueOp::Activate:
+    return activation_derivative(node.activation, in[0], y);
+  case ValueOp::FmaActivate: {
+    double local = activation_derivative(node.activation,
+                                         in[0] * in[1] + in[2], y);
+    return k == 0 ? in[1] * local : k == 1 ? in[0] * local : local;
+  }
+  case ValueOp::Leaf:
+  case ValueOp::Constant:
+  case ValueOp::Custom:
+    break;
+  }
+  return 0.0;
+}
+
+} // namespace
+
+IncrementalTape::IncrementalTape(Tape tape) : _tape(std::move(tape)) {
+  u32 n = static_cast<u32>(_tape.size());
+  u32 root = _tape.root();
+  for (u32 i = 0; i <= root; i++) {
+    if (_tape.node(i).op == ValueOp::Custom) {
+      throw std::invalid_argument("Cannot evaluate custom nodes");
+    }
+    if (_tape.node(i).op == ValueOp::Leaf) {
+      _leaves.emplace(_tape.source(i).get(), i);
+    }
+  }
+
+  _consumer_begin.assign(n + 1, 0);
+  for (u32 c = 0; c <= root; c++) {
+    const TapeNode &node = _tape.node(c);
+    for (u8 k = 0; k < node.num_inputs; k++) {
+      _consumer_begin[node.inputs[k] + 1]++;
+    }
+  }
+  for (u32 i = 0; i < n; i++) {
+    _consumer_begin[i + 1] += _consumer_begin[i];
+  }
+  _consumers.resize(_consumer_begin[n]);
+  _consumer_input.resize(_consumer_begin[n]);
+  std::vector<u32> fill(_consumer_begin.begin(), _consumer_begin.end() - 1);
+  for (u32 c = 0; c <= root; c++) {
+    const TapeNode &node = _tape.node(c);
+    for (u8 k = 0; k < node.num_inputs; k++) {
+      u32 at = fill[node.inputs[k]]++;
+      _consumers[at] = c;
+      _consumer_input[at] = k;
+    }
+  }
+
+  _values.resize(n);
+  for (u32 i = 0; i < n; i++) {
+    _values[i] = _tape.node(i).op == ValueOp::Leaf
+                     ? _tape.source(i)->get_value()
+                     : _tape.value(i);
+  }
+  for (u32 i = 0; i <= root; i++) {
+    if (_tape.node(i).op != ValueOp::Leaf &&
+        _tape.node(i).op != ValueOp::Constant) {
+      _values[i] = recompute_value(i);
+    }
+  }
+  _stats.forward_nodes = root + 1;
+
+  _gradients.assign(n, 0.0);
+  for (u32 i = root + 1; i-- > 0;) {
+    _gradients[i] = recompute_gradient(i);
+  }
+  for (u32 i = 0; i < n; i++) {
+    if (_tape.node(i).op == ValueOp::Leaf) {
+      _tape.source(i)->set_gradient(_gradients[i]);
+    }
+  }
+  _stats.backward_nodes = root + 1;
+
+  _dirty.assign(n, 0);
+  _dirty_begin = root + 1;
+  _in_change.assign(n, 0);
+}
+
+auto IncrementalTape::leaf(const ValuePtr &value) const -> u32 {
+  auto found = _leaves.find(value.get());
+  if (found == _leaves.end()) {
+    throw std::invalid_argument("Value is not a leaf of this tape");
+  }
+  return found->second;
+}
+
+void IncrementalTape::set_value(u32 leaf, double value) {
+  _tape.source(leaf)->set_value(value);
+  if (_values[leaf] == value) {
+    return;
+  }
+  _values[leaf] = value;
+  mark_consumers(leaf);
+}
+
+void IncrementalTape::sync_leaves() {
+  for (const auto &[source, leaf] : _leaves) {
+    double value = source->get_value();
+    if (_values[leaf] != value) {
+      _values[leaf] = value;
+      mark_consumers(leaf);
+    }
+  }
+}
+
+void IncrementalTape::mark_consumers(u32 node) {
+  for (u32 at = _consumer_begin[node]; at < _consumer_begin[node + 1];
+       at++) {
+    _dirty[_consumers[at]] = 1;
+  }
+  // Consumers are listed in tape order, the first is the earliest
+  if (_consumer_begin[node] < _consumer_begin[node + 1]) {
+    _dirty_begin = std::min(_dirty_begin, _consumers[_consumer_begin[node]]);
+  }
+}
+
+auto IncrementalTape::recompute_value(u32 node) const -> double {
+  const TapeNode &tape_node = _tape.node(node);
+  double in[3];
+  for (u8 k = 0; k < tape_node.num_inputs; k++) {
+    in[k] = _values[tape_node.inputs[k]];
+  }
+  return Tape::evaluate(tape_node.op, in, tape_node.activation);
+}
+
+auto IncrementalTape::recompute_gradient(u32 node) const -> double {
+  if (node == _tape.root()) {
+    return 1.0;
+  }
+  double sum = 0.0;
+  double in[3];
+  for (u32 at = _consumer_begin[node]; at < _consumer_begin[node + 1];
+       at++) {
+    u32 consumer = _consumers[at];
+    const TapeNode &tape_node = _tape.node(consumer);
+    for (u8 k = 0; k < tape_node.num_inputs; k++) {
+      in[k] = _values[tape_node.inputs[k]];
+    }
+    sum += partial(tape_node, in, _values[consumer], _consumer_input[at]) *
+           _gradients[consumer];
+  }
+  return sum;
+}
+
+auto IncrementalTape::forward() -> double {
+  u32 root = _tape.root();
+  _stats.forward_nodes = 0;
+  // Consumers come after their inputs, so one pass in order sees every node
+  // the wave dirties
+  for (u32 node = _dirty_begin; node <= root; node++) {
+    if (!_dirty[node]) {
+      continue;
+    }
+    _dirty[node] = 0;
+    _stats.forward_nodes++;
+
+    if (!_in_change[node]) {
+      _in_change[node] = 1;
+      _changed.push_back(node);
+    }
+    double value = recompute_value(node);
+    if (value != _values[node]) {
+      _values[node] = value;
+      mark_consumers(node);
+    }
+  }
+  _dirty_begin = root + 1;
+  return _values[root];
+}
+
+void IncrementalTape::backward() {
+  if (_dirty_begin <= _tape.root()) {
+    forward();
+  }
+  _stats.backward_nodes = 0;
+
+  // Reuses the forward flags, which are clear now. Inputs come before their
+  // consumers, so one pass down from the highest flagged node sees them all.
+  u32 begin = _tape.root() + 1;
+  u32 end = 0;
+  auto flag = [&](u32 node) {
+    if (_tape.node(node).op != ValueOp::Constant) {
+      _dirty[node] = 1;
+      begin = std::min(begin, node);
+      end = std::max(end, node + 1);
+    }
+  };
+  // A recomputed node's partials changed, so its inputs' gradients may have
+  for (u32 node : _changed) {
+    _in_change[node] = 0;
+    const TapeNode &tape_node = _tape.node(node);
+    for (u8 k = 0; k < tape_node.num_inputs; k++) {
+      flag(tape_node.inputs[k]);
+    }
+  }
+  _changed.clear();
+
+  for (u32 node = end; node-- > begin;) {
+    if (!_dirty[node]) {
+      continue;
+    }
+    _dirty[node] = 0;
+    _stats.backward_nodes++;
+
+    double gradient = recompute_gradient(node);
+    if (gradient == _gradients[node]) {
+      continue;
+    }
+    _gradients[node] = gradient;
+    const TapeNode &tape_node = _tape.node(node);
+    if (tape_node.op == ValueOp::Leaf) {
+      _tape.source(node)->set_gradient(gradient);
+    }
+    for (u8 k = 0; k < tape_node.num_inputs; k++) {
+      flag(tape_node.inputs[k]);
+    }
+  }
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include "Tape.hpp"
+#include <unordered_map>
+
+// A captured graph kept alive between evaluations, for sweeps that change
+// one input or weight at a time and re-read the output.
+//
+//   IncrementalTape graph(Tape::capture(loss));   // Full evaluation once
+//   graph.set_value(graph.leaf(x[3]), 0.25);      // Marks x[3] dirty
+//   double y = graph.forward();                   // Only x[3]'s cone
+//   graph.backward();                             // Only what it changed
+//
+// forward() walks the tape in order from the lowest dirty node, recomputing
+// only nodes flagged dirty. A node whose value comes out unchanged does not
+// dirty its consumers, so a dead relu or a zero weight stops the wave early.
+//
+// backward() computes each gradient by pulling from the node's consumers,
+// g[i] = sum over consumers c of dc/di * g[c]. A gradient is redone when a
+// consumer's gradient changed or a consumer was recomputed (its partials
+// depend on its inputs), walking down from the highest such node, and
+// unchanged gradients stop the wave again. Changed leaf gradients are
+// written back to their Values.
+//
+// Cost follows the part of the graph that changes. A perturbed weight near
+// the output touches little; an input feeding every neuron touches most of
+// the forward pass, and most gradients depend on every activation.
+
+struct IncrementalStats {
+  size_t forward_nodes = 0;  // Values recomputed by the last forward()
+  size_t backward_nodes = 0; // Gradients recomputed by the last backward()
+};
+
+class IncrementalTape {
+public:
+  // * Evaluates the whole tape forward and backward once
+  explicit IncrementalTape(Tape tape);
+
+  // * The tape index of a leaf. Throws std::invalid_argument if the tape
+  // * does not read this Value.
+  auto leaf(const ValuePtr &value) const -> u32;
+
+  // * Sets a leaf here and on its Value and marks it dirty
+  void set_value(u32 leaf, double value);
+
+  // * Marks every leaf whose Value was set directly since the tape last saw
+  // * it. Costs one read per leaf.
+  void sync_leaves();
+
+  // * Recomputes the dirty cone, returns the root value
+  auto forward() -> double;
+
+  // * Runs forward() if anything is dirty, then updates the gradients the
+  // * recomputed nodes affect
+  void backward();
+
+  auto value(u32 node) const -> double { return _values[node]; }
+  auto gradient(u32 node) const -> double { return _gradients[node]; }
+  auto root() const -> u32 { return _tape.root(); }
+  auto stats() const -> const IncrementalStats & { return _stats; }
+
+private:
+  void mark_consumers(u32 node);
+  auto recompute_value(u32 node) const -> double;
+  auto recompute_gradient(u32 node) const -> double;
+
+  Tape _tape;
+  std::vector<double> _values;
+  std::vector<double> _gradients;
+  std::unordered_map<const Value *, u32> _leaves;
+
+  // Consumers of node i at [_consumer_begin[i], _consumer_begin[i + 1]),
+  // each with the input position it reads i at. Nodes past the root are
+  // left out.
+  std::vector<u32> _consumer_begin;
+  std::vector<u32> _consumers;
+  std::vector<u8> _consumer_input;
+
+  // Flags of nodes to recompute, none below _dirty_begin. forward() leaves
+  // them clear for backward() to reuse.
+  std::vector<u8> _dirty;
+  u32 _dirty_begin;
+  std::vector<u32> _changed;  // Recomputed since the last backward()
+  std::vector<u8> _in_change; // Node is in _changed
+  IncrementalStats _stats;
+};
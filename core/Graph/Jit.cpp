@@ -0,0 +1,591 @@
+#include "Jit.hpp"
+#include "../Shared/hash.hpp"
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define JIT_HAVE_DLOPEN 1
+#include <cerrno>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#else
+#define JIT_HAVE_DLOPEN 0
+#endif
+
+#ifndef MICROGRAD_JIT_DEFAULT_CXX
+#define MICROGRAD_JIT_DEFAULT_CXX "c++"
+#endif
+
+namespace {
+
+// Bump when the emitted code changes, so stale cache entries are not loaded
+constexpr u64 kCodegenVersion = 1;
+
+// Nodes per generated function. Compile time grows faster than linearly
+// with the size of a function, so one function per tape does not scale.
+constexpr u32 kNodesPerPart = 256;
+
+// Overloads the shared byte version rather than hiding it
+using ::fnv1a;
+
+void fnv1a(u64 &hash, const std::string &text) {
+  fnv1a(hash, text.data(), text.size());
+  fnv1a(hash, "", 1); // Separator, so adjacent strings cannot run together
+}
+
+auto hex(u64 value) -> std::string {
+  char buffer[17];
+  std::snprintf(buffer, sizeof(buffer), "%016llx",
+                static_cast<unsigned long long>(value));
+  return buffer;
+}
+
+// Exact, hexadecimal floating point survives the round trip bit for bit
+auto literal(double value) -> std::string {
+  if (std::isnan(value)) {
+    return "NAN";
+  }
+  if (std::isinf(value)) {
+    return value > 0 ? "HUGE_VAL" : "(-HUGE_VAL)";
+  }
+  char buffer[64];
+  std::snprintf(buffer, sizeof(buffer), "%a", value);
+  return value < 0 ? "(" + std::string(buffer) + ")" : buffer;
+}
+
+// Activation.hpp, spelled out so the generated file needs no include path
+auto activation_prelude() -> std::string {
+  std::ostringstream os;
+  os << "#include <cmath>\n\n"
+     << "static inline double act(int a, double z) {\n"
+     << "  switch (a) {\n"
+     << "  case " << int(Activation::Relu) << ": return z > 0 ? z : 0.0;\n"
+     << "  case " << int(Activation::LeakyRelu) << ": return z > 0 ? z : "
+     << literal(kLeakySlope) << " * z;\n"
+     << "  case " << int(Activation::Tanh) << ": return std::tanh(z);\n"
+     << "  case " << int(Activation::Sigmoid)
+     << ": return z >= 0 ? 1.0 / (1.0 + std::exp(-z))\n"
+     << "                  : std::exp(z) / (1.0 + std::exp(z));\n"
+     << "  case " << int(Activation::Gelu)
+     << ": return 0.5 * z * (1.0 + std::erf(z * " << literal(M_SQRT1_2)
+     << "));\n"
+     << "  }\n"
+     << "  return z;\n"
+     << "}\n\n"
+     << "static inline double dact(int a, double z, double y) {\n"
+     << "  switch (a) {\n"
+     << "  case " << int(Activation::Relu) << ": return z > 0 ? 1.0 : 0.0;\n"
+     << "  case " << int(Activation::LeakyRelu) << ": return z > 0 ? 1.0 : "
+     << literal(kLeakySlope) << ";\n"
+     << "  case " << int(Activation::Tanh) << ": return 1.0 - y * y;\n"
+     << "  case " << int(Activation::Sigmoid) << ": return y * (1.0 - y);\n"
+     << "  case " << int(Activation::Gelu)
+     << ": return 0.5 * (1.0 + std::erf(z * " << literal(M_SQRT1_2)
+     << ")) +\n"
+     << "                 z * " << literal(0.3989422804014327)
+     << " * std::exp(-0.5 * z * z);\n"
+     << "  }\n"
+     << "  return 1.0;\n"
+     << "}\n\n";
+  return os.str();
+}
+
+auto default_compiler() -> std::string {
+  const char *env = std::getenv("MICROGRAD_JIT_CXX");
+  return env && *env ? env : MICROGRAD_JIT_DEFAULT_CXX;
+}
+
+// Per user, a shared directory would let anyone plant objects we load
+auto default_cache_dir() -> std::filesystem::path {
+  const char *env = std::getenv("MICROGRAD_JIT_CACHE");
+  if (env && *env) {
+    return env;
+  }
+  const char *xdg = std::getenv("XDG_CACHE_HOME");
+  if (xdg && *xdg) {
+    return std::filesystem::path(xdg) / "micrograd_jit";
+  }
+  const char *home = std::getenv("HOME");
+  if (home && *home) {
+    return std::filesystem::path(home) / ".cache" / "micrograd_jit";
+  }
+  std::error_code error;
+  std::filesystem::path temp = std::filesystem::temp_directory_path(error);
+  std::string name = "micrograd_jit";
+#if JIT_HAVE_DLOPEN
+  name += "-" + std::to_string(geteuid());
+#endif
+  return (error ? std::filesystem::path("/tmp") : temp) / name;
+}
+
+// Whitespace separated, as a shell would split them without quoting
+auto split_flags(const std::string &flags) -> std::vector<std::string> {
+  std::vector<std::string> words;
+  std::istringstream in(flags);
+  std::string word;
+  while (in >> word) {
+    words.push_back(word);
+  }
+  return words;
+}
+
+// Unique within the machine, so concurrent builds of one graph never share
+// a temporary file
+auto temp_suffix() -> std::string {
+  static std::atomic<u64> counter{0};
+#if JIT_HAVE_DLOPEN
+  u64 pid = static_cast<u64>(getpid());
+#else
+  u64 pid = 0;
+#endif
+  return "." + std::to_string(pid) + "." + std::to_string(counter++) + ".tmp";
+}
+
+#if JIT_HAVE_DLOPEN
+// Anyone who can replace a cached object runs code in this process, so only
+// paths this user owns and no one else can write are trusted
+auto check_private(const std::filesystem::path &path, std::string &reason)
+    -> bool {
+  struct stat info {};
+  if (::stat(path.c_str(), &info) != 0) {
+    reason = "Cannot stat " + path.string() + ": " + std::strerror(errno);
+    return false;
+  }
+  if (info.st_uid != geteuid()) {
+    reason = "Refusing " + path.string() + ": not owned by this user";
+    return false;
+  }
+  if (info.st_mode & (S_IWGRP | S_IWOTH)) {
+    reason = "Refusing " + path.string() + ": writable by group or others";
+    return false;
+  }
+  return true;
+}
+
+// Runs args[0] from PATH with stdout and stderr going to `log`, no shell
+// in between, so nothing in the arguments is ever interpreted
+auto run_compiler(const std::vector<std::string> &args,
+                  const std::filesystem::path &log, std::string &reason)
+    -> bool {
+  std::vector<char *> argv;
+  for (const std::string &arg : args) {
+    argv.push_back(const_cast<char *>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, log.c_str(),
+                                   O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+  pid_t pid = 0;
+  int spawned =
+      posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+  posix_spawn_file_actions_destroy(&actions);
+  if (spawned != 0) {
+    reason = "Cannot run " + args[0] + ": " + std::strerror(spawned);
+    return false;
+  }
+  int status = 0;
+  while (waitpid(pid, &status, 0) < 0) {
+    if (errno != EINTR) {
+      reason = std::string("Lost the compiler: ") + std::strerror(errno);
+      return false;
+    }
+  }
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    reason = "Compiler failed:";
+    for (const std::string &arg : args) {
+      reason += " " + arg;
+    }
+    reason += "\n";
+    return false;
+  }
+  return true;
+}
+
+// Parents as usual, the cache directory itself 0700
+auto create_private_directory(const std::filesystem::path &dir,
+                              std::string &reason) -> bool {
+  std::error_code error;
+  if (dir.has_parent_path()) {
+    std::filesystem::create_directories(dir.parent_path(), error);
+    if (error) {
+      reason = "Cannot create " + dir.parent_path().string() + ": " +
+               error.message();
+      return false;
+    }
+  }
+  if (::mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST) {
+    reason = "Cannot create " + dir.string() + ": " + std::strerror(errno);
+    return false;
+  }
+  return check_private(dir, reason);
+}
+#endif
+
+auto read_file(const std::filesystem::path &path) -> std::string {
+  std::ifstream in(path);
+  std::ostringstream text;
+  text << in.rdbuf();
+  return text.str();
+}
+
+} // namespace
+
+auto tape_hash(const Tape &tape) -> u64 {
+  u64 hash = kFnvOffset;
+  fnv1a(hash, &kCodegenVersion, sizeof(kCodegenVersion));
+  u64 size = tape.size();
+  fnv1a(hash, &size, sizeof(size));
+  for (u32 i = 0; i < tape.size(); i++) {
+    const TapeNode &node = tape.node(i);
+    fnv1a(hash, &node.op, sizeof(node.op));
+    fnv1a(hash, &node.activation, sizeof(node.activation));
+    fnv1a(hash, node.inputs, node.num_inputs * sizeof(u32));
+    if (node.op == ValueOp::Constant) {
+      double value = tape.value(i);
+      fnv1a(hash, &value, sizeof(value));
+    }
+  }
+  u32 root = tape.root();
+  fnv1a(hash, &root, sizeof(root));
+  return hash;
+}
+
+auto emit_tape_source(const Tape &tape, const std::string &symbol)
+    -> std::string {
+  std::ostringstream os;
+  os << "// Generated from a captured tape of " << tape.size() << " nodes\n";
+  os << activation_prelude();
+  const char *params = "(const double *__restrict in, "
+                       "double *__restrict grad_out, "
+                       "double *__restrict v, double *__restrict g)";
+
+  // Leaves are numbered in tape order, constants are inlined
+  std::vector<u32> leaf_number(tape.size(), 0);
+  u32 leaves = 0;
+  for (u32 i = 0; i < tape.size(); i++) {
+    if (tape.node(i).op == ValueOp::Leaf) {
+      leaf_number[i] = leaves++;
+    }
+  }
+  auto v = [&](u32 index) {
+    return tape.node(index).op == ValueOp::Constant
+               ? literal(tape.value(index))
+               : "v[" + std::to_string(index) + "]";
+  };
+  auto g = [](u32 index) { return "g[" + std::to_string(index) + "]"; };
+  // Appends in order. "-" + g(i) inserts at the front of the temporary,
+  // which GCC 12 flags with a spurious -Wrestrict.
+  auto join = [](std::initializer_list<std::string> pieces) {
+    std::string joined;
+    for (const std::string &piece : pieces) {
+      joined += piece;
+    }
+    return joined;
+  };
+
+  // Forward in parts of kNodesPerPart nodes
+  u32 root = tape.root();
+  size_t parts = 0;
+  for (u32 first = 0; first <= root; first += kNodesPerPart) {
+    os << "__attribute__((noinline)) static int part" << parts++ << params
+       << " {\n";
+    for (u32 i = first; i <= root && i < first + kNodesPerPart; i++) {
+      const TapeNode &node = tape.node(i);
+      const u32 *in = node.inputs;
+      std::string out = "  v[" + std::to_string(i) + "] = ";
+      switch (node.op) {
+      case ValueOp::Leaf:
+        os << out << "in[" << leaf_number[i] << "];\n";
+        break;
+      case ValueOp::Constant:
+        break;
+      case ValueOp::Add:
+        os << out << v(in[0]) << " + " << v(in[1]) << ";\n";
+        break;
+      case ValueOp::Sub:
+        os << out << v(in[0]) << " - " << v(in[1]) << ";\n";
+        break;
+      case ValueOp::Mul:
+        os << out << v(in[0]) << " * " << v(in[1]) << ";\n";
+        break;
+      case ValueOp::Neg:
+        os << out << "-" << v(in[0]) << ";\n";
+        break;
+      case ValueOp::Fma:
+        os << out << v(in[0]) << " * " << v(in[1]) << " + " << v(in[2])
+           << ";\n";
+        break;
+      case ValueOp::Inverse:
+        os << "  if (std::abs(" << v(in[0]) << ") < 0.0001) return 1;\n"
+           << out << "1.0 / " << v(in[0]) << ";\n";
+        break;
+      case ValueOp::Relu:
+        os << out << v(in[0]) << " > 0 ? " << v(in[0]) << " : 0.0;\n";
+        break;
+      case ValueOp::Activate:
+        os << out << "act(" << int(node.activation) << ", " << v(in[0])
+           << ");\n";
+        break;
+      case ValueOp::FmaActivate:
+        os << out << "act(" << int(node.activation) << ", " << v(in[0])
+           << " * " << v(in[1]) << " + " << v(in[2]) << ");\n";
+        break;
+      case ValueOp::Custom:
+        throw std::invalid_argument("Tape cannot evaluate this node");
+      }
+    }
+    os << "  return 0;\n}\n\n";
+  }
+  size_t forward_parts = parts;
+
+  // Backward, root down. Constants take no gradient.
+  auto add = [&](u32 input, const std::string &term) {
+    if (tape.node(input).op != ValueOp::Constant) {
+      os << "  " << g(input) << " += " << term << ";\n";
+    }
+  };
+  for (u32 last = root + 1; last > 0;
+       last = last > kNodesPerPart ? last - kNodesPerPart : 0) {
+    u32 first = last > kNodesPerPart ? last - kNodesPerPart : 0;
+    os << "__attribute__((noinline)) static int part" << parts++ << params
+       << " {\n";
+    for (u32 i = last; i-- > first;) {
+      const TapeNode &node = tape.node(i);
+      const u32 *in = node.inputs;
+      switch (node.op) {
+      case ValueOp::Add:
+        add(in[0], g(i));
+        add(in[1], g(i));
+        break;
+      case ValueOp::Sub:
+        add(in[0], g(i));
+        add(in[1], join({"-", g(i)}));
+        break;
+      case ValueOp::Mul:
+        add(in[0], v(in[1]) + " * " + g(i));
+        add(in[1], v(in[0]) + " * " + g(i));
+        break;
+      case ValueOp::Neg:
+        add(in[0], join({"-", g(i)}));
+        break;
+      case ValueOp::Fma:
+        add(in[0], v(in[1]) + " * " + g(i));
+        add(in[1], v(in[0]) + " * " + g(i));
+        add(in[2], g(i));
+        break;
+      case ValueOp::Inverse:
+        add(in[0], join({"-", v(i), " * ", v(i), " * ", g(i)}));
+        break;
+      case ValueOp::Relu:
+        add(in[0], join({"(", v(i), " > 0 ? ", g(i), " : 0.0)"}));
+        break;
+      case ValueOp::Activate:
+        add(in[0], g(i) + " * dact(" + std::to_string(int(node.activation)) +
+                       ", " + v(in[0]) + ", " + v(i) + ")");
+        break;
+      case ValueOp::FmaActivate: {
+        // z is recomputed, as Tape::backward does
+        os << "  {\n    const double z = " << v(in[0]) << " * " << v(in[1])
+           << " + " << v(in[2]) << ";\n    const double local = " << g(i)
+           << " * dact(" << int(node.activation) << ", z, " << v(i)
+           << ");\n  ";
+        add(in[0], v(in[1]) + " * local");
+        os << "  ";
+        add(in[1], v(in[0]) + " * local");
+        os << "  ";
+        add(in[2], "local");
+        os << "  }\n";
+        break;
+      }
+      case ValueOp::Leaf:
+        os << "  grad_out[" << leaf_number[i] << "] = " << g(i) << ";\n";
+        break;
+      case ValueOp::Constant:
+      case ValueOp::Custom:
+        break;
+      }
+    }
+    os << "  return 0;\n}\n\n";
+  }
+
+  os << "extern \"C\" int " << symbol
+     << "(const double *in, double *grad_out, double *root_out, "
+        "double *work) {\n"
+     << "  double *v = work;\n"
+     << "  double *g = work + " << tape.size() << ";\n";
+  for (size_t p = 0; p < parts; p++) {
+    if (p == forward_parts) {
+      os << "  *root_out = v[" << root << "];\n"
+         << "  for (int i = 0; i < " << tape.size() << "; i++) g[i] = 0.0;\n"
+         << "  g[" << root << "] = 1.0;\n";
+    }
+    os << "  if (part" << p << "(in, grad_out, v, g)) return 1;\n";
+  }
+  // Leaves past the root get no gradient
+  for (u32 i = root + 1; i < tape.size(); i++) {
+    if (tape.node(i).op == ValueOp::Leaf) {
+      os << "  grad_out[" << leaf_number[i] << "] = 0.0;\n";
+    }
+  }
+  os << "  return 0;\n}\n";
+  return os.str();
+}
+
+auto CompiledTape::compile(Tape tape, const JitOptions &options)
+    -> CompiledTape {
+  CompiledTape jit;
+  jit._tape = std::move(tape);
+  for (u32 i = 0; i < jit._tape.size(); i++) {
+    if (jit._tape.node(i).op == ValueOp::Leaf) {
+      jit._leaves.push_back(i);
+    }
+  }
+  jit._leaf_values.resize(jit._leaves.size());
+  jit._leaf_gradients.resize(jit._leaves.size());
+  jit._work.resize(2 * jit._tape.size());
+
+#if JIT_HAVE_DLOPEN
+  std::string compiler =
+      options.compiler.empty() ? default_compiler() : options.compiler;
+  std::filesystem::path dir =
+      options.cache_dir.empty() ? default_cache_dir() : options.cache_dir;
+
+  // The build command is part of the key, a different compiler or flags
+  // must not pick up another build's object
+  u64 hash = tape_hash(jit._tape);
+  fnv1a(hash, compiler);
+  fnv1a(hash, options.flags);
+  jit._hash = hash;
+  std::string name = "tape_" + hex(hash);
+  std::string symbol = "micrograd_" + name;
+  std::filesystem::path library = dir / (name + ".so");
+
+  auto load = [&]() -> bool {
+    void *handle = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+      return false;
+    }
+    void *function = dlsym(handle, symbol.c_str());
+    if (!function) {
+      dlclose(handle);
+      return false;
+    }
+    jit._library = std::shared_ptr<void>(handle, [](void *h) { dlclose(h); });
+    jit._function = reinterpret_cast<Function>(function);
+    return true;
+  };
+
+  if (!create_private_directory(dir, jit._fallback_reason)) {
+    return jit;
+  }
+  std::error_code error;
+  // An entry that fails the check is never loaded, the build below
+  // replaces it with one of our own
+  std::string refused;
+  if (std::filesystem::exists(library, error) &&
+      check_private(library, refused) && load()) {
+    jit._cache_hit = true;
+    return jit;
+  }
+
+  // Build under temporary names and rename into place, a concurrent build
+  // of the same graph then at worst replaces the file with an equal one
+  std::string suffix = temp_suffix();
+  std::filesystem::path source = dir / (name + ".cpp");
+  std::filesystem::path temp_source = dir / (name + suffix + ".cpp");
+  std::filesystem::path temp_library = dir / (name + suffix + ".so");
+  std::filesystem::path log = dir / (name + suffix + ".log");
+  {
+    std::ofstream out(temp_source);
+    out << emit_tape_source(jit._tape, symbol);
+    if (!out) {
+      jit._fallback_reason = "Cannot write " + temp_source.string();
+      return jit;
+    }
+  }
+
+  std::vector<std::string> args = {compiler, "-std=c++17"};
+  for (std::string &flag : split_flags(options.flags)) {
+    args.push_back(std::move(flag));
+  }
+  for (const char *flag : {"-ffp-contract=off", "-fPIC", "-shared", "-o"}) {
+    args.emplace_back(flag);
+  }
+  args.push_back(temp_library.string());
+  args.push_back(temp_source.string());
+  if (!run_compiler(args, log, jit._fallback_reason)) {
+    jit._fallback_reason += read_file(log);
+  } else {
+    // The compiler creates the object as 0777 & ~umask, which a umask such
+    // as 002 leaves group-writable and check_private would then refuse
+    std::filesystem::permissions(temp_library,
+                                 std::filesystem::perms::owner_all, error);
+    std::filesystem::rename(temp_library, library, error);
+    std::filesystem::rename(temp_source, source, error);
+    // A failed rename leaves a refused entry in place, so check again
+    if (check_private(library, jit._fallback_reason) && !load()) {
+      jit._fallback_reason = "Cannot load " + library.string();
+      const char *message = dlerror();
+      if (message) {
+        jit._fallback_reason += std::string(": ") + message;
+      }
+    }
+  }
+  std::filesystem::remove(temp_source, error);
+  std::filesystem::remove(temp_library, error);
+  std::filesystem::remove(log, error);
+#else
+  (void)options;
+  jit._hash = tape_hash(jit._tape);
+  jit._fallback_reason = "No dlopen on this platform";
+#endif
+  return jit;
+}
+
+void CompiledTape::run() {
+  if (!_function) {
+    _tape.forward();
+    _tape.backward();
+    _root_value = _tape.value(_tape.root());
+    return;
+  }
+  for (size_t k = 0; k < _leaves.size(); k++) {
+    _leaf_values[k] = _tape.source(_leaves[k])->get_value();
+  }
+  if (_function(_leaf_values.data(), _leaf_gradients.data(), &_root_value,
+                _work.data())) {
+    throw std::invalid_argument("Division by zero in inverse operation");
+  }
+  for (size_t k = 0; k < _leaves.size(); k++) {
+    _tape.source(_leaves[k])->set_gradient(_leaf_gradients[k]);
+  }
+}
+
+auto CompiledTape::value() const -> double { return _root_value; }
+
+auto CompiledTape::backend() const -> JitBackend {
+  return _function ? JitBackend::Native : JitBackend::Interpreter;
+}
+
+auto CompiledTape::fallback_reason() const -> const std::string & {
+  return _fallback_reason;
+}
+
+auto CompiledTape::cache_hit() const -> bool { return _cache_hit; }
+
+auto CompiledTape::hash() const -> u64 { return _hash; }
+
+auto CompiledTape::tape() const -> const Tape & { return _tape; }
@@ -0,0 +1,86 @@
+#pragma once
+#include "Tape.hpp"
+#include <filesystem>
+#include <memory>
+#include <string>
+
+// Native code for a captured tape. The tape is emitted as straight-line C++
+// computing the forward pass and then the backward pass, with every node's
+// inputs, constants and activations baked in. The system compiler builds it
+// into a shared object, which is loaded with dlopen.
+//
+//   Tape tape = optimize(Tape::capture(loss));
+//   CompiledTape jit = CompiledTape::compile(std::move(tape));
+//   jit.run(); // Same as tape.forward(); tape.backward();
+//
+// Shared objects are cached on disk, named by tape_hash(), so the compiler
+// only runs the first time a given graph is seen. The hash covers the graph's
+// structure and constants, not the leaf values, so one build serves every
+// step of a fixed model. The cache is per user and created 0700, and builds
+// are stored 0700 whatever the umask. An object that another user owns, or
+// that group or others can write, is never loaded; it is rebuilt in place.
+//
+// If the compiler is missing or fails, or the platform has no dlopen, the
+// CompiledTape falls back to replaying the tape. fallback_reason() then
+// says why. A cold build takes a few seconds per thousand nodes with GCC at
+// -O1, so this is for fixed models that run many steps.
+
+enum class JitBackend : u8 { Native, Interpreter };
+
+struct JitOptions {
+  // Empty means $MICROGRAD_JIT_CXX, else the compiler this library was
+  // built with
+  std::string compiler;
+  // Split at whitespace into separate arguments. The compiler is spawned
+  // directly, so no shell ever interprets them.
+  std::string flags = "-O1";
+  // Empty means $MICROGRAD_JIT_CACHE, else micrograd_jit under
+  // $XDG_CACHE_HOME or ~/.cache, else micrograd_jit-<uid> in the temp dir
+  std::filesystem::path cache_dir;
+};
+
+// * FNV-1a over the nodes, constants and root. Leaf values are not included.
+auto tape_hash(const Tape &tape) -> u64;
+
+// * The source compile() builds, one extern "C" function named `symbol`
+auto emit_tape_source(const Tape &tape, const std::string &symbol)
+    -> std::string;
+
+class CompiledTape {
+public:
+  // * Never throws for a missing or failing compiler, see backend()
+  static auto compile(Tape tape, const JitOptions &options = JitOptions())
+      -> CompiledTape;
+
+  // * Reads the leaf values, computes the root and writes every leaf
+  // * gradient back. Throws std::invalid_argument on a division by zero, as
+  // * Tape does.
+  void run();
+
+  // * Root value as of the last run()
+  auto value() const -> double;
+
+  auto backend() const -> JitBackend;
+  auto fallback_reason() const -> const std::string &;
+  // * Whether the shared object was already in the cache
+  auto cache_hit() const -> bool;
+  auto hash() const -> u64;
+  auto tape() const -> const Tape &;
+
+private:
+  using Function = int (*)(const double *leaves, double *gradients,
+                           double *root, double *work);
+
+  Tape _tape;
+  u64 _hash = 0;
+  std::shared_ptr<void> _library; // dlclose on release
+  Function _function = nullptr;
+  std::string _fallback_reason;
+  bool _cache_hit = false;
+
+  std::vector<u32> _leaves; // Tape index of each leaf, in argument order
+  std::vector<double> _leaf_values;
+  std::vector<double> _leaf_gradients;
+  std::vector<double> _work; // Node values and gradients
+  double _root_value = 0.0;
+};
@@ -0,0 +1,278 @@
+#include "Optimize.hpp"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+struct NodeKey {
+  ValueOp op;
+  Activation activation;
+  u32 inputs[3];
+
+  bool operator==(const NodeKey &other) const {
+    return op == other.op && activation == other.activation &&
+           inputs[0] == other.inputs[0] &&
+           inputs[1] == other.inputs[1] && inputs[2] == other.inputs[2];
+  }
+};
+
+struct NodeKeyHash {
+  size_t operator()(const NodeKey &key) const {
+    u64 hash = static_cast<u64>(key.op) |
+               (static_cast<u64>(key.activation) << 8);
+    for (u32 input : key.inputs) {
+      hash = (hash ^ input) * 0x100000001b3ULL;
+    }
+    return static_cast<size_t>(hash);
+  }
+};
+
+// Builds the rewritten tape, tracking which emitted nodes are constants and
+// which products only have one consumer
+class Rewriter {
+public:
+  Rewriter(OptimizeStats &stats) : _stats(stats) {}
+
+  auto constant(double value) -> u32 {
+    u64 bits = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
+    auto it = _constants.find(bits);
+    if (it != _constants.end()) {
+      return it->second;
+    }
+    u32 id = _tape.push_constant(value);
+    _constants.emplace(bits, id);
+    grow();
+    return id;
+  }
+
+  auto leaf(const ValuePtr &source) -> u32 {
+    u32 id = _tape.push_leaf(source);
+    grow();
+    return id;
+  }
+
+  auto is_constant(u32 id, double value) const -> bool {
+    return op(id) == ValueOp::Constant && _tape.value(id) == value;
+  }
+
+  auto op(u32 id) const -> ValueOp { return _tape.node(id).op; }
+
+  auto input(u32 id, size_t k) const -> u32 { return _tape.node(id).inputs[k]; }
+
+  // Emits op(inputs) after folding, peepholes and CSE. single_use says
+  // whether the original node had exactly one consumer.
+  auto emit(ValueOp node_op, u32 a, u32 b, u32 c, u8 num_inputs,
+            bool single_use,
+            Activation activation = Activation::Identity) -> u32 {
+    u32 in[3] = {a, b, c};
+
+    // Constant folding
+    bool all_constant = true;
+    for (u8 k = 0; k < num_inputs; k++) {
+      all_constant = all_constant && op(in[k]) == ValueOp::Constant;
+    }
+    if (all_constant) {
+      double values[3];
+      for (u8 k = 0; k < num_inputs; k++) {
+        values[k] = _tape.value(in[k]);
+      }
+      _stats.folded++;
+      return constant(Tape::evaluate(node_op, values, activation));
+    }
+
+    switch (node_op) {
+    case ValueOp::Mul:
+      for (int k = 0; k < 2; k++) {
+        if (is_constant(in[k], -1.0)) {
+          _stats.neg_sub++;
+          return emit(ValueOp::Neg, in[1 - k], 0, 0, 1, single_use);
+        }
+        if (is_constant(in[k], 1.0)) {
+          _stats.folded++;
+          return in[1 - k];
+        }
+      }
+      break;
+    case ValueOp::Add:
+      for (int k = 0; k < 2; k++) {
+        if (is_constant(in[k], 0.0)) {
+          _stats.folded++;
+          return in[1 - k];
+        }
+        if (op(in[k]) == ValueOp::Neg) {
+          _stats.neg_sub++;
+          return emit(ValueOp::Sub, in[1 - k], input(in[k], 0), 0, 2,
+                      single_use);
+        }
+      }
+      for (int k = 0; k < 2; k++) {
+        u32 product = in[k];
+        if (op(product) == ValueOp::Mul && _single_use[product]) {
+          _stats.fma++;
+          return emit(ValueOp::Fma, input(product, 0), input(product, 1),
+                      in[1 - k], 3, single_use);
+        }
+      }
+      break;
+    case ValueOp::Sub:
+      if (is_constant(in[1], 0.0)) {
+        _stats.folded++;
+        return in[0];
+      }
+      if (op(in[1]) == ValueOp::Neg) {
+        _stats.neg_sub++;
+        return emit(ValueOp::Add, in[0], input(in[1], 0), 0, 2, single_use);
+      }
+      break;
+    case ValueOp::Neg:
+      if (op(in[0]) == ValueOp::Neg) {
+        _stats.neg_sub++;
+        return input(in[0], 0);
+      }
+      break;
+    default:
+      break;
+    }
+
+    // Common subexpressions, with commutative inputs in a canonical order
+    NodeKey key{node_op, activation, {in[0], in[1], in[2]}};
+    for (u8 k = num_inputs; k < 3; k++) {
+      key.inputs[k] = 0;
+    }
+    if (node_op == ValueOp::Add || node_op == ValueOp::Mul ||
+        node_op == ValueOp::Fma || node_op == ValueOp::FmaActivate) {
+      if (key.inputs[0] > key.inputs[1]) {
+        std::swap(key.inputs[0], key.inputs[1]);
+      }
+    }
+    auto it = _emitted.find(key);
+    if (it != _emitted.end()) {
+      _stats.cse++;
+      _single_use[it->second] = false;
+      return it->second;
+    }
+
+    u32 id = 0;
+    switch (num_inputs) {
+    case 1:
+      id = _tape.push(node_op, {key.inputs[0]}, activation);
+      break;
+    case 2:
+      id = _tape.push(node_op, {key.inputs[0], key.inputs[1]}, activation);
+      break;
+    default:
+      id = _tape.push(node_op, {key.inputs[0], key.inputs[1], key.inputs[2]},
+                      activation);
+      break;
+    }
+    grow();
+    _single_use[id] = single_use;
+    _emitted.emplace(key, id);
+    return id;
+  }
+
+  auto tape() -> Tape & { return _tape; }
+
+private:
+  void grow() { _single_use.resize(_tape.size(), false); }
+
+  OptimizeStats &_stats;
+  Tape _tape;
+  std::vector<bool> _single_use;
+  std::unordered_map<u64, u32> _constants;
+  std::unordered_map<NodeKey, u32, NodeKeyHash> _emitted;
+};
+
+// Copies the nodes reachable from the root, in order
+auto eliminate_dead(const Tape &tape, OptimizeStats &stats) -> Tape {
+  std::vector<bool> live(tape.size(), false);
+  live[tape.root()] = true;
+  for (size_t i = tape.size(); i-- > 0;) {
+    if (!live[i]) {
+      continue;
+    }
+    const TapeNode &node = tape.node(static_cast<u32>(i));
+    for (u8 k = 0; k < node.num_inputs; k++) {
+      live[node.inputs[k]] = true;
+    }
+  }
+
+  Tape result;
+  std::vector<u32> remap(tape.size(), 0);
+  for (u32 i = 0; i < tape.size(); i++) {
+    if (!live[i]) {
+      stats.dead++;
+      continue;
+    }
+    const TapeNode &node = tape.node(i);
+    const u32 *in = node.inputs;
+    switch (node.op) {
+    case ValueOp::Leaf:
+      remap[i] = result.push_leaf(tape.source(i));
+      break;
+    case ValueOp::Constant:
+      remap[i] = result.push_constant(tape.value(i));
+      break;
+    default:
+      if (node.num_inputs == 1) {
+        remap[i] = result.push(node.op, {remap[in[0]]}, node.activation);
+      } else if (node.num_inputs == 2) {
+        remap[i] = result.push(node.op, {remap[in[0]], remap[in[1]]},
+                               node.activation);
+      } else {
+        remap[i] = result.push(
+            node.op, {remap[in[0]], remap[in[1]], remap[in[2]]},
+            node.activation);
+      }
+      break;
+    }
+  }
+  result.set_root(remap[tape.root()]);
+  return result;
+}
+
+} // namespace
+
+auto optimize(const Tape &tape, OptimizeStats *stats_out) -> Tape {
+  OptimizeStats stats;
+  stats.nodes_before = tape.size();
+
+  std::vector<u32> uses(tape.size(), 0);
+  for (u32 i = 0; i < tape.size(); i++) {
+    const TapeNode &node = tape.node(i);
+    for (u8 k = 0; k < node.num_inputs; k++) {
+      uses[node.inputs[k]]++;
+    }
+  }
+
+  Rewriter rewriter(stats);
+  std::vector<u32> remap(tape.size(), 0);
+  for (u32 i = 0; i < tape.size(); i++) {
+    const TapeNode &node = tape.node(i);
+    const u32 *in = node.inputs;
+    switch (node.op) {
+    case ValueOp::Leaf:
+      remap[i] = rewriter.leaf(tape.source(i));
+      break;
+    case ValueOp::Constant:
+      remap[i] = rewriter.constant(tape.value(i));
+      break;
+    default:
+      remap[i] = rewriter.emit(
+          node.op, remap[in[0]], node.num_inputs > 1 ? remap[in[1]] : 0,
+          node.num_inputs > 2 ? remap[in[2]] : 0, node.num_inputs,
+          uses[i] == 1 && i != tape.root(), node.activation);
+      break;
+    }
+  }
+  rewriter.tape().set_root(remap[tape.root()]);
+
+  Tape result = eliminate_dead(rewriter.tape(), stats);
+  stats.nodes_after = result.size();
+  if (stats_out) {
+    *stats_out = stats;
+  }
+  return result;
+}
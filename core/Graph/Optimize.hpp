@@ -0,0 +1,25 @@
+#pragma once
+#include "Tape.hpp"
+
+// Peephole optimizer for captured tapes. One pass in topological order
+// rewrites each node against what has been emitted so far, then dead nodes
+// are dropped:
+//   - constant folding over create_constant leaves
+//   - x * -1 -> neg x, x + neg y -> x - y, x - neg y -> x + y, neg neg x -> x
+//   - x + 0, x * 1 -> x
+//   - a * b + c -> fma(a, b, c) when the product has no other consumer
+//   - common subexpression elimination (commutative inputs canonicalized)
+//
+// The optimized tape computes the same root value and leaf gradients.
+
+struct OptimizeStats {
+  size_t nodes_before = 0;
+  size_t nodes_after = 0;
+  size_t folded = 0;
+  size_t neg_sub = 0;
+  size_t fma = 0;
+  size_t cse = 0;
+  size_t dead = 0;
+};
+
+auto optimize(const Tape &tape, OptimizeStats *stats = nullptr) -> Tape;
@@ -0,0 +1,325 @@
+#include "Plan.hpp"
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+
+namespace {
+
+// Whether backward of an `op` node reads input k's value, or its own
+auto backward_reads_input(ValueOp op, u8 k) -> bool {
+  switch (op) {
+  case ValueOp::Mul:
+  case ValueOp::Fma:
+    return k < 2;
+  case ValueOp::Activate:
+  case ValueOp::FmaActivate:
+    return true;
+  default:
+    return false;
+  }
+}
+
+auto backward_reads_output(ValueOp op) -> bool {
+  switch (op) {
+  case ValueOp::Inverse:
+  case ValueOp::Relu:
+  case ValueOp::Activate:
+  case ValueOp::FmaActivate:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Lowest free offset first, growing the region when none is free
+class SlotPool {
+public:
+  auto take() -> u32 {
+    if (_free.empty()) {
+      return _size++;
+    }
+    u32 slot = _free.top();
+    _free.pop();
+    return slot;
+  }
+  void give(u32 slot) { _free.push(slot); }
+  auto size() const -> u32 { return _size; }
+
+private:
+  std::priority_queue<u32, std::vector<u32>, std::greater<>> _free;
+  u32 _size = 0;
+};
+
+} // namespace
+
+auto PlannedTape::plan(Tape tape) -> PlannedTape {
+  PlannedTape planned;
+  u32 n = static_cast<u32>(tape.size());
+  u32 root = tape.root();
+  for (u32 i = 0; i <= root; i++) {
+    if (tape.node(i).op == ValueOp::Custom) {
+      throw std::invalid_argument("Cannot plan custom nodes");
+    }
+  }
+
+  // Steps: forward of i at i, backward of i at 2 * root + 1 - i, and one
+  // past the end where the root value is read
+  u32 end = 2 * root + 2;
+  auto backward_step = [&](u32 i) { return 2 * root + 1 - i; };
+
+  std::vector<u32> value_last(n, 0);
+  std::vector<u32> gradient_first(n, PlannedTape::kNoSlot);
+  std::vector<u8> first_touch(n, 0);
+  for (u32 i = 0; i <= root; i++) {
+    value_last[i] = i;
+  }
+  // Only nodes the root's gradient reaches run a backward step
+  if (tape.node(root).op != ValueOp::Constant) {
+    gradient_first[root] = backward_step(root);
+  }
+  for (u32 i = root + 1; i-- > 0;) {
+    const TapeNode &node = tape.node(i);
+    u32 step = backward_step(i);
+    bool reached = gradient_first[i] != PlannedTape::kNoSlot;
+    if (reached && backward_reads_output(node.op)) {
+      value_last[i] = std::max(value_last[i], step);
+    }
+    for (u8 k = 0; k < node.num_inputs; k++) {
+      u32 input = node.inputs[k];
+      value_last[input] = std::max(value_last[input], i);
+      if (!reached) {
+        continue;
+      }
+      if (backward_reads_input(node.op, k)) {
+        value_last[input] = std::max(value_last[input], step);
+      }
+      if (tape.node(input).op != ValueOp::Constant &&
+          gradient_first[input] == PlannedTape::kNoSlot) {
+        gradient_first[input] = step;
+        first_touch[i] |= static_cast<u8>(1U << k);
+      }
+    }
+  }
+  value_last[root] = end;
+
+  // Interval ids are 2 * node for values and 2 * node + 1 for gradients
+  std::vector<std::vector<u32>> starts(end + 1);
+  std::vector<std::vector<u32>> ends(end + 1);
+  planned._value_slots.assign(n, kNoSlot);
+  planned._gradient_slots.assign(n, kNoSlot);
+  SlotPool pool;
+  for (u32 i = 0; i <= root; i++) {
+    if (tape.node(i).op == ValueOp::Constant) {
+      planned._value_slots[i] = pool.take(); // Pinned
+      continue;
+    }
+    starts[i].push_back(2 * i);
+    ends[value_last[i]].push_back(2 * i);
+    if (gradient_first[i] != kNoSlot) {
+      starts[gradient_first[i]].push_back(2 * i + 1);
+      ends[backward_step(i)].push_back(2 * i + 1);
+    }
+  }
+
+  auto slot_of = [&](u32 id) -> u32 & {
+    return id % 2 ? planned._gradient_slots[id / 2]
+                  : planned._value_slots[id / 2];
+  };
+  auto starts_at = [&](u32 id, u32 step) {
+    return (id % 2 ? gradient_first[id / 2] : id / 2) == step;
+  };
+
+  for (u32 step = 0; step <= end; step++) {
+    // Slots read for the last time in this step are free for its outputs
+    std::vector<u32> dying;
+    for (u32 id : ends[step]) {
+      if (!starts_at(id, step)) {
+        dying.push_back(id);
+      }
+    }
+
+    if (step <= root && !starts[step].empty()) {
+      // Forward: run in place over an input that dies here
+      const TapeNode &node = tape.node(step);
+      for (u8 k = 0; k < node.num_inputs && slot_of(2 * step) == kNoSlot;
+           k++) {
+        auto found =
+            std::find(dying.begin(), dying.end(), 2 * node.inputs[k]);
+        if (found != dying.end()) {
+          slot_of(2 * step) = slot_of(*found);
+          dying.erase(found);
+          planned._stats.in_place++;
+        }
+      }
+    }
+    for (u32 id : dying) {
+      pool.give(slot_of(id));
+    }
+    for (u32 id : starts[step]) {
+      if (slot_of(id) == kNoSlot) {
+        slot_of(id) = pool.take();
+      }
+    }
+    // Written and last read in this one step
+    for (u32 id : ends[step]) {
+      if (starts_at(id, step)) {
+        pool.give(slot_of(id));
+      }
+    }
+  }
+
+  planned._region.assign(pool.size(), 0.0);
+  for (u32 i = 0; i <= root; i++) {
+    if (tape.node(i).op == ValueOp::Constant) {
+      planned._region[planned._value_slots[i]] = tape.value(i);
+    }
+  }
+  for (u32 i = 0; i <= root; i++) {
+    const TapeNode &node = tape.node(i);
+    Step step{node.op,
+              node.activation,
+              node.num_inputs,
+              first_touch[i],
+              planned._value_slots[i],
+              planned._gradient_slots[i],
+              {0, 0, 0},
+              {kNoSlot, kNoSlot, kNoSlot}};
+    for (u8 k = 0; k < node.num_inputs; k++) {
+      step.inputs[k] = planned._value_slots[node.inputs[k]];
+      step.input_gradients[k] = planned._gradient_slots[node.inputs[k]];
+    }
+    planned._steps.push_back(step);
+  }
+  planned._stats.nodes = n;
+  planned._stats.naive_bytes = 2 * n * sizeof(double);
+  planned._stats.planned_bytes = pool.size() * sizeof(double);
+  planned._tape = std::move(tape);
+  return planned;
+}
+
+void PlannedTape::run() {
+  double *region = _region.data();
+  u32 root = _tape.root();
+
+  double in[3];
+  for (u32 i = 0; i <= root; i++) {
+    const Step &step = _steps[i];
+    if (step.op == ValueOp::Leaf) {
+      region[step.value] = _tape.source(i)->get_value();
+      continue;
+    }
+    if (step.op == ValueOp::Constant) {
+      continue;
+    }
+    for (u8 k = 0; k < step.num_inputs; k++) {
+      in[k] = region[step.inputs[k]];
+    }
+    region[step.value] = Tape::evaluate(step.op, in, step.activation);
+  }
+
+  double out[3];
+  for (u32 i = root + 1; i-- > 0;) {
+    const Step &step = _steps[i];
+    if (step.gradient == kNoSlot) {
+      if (step.op == ValueOp::Leaf) {
+        _tape.source(i)->set_gradient(0.0);
+      }
+      continue;
+    }
+    // The root's gradient is seeded here, never stored: its slot starts at
+    // this step and may share storage with an operand read below
+    double grad = i == root ? 1.0 : region[step.gradient];
+    const u32 *in_slot = step.inputs;
+
+    // Every operand is read before any gradient is written, an input's
+    // gradient may have taken the slot of one of them
+    switch (step.op) {
+    case ValueOp::Leaf:
+      _tape.source(i)->set_gradient(grad);
+      continue;
+    case ValueOp::Add:
+      out[0] = grad;
+      out[1] = grad;
+      break;
+    case ValueOp::Sub:
+      out[0] = grad;
+      out[1] = -grad;
+      break;
+    case ValueOp::Mul:
+      out[0] = region[in_slot[1]] * grad;
+      out[1] = region[in_slot[0]] * grad;
+      break;
+    case ValueOp::Neg:
+      out[0] = -grad;
+      break;
+    case ValueOp::Fma:
+      out[0] = region[in_slot[1]] * grad;
+      out[1] = region[in_slot[0]] * grad;
+      out[2] = grad;
+      break;
+    case ValueOp::Inverse: {
+      double y = region[step.value];
+      out[0] = -y * y * grad;
+      break;
+    }
+    case ValueOp::Relu:
+      out[0] = region[step.value] > 0 ? grad : 0.0;
+      break;
+    case ValueOp::Activate:
+      out[0] = grad * activation_derivative(step.activation,
+                                            region[in_slot[0]],
+                                            region[step.value]);
+      break;
+    case ValueOp::FmaActivate: {
+      double x = region[in_slot[0]];
+      double w = region[in_slot[1]];
+      double z = x * w + region[in_slot[2]];
+      double local = grad * activation_derivative(step.activation, z,
+                                                  region[step.value]);
+      out[0] = w * local;
+      out[1] = x * local;
+      out[2] = local;
+      break;
+    }
+    case ValueOp::Constant:
+    case ValueOp::Custom:
+      continue;
+    }
+
+    for (u8 k = 0; k < step.num_inputs; k++) {
+      u32 slot = step.input_gradients[k];
+      if (slot == kNoSlot) {
+        continue; // A constant
+      }
+      if (step.first_touch & (1U << k)) {
+        region[slot] = out[k];
+      } else {
+        region[slot] += out[k];
+      }
+    }
+  }
+
+  // Past the root, as Tape::backward leaves them
+  for (u32 i = root + 1; i < _tape.size(); i++) {
+    if (_tape.node(i).op == ValueOp::Leaf) {
+      _tape.source(i)->set_gradient(0.0);
+    }
+  }
+}
+
+auto PlannedTape::value() const -> double {
+  return _region[_steps[_tape.root()].value];
+}
+
+auto PlannedTape::stats() const -> const MemoryPlanStats & { return _stats; }
+
+auto PlannedTape::tape() const -> const Tape & { return _tape; }
+
+auto PlannedTape::value_slot(u32 node) const -> u32 {
+  return _value_slots[node];
+}
+
+auto PlannedTape::gradient_slot(u32 node) const -> u32 {
+  return _gradient_slots[node];
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "Tape.hpp"
+
+// Static memory plan for replaying a captured tape. A Tape keeps a value
+// and a gradient for every node, bump allocated once. But the schedule is
+// fixed, forward over nodes 0..root and then backward from root to 0, so
+// each slot's lifetime is known ahead of time:
+//
+//   value of i     written at forward step i, live until its last reader:
+//                  a consumer's forward step, or a backward step that needs
+//                  it (Mul and Fma read their inputs, Relu, Inverse and the
+//                  activations read their output)
+//   gradient of i  first written by the backward step of its last consumer,
+//                  live until i's own backward step reads it
+//
+// Constants and the root's value stay live throughout. Slots are handed out
+// by a linear scan over the schedule, lowest free offset first, and a slot
+// is free again in the step that reads it for the last time. Every step reads
+// its operands before writing, so an output may take a slot released in the
+// same step. A forward op reuses an input's slot whenever that input dies at
+// the op (relu over a value nothing else reads), which runs it in place.
+//
+// Gradients are not zeroed up front. The first contribution to a gradient
+// overwrites its slot and later ones accumulate. The root's gradient is the
+// constant 1 and is passed straight to its backward step, not stored.
+
+struct MemoryPlanStats {
+  size_t nodes = 0;
+  size_t naive_bytes = 0;   // A value and a gradient per node, as Tape has
+  size_t planned_bytes = 0; // Peak of the planned region
+  size_t in_place = 0;      // Forward ops that overwrite an input's slot
+};
+
+class PlannedTape {
+public:
+  // * Throws std::invalid_argument for graphs with ValueOp::Custom nodes
+  static auto plan(Tape tape) -> PlannedTape;
+
+  // * Forward then backward, as tape.forward(); tape.backward(). Leaf
+  // * gradients are written back to their Values.
+  void run();
+
+  // * Root value as of the last run()
+  auto value() const -> double;
+
+  auto stats() const -> const MemoryPlanStats &;
+  auto tape() const -> const Tape &;
+
+  // * Offsets into the region in doubles, kNoSlot where a node has none
+  static constexpr u32 kNoSlot = UINT32_MAX;
+  auto value_slot(u32 node) const -> u32;
+  auto gradient_slot(u32 node) const -> u32;
+
+private:
+  // A node with its slots resolved, so replay does one lookup per operand
+  struct Step {
+    ValueOp op;
+    Activation activation;
+    u8 num_inputs;
+    // Bit k set: this backward step is the first to reach input k's
+    // gradient and overwrites it instead of adding to it
+    u8 first_touch;
+    u32 value;
+    u32 gradient;
+    u32 inputs[3];
+    u32 input_gradients[3];
+  };
+
+  Tape _tape;
+  MemoryPlanStats _stats;
+  std::vector<double> _region;
+  std::vector<Step> _steps; // Nodes 0..root
+  std::vector<u32> _value_slots;
+  std::vector<u32> _gradient_slots;
+};
@@ -0,0 +1,197 @@
+#include "Tape.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <unordered_map>
+
+auto Tape::capture(const ValuePtr &root) -> Tape {
+  Tape tape;
+  std::vector<Value *> order = root->topological_order();
+  std::unordered_map<const Value *, u32> index;
+  index.reserve(order.size());
+
+  for (Value *node : order) {
+    u32 id = 0;
+    switch (node->_op) {
+    case ValueOp::Leaf:
+      // The owning ValuePtr is filled in from the first consumer below
+      id = static_cast<u32>(tape._nodes.size());
+      tape._nodes.push_back(
+          TapeNode{ValueOp::Leaf, 0, Activation::Identity, {0, 0, 0}});
+      tape._values.push_back(node->_value);
+      tape._sources.push_back(nullptr);
+      break;
+    case ValueOp::Constant:
+      id = tape.push_constant(node->_value);
+      break;
+    case ValueOp::Custom:
+      throw std::invalid_argument("Tape cannot capture custom nodes");
+    default: {
+      TapeNode tape_node{node->_op, static_cast<u8>(node->prev.size()),
+                         node->_activation, {0, 0, 0}};
+      for (size_t i = 0; i < node->prev.size(); i++) {
+        tape_node.inputs[i] = index.at(node->prev[i].get());
+      }
+      id = static_cast<u32>(tape._nodes.size());
+      tape._nodes.push_back(tape_node);
+      tape._values.push_back(node->_value);
+      tape._sources.push_back(nullptr);
+      break;
+    }
+    }
+    index.emplace(node, id);
+
+    for (const ValuePtr &parent : node->prev) {
+      u32 parent_id = index.at(parent.get());
+      if (tape._nodes[parent_id].op == ValueOp::Leaf &&
+          !tape._sources[parent_id]) {
+        tape._sources[parent_id] = parent;
+      }
+    }
+  }
+
+  // A bare leaf as root has no consumer to borrow the pointer from
+  if (tape._nodes.back().op == ValueOp::Leaf && !tape._sources.back()) {
+    tape._sources.back() = root;
+  }
+
+  tape._gradients.assign(tape._nodes.size(), 0.0);
+  tape._root = static_cast<u32>(tape._nodes.size() - 1);
+  return tape;
+}
+
+void Tape::forward() {
+  double in[3];
+  for (size_t i = 0; i < _nodes.size(); i++) {
+    const TapeNode &node = _nodes[i];
+    if (node.op == ValueOp::Leaf) {
+      _values[i] = _sources[i]->get_value();
+      continue;
+    }
+    if (node.op == ValueOp::Constant) {
+      continue;
+    }
+    for (u8 k = 0; k < node.num_inputs; k++) {
+      in[k] = _values[node.inputs[k]];
+    }
+    _values[i] = evaluate(node.op, in, node.activation);
+  }
+}
+
+void Tape::backward() {
+  std::fill(_gradients.begin(), _gradients.end(), 0.0);
+  _gradients[_root] = 1.0;
+
+  for (size_t i = _nodes.size(); i-- > 0;) {
+    const TapeNode &node = _nodes[i];
+    double grad = _gradients[i];
+    const u32 *in = node.inputs;
+
+    switch (node.op) {
+    case ValueOp::Add:
+      _gradients[in[0]] += grad;
+      _gradients[in[1]] += grad;
+      break;
+    case ValueOp::Sub:
+      _gradients[in[0]] += grad;
+      _gradients[in[1]] -= grad;
+      break;
+    case ValueOp::Mul:
+      _gradients[in[0]] += _values[in[1]] * grad;
+      _gradients[in[1]] += _values[in[0]] * grad;
+      break;
+    case ValueOp::Neg:
+      _gradients[in[0]] -= grad;
+      break;
+    case ValueOp::Fma:
+      _gradients[in[0]] += _values[in[1]] * grad;
+      _gradients[in[1]] += _values[in[0]] * grad;
+      _gradients[in[2]] += grad;
+      break;
+    case ValueOp::Inverse:
+      _gradients[in[0]] += -_values[i] * _values[i] * grad;
+      break;
+    case ValueOp::Relu:
+      _gradients[in[0]] += _values[i] > 0 ? grad : 0.0;
+      break;
+    case ValueOp::Activate:
+      _gradients[in[0]] += grad * activation_derivative(node.activation,
+                                                        _values[in[0]],
+                                                        _values[i]);
+      break;
+    case ValueOp::FmaActivate: {
+      double z = _values[in[0]] * _values[in[1]] + _values[in[2]];
+      double local = grad * activation_derivative(node.activation, z,
+                                                  _values[i]);
+      _gradients[in[0]] += _values[in[1]] * local;
+      _gradients[in[1]] += _values[in[0]] * local;
+      _gradients[in[2]] += local;
+      break;
+    }
+    case ValueOp::Leaf:
+      _sources[i]->set_gradient(grad);
+      break;
+    case ValueOp::Constant:
+    case ValueOp::Custom:
+      break;
+    }
+  }
+}
+
+auto Tape::push_leaf(const ValuePtr &source) -> u32 {
+  _nodes.push_back(
+      TapeNode{ValueOp::Leaf, 0, Activation::Identity, {0, 0, 0}});
+  _values.push_back(source->get_value());
+  _gradients.push_back(0.0);
+  _sources.push_back(source);
+  return static_cast<u32>(_nodes.size() - 1);
+}
+
+auto Tape::push_constant(double value) -> u32 {
+  _nodes.push_back(
+      TapeNode{ValueOp::Constant, 0, Activation::Identity, {0, 0, 0}});
+  _values.push_back(value);
+  _gradients.push_back(0.0);
+  _sources.push_back(nullptr);
+  return static_cast<u32>(_nodes.size() - 1);
+}
+
+auto Tape::push(ValueOp op, std::initializer_list<u32> inputs,
+                Activation activation) -> u32 {
+  TapeNode node{op, static_cast<u8>(inputs.size()), activation, {0, 0, 0}};
+  double in[3];
+  u8 k = 0;
+  for (u32 input : inputs) {
+    node.inputs[k] = input;
+    in[k++] = _values[input];
+  }
+  _nodes.push_back(node);
+  _values.push_back(evaluate(op, in, activation));
+  _gradients.push_back(0.0);
+  _sources.push_back(nullptr);
+  return static_cast<u32>(_nodes.size() - 1);
+}
+
+void Tape::set_root(u32 index) { _root = index; }
+
+auto Tape::size() const -> size_t { return _nodes.size(); }
+
+auto Tape::root() const -> u32 { return _root; }
+
+auto Tape::node(u32 index) const -> const TapeNode & { return _nodes[index]; }
+
+auto Tape::value(u32 index) const -> double { return _values[index]; }
+
+auto Tape::gradient(u32 index) const -> double { return _gradients[index]; }
+
+auto Tape::source(u32 index) const -> const ValuePtr & {
+  return _sources[index];
+}
+
+auto Tape::count(ValueOp op) const -> size_t {
+  size_t total = 0;
+  for (const TapeNode &node : _nodes) {
+    total += node.op == op ? 1 : 0;
+  }
+  return total;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include "../Value.h"
+#include <cmath>
+#include <initializer_list>
+#include <stdexcept>
+#include <vector>
+
+// A captured graph: every node reachable from one root, flattened into
+// topological order with index based inputs. Replaying a tape needs no
+// allocation and no std::function dispatch, and graph passes (Optimize.hpp)
+// rewrite tapes instead of live Values.
+//
+// Leaves keep a ValuePtr to their source so forward() reads the current
+// parameter and input values and backward() writes gradients back.
+
+struct TapeNode {
+  ValueOp op;
+  u8 num_inputs;
+  Activation activation; // Activate and FmaActivate only
+  u32 inputs[3];
+};
+
+class Tape {
+public:
+  // * Throws std::invalid_argument for graphs with ValueOp::Custom nodes
+  static auto capture(const ValuePtr &root) -> Tape;
+
+  // * Recompute every node from the current leaf values
+  void forward();
+
+  // * Gradient of the root with respect to every node. Leaf gradients are
+  // * written back to their Values.
+  void backward();
+
+  // * Building, used by capture and by graph passes. The node's value is
+  // * computed on push from its inputs' current values.
+  auto push_leaf(const ValuePtr &source) -> u32;
+  auto push_constant(double value) -> u32;
+  auto push(ValueOp op, std::initializer_list<u32> inputs,
+            Activation activation = Activation::Identity) -> u32;
+  void set_root(u32 index);
+
+  auto size() const -> size_t;
+  auto root() const -> u32;
+  auto node(u32 index) const -> const TapeNode &;
+  auto value(u32 index) const -> double;
+  auto gradient(u32 index) const -> double;
+  auto source(u32 index) const -> const ValuePtr &;
+  auto count(ValueOp op) const -> size_t;
+
+  // * Inline, every replay loop calls it once per node
+  static auto evaluate(ValueOp op, const double *inputs,
+                       Activation activation = Activation::Identity)
+      -> double;
+
+private:
+  std::vector<TapeNode> _nodes;
+  std::vector<double> _values;
+  std::vector<double> _gradients;
+  std::vector<ValuePtr> _sources; // Set for ValueOp::Leaf only
+  u32 _root = 0;
+};
+
+inline auto Tape::evaluate(ValueOp op, const double *in,
+                           Activation activation) -> double {
+  switch (op) {
+  case ValueOp::Add:
+    return in[0] + in[1];
+  case ValueOp::Sub:
+    return in[0] - in[1];
+  case ValueOp::Mul:
+    return in[0] * in[1];
+  case ValueOp::Neg:
+    return -in[0];
+  case ValueOp::Fma:
+    return in[0] * in[1] + in[2];
+  case ValueOp::Inverse:
+    if (std::abs(in[0]) < 0.0001) {
+      throw std::invalid_argument("Division by zero in inverse operation");
+    }
+    return 1.0 / in[0];
+  case ValueOp::Relu:
+    return in[0] > 0 ? in[0] : 0.0;
+  case ValueOp::Activate:
+    return apply_activation(activation, in[0]);
+  case ValueOp::FmaActivate:
+    return apply_activation(activation, in[0] * in[1] + in[2]);
+  case ValueOp::Leaf:
+  case ValueOp::Constant:
+  case ValueOp::Custom:
+    break;
+  }
+  throw std::invalid_argument("Tape cannot evaluate this node");
+}
@@ -0,0 +1,146 @@
+#include "Loss.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+// Node over `inputs` whose backward adds gradient * derivatives[i] to input i
+auto make_loss(double loss, std::vector<ValuePtr> inputs,
+               std::vector<double> derivatives) -> ValuePtr {
+  PROFILE_OP(profile::Op::Fused);
+  std::vector<Value *> targets(inputs.size());
+  for (size_t i = 0; i < inputs.size(); i++) {
+    targets[i] = inputs[i].get();
+  }
+  return create_fused(loss, std::move(inputs),
+                      [targets = std::move(targets),
+                       derivatives = std::move(derivatives)](double gradient) {
+                        for (size_t i = 0; i < targets.size(); i++) {
+                          targets[i]->accumulate_gradient(gradient *
+                                                          derivatives[i]);
+                        }
+                      });
+}
+
+void check_sizes(size_t predictions, size_t targets) {
+  if (predictions != targets) {
+    throw std::invalid_argument("Loss needs one target per prediction");
+  }
+  if (predictions == 0) {
+    throw std::invalid_argument("Loss of an empty batch");
+  }
+}
+
+// Adds softmax cross-entropy of one sample, scaled by `scale`, to the loss
+// and writes its derivatives
+auto softmax_term(const std::vector<ValuePtr> &logits, size_t target,
+                  double scale, double *derivatives) -> double {
+  if (target >= logits.size()) {
+    throw std::invalid_argument("Target class out of range");
+  }
+  double shift = logits[0]->get_value();
+  for (const ValuePtr &logit : logits) {
+    shift = std::max(shift, logit->get_value());
+  }
+
+  double sum = 0.0;
+  for (size_t i = 0; i < logits.size(); i++) {
+    derivatives[i] = std::exp(logits[i]->get_value() - shift);
+    sum += derivatives[i];
+  }
+  for (size_t i = 0; i < logits.size(); i++) {
+    derivatives[i] = scale * (derivatives[i] / sum - (i == target ? 1.0 : 0.0));
+  }
+  double log_sum_exp = shift + std::log(sum);
+  return scale * (log_sum_exp - logits[target]->get_value());
+}
+
+} // namespace
+
+auto mse_loss(const std::vector<ValuePtr> &predictions,
+              const std::vector<double> &targets) -> ValuePtr {
+  check_sizes(predictions.size(), targets.size());
+  double scale = 1.0 / static_cast<double>(predictions.size());
+
+  double loss = 0.0;
+  std::vector<double> derivatives(predictions.size());
+  for (size_t i = 0; i < predictions.size(); i++) {
+    double diff = predictions[i]->get_value() - targets[i];
+    loss += diff * diff;
+    derivatives[i] = 2.0 * scale * diff;
+  }
+  return make_loss(loss * scale, predictions, std::move(derivatives));
+}
+
+auto bce_loss(const std::vector<ValuePtr> &probabilities,
+              const std::vector<double> &targets, double epsilon)
+    -> ValuePtr {
+  check_sizes(probabilities.size(), targets.size());
+  double scale = 1.0 / static_cast<double>(probabilities.size());
+
+  double loss = 0.0;
+  std::vector<double> derivatives(probabilities.size());
+  for (size_t i = 0; i < probabilities.size(); i++) {
+    double raw = probabilities[i]->get_value();
+    double p = std::min(std::max(raw, epsilon), 1.0 - epsilon);
+    double t = targets[i];
+    loss -= t * std::log(p) + (1.0 - t) * std::log(1.0 - p);
+    // The clamp is flat, so it passes no gradient
+    derivatives[i] =
+        p == raw ? scale * (p - t) / (p * (1.0 - p)) : 0.0;
+  }
+  return make_loss(loss * scale, probabilities, std::move(derivatives));
+}
+
+auto bce_with_logits_loss(const std::vector<ValuePtr> &logits,
+                          const std::vector<double> &targets) -> ValuePtr {
+  check_sizes(logits.size(), targets.size());
+  double scale = 1.0 / static_cast<double>(logits.size());
+
+  double loss = 0.0;
+  std::vector<double> derivatives(logits.size());
+  for (size_t i = 0; i < logits.size(); i++) {
+    double x = logits[i]->get_value();
+    double t = targets[i];
+    loss += std::max(x, 0.0) - x * t + std::log1p(std::exp(-std::abs(x)));
+    double sigmoid = x >= 0 ? 1.0 / (1.0 + std::exp(-x))
+                            : std::exp(x) / (1.0 + std::exp(x));
+    derivatives[i] = scale * (sigmoid - t);
+  }
+  return make_loss(loss * scale, logits, std::move(derivatives));
+}
+
+auto softmax_cross_entropy(const std::vector<ValuePtr> &logits, size_t target)
+    -> ValuePtr {
+  if (logits.empty()) {
+    throw std::invalid_argument("Softmax over no logits");
+  }
+  std::vector<double> derivatives(logits.size());
+  double loss = softmax_term(logits, target, 1.0, derivatives.data());
+  return make_loss(loss, logits, std::move(derivatives));
+}
+
+auto softmax_cross_entropy(const std::vector<std::vector<ValuePtr>> &logits,
+                           const std::vector<size_t> &targets) -> ValuePtr {
+  check_sizes(logits.size(), targets.size());
+  double scale = 1.0 / static_cast<double>(logits.size());
+
+  std::vector<ValuePtr> inputs;
+  for (const std::vector<ValuePtr> &sample : logits) {
+    if (sample.empty()) {
+      throw std::invalid_argument("Softmax over no logits");
+    }
+    inputs.insert(inputs.end(), sample.begin(), sample.end());
+  }
+
+  double loss = 0.0;
+  std::vector<double> derivatives(inputs.size());
+  size_t offset = 0;
+  for (size_t b = 0; b < logits.size(); b++) {
+    loss += softmax_term(logits[b], targets[b], scale,
+                         derivatives.data() + offset);
+    offset += logits[b].size();
+  }
+  return make_loss(loss, std::move(inputs), std::move(derivatives));
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "../Value.h"
+#include <vector>
+
+// Fused loss functions. Each returns one node over the predictions, with
+// the loss and its closed-form derivative for every prediction computed in a
+// single pass at construction; backward is one multiply-add per input. Chained
+// scalar ops would instead build several nodes per element and go through
+// inverse(), which throws for small denominators.
+//
+// Batches are passed flattened (or as one logit vector per sample for
+// softmax), and every loss is the mean over its terms. Mismatched sizes
+// throw std::invalid_argument.
+
+// * mean((prediction - target)^2)
+auto mse_loss(const std::vector<ValuePtr> &predictions,
+              const std::vector<double> &targets) -> ValuePtr;
+
+// * Binary cross-entropy of probabilities in [0, 1], clamped to
+// * [epsilon, 1 - epsilon] so saturated outputs give a finite loss
+auto bce_loss(const std::vector<ValuePtr> &probabilities,
+              const std::vector<double> &targets, double epsilon = 1e-7)
+    -> ValuePtr;
+
+// * Binary cross-entropy applied to sigmoid(logits), in the stable form
+// * max(x, 0) - x t + log(1 + exp(-|x|)) with gradient sigmoid(x) - t
+auto bce_with_logits_loss(const std::vector<ValuePtr> &logits,
+                          const std::vector<double> &targets) -> ValuePtr;
+
+// * -log softmax(logits)[target], using log-sum-exp shifted by the largest
+// * logit. Gradient softmax(logits) - onehot(target).
+auto softmax_cross_entropy(const std::vector<ValuePtr> &logits, size_t target)
+    -> ValuePtr;
+
+// * Mean softmax cross-entropy over a batch, one node for the whole batch
+auto softmax_cross_entropy(const std::vector<std::vector<ValuePtr>> &logits,
+                           const std::vector<size_t> &targets) -> ValuePtr;
@@ -0,0 +1,254 @@
+#include "Format.hpp"
+#include "../Random/Philox.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+constexpr char kMagic[8] = {'M', 'G', 'M', 'L', 'P', '0', '0', '2'};
+constexpr char kMagicV1[8] = {'M', 'G', 'M', 'L', 'P', '0', '0', '1'};
+
+// Layer sizes and parameter counts would be nonsense past this, so treat
+// them as a corrupt file rather than attempting the allocation
+constexpr u64 kMaxLayers = 1 << 16;
+constexpr u64 kMaxParameters = u64(1) << 32;
+
+void write_u64(std::ostream &os, u64 value) {
+  u8 bytes[8];
+  for (int i = 0; i < 8; i++) {
+    bytes[i] = static_cast<u8>(value >> (8 * i));
+  }
+  os.write(reinterpret_cast<const char *>(bytes), sizeof(bytes));
+}
+
+auto read_u64(std::istream &is) -> u64 {
+  u8 bytes[8];
+  if (!is.read(reinterpret_cast<char *>(bytes), sizeof(bytes))) {
+    throw std::runtime_error("Truncated model file");
+  }
+  u64 value = 0;
+  for (int i = 0; i < 8; i++) {
+    value |= static_cast<u64>(bytes[i]) << (8 * i);
+  }
+  return value;
+}
+
+} // namespace
+
+auto ModelShape::parameter_count() const -> size_t {
+  size_t count = 0;
+  size_t previous = inputs;
+  for (size_t size : layer_sizes) {
+    count += size * (previous + 1);
+    previous = size;
+  }
+  return count;
+}
+
+namespace {
+
+// Standard deviation for uniform draws in [-1, 1] or for standard normals
+auto scheme_scale(InitScheme scheme, size_t fan_in, size_t fan_out)
+    -> double {
+  double fan = static_cast<double>(std::max<size_t>(fan_in, 1));
+  double fan_sum = static_cast<double>(std::max<size_t>(fan_in + fan_out, 1));
+  switch (scheme) {
+  case InitScheme::Uniform:
+    return 1.0;
+  case InitScheme::XavierUniform:
+    return std::sqrt(6.0 / fan_sum);
+  case InitScheme::XavierNormal:
+    return std::sqrt(2.0 / fan_sum);
+  case InitScheme::HeUniform:
+    return std::sqrt(6.0 / fan);
+  case InitScheme::HeNormal:
+    return std::sqrt(2.0 / fan);
+  }
+  return 1.0;
+}
+
+// One Philox draw covers a neuron's parameters 2 * pair and 2 * pair + 1
+void draw_pair(u64 seed, InitScheme scheme, u64 layer, u64 neuron, u64 pair,
+               double scale, double *out) {
+  philox::Counter words = philox::generate(
+      philox::Counter{static_cast<u32>(pair), static_cast<u32>(neuron),
+                      static_cast<u32>(layer),
+                      static_cast<u32>(pair >> 32) ^
+                          static_cast<u32>(neuron >> 32)},
+      philox::key(seed));
+  double u = philox::unit(words[0], words[1]);
+  double v = philox::unit(words[2], words[3]);
+
+  if (scheme == InitScheme::XavierNormal || scheme == InitScheme::HeNormal) {
+    // Box-Muller, 1 - u keeps the log argument in (0, 1]
+    double radius = scale * std::sqrt(-2.0 * std::log(1.0 - u));
+    double angle = 6.283185307179586 * v;
+    out[0] = radius * std::cos(angle);
+    out[1] = radius * std::sin(angle);
+    return;
+  }
+  out[0] = (2.0 * u - 1.0) * scale;
+  out[1] = (2.0 * v - 1.0) * scale;
+}
+
+// Fills the parameters [begin, end) of the shared layout
+void initialize_range(const ModelShape &shape, u64 seed, InitScheme scheme,
+                      double *parameters, size_t begin, size_t end) {
+  size_t offset = 0;
+  size_t fan_in = shape.inputs;
+  for (size_t layer = 0; layer < shape.layer_sizes.size(); layer++) {
+    size_t neurons = shape.layer_sizes[layer];
+    size_t stride = fan_in + 1;
+    size_t layer_end = offset + neurons * stride;
+    double scale = scheme_scale(scheme, fan_in, neurons);
+    bool zero_bias = scheme != InitScheme::Uniform;
+
+    size_t first = std::max(begin, offset);
+    size_t last = std::min(end, layer_end);
+    if (first < last) {
+      size_t neuron = (first - offset) / stride;
+      size_t index = (first - offset) % stride;
+      double pair[2];
+      bool drawn = false;
+      for (size_t i = first; i < last; i++) {
+        if (index == fan_in && zero_bias) {
+          parameters[i] = 0.0;
+        } else {
+          if (index % 2 == 0 || !drawn) {
+            draw_pair(seed, scheme, layer, neuron, index / 2, scale, pair);
+            drawn = true;
+          }
+          parameters[i] = pair[index % 2];
+        }
+        if (++index == stride) {
+          index = 0;
+          neuron++;
+          drawn = false;
+        }
+      }
+    }
+    offset = layer_end;
+    fan_in = neurons;
+  }
+}
+
+// Below this a thread costs more than it saves
+constexpr size_t kMinParametersPerThread = 1 << 16;
+
+} // namespace
+
+auto initial_parameter(u64 seed, InitScheme scheme, u64 layer, u64 neuron,
+                       u64 index, size_t fan_in, size_t fan_out) -> double {
+  if (index == fan_in && scheme != InitScheme::Uniform) {
+    return 0.0;
+  }
+  double pair[2];
+  draw_pair(seed, scheme, layer, neuron, index / 2,
+            scheme_scale(scheme, fan_in, fan_out), pair);
+  return pair[index % 2];
+}
+
+void initialize_parameters(const ModelShape &shape, u64 seed,
+                           InitScheme scheme, double *parameters,
+                           size_t threads) {
+  size_t count = shape.parameter_count();
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threads = std::max<size_t>(
+      1, std::min(threads, count / kMinParametersPerThread));
+
+  size_t chunk = (count + threads - 1) / threads;
+  std::vector<std::thread> workers;
+  for (size_t t = 1; t < threads; t++) {
+    size_t begin = std::min(count, t * chunk);
+    size_t end = std::min(count, begin + chunk);
+    workers.emplace_back(initialize_range, std::cref(shape), seed, scheme,
+                         parameters, begin, end);
+  }
+  initialize_range(shape, seed, scheme, parameters, 0,
+                   std::min(count, chunk));
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+}
+
+auto initial_parameters(const ModelShape &shape, u64 seed, InitScheme scheme,
+                        size_t threads) -> std::vector<double> {
+  std::vector<double> parameters(shape.parameter_count());
+  initialize_parameters(shape, seed, scheme, parameters.data(), threads);
+  return parameters;
+}
+
+void write_model(std::ostream &os, const ModelShape &shape,
+                 const std::vector<double> &parameters) {
+  if (parameters.size() != shape.parameter_count()) {
+    throw std::invalid_argument("Parameter count does not match the shape");
+  }
+
+  os.write(kMagic, sizeof(kMagic));
+  write_u64(os, shape.inputs);
+  write_u64(os, shape.layer_sizes.size());
+  for (size_t size : shape.layer_sizes) {
+    write_u64(os, size);
+  }
+  for (size_t i = 0; i < shape.layer_sizes.size(); i++) {
+    char activation = static_cast<char>(shape.activation(i));
+    os.write(&activation, 1);
+  }
+  write_u64(os, parameters.size());
+  for (double parameter : parameters) {
+    u64 bits = 0;
+    std::memcpy(&bits, &parameter, sizeof(bits));
+    write_u64(os, bits);
+  }
+}
+
+auto read_model(std::istream &is) -> ModelData {
+  char magic[sizeof(kMagic)];
+  if (!is.read(magic, sizeof(magic))) {
+    throw std::runtime_error("Not a model file");
+  }
+  bool has_activations = std::memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+  if (!has_activations && std::memcmp(magic, kMagicV1, sizeof(kMagic)) != 0) {
+    throw std::runtime_error("Not a model file");
+  }
+
+  ModelData data;
+  data.shape.inputs = read_u64(is);
+  u64 layers = read_u64(is);
+  if (layers == 0 || layers > kMaxLayers) {
+    throw std::runtime_error("Invalid layer count in model file");
+  }
+  for (u64 i = 0; i < layers; i++) {
+    data.shape.layer_sizes.push_back(read_u64(is));
+  }
+  data.shape.activations.assign(layers, Activation::Relu);
+  if (has_activations) {
+    for (Activation &activation : data.shape.activations) {
+      char byte = 0;
+      if (!is.read(&byte, 1)) {
+        throw std::runtime_error("Truncated model file");
+      }
+      if (static_cast<u8>(byte) > static_cast<u8>(Activation::Identity)) {
+        throw std::runtime_error("Unknown activation in model file");
+      }
+      activation = static_cast<Activation>(byte);
+    }
+  }
+
+  u64 count = read_u64(is);
+  if (count > kMaxParameters || count != data.shape.parameter_count()) {
+    throw std::runtime_error("Parameter count does not match the shape");
+  }
+  data.parameters.resize(count);
+  for (double &parameter : data.parameters) {
+    u64 bits = read_u64(is);
+    std::memcpy(&parameter, &bits, sizeof(bits));
+  }
+  return data;
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include "../Activation.hpp"
+#include "../Shared/types.hpp"
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+// Parameter layout and file format shared by MultiLayerPerceptron and
+// StaticMLP, so a model trained in one loads into the other.
+//
+// Parameters are flat, in MultiLayerPerceptron::parameters() order: layer by
+// layer, neuron by neuron, each neuron's weights followed by its bias.
+//
+// The file is little-endian binary:
+//   "MGMLP002"         8 byte magic
+//   u64 inputs
+//   u64 layer count    then one u64 size per layer
+//   u8 activation      one per layer, see Activation.hpp
+//   u64 parameter count
+//   f64 parameters     in the order above
+//
+// Version 001 files have no activations and load as relu everywhere.
+
+struct ModelShape {
+  size_t inputs = 0;
+  std::vector<size_t> layer_sizes;
+  std::vector<Activation> activations; // Per layer, empty means all relu
+
+  auto parameter_count() const -> size_t;
+
+  auto activation(size_t layer) const -> Activation {
+    return layer < activations.size() ? activations[layer] : Activation::Relu;
+  }
+
+  bool operator==(const ModelShape &other) const {
+    if (inputs != other.inputs || layer_sizes != other.layer_sizes) {
+      return false;
+    }
+    for (size_t i = 0; i < layer_sizes.size(); i++) {
+      if (activation(i) != other.activation(i)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  bool operator!=(const ModelShape &other) const { return !(*this == other); }
+};
+
+struct ModelData {
+  ModelShape shape;
+  std::vector<double> parameters;
+};
+
+// How initial weights are drawn. Uniform is the historical default, every
+// parameter in [-1, 1]. The Xavier (Glorot) schemes scale by fan-in plus
+// fan-out and suit tanh and sigmoid layers, the He (Kaiming) schemes scale by
+// fan-in alone and suit the relu family. Biases start at zero under both.
+enum class InitScheme : u8 {
+  Uniform,
+  XavierUniform,
+  XavierNormal,
+  HeUniform,
+  HeNormal
+};
+
+// * Parameter `index` of a neuron (its weights, then the bias at index
+// * fan_in) in a layer of fan_out neurons. A pure function of its
+// * arguments: parameters 2k and 2k + 1 share one Philox draw keyed by the
+// * seed, with (layer, neuron, k) as the counter.
+auto initial_parameter(u64 seed, InitScheme scheme, u64 layer, u64 neuron,
+                       u64 index, size_t fan_in, size_t fan_out) -> double;
+
+// * Fills shape.parameter_count() parameters in the shared layout. The
+// * buffer is split across `threads` threads (0 picks the hardware
+// * concurrency); the result is bit-identical for any thread count.
+void initialize_parameters(const ModelShape &shape, u64 seed,
+                           InitScheme scheme, double *parameters,
+                           size_t threads = 0);
+
+// * Seeded initial parameters in the shared layout
+auto initial_parameters(const ModelShape &shape, u64 seed,
+                        InitScheme scheme = InitScheme::Uniform,
+                        size_t threads = 0) -> std::vector<double>;
+
+// * Throws std::invalid_argument if the parameter count does not match
+void write_model(std::ostream &os, const ModelShape &shape,
+                 const std::vector<double> &parameters);
+
+// * Throws std::runtime_error on a truncated or foreign file
+auto read_model(std::istream &is) -> ModelData;
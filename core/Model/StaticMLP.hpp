@@ -0,0 +1,269 @@
+#pragma once
+#include "../Neuron.h"
+#include "Format.hpp"
+#include <array>
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+// Inference MLP whose architecture is fixed at compile time.
+//
+//   StaticMLP<2, 16, 16, 1> model(seed);   // 2 inputs, two hidden, 1 output
+//   std::array<double, 1> y = model({x0, x1});
+//
+// A parameter pack cannot be followed by another parameter, so the sizes are
+// written <In, Sizes...> with the last size being the output width. Inputs
+// are a std::array<double, In>, so a wrong input width is a compile error
+// instead of the runtime_error thrown by Neuron::operator().
+//
+// It computes the same function as MultiLayerPerceptron (bias added first,
+// inputs accumulated in order, then the layer's activation) and shares its
+// seeded initialization and file format, see Format.hpp. Activations are
+// chosen per layer at runtime and default to relu.
+
+#if defined(__clang__)
+#define STATIC_MLP_UNROLL _Pragma("unroll")
+#elif defined(__GNUC__)
+#define STATIC_MLP_UNROLL _Pragma("GCC unroll 16")
+#else
+#define STATIC_MLP_UNROLL
+#endif
+
+namespace static_mlp {
+
+// Weights are stored input-major, weights[i * Out + o] connects input i to
+// neuron o. The inner loop then updates Out independent sums with a
+// unit-stride weight row, which vectorizes without reassociating any sum,
+// and with constexpr trip counts small layers unroll completely.
+template <size_t In, size_t Out> struct DenseLayer {
+  static_assert(Out > 0, "Layers need at least one neuron");
+
+  static constexpr size_t parameter_count = Out * (In + 1);
+
+  std::array<double, In * Out> weights{};
+  std::array<double, Out> bias{};
+  Activation activation = Activation::Relu;
+
+  auto operator()(const std::array<double, In> &inputs) const
+      -> std::array<double, Out> {
+    std::array<double, Out> outputs = bias;
+    for (size_t i = 0; i < In; i++) {
+      const double x = inputs[i];
+      const double *row = weights.data() + i * Out;
+      STATIC_MLP_UNROLL
+      for (size_t o = 0; o < Out; o++) {
+        outputs[o] += row[o] * x;
+      }
+    }
+    if (activation == Activation::Relu) {
+      STATIC_MLP_UNROLL
+      for (size_t o = 0; o < Out; o++) {
+        outputs[o] = outputs[o] > 0 ? outputs[o] : 0.0;
+      }
+    } else {
+      for (size_t o = 0; o < Out; o++) {
+        outputs[o] = apply_activation(activation, outputs[o]);
+      }
+    }
+    return outputs;
+  }
+
+  // Shared layout is neuron-major, weights then bias
+  auto read(const double *params) -> const double * {
+    for (size_t o = 0; o < Out; o++) {
+      for (size_t i = 0; i < In; i++) {
+        weights[i * Out + o] = *params++;
+      }
+      bias[o] = *params++;
+    }
+    return params;
+  }
+
+  auto write(double *params) const -> double * {
+    for (size_t o = 0; o < Out; o++) {
+      for (size_t i = 0; i < In; i++) {
+        *params++ = weights[i * Out + o];
+      }
+      *params++ = bias[o];
+    }
+    return params;
+  }
+};
+
+template <size_t In, size_t First, size_t... Rest> struct Layers {
+  using Head = DenseLayer<In, First>;
+  using Tail = Layers<First, Rest...>;
+
+  static constexpr size_t outputs = Tail::outputs;
+  static constexpr size_t parameter_count =
+      Head::parameter_count + Tail::parameter_count;
+
+  Head head;
+  Tail tail;
+
+  auto operator()(const std::array<double, In> &inputs) const
+      -> std::array<double, outputs> {
+    return tail(head(inputs));
+  }
+
+  auto read(const double *params) -> const double * {
+    return tail.read(head.read(params));
+  }
+
+  auto write(double *params) const -> double * {
+    return tail.write(head.write(params));
+  }
+
+  static void sizes(std::vector<size_t> &out) {
+    out.push_back(First);
+    Tail::sizes(out);
+  }
+
+  void set_activations(const Activation *activations) {
+    head.activation = activations[0];
+    tail.set_activations(activations + 1);
+  }
+
+  void activations(std::vector<Activation> &out) const {
+    out.push_back(head.activation);
+    tail.activations(out);
+  }
+};
+
+template <size_t In, size_t Out> struct Layers<In, Out> {
+  using Head = DenseLayer<In, Out>;
+
+  static constexpr size_t outputs = Out;
+  static constexpr size_t parameter_count = Head::parameter_count;
+
+  Head head;
+
+  auto operator()(const std::array<double, In> &inputs) const
+      -> std::array<double, Out> {
+    return head(inputs);
+  }
+
+  auto read(const double *params) -> const double * {
+    return head.read(params);
+  }
+
+  auto write(double *params) const -> double * { return head.write(params); }
+
+  static void sizes(std::vector<size_t> &out) { out.push_back(Out); }
+
+  void set_activations(const Activation *activations) {
+    head.activation = activations[0];
+  }
+
+  void activations(std::vector<Activation> &out) const {
+    out.push_back(head.activation);
+  }
+};
+
+} // namespace static_mlp
+
+template <size_t In, size_t... Sizes> class StaticMLP {
+  static_assert(sizeof...(Sizes) > 0, "StaticMLP needs at least one layer");
+
+  using Layers = static_mlp::Layers<In, Sizes...>;
+
+public:
+  static constexpr size_t inputs = In;
+  static constexpr size_t outputs = Layers::outputs;
+  static constexpr size_t num_layers = sizeof...(Sizes);
+  static constexpr size_t parameter_count = Layers::parameter_count;
+
+  using Input = std::array<double, In>;
+  using Output = std::array<double, outputs>;
+  using Activations = std::array<Activation, num_layers>;
+
+  // * All parameters zero, relu everywhere
+  StaticMLP() = default;
+
+  // * Same parameters as MultiLayerPerceptron(shape(), seed, scheme). A
+  // * value-initialized Activations is relu on every layer.
+  explicit StaticMLP(u64 seed, const Activations &activations = {},
+                     InitScheme scheme = InitScheme::Uniform) {
+    set_activations(activations);
+    set_parameters(initial_parameters(shape(), seed, scheme));
+  }
+
+  auto operator()(const Input &input) const -> Output { return _layers(input); }
+
+  auto shape() const -> ModelShape {
+    ModelShape result;
+    result.inputs = In;
+    Layers::sizes(result.layer_sizes);
+    _layers.activations(result.activations);
+    return result;
+  }
+
+  void set_activations(const Activations &activations) {
+    _layers.set_activations(activations.data());
+  }
+
+  // * Parameter values in the layout of Format.hpp
+  auto parameters() const -> std::vector<double> {
+    std::vector<double> values(parameter_count);
+    _layers.write(values.data());
+    return values;
+  }
+
+  void set_parameters(const std::vector<double> &values) {
+    if (values.size() != parameter_count) {
+      throw std::runtime_error("Parameter count mismatch");
+    }
+    _layers.read(values.data());
+  }
+
+  void save(std::ostream &os) const { write_model(os, shape(), parameters()); }
+
+  // * Throws if the file holds different layer sizes, takes its activations
+  static auto load(std::istream &is) -> StaticMLP {
+    ModelData data = read_model(is);
+    if (!same_sizes(data.shape)) {
+      throw std::runtime_error("Model file has a different architecture");
+    }
+    StaticMLP mlp;
+    mlp.adopt_activations(data.shape);
+    mlp.set_parameters(data.parameters);
+    return mlp;
+  }
+
+  static auto from(const MultiLayerPerceptron &mlp) -> StaticMLP {
+    if (!same_sizes(mlp.shape())) {
+      throw std::runtime_error("MultiLayerPerceptron has a different shape");
+    }
+    StaticMLP result;
+    result.adopt_activations(mlp.shape());
+    result.set_parameters(mlp.parameter_values());
+    return result;
+  }
+
+  auto to_dynamic() const -> MultiLayerPerceptron {
+    MultiLayerPerceptron mlp(shape());
+    mlp.set_parameters(parameters());
+    return mlp;
+  }
+
+private:
+  static auto same_sizes(const ModelShape &other) -> bool {
+    ModelShape sizes;
+    sizes.inputs = In;
+    Layers::sizes(sizes.layer_sizes);
+    return other.inputs == sizes.inputs &&
+           other.layer_sizes == sizes.layer_sizes;
+  }
+
+  void adopt_activations(const ModelShape &other) {
+    Activations activations;
+    for (size_t i = 0; i < num_layers; i++) {
+      activations[i] = other.activation(i);
+    }
+    set_activations(activations);
+  }
+
+  Layers _layers;
+};
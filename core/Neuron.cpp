@@ -1 +1,18 @@
-// Nothing for now
\ No newline at end of file
+#include "Neuron.h"
+#include <atomic>
+#include <random>
+
+// Unseeded neurons share one seed per process, drawn once, and each takes
+// the next stream of it, so construction costs no random_device call
+auto unseeded_init_seed() -> u64 {
+  static const u64 seed = [] {
+    std::random_device rd;
+    return static_cast<u64>(rd()) << 32 | rd();
+  }();
+  return seed;
+}
+
+auto next_init_stream() -> u64 {
+  static std::atomic<u64> stream{0};
+  return stream.fetch_add(1, std::memory_order_relaxed);
+}
@@ -1,55 +1,149 @@
+#pragma once
+#include "Model/Format.hpp"
 #include "Value.h"
+#include <algorithm>
+#include <cmath>
 #include <cstdlib>
-#include <random>
+#include <istream>
+#include <ostream>
+#include <span>
 #include <stdexcept>
 #include <vector>
 
+// * How the layer code below reads parameters for a scalar type T. ValuePtr
+// * links the parameter nodes into the graph and groups each neuron's nodes.
+// * Any other type (the duals in Forward/Dual.hpp) gets the parameter values as
+// * plain doubles and records nothing.
+template <typename T> struct ScalarTraits {
+  struct Group {};
+  static auto parameter(const ValuePtr &param) -> double {
+    return param->get_value();
+  }
+};
+
+template <> struct ScalarTraits<ValuePtr> {
+  using Group = GraphGroup;
+  static auto parameter(const ValuePtr &param) -> const ValuePtr & {
+    return param;
+  }
+};
+
+// Seed and stream for neurons built without a seed, see Neuron.cpp
+auto unseeded_init_seed() -> u64;
+auto next_init_stream() -> u64;
+
 class Neuron {
 public:
-  Neuron(size_t number_of_inputs) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<float> dis(-1.0F, 1.0F);
+  // * Unseeded: uniform in [-1, 1] from this process's own stream
+  Neuron(size_t number_of_inputs,
+         Activation activation = Activation::Relu)
+      : _activation(activation) {
+    u64 seed = unseeded_init_seed();
+    u64 stream = next_init_stream();
+    _bias = create_value(initial_parameter(seed, InitScheme::Uniform, 0,
+                                           stream, number_of_inputs,
+                                           number_of_inputs, 0));
+    _weights.resize(number_of_inputs);
+    for (size_t i = 0; i < number_of_inputs; i++) {
+      _weights[i] = create_value(initial_parameter(
+          seed, InitScheme::Uniform, 0, stream, i, number_of_inputs, 0));
+    }
+  }
 
-    _bias = create_value(dis(gen));
+  // * Takes number_of_inputs weights and then the bias from parameters
+  Neuron(size_t number_of_inputs, Activation activation,
+         const double *parameters)
+      : _activation(activation) {
     _weights.resize(number_of_inputs);
     for (size_t i = 0; i < number_of_inputs; i++) {
-      _weights[i] = create_value(dis(gen));
+      _weights[i] = create_value(parameters[i]);
     }
+    _bias = create_value(parameters[number_of_inputs]);
   }
 
   auto operator()(const std::vector<ValuePtr> &inputs) -> ValuePtr {
+    return operator()<ValuePtr>(inputs);
+  }
+
+  template <typename T> auto operator()(const std::vector<T> &inputs) -> T {
 
     if (inputs.size() != _weights.size()) {
       throw std::runtime_error("Invalid number of inputs");
     }
+    return evaluate(inputs.data());
+  }
 
-    ValuePtr activation = _bias;
+  // * Unchecked core of operator(), reads _weights.size() inputs
+  template <typename T> auto evaluate(const T *inputs) const -> T {
+    using Traits = ScalarTraits<T>;
+    typename Traits::Group group;
+    (void)group;
 
-    for (size_t i = 0; i < inputs.size(); i++) {
-      activation = activation + (inputs[i] * _weights[i]);
+    T sum = Traits::parameter(_bias);
+    if (_weights.empty()) {
+      return activate(sum, _activation);
     }
 
-    ValuePtr output = relu(activation);
+    size_t last = _weights.size() - 1;
+    for (size_t i = 0; i < last; i++) {
+      sum = sum + (inputs[i] * Traits::parameter(_weights[i]));
+    }
+
+    // The last term and the activation are one node
+    T output = activate(inputs[last], Traits::parameter(_weights[last]), sum,
+                        _activation);
     return output;
   }
 
+  auto num_inputs() const -> size_t { return _weights.size(); }
+
+  auto activation() const -> Activation { return _activation; }
+
+  auto parameters() const -> std::vector<ValuePtr> {
+    std::vector<ValuePtr> params(_weights);
+    params.push_back(_bias);
+    return params;
+  }
+
 private:
   std::vector<ValuePtr> _weights;
   ValuePtr _bias;
+  Activation _activation;
 };
 
 class Layer {
 public:
-  Layer(size_t number_of_inputs, size_t number_of_neurons) {
-    _neurons.resize(number_of_neurons, Neuron(number_of_inputs));
+  Layer(size_t number_of_inputs, size_t number_of_neurons,
+        Activation activation = Activation::Relu)
+      : _activation(activation) {
+    // Each neuron needs its own Values, copies of one Neuron would share them
+    _neurons.reserve(number_of_neurons);
+    for (size_t i = 0; i < number_of_neurons; i++) {
+      _neurons.emplace_back(number_of_inputs, activation);
+    }
+  }
+
+  // * Neuron by neuron from parameters, in the layout of Model/Format.hpp
+  Layer(size_t number_of_inputs, size_t number_of_neurons,
+        Activation activation, const double *parameters)
+      : _activation(activation) {
+    _neurons.reserve(number_of_neurons);
+    for (size_t i = 0; i < number_of_neurons; i++) {
+      _neurons.emplace_back(number_of_inputs, activation,
+                            parameters + i * (number_of_inputs + 1));
+    }
   }
 
   auto operator()(const std::vector<ValuePtr> &inputs)
       -> std::vector<ValuePtr> {
+    return operator()<ValuePtr>(inputs);
+  }
+
+  template <typename T>
+  auto operator()(const std::vector<T> &inputs) -> std::vector<T> {
     try {
 
-      std::vector<ValuePtr> outputs;
+      std::vector<T> outputs;
       outputs.resize(_neurons.size());
 
       for (size_t i = 0; i < _neurons.size(); i++) {
@@ -62,39 +156,296 @@ public:
     }
   }
 
+  // * Unchecked and allocation free, writes size() outputs
+  template <typename T> void evaluate(const T *inputs, T *outputs) const {
+    for (size_t i = 0; i < _neurons.size(); i++) {
+      outputs[i] = _neurons[i].evaluate(inputs);
+    }
+  }
+
+  auto size() const -> size_t { return _neurons.size(); }
+
+  auto activation() const -> Activation { return _activation; }
+
+  auto parameters() const -> std::vector<ValuePtr> {
+    std::vector<ValuePtr> params;
+    for (const Neuron &neuron : _neurons) {
+      auto neuron_params = neuron.parameters();
+      params.insert(params.end(), neuron_params.begin(), neuron_params.end());
+    }
+    return params;
+  }
+
 private:
   std::vector<Neuron> _neurons;
+  Activation _activation;
+};
+
+// * Forward pass that only keeps the outputs of every `interval`-th layer.
+// * The inner nodes of each segment are dropped after the forward pass and
+// * rebuilt, one segment at a time, by backward(). With an interval near
+// * sqrt(depth) the live graph grows with sqrt(depth) instead of depth.
+// *
+// * It refers to the layers it was built over, so the MLP must outlive it and
+// * must not be reassigned before backward(). Construction zeroes the
+// * gradients of those layers' parameters and of the inputs, as a plain
+// * backpropagate through the whole graph would.
+class CheckpointedForward {
+public:
+  CheckpointedForward(std::span<Layer> layers,
+                      const std::vector<ValuePtr> &inputs, size_t interval,
+                      bool measure = false)
+      : _layers(layers), _interval(interval), _measure(measure) {
+    if (_interval == 0) {
+      _interval = static_cast<size_t>(
+          std::ceil(std::sqrt(static_cast<double>(layers.size()))));
+    }
+
+    // backward() only adds to leaves, so a previous step's gradients must
+    // not carry over
+    for (const Layer &layer : _layers) {
+      for (const ValuePtr &param : layer.parameters()) {
+        param->set_gradient(0.0);
+      }
+    }
+    for (const ValuePtr &input : inputs) {
+      input->set_gradient(0.0);
+    }
+
+    _checkpoints.push_back(inputs);
+    for (size_t segment = 0; segment * _interval < _layers.size();
+         segment++) {
+      std::vector<ValuePtr> outputs = run_segment(segment);
+
+      // Detach the segment outputs so its inner graph is freed here
+      std::vector<ValuePtr> checkpoint(outputs.size());
+      for (size_t i = 0; i < outputs.size(); i++) {
+        checkpoint[i] = create_value(outputs[i]->get_value());
+      }
+      _stored_values += checkpoint.size();
+      _checkpoints.push_back(std::move(checkpoint));
+    }
+  }
+
+  // * Detached leaves holding the network output, build the loss on these
+  auto outputs() const -> const std::vector<ValuePtr> & {
+    return _checkpoints.back();
+  }
+
+  // * Call after backpropagating the loss into outputs(). Replays each
+  // * segment from its checkpoint, last to first, and adds the gradients to
+  // * the parameters and the original inputs. Gradients the loss gave them
+  // * directly, e.g. through a skip term, are kept.
+  void backward() {
+    for (size_t segment = _checkpoints.size() - 1; segment-- > 0;) {
+      std::vector<ValuePtr> outputs = run_segment(segment);
+
+      const std::vector<ValuePtr> &checkpoint = _checkpoints[segment + 1];
+      std::vector<double> seeds(checkpoint.size());
+      for (size_t i = 0; i < checkpoint.size(); i++) {
+        seeds[i] = checkpoint[i]->get_gradient();
+      }
+      Value::accumulate_backpropagate(outputs, seeds);
+    }
+  }
+
+  // * Largest number of intermediate nodes alive at once, checkpoints
+  // * included. Only recorded when constructed with measure = true.
+  auto peak_nodes() const -> size_t { return _peak_segment + _stored_values; }
+
+  auto interval() const -> size_t { return _interval; }
+
+private:
+  auto run_segment(size_t segment) -> std::vector<ValuePtr> {
+    size_t first = segment * _interval;
+    size_t last = std::min(first + _interval, _layers.size());
+
+    std::vector<ValuePtr> current = _checkpoints[segment];
+    for (size_t i = first; i < last; i++) {
+      PROFILE_LAYER(i + 1);
+      current = _layers[i](current);
+    }
+
+    if (_measure) {
+      std::vector<Value *> roots;
+      for (const ValuePtr &value : current) {
+        roots.push_back(value.get());
+      }
+      size_t interior = 0;
+      for (Value *node : Value::topological_order(roots)) {
+        interior += node->is_leaf() ? 0 : 1;
+      }
+      _peak_segment = std::max(_peak_segment, interior);
+    }
+    return current;
+  }
+
+  std::span<Layer> _layers;
+  size_t _interval;
+  bool _measure;
+
+  // _checkpoints[s] is the input of segment s, the last entry the output
+  std::vector<std::vector<ValuePtr>> _checkpoints;
+  size_t _stored_values = 0;
+  size_t _peak_segment = 0;
 };
 
 class MultiLayerPerceptron {
 public:
   MultiLayerPerceptron(size_t number_of_inputs,
-                       const std::vector<size_t> &layer_sizes) : _number_of_inputs(number_of_inputs) {
-    
-    _layers.push_back(Layer(number_of_inputs, layer_sizes[0]));
+                       const std::vector<size_t> &layer_sizes)
+      : MultiLayerPerceptron(ModelShape{number_of_inputs, layer_sizes, {}}) {}
 
-    for (size_t i = 1; i < layer_sizes.size(); i++) {
-      _layers.push_back(Layer(layer_sizes[i - 1], layer_sizes[i]));
+  // * Per-layer activations come from shape.activations, relu if empty
+  explicit MultiLayerPerceptron(const ModelShape &shape) : _shape(shape) {
+    _shape.activations.resize(_shape.layer_sizes.size(), Activation::Relu);
+
+    size_t inputs = _shape.inputs;
+    for (size_t i = 0; i < _shape.layer_sizes.size(); i++) {
+      _layers.push_back(
+          Layer(inputs, _shape.layer_sizes[i], _shape.activations[i]));
+      inputs = _shape.layer_sizes[i];
+    }
+  }
+
+  // * Reproducible initialization, the same seed and scheme give a StaticMLP
+  // * of this shape the same parameters
+  MultiLayerPerceptron(size_t number_of_inputs,
+                       const std::vector<size_t> &layer_sizes, u64 seed,
+                       InitScheme scheme = InitScheme::Uniform)
+      : MultiLayerPerceptron(ModelShape{number_of_inputs, layer_sizes, {}},
+                             seed, scheme) {}
+
+  MultiLayerPerceptron(const ModelShape &shape, u64 seed,
+                       InitScheme scheme = InitScheme::Uniform)
+      : _shape(shape) {
+    _shape.activations.resize(_shape.layer_sizes.size(), Activation::Relu);
+
+    std::vector<double> values = initial_parameters(_shape, seed, scheme);
+    const double *parameters = values.data();
+    size_t inputs = _shape.inputs;
+    for (size_t i = 0; i < _shape.layer_sizes.size(); i++) {
+      _layers.push_back(Layer(inputs, _shape.layer_sizes[i],
+                              _shape.activations[i], parameters));
+      parameters += _shape.layer_sizes[i] * (inputs + 1);
+      inputs = _shape.layer_sizes[i];
     }
   }
 
   std::vector<ValuePtr> operator()(const std::vector<ValuePtr>& inputs) {
-    if (inputs.size() != _number_of_inputs) {
+    return operator()<ValuePtr>(inputs);
+  }
+
+  template <typename T>
+  std::vector<T> operator()(const std::vector<T>& inputs) {
+    if (inputs.size() != _shape.inputs) {
         throw std::runtime_error("Input size mismatch");
     }
 
+    PROFILE_FORWARD();
+
     // Store the actual vector, but we only do this once
-    std::vector<ValuePtr> current = _layers[0](inputs);
+    std::vector<T> current;
+    {
+      PROFILE_LAYER(1);
+      current = _layers[0](inputs);
+    }
 
     // Modify current in place
     for (size_t i = 1; i < _layers.size(); ++i) {
+        PROFILE_LAYER(i + 1);
         current = std::move(_layers[i](current));  // Use move semantics
     }
 
     return current;  // Will likely be moved by compiler
   }
 
+  // * Activation checkpointing at Layer boundaries, interval 0 picks
+  // * ceil(sqrt(depth)). See CheckpointedForward.
+  auto forward_checkpointed(const std::vector<ValuePtr> &inputs,
+                            size_t interval = 0, bool measure = false)
+      -> CheckpointedForward {
+    if (inputs.size() != _shape.inputs) {
+      throw std::runtime_error("Input size mismatch");
+    }
+    PROFILE_FORWARD();
+    return CheckpointedForward(_layers, inputs, interval, measure);
+  }
+
+  // * Forward pass without allocating, for value types such as the duals in
+  // * Forward/Dual.hpp. Unchecked: inputs holds num_inputs() elements, outputs
+  // * the last layer's size and scratch 2 * max_width().
+  template <typename T>
+  void evaluate(const T *inputs, T *outputs, T *scratch) const {
+    size_t width = max_width();
+    const T *current = inputs;
+    for (size_t i = 0; i < _layers.size(); i++) {
+      T *next = i + 1 == _layers.size() ? outputs
+                                        : scratch + (i % 2) * width;
+      _layers[i].evaluate(current, next);
+      current = next;
+    }
+  }
+
+  auto num_layers() const -> size_t { return _layers.size(); }
+
+  auto layer(size_t index) const -> const Layer & { return _layers[index]; }
+
+  auto num_inputs() const -> size_t { return _shape.inputs; }
+
+  auto num_outputs() const -> size_t { return _layers.back().size(); }
+
+  // * Widest layer
+  auto max_width() const -> size_t {
+    size_t width = 0;
+    for (const Layer &layer : _layers) {
+      width = std::max(width, layer.size());
+    }
+    return width;
+  }
+
+  auto parameters() const -> std::vector<ValuePtr> {
+    std::vector<ValuePtr> params;
+    for (const Layer &layer : _layers) {
+      auto layer_params = layer.parameters();
+      params.insert(params.end(), layer_params.begin(), layer_params.end());
+    }
+    return params;
+  }
+
+  auto shape() const -> const ModelShape & { return _shape; }
+
+  // * Parameter values in the layout of Model/Format.hpp
+  auto parameter_values() const -> std::vector<double> {
+    std::vector<double> values;
+    for (const ValuePtr &param : parameters()) {
+      values.push_back(param->get_value());
+    }
+    return values;
+  }
+
+  void set_parameters(const std::vector<double> &values) {
+    std::vector<ValuePtr> params = parameters();
+    if (values.size() != params.size()) {
+      throw std::runtime_error("Parameter count mismatch");
+    }
+    for (size_t i = 0; i < params.size(); i++) {
+      params[i]->set_value(values[i]);
+    }
+  }
+
+  void save(std::ostream &os) const {
+    write_model(os, shape(), parameter_values());
+  }
+
+  static auto load(std::istream &is) -> MultiLayerPerceptron {
+    ModelData data = read_model(is);
+    MultiLayerPerceptron mlp(data.shape);
+    mlp.set_parameters(data.parameters);
+    return mlp;
+  }
+
 private:
-  size_t _number_of_inputs;
+  ModelShape _shape;
   std::vector<Layer> _layers;
 };
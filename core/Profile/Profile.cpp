@@ -0,0 +1,305 @@
+#include "Profile.hpp"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+
+namespace profile {
+
+namespace {
+
+struct TraceEvent {
+  const char *name;
+  char phase; // 'X' complete, 'C' counter
+  u64 start_ns;
+  u64 value; // Duration for 'X', counter value for 'C'
+};
+
+// Bound the trace so a long run cannot eat all memory, the summary keeps
+// counting after the cap is hit
+constexpr size_t kMaxEvents = 1 << 20;
+
+// One thread's recordings. Only the owning thread writes to it.
+struct ThreadBuffer {
+  explicit ThreadBuffer(u32 id) : thread_id(id) {}
+  u32 thread_id;
+  Stats stats;
+  std::vector<TraceEvent> events;
+  size_t current_layer = 0;
+  u64 dropped_events = 0;
+};
+
+// Buffers live until the process exits, so a worker's recordings are still
+// there to merge after it is joined
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+};
+
+auto registry() -> Registry & {
+  static Registry instance;
+  return instance;
+}
+
+// Events kept over all threads, against kMaxEvents
+std::atomic<size_t> g_event_count{0};
+
+thread_local ThreadBuffer *t_buffer = nullptr;
+
+auto local() -> ThreadBuffer & {
+  if (t_buffer == nullptr) {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    auto id = static_cast<u32>(reg.buffers.size() + 1);
+    reg.buffers.push_back(std::make_unique<ThreadBuffer>(id));
+    t_buffer = reg.buffers.back().get();
+  }
+  return *t_buffer;
+}
+
+void push_event(const TraceEvent &event) {
+  ThreadBuffer &buffer = local();
+  if (g_event_count.fetch_add(1, std::memory_order_relaxed) >= kMaxEvents) {
+    buffer.dropped_events++;
+    return;
+  }
+  buffer.events.push_back(event);
+}
+
+} // namespace
+
+auto op_name(Op op) -> const char * {
+  switch (op) {
+  case Op::Add:
+    return "add";
+  case Op::Sub:
+    return "sub";
+  case Op::Mul:
+    return "mul";
+  case Op::Neg:
+    return "neg";
+  case Op::Inverse:
+    return "inverse";
+  case Op::Relu:
+    return "relu";
+  case Op::Activate:
+    return "activate";
+  case Op::Fused:
+    return "fused";
+  case Op::Count:
+    break;
+  }
+  return "unknown";
+}
+
+// * ------------- Recording ---------------
+
+void reset() {
+  Registry &reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  for (const std::unique_ptr<ThreadBuffer> &buffer : reg.buffers) {
+    buffer->stats = Stats{};
+    buffer->events.clear();
+    buffer->current_layer = 0;
+    buffer->dropped_events = 0;
+  }
+  g_event_count.store(0, std::memory_order_relaxed);
+}
+
+auto stats() -> Stats {
+  Stats merged;
+  Registry &reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  for (const std::unique_ptr<ThreadBuffer> &buffer : reg.buffers) {
+    const Stats &s = buffer->stats;
+    for (size_t i = 0; i < kOpCount; i++) {
+      merged.ops[i].count += s.ops[i].count;
+      merged.ops[i].forward_ns += s.ops[i].forward_ns;
+      merged.ops[i].backward_ns += s.ops[i].backward_ns;
+    }
+    merged.forward_passes += s.forward_passes;
+    merged.forward_nodes += s.forward_nodes;
+    merged.max_forward_nodes =
+        std::max(merged.max_forward_nodes, s.max_forward_nodes);
+    merged.nodes_created += s.nodes_created;
+    merged.backward_passes += s.backward_passes;
+    for (size_t layer = 0; layer < kMaxLayers; layer++) {
+      merged.backward_layer_ns[layer] += s.backward_layer_ns[layer];
+    }
+    merged.max_layer = std::max(merged.max_layer, s.max_layer);
+    merged.arena_bytes_pushed += s.arena_bytes_pushed;
+    merged.arena_high_water =
+        std::max(merged.arena_high_water, s.arena_high_water);
+  }
+  return merged;
+}
+
+auto thread_nodes_created() -> u64 { return local().stats.nodes_created; }
+
+auto now_ns() -> u64 {
+  return static_cast<u64>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+void record_op(Op op, u64 forward_ns) {
+  OpStats &op_stats = local().stats.ops[static_cast<size_t>(op)];
+  op_stats.count++;
+  op_stats.forward_ns += forward_ns;
+}
+
+void record_backward(Op op, size_t layer, u64 ns) {
+  Stats &stats = local().stats;
+  stats.ops[static_cast<size_t>(op)].backward_ns += ns;
+  layer = std::min(layer, kMaxLayers - 1);
+  stats.backward_layer_ns[layer] += ns;
+  stats.max_layer = std::max(stats.max_layer, layer);
+}
+
+void record_node() { local().stats.nodes_created++; }
+
+void record_forward_pass(u64 nodes) {
+  Stats &stats = local().stats;
+  stats.forward_passes++;
+  stats.forward_nodes += nodes;
+  stats.max_forward_nodes = std::max(stats.max_forward_nodes, nodes);
+  record_counter("forward nodes", nodes);
+}
+
+void record_backward_pass() { local().stats.backward_passes++; }
+
+void record_arena_push(u64 bytes, u64 arena_pos) {
+  Stats &stats = local().stats;
+  stats.arena_bytes_pushed += bytes;
+  if (arena_pos > stats.arena_high_water) {
+    stats.arena_high_water = arena_pos;
+    record_counter("arena high water", arena_pos);
+  }
+}
+
+void record_event(const char *name, u64 start_ns, u64 duration_ns) {
+  push_event(TraceEvent{name, 'X', start_ns, duration_ns});
+}
+
+void record_counter(const char *name, u64 value) {
+  push_event(TraceEvent{name, 'C', now_ns(), value});
+}
+
+auto current_layer() -> size_t { return local().current_layer; }
+
+void set_current_layer(size_t layer) { local().current_layer = layer; }
+
+auto layer_name(size_t layer) -> const char * {
+  // Trace events keep the name pointer, so the strings must live forever
+  static std::vector<std::string> names = [] {
+    std::vector<std::string> result;
+    for (size_t i = 0; i < kMaxLayers; i++) {
+      result.push_back("backward layer " + std::to_string(i));
+    }
+    return result;
+  }();
+  return names[std::min(layer, kMaxLayers - 1)].c_str();
+}
+
+// * ------------- Export ---------------
+
+void write_chrome_trace(std::ostream &os) {
+  Registry &reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+
+  // Timestamps relative to the earliest event keep the numbers readable
+  u64 epoch = UINT64_MAX;
+  for (const std::unique_ptr<ThreadBuffer> &buffer : reg.buffers) {
+    for (const TraceEvent &event : buffer->events) {
+      epoch = std::min(epoch, event.start_ns);
+    }
+  }
+
+  os << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+  os << std::fixed << std::setprecision(3);
+  bool first = true;
+  for (const std::unique_ptr<ThreadBuffer> &buffer : reg.buffers) {
+    for (const TraceEvent &event : buffer->events) {
+      double ts_us = (event.start_ns - epoch) / 1000.0;
+      os << (first ? "" : ",\n") << "  {\"name\": \"" << event.name
+         << "\", \"ph\": \"" << event.phase << "\", \"ts\": " << ts_us
+         << ", \"pid\": 1, \"tid\": " << buffer->thread_id;
+      if (event.phase == 'X') {
+        os << ", \"dur\": " << event.value / 1000.0;
+      } else {
+        os << ", \"args\": {\"value\": " << event.value << "}";
+      }
+      os << "}";
+      first = false;
+    }
+  }
+  os << (first ? "" : "\n") << "]}\n";
+}
+
+auto write_chrome_trace(const std::string &path) -> bool {
+  std::ofstream file(path);
+  if (!file) {
+    return false;
+  }
+  write_chrome_trace(file);
+  return static_cast<bool>(file);
+}
+
+void write_summary(std::ostream &os) {
+  auto ms = [](u64 ns) { return ns / 1e6; };
+  const Stats merged = stats();
+  u64 dropped_events = 0;
+  {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (const std::unique_ptr<ThreadBuffer> &buffer : reg.buffers) {
+      dropped_events += buffer->dropped_events;
+    }
+  }
+
+  os << std::fixed << std::setprecision(3);
+  os << std::left << std::setw(10) << "op" << std::right << std::setw(12)
+     << "count" << std::setw(14) << "forward ms" << std::setw(14)
+     << "backward ms" << std::setw(12) << "ns/op" << "\n";
+  for (size_t i = 0; i < kOpCount; i++) {
+    const OpStats &op = merged.ops[i];
+    if (op.count == 0 && op.backward_ns == 0) {
+      continue;
+    }
+    double per_op =
+        op.count ? static_cast<double>(op.forward_ns + op.backward_ns) /
+                       op.count
+                 : 0.0;
+    os << std::left << std::setw(10) << op_name(static_cast<Op>(i))
+       << std::right << std::setw(12) << op.count << std::setw(14)
+       << ms(op.forward_ns) << std::setw(14) << ms(op.backward_ns)
+       << std::setw(12) << per_op << "\n";
+  }
+
+  os << "\nforward passes    " << merged.forward_passes << ", nodes/pass "
+     << (merged.forward_passes
+             ? merged.forward_nodes / merged.forward_passes
+             : 0)
+     << " (max " << merged.max_forward_nodes << ")\n";
+
+  os << "backward passes   " << merged.backward_passes << "\n";
+  for (size_t layer = 0; layer <= merged.max_layer; layer++) {
+    if (merged.backward_layer_ns[layer] == 0) {
+      continue;
+    }
+    os << "  backward layer " << std::setw(2) << layer << "  "
+       << ms(merged.backward_layer_ns[layer]) << " ms"
+       << (layer == 0 ? " (outside the model)" : "") << "\n";
+  }
+
+  os << "arena bytes pushed " << merged.arena_bytes_pushed
+     << ", high water " << merged.arena_high_water << "\n";
+  if (dropped_events) {
+    os << "trace truncated, " << dropped_events << " events dropped\n";
+  }
+}
+
+} // namespace profile
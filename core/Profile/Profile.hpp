@@ -0,0 +1,173 @@
+#pragma once
+#include "../Shared/types.hpp"
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Hot-path instrumentation for training steps.
+//
+// Everything below is always compiled into the profile library, but the
+// PROFILE_* macros that the engine calls only expand to anything when the
+// build sets MICROGRAD_PROFILE=1 (cmake -DMICROGRAD_PROFILE=ON). Without it
+// the macros are empty statements and Value carries no extra fields, so the
+// instrumentation can stay in production builds at zero cost.
+//
+// Each thread records into its own buffer, found through a thread_local
+// pointer, so the hot path takes no lock and shares no cache lines with
+// other threads. stats(), the writers and reset() merge or clear every
+// thread's buffer, including those of threads that have exited; call them
+// once the recording threads are joined or idle. Trace events carry the
+// recording thread's id.
+
+#ifndef MICROGRAD_PROFILE
+#define MICROGRAD_PROFILE 0
+#endif
+
+namespace profile {
+
+enum class Op : u8 {
+  Add,
+  Sub,
+  Mul,
+  Neg,
+  Inverse,
+  Relu,
+  Activate,
+  Fused,
+  Count
+};
+
+constexpr size_t kOpCount = static_cast<size_t>(Op::Count);
+
+// Layer 0 is anything built outside MultiLayerPerceptron (inputs, loss)
+constexpr size_t kMaxLayers = 64;
+
+struct OpStats {
+  u64 count = 0;
+  u64 forward_ns = 0;
+  u64 backward_ns = 0;
+};
+
+struct Stats {
+  OpStats ops[kOpCount];
+
+  u64 forward_passes = 0;
+  u64 forward_nodes = 0;     // Summed over all forward passes
+  u64 max_forward_nodes = 0; // Largest single forward pass
+  u64 nodes_created = 0;
+
+  u64 backward_passes = 0;
+  u64 backward_layer_ns[kMaxLayers] = {};
+  size_t max_layer = 0;
+
+  u64 arena_bytes_pushed = 0;
+  u64 arena_high_water = 0;
+};
+
+auto op_name(Op op) -> const char *;
+
+// * ------------- Recording ---------------
+void reset();
+// * Every thread's counters merged. Sums add, maxima take the largest.
+auto stats() -> Stats;
+// * Nodes created on the calling thread so far
+auto thread_nodes_created() -> u64;
+auto now_ns() -> u64;
+
+void record_op(Op op, u64 forward_ns);
+void record_backward(Op op, size_t layer, u64 ns);
+void record_node();
+void record_forward_pass(u64 nodes);
+void record_backward_pass();
+void record_arena_push(u64 bytes, u64 arena_pos);
+
+// Complete ("X") and counter ("C") events for the Chrome trace
+void record_event(const char *name, u64 start_ns, u64 duration_ns);
+void record_counter(const char *name, u64 value);
+
+// Layer the calling thread is building nodes for, stamped onto each Value
+auto current_layer() -> size_t;
+void set_current_layer(size_t layer);
+auto layer_name(size_t layer) -> const char *;
+
+// * ------------- Export ---------------
+
+// Chrome trace / Perfetto JSON (load in chrome://tracing or ui.perfetto.dev)
+void write_chrome_trace(std::ostream &os);
+auto write_chrome_trace(const std::string &path) -> bool;
+
+void write_summary(std::ostream &os);
+
+// * ------------- Scopes used by the macros ---------------
+
+class TraceScope {
+public:
+  explicit TraceScope(const char *name) : _name(name), _start(now_ns()) {}
+  ~TraceScope() { record_event(_name, _start, now_ns() - _start); }
+
+private:
+  const char *_name;
+  u64 _start;
+};
+
+class OpTimer {
+public:
+  explicit OpTimer(Op op) : _op(op), _start(now_ns()) {}
+  ~OpTimer() { record_op(_op, now_ns() - _start); }
+
+private:
+  Op _op;
+  u64 _start;
+};
+
+class LayerScope {
+public:
+  explicit LayerScope(size_t layer) : _previous(current_layer()) {
+    set_current_layer(layer);
+  }
+  ~LayerScope() { set_current_layer(_previous); }
+
+private:
+  size_t _previous;
+};
+
+class ForwardScope {
+public:
+  ForwardScope() : _nodes(thread_nodes_created()), _start(now_ns()) {}
+  ~ForwardScope() {
+    record_event("forward", _start, now_ns() - _start);
+    record_forward_pass(thread_nodes_created() - _nodes);
+  }
+
+private:
+  u64 _nodes;
+  u64 _start;
+};
+
+} // namespace profile
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if MICROGRAD_PROFILE
+#define PROFILE_SCOPE(name)                                                    \
+  profile::TraceScope PROFILE_CONCAT(_profile_scope_, __LINE__)(name)
+#define PROFILE_OP(op)                                                         \
+  profile::OpTimer PROFILE_CONCAT(_profile_op_, __LINE__)(op)
+#define PROFILE_LAYER(layer)                                                   \
+  profile::LayerScope PROFILE_CONCAT(_profile_layer_, __LINE__)(layer)
+#define PROFILE_FORWARD()                                                      \
+  profile::ForwardScope PROFILE_CONCAT(_profile_forward_, __LINE__)
+#define PROFILE_NODE() profile::record_node()
+#define PROFILE_TAG_NODE(node, op) ((node)->_profile_op = (op))
+#define PROFILE_ARENA_PUSH(bytes, pos) profile::record_arena_push(bytes, pos)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_OP(op) ((void)0)
+#define PROFILE_LAYER(layer) ((void)0)
+#define PROFILE_FORWARD() ((void)0)
+#define PROFILE_NODE() ((void)0)
+#define PROFILE_TAG_NODE(node, op) ((void)0)
+#define PROFILE_ARENA_PUSH(bytes, pos) ((void)0)
+#endif
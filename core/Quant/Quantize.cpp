@@ -0,0 +1,213 @@
+#include "Quantize.hpp"
+#include "../Shared/simd.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+constexpr size_t kLanes = 32;
+constexpr i32 kMaxCode = 127;
+constexpr f32 kMaxWeight = 127.0F;
+
+auto dot_scalar(const u8 *codes, const i8 *weights, size_t n) -> i32 {
+  i32 sum = 0;
+  for (size_t i = 0; i < n; i++) {
+    sum += static_cast<i32>(codes[i]) * weights[i];
+  }
+  return sum;
+}
+
+#if MICROGRAD_HAVE_AVX2
+__attribute__((target("avx2"))) auto dot_avx2(const u8 *codes,
+                                              const i8 *weights, size_t n)
+    -> i32 {
+  const __m256i ones = _mm256_set1_epi16(1);
+  __m256i sum = _mm256_setzero_si256();
+  for (size_t i = 0; i < n; i += kLanes) {
+    __m256i x =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(codes + i));
+    __m256i w =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(weights + i));
+    // u8 x s8 pairs into s16, then pairs of s16 into s32
+    __m256i pairs = _mm256_maddubs_epi16(x, w);
+    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(pairs, ones));
+  }
+  __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                               _mm256_extracti128_si256(sum, 1));
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+  return _mm_cvtsi128_si32(half);
+}
+#endif
+
+struct Range {
+  double low = 0.0;
+  double high = 0.0;
+};
+
+// Asymmetric 7-bit code for [low, high], which always contains zero
+void set_input_range(QuantizedLayer &layer, const Range &range) {
+  double span = range.high - range.low;
+  double scale = span > 0.0 ? span / kMaxCode : 1.0;
+  layer.input_scale = static_cast<f32>(scale);
+  layer.input_zero_point = static_cast<i32>(std::lround(-range.low / scale));
+}
+
+void quantize_weights(QuantizedLayer &layer, const Layer &source,
+                      QuantGranularity granularity) {
+  std::vector<ValuePtr> params = source.parameters();
+  size_t stride = layer.inputs + 1;
+
+  std::vector<f32> scales(layer.outputs);
+  f32 layer_max = 0.0F;
+  for (size_t o = 0; o < layer.outputs; o++) {
+    f32 row_max = 0.0F;
+    for (size_t i = 0; i < layer.inputs; i++) {
+      row_max = std::max(row_max, static_cast<f32>(std::abs(
+                                      params[o * stride + i]->get_value())));
+    }
+    scales[o] = row_max;
+    layer_max = std::max(layer_max, row_max);
+  }
+
+  layer.weights.assign(layer.outputs * layer.stride, 0);
+  layer.weight_sums.assign(layer.outputs, 0);
+  layer.weight_scales.resize(layer.outputs);
+  layer.bias.resize(layer.outputs);
+  for (size_t o = 0; o < layer.outputs; o++) {
+    f32 max = granularity == QuantGranularity::PerLayer ? layer_max
+                                                        : scales[o];
+    f32 scale = max > 0.0F ? max / kMaxWeight : 1.0F;
+    layer.weight_scales[o] = scale;
+    for (size_t i = 0; i < layer.inputs; i++) {
+      f32 w = static_cast<f32>(params[o * stride + i]->get_value());
+      long q = std::lround(w / scale);
+      q = std::min<long>(kMaxCode, std::max<long>(-kMaxCode, q));
+      layer.weights[o * layer.stride + i] = static_cast<i8>(q);
+      layer.weight_sums[o] += static_cast<i32>(q);
+    }
+    layer.bias[o] =
+        static_cast<f32>(params[o * stride + layer.inputs]->get_value());
+  }
+}
+
+} // namespace
+
+auto avx2_supported() -> bool { return cpu_has_avx2(); }
+
+auto QuantizedMLP::quantize(
+    const MultiLayerPerceptron &mlp,
+    const std::vector<std::vector<double>> &calibration,
+    QuantGranularity granularity) -> QuantizedMLP {
+  if (calibration.empty()) {
+    throw std::invalid_argument("Quantization needs calibration samples");
+  }
+
+  // Range of every layer's input over the samples, zero included
+  size_t num_layers = mlp.num_layers();
+  std::vector<Range> ranges(num_layers);
+  std::vector<double> current;
+  std::vector<double> next;
+  for (const std::vector<double> &sample : calibration) {
+    if (sample.size() != mlp.num_inputs()) {
+      throw std::invalid_argument("Calibration sample has the wrong width");
+    }
+    current = sample;
+    for (size_t l = 0; l < num_layers; l++) {
+      for (double x : current) {
+        ranges[l].low = std::min(ranges[l].low, x);
+        ranges[l].high = std::max(ranges[l].high, x);
+      }
+      next.resize(mlp.layer(l).size());
+      mlp.layer(l).evaluate(current.data(), next.data());
+      std::swap(current, next);
+    }
+  }
+
+  QuantizedMLP model;
+  size_t inputs = mlp.num_inputs();
+  size_t widest = 0;
+  for (size_t l = 0; l < num_layers; l++) {
+    QuantizedLayer layer;
+    layer.inputs = inputs;
+    layer.outputs = mlp.layer(l).size();
+    layer.stride = (inputs + kLanes - 1) / kLanes * kLanes;
+    layer.activation = mlp.layer(l).activation();
+    set_input_range(layer, ranges[l]);
+    quantize_weights(layer, mlp.layer(l), granularity);
+
+    widest = std::max({widest, layer.stride, layer.outputs});
+    inputs = layer.outputs;
+    model._layers.push_back(std::move(layer));
+  }
+  model._width = widest;
+  return model;
+}
+
+auto QuantizedMLP::workspace() const -> Workspace { return Workspace(_width); }
+
+void QuantizedMLP::run(const f32 *inputs, f32 *outputs, Workspace &workspace,
+                       QuantKernel kernel) const {
+  if (workspace.size() < _width) {
+    throw std::invalid_argument("Workspace is too small for this model");
+  }
+  bool avx2 = kernel == QuantKernel::Avx2 ||
+              (kernel == QuantKernel::Auto && avx2_supported());
+  if (avx2 && !avx2_supported()) {
+    throw std::runtime_error("AVX2 kernel requested on a CPU without AVX2");
+  }
+
+  std::vector<u8> &codes = workspace._codes;
+  const f32 *current = inputs;
+  for (size_t l = 0; l < _layers.size(); l++) {
+    const QuantizedLayer &layer = _layers[l];
+
+    // Quantize the input first, the f32 buffer is then free for the output
+    f32 inverse = 1.0F / layer.input_scale;
+    for (size_t i = 0; i < layer.inputs; i++) {
+      long q = std::lround(current[i] * inverse) + layer.input_zero_point;
+      codes[i] = static_cast<u8>(std::min<long>(kMaxCode,
+                                                std::max<long>(0, q)));
+    }
+    std::fill(codes.begin() + layer.inputs, codes.begin() + layer.stride, 0);
+
+    f32 *out = l + 1 == _layers.size() ? outputs : workspace._values.data();
+    for (size_t o = 0; o < layer.outputs; o++) {
+      const i8 *row = layer.weights.data() + o * layer.stride;
+#if MICROGRAD_HAVE_AVX2
+      i32 dot = avx2 ? dot_avx2(codes.data(), row, layer.stride)
+                     : dot_scalar(codes.data(), row, layer.stride);
+#else
+      i32 dot = dot_scalar(codes.data(), row, layer.stride);
+#endif
+      i32 acc = dot - layer.input_zero_point * layer.weight_sums[o];
+      f32 z = static_cast<f32>(acc) * layer.input_scale *
+                  layer.weight_scales[o] +
+              layer.bias[o];
+      out[o] = layer.activation == Activation::Relu
+                   ? std::max(z, 0.0F)
+                   : static_cast<f32>(apply_activation(layer.activation, z));
+    }
+    current = out;
+  }
+}
+
+auto QuantizedMLP::operator()(const std::vector<f32> &inputs) const
+    -> std::vector<f32> {
+  if (inputs.size() != num_inputs()) {
+    throw std::runtime_error("Input size mismatch");
+  }
+  std::vector<f32> outputs(num_outputs());
+  Workspace scratch = workspace();
+  run(inputs.data(), outputs.data(), scratch);
+  return outputs;
+}
+
+auto QuantizedMLP::weight_bytes() const -> size_t {
+  size_t bytes = 0;
+  for (const QuantizedLayer &layer : _layers) {
+    bytes += layer.weights.size();
+  }
+  return bytes;
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include "../Neuron.h"
+#include <vector>
+
+// Post-training int8 quantization of a MultiLayerPerceptron for inference.
+//
+//   std::vector<std::vector<double>> samples = ...;  // representative inputs
+//   QuantizedMLP model = QuantizedMLP::quantize(mlp, samples);
+//   QuantizedMLP::Workspace ws = model.workspace();  // One per thread
+//   model.run(x, y, ws);                             // f32 in, f32 out
+//
+// Weights are symmetric int8 in [-127, 127] with one scale per layer or per
+// neuron. Each layer's input is asymmetric uint8 in [0, 127] whose scale and
+// zero point cover the range calibration saw at that input, so signed
+// inputs and relu outputs both use every code. Products accumulate in int32
+// and the zero point is taken out with a precomputed weight sum:
+//
+//   y[o] = (sum_i w[o][i] x[i] - zero_point * sum_i w[o][i])
+//          * input_scale * weight_scale[o] + bias[o]
+//
+// Biases and activations stay in f32. The AVX2 kernel multiplies with
+// maddubs (uint8 x int8 pairs summed into a saturating int16). With 7-bit
+// activations a pair is at most 2 * 127 * 127 = 32258, so it never saturates
+// and the scalar and AVX2 kernels agree bit for bit.
+
+enum class QuantGranularity : u8 { PerLayer, PerChannel };
+
+enum class QuantKernel : u8 { Auto, Scalar, Avx2 };
+
+// * Whether this build and CPU can run QuantKernel::Avx2
+auto avx2_supported() -> bool;
+
+struct QuantizedLayer {
+  size_t inputs = 0;
+  size_t outputs = 0;
+  size_t stride = 0; // Inputs padded to the 32 byte AVX2 width
+
+  std::vector<i8> weights; // outputs x stride, neuron-major, zero padded
+  std::vector<i32> weight_sums;
+  std::vector<f32> weight_scales; // Per neuron, all equal for PerLayer
+  std::vector<f32> bias;
+
+  f32 input_scale = 1.0F;
+  i32 input_zero_point = 0;
+  Activation activation = Activation::Relu;
+};
+
+class QuantizedMLP {
+public:
+  // Integer codes and f32 activations for one thread's calls to run()
+  class Workspace {
+  public:
+    auto size() const -> size_t { return _codes.size(); }
+
+  private:
+    friend class QuantizedMLP;
+    explicit Workspace(size_t width) : _codes(width, 0), _values(width, 0.0F) {}
+    std::vector<u8> _codes;
+    std::vector<f32> _values;
+  };
+
+  // * Calibrates every layer's input range by running the samples through
+  // * mlp. Throws std::invalid_argument without samples or on a sample of
+  // * the wrong width.
+  static auto quantize(const MultiLayerPerceptron &mlp,
+                       const std::vector<std::vector<double>> &calibration,
+                       QuantGranularity granularity =
+                           QuantGranularity::PerChannel) -> QuantizedMLP;
+
+  // * A workspace large enough for this model. Allocates; make one per
+  // * thread up front.
+  auto workspace() const -> Workspace;
+
+  // * Reads num_inputs() and writes num_outputs() values. Thread-safe for
+  // * distinct workspaces. Throws std::invalid_argument for a workspace made
+  // * by a narrower model and std::runtime_error for QuantKernel::Avx2
+  // * without AVX2.
+  void run(const f32 *inputs, f32 *outputs, Workspace &workspace,
+           QuantKernel kernel = QuantKernel::Auto) const;
+
+  // * One input with a workspace of its own
+  auto operator()(const std::vector<f32> &inputs) const -> std::vector<f32>;
+
+  auto num_inputs() const -> size_t { return _layers.front().inputs; }
+  auto num_outputs() const -> size_t { return _layers.back().outputs; }
+  auto layers() const -> const std::vector<QuantizedLayer> & {
+    return _layers;
+  }
+
+  // * Bytes of int8 weights, padding included
+  auto weight_bytes() const -> size_t;
+
+private:
+  std::vector<QuantizedLayer> _layers;
+  size_t _width = 0; // Widest padded layer input or output
+};
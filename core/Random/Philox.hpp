@@ -0,0 +1,51 @@
+#pragma once
+#include "../Shared/types.hpp"
+#include <array>
+
+// Philox4x32-10 (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2,
+// 3"), a counter-based generator: the output is a pure function of a 128-bit
+// counter and a 64-bit key, so any element of a stream can be drawn directly
+// and in any order. Parameter initialization uses it to fill buffers in
+// parallel with results that do not depend on the thread count.
+
+namespace philox {
+
+using Counter = std::array<u32, 4>;
+using Key = std::array<u32, 2>;
+
+constexpr u32 kMul0 = 0xD2511F53u;
+constexpr u32 kMul1 = 0xCD9E8D57u;
+constexpr u32 kWeyl0 = 0x9E3779B9u;
+constexpr u32 kWeyl1 = 0xBB67AE85u;
+constexpr int kRounds = 10;
+
+inline auto round(const Counter &ctr, const Key &key) -> Counter {
+  u64 product0 = static_cast<u64>(kMul0) * ctr[0];
+  u64 product1 = static_cast<u64>(kMul1) * ctr[2];
+  return Counter{static_cast<u32>(product1 >> 32) ^ ctr[1] ^ key[0],
+                 static_cast<u32>(product1),
+                 static_cast<u32>(product0 >> 32) ^ ctr[3] ^ key[1],
+                 static_cast<u32>(product0)};
+}
+
+// * Four random words for one counter value
+inline auto generate(Counter ctr, Key key) -> Counter {
+  for (int i = 0; i < kRounds; i++) {
+    ctr = round(ctr, key);
+    key[0] += kWeyl0;
+    key[1] += kWeyl1;
+  }
+  return ctr;
+}
+
+inline auto key(u64 seed) -> Key {
+  return Key{static_cast<u32>(seed), static_cast<u32>(seed >> 32)};
+}
+
+// * A double in [0, 1) from two words, with the full 53 bits of mantissa
+inline auto unit(u32 hi, u32 lo) -> double {
+  u64 bits = (static_cast<u64>(hi) << 32 | lo) >> 11;
+  return static_cast<double>(bits) * (1.0 / 9007199254740992.0);
+}
+
+} // namespace philox
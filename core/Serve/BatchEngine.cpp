@@ -0,0 +1,219 @@
+#include "BatchEngine.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+// * ------------- BatchedMLP ---------------
+
+BatchedMLP::BatchedMLP(const MultiLayerPerceptron &mlp)
+    : _shape(mlp.shape()), _parameters(mlp.parameter_values()) {}
+
+void BatchedMLP::forward(const double *inputs, size_t batch,
+                         double *outputs) {
+  size_t width = 0;
+  for (size_t size : _shape.layer_sizes) {
+    width = std::max(width, size);
+  }
+  if (_scratch.size() < 2 * batch * width) {
+    _scratch.resize(2 * batch * width);
+  }
+
+  const double *current = inputs;
+  const double *parameters = _parameters.data();
+  size_t fan_in = _shape.inputs;
+  size_t num_layers = _shape.layer_sizes.size();
+  for (size_t l = 0; l < num_layers; l++) {
+    size_t neurons = _shape.layer_sizes[l];
+    Activation activation = _shape.activation(l);
+    double *next = l + 1 == num_layers
+                       ? outputs
+                       : _scratch.data() + (l % 2) * batch * width;
+
+    // Each weight row is loaded once and applied to the whole batch
+    for (size_t o = 0; o < neurons; o++) {
+      const double *row = parameters + o * (fan_in + 1);
+      for (size_t b = 0; b < batch; b++) {
+        const double *x = current + b * fan_in;
+        double sum = row[fan_in];
+        for (size_t i = 0; i < fan_in; i++) {
+          sum += x[i] * row[i];
+        }
+        next[b * neurons + o] = apply_activation(activation, sum);
+      }
+    }
+
+    parameters += neurons * (fan_in + 1);
+    current = next;
+    fan_in = neurons;
+  }
+}
+
+// * ------------- InferenceEngine ---------------
+
+InferenceEngine::InferenceEngine(const MultiLayerPerceptron &mlp,
+                                 BatchingOptions options)
+    : _model(mlp), _options(options) {
+  if (_options.max_batch == 0) {
+    throw std::invalid_argument("max_batch must be at least 1");
+  }
+  _batch_sizes.assign(_options.max_batch + 1, 0);
+  _latencies_ns.reserve(kLatencyWindow);
+  _worker = std::thread(&InferenceEngine::run, this);
+}
+
+InferenceEngine::~InferenceEngine() { shutdown(); }
+
+auto InferenceEngine::submit(std::vector<double> input)
+    -> std::future<std::vector<double>> {
+  if (input.size() != _model.num_inputs()) {
+    throw std::invalid_argument("Input size mismatch");
+  }
+
+  Request request;
+  request.input = std::move(input);
+  request.submitted = Clock::now();
+  std::future<std::vector<double>> result = request.result.get_future();
+  {
+    std::lock_guard<std::mutex> lock(_queue_mutex);
+    if (_stopping) {
+      throw std::runtime_error("Inference engine is shut down");
+    }
+    _queue.push_back(std::move(request));
+  }
+  _queue_ready.notify_one();
+  return result;
+}
+
+void InferenceEngine::shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(_queue_mutex);
+    _stopping = true;
+  }
+  _queue_ready.notify_one();
+  if (_worker.joinable()) {
+    _worker.join();
+  }
+}
+
+void InferenceEngine::run() {
+  std::vector<Request> batch;
+  batch.reserve(_options.max_batch);
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(_queue_mutex);
+      _queue_ready.wait(lock, [&] { return _stopping || !_queue.empty(); });
+      if (_queue.empty()) {
+        return; // Stopping and drained
+      }
+
+      // Hold the batch open until it is full or its oldest request is due
+      Clock::time_point deadline = _queue.front().submitted + _options.max_wait;
+      _queue_ready.wait_until(lock, deadline, [&] {
+        return _stopping || _queue.size() >= _options.max_batch;
+      });
+
+      size_t count = std::min(_queue.size(), _options.max_batch);
+      for (size_t i = 0; i < count; i++) {
+        batch.push_back(std::move(_queue.front()));
+        _queue.pop_front();
+      }
+    }
+
+    serve(batch);
+    batch.clear();
+  }
+}
+
+void InferenceEngine::serve(std::vector<Request> &batch) {
+  size_t inputs = _model.num_inputs();
+  size_t outputs = _model.num_outputs();
+  std::vector<double> in(batch.size() * inputs);
+  std::vector<double> out(batch.size() * outputs);
+  for (size_t b = 0; b < batch.size(); b++) {
+    std::copy(batch[b].input.begin(), batch[b].input.end(),
+              in.begin() + b * inputs);
+  }
+
+  _model.forward(in.data(), batch.size(), out.data());
+
+  // Stats first, so a caller holding its result also sees it counted
+  Clock::time_point done = Clock::now();
+  record(batch, done);
+  for (size_t b = 0; b < batch.size(); b++) {
+    batch[b].result.set_value(std::vector<double>(
+        out.begin() + b * outputs, out.begin() + (b + 1) * outputs));
+  }
+}
+
+void InferenceEngine::record(const std::vector<Request> &batch,
+                             Clock::time_point done) {
+  std::lock_guard<std::mutex> lock(_stats_mutex);
+  _batches++;
+  _batch_sizes[batch.size()]++;
+  for (const Request &request : batch) {
+    u64 ns = static_cast<u64>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            done - request.submitted)
+            .count());
+    if (_latencies_ns.size() < kLatencyWindow) {
+      _latencies_ns.push_back(ns);
+    } else {
+      _latencies_ns[_next_latency] = ns;
+    }
+    _next_latency = (_next_latency + 1) % kLatencyWindow;
+    _requests++;
+  }
+}
+
+auto InferenceEngine::stats() const -> InferenceStats {
+  InferenceStats result;
+  std::vector<u64> latencies;
+  {
+    std::lock_guard<std::mutex> lock(_stats_mutex);
+    result.requests = _requests;
+    result.batches = _batches;
+    result.batch_sizes = _batch_sizes;
+    latencies = _latencies_ns;
+  }
+  if (latencies.empty()) {
+    return result;
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&](double p) {
+    size_t rank = static_cast<size_t>(p * (latencies.size() - 1) + 0.5);
+    return latencies[rank] / 1e3;
+  };
+  result.p50_us = percentile(0.50);
+  result.p90_us = percentile(0.90);
+  result.p99_us = percentile(0.99);
+  result.max_us = latencies.back() / 1e3;
+  return result;
+}
+
+void InferenceEngine::reset_stats() {
+  std::lock_guard<std::mutex> lock(_stats_mutex);
+  _requests = 0;
+  _batches = 0;
+  std::fill(_batch_sizes.begin(), _batch_sizes.end(), 0);
+  _latencies_ns.clear();
+  _next_latency = 0;
+}
+
+void write_stats_json(std::ostream &os, const InferenceStats &stats) {
+  os << "{\"requests\": " << stats.requests
+     << ", \"batches\": " << stats.batches
+     << ", \"mean_batch\": " << stats.mean_batch()
+     << ", \"latency_us\": {\"p50\": " << stats.p50_us
+     << ", \"p90\": " << stats.p90_us << ", \"p99\": " << stats.p99_us
+     << ", \"max\": " << stats.max_us << "}, \"batch_sizes\": {";
+  bool first = true;
+  for (size_t n = 1; n < stats.batch_sizes.size(); n++) {
+    if (stats.batch_sizes[n] == 0) {
+      continue;
+    }
+    os << (first ? "" : ", ") << "\"" << n << "\": " << stats.batch_sizes[n];
+    first = false;
+  }
+  os << "}}";
+}
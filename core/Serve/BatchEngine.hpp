@@ -0,0 +1,126 @@
+#pragma once
+#include "../Neuron.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+// Dynamic batching for serving one sample at a time from many threads.
+//
+//   BatchingOptions options{32, std::chrono::microseconds(500)};
+//   InferenceEngine engine(mlp, options);
+//   std::future<std::vector<double>> y = engine.submit({x0, x1});
+//
+// submit() queues the sample and returns at once. A worker thread takes the
+// queue as soon as it holds max_batch samples, or once the oldest one has
+// waited max_wait, runs a single forward pass over the whole batch and
+// fulfils the futures. Every weight row is then read once per batch rather
+// than once per request.
+//
+// The engine copies the parameters at construction, so training the MLP
+// afterwards does not change what it serves. It computes the same function
+// as MultiLayerPerceptron, summing each neuron in the same order.
+
+struct BatchingOptions {
+  size_t max_batch = 32;
+  std::chrono::microseconds max_wait{500};
+};
+
+struct InferenceStats {
+  u64 requests = 0;
+  u64 batches = 0;
+
+  // Submit to result, over the most recent kLatencyWindow requests
+  double p50_us = 0.0;
+  double p90_us = 0.0;
+  double p99_us = 0.0;
+  double max_us = 0.0;
+
+  // batch_sizes[n] counts batches of n samples, n up to max_batch
+  std::vector<u64> batch_sizes;
+
+  auto mean_batch() const -> double {
+    return batches ? static_cast<double>(requests) / batches : 0.0;
+  }
+};
+
+// * One JSON object, as the benches print
+void write_stats_json(std::ostream &os, const InferenceStats &stats);
+
+// The forward pass over a batch, on a flat copy of the parameters
+class BatchedMLP {
+public:
+  explicit BatchedMLP(const MultiLayerPerceptron &mlp);
+
+  // * inputs is batch rows of num_inputs(), outputs batch rows of
+  // * num_outputs(). Unchecked.
+  void forward(const double *inputs, size_t batch, double *outputs);
+
+  auto num_inputs() const -> size_t { return _shape.inputs; }
+  auto num_outputs() const -> size_t { return _shape.layer_sizes.back(); }
+
+private:
+  ModelShape _shape;
+  std::vector<double> _parameters;
+  std::vector<double> _scratch;
+};
+
+class InferenceEngine {
+public:
+  static constexpr size_t kLatencyWindow = 1 << 16;
+
+  // * Throws std::invalid_argument for a max_batch of 0
+  explicit InferenceEngine(const MultiLayerPerceptron &mlp,
+                           BatchingOptions options = BatchingOptions());
+
+  // * Finishes everything already submitted, see shutdown()
+  ~InferenceEngine();
+
+  InferenceEngine(const InferenceEngine &) = delete;
+  InferenceEngine &operator=(const InferenceEngine &) = delete;
+
+  // * Thread-safe. Throws std::invalid_argument for the wrong input width
+  // * and std::runtime_error once the engine is shut down.
+  auto submit(std::vector<double> input) -> std::future<std::vector<double>>;
+
+  // * Stops accepting requests, serves the ones queued and joins the worker
+  void shutdown();
+
+  auto stats() const -> InferenceStats;
+  void reset_stats();
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Request {
+    std::vector<double> input;
+    std::promise<std::vector<double>> result;
+    Clock::time_point submitted;
+  };
+
+  void run();
+  void serve(std::vector<Request> &batch);
+  void record(const std::vector<Request> &batch, Clock::time_point done);
+
+  BatchedMLP _model;
+  BatchingOptions _options;
+
+  std::mutex _queue_mutex;
+  std::condition_variable _queue_ready;
+  std::deque<Request> _queue;
+  bool _stopping = false;
+
+  mutable std::mutex _stats_mutex;
+  u64 _requests = 0;
+  u64 _batches = 0;
+  std::vector<u64> _batch_sizes;
+  std::vector<u64> _latencies_ns; // Ring buffer of kLatencyWindow entries
+  size_t _next_latency = 0;
+
+  // Started by the constructor once everything above exists
+  std::thread _worker;
+};
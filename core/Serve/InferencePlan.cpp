@@ -0,0 +1,160 @@
+#include "InferencePlan.hpp"
+#include "../Shared/simd.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+constexpr size_t kLanes = 8; // Floats per AVX2 register
+constexpr size_t kRows = 4;  // Neurons per AVX2 step
+
+auto round_up(size_t n) -> size_t { return (n + kLanes - 1) / kLanes * kLanes; }
+
+auto activate(Activation activation, f32 z) -> f32 {
+  return activation == Activation::Relu
+             ? std::max(z, 0.0F)
+             : static_cast<f32>(apply_activation(activation, z));
+}
+
+void layer_scalar(const f32 *weights, const f32 *bias, size_t outputs,
+                  size_t stride, const f32 *x, f32 *y) {
+  for (size_t o = 0; o < outputs; o++) {
+    const f32 *row = weights + o * stride;
+    f32 sum = 0.0F;
+    for (size_t i = 0; i < stride; i++) {
+      sum += row[i] * x[i];
+    }
+    y[o] = sum + bias[o];
+  }
+}
+
+#if MICROGRAD_HAVE_AVX2
+__attribute__((target("avx2,fma"))) auto horizontal_sum(__m256 v) -> f32 {
+  __m128 half = _mm_add_ps(_mm256_castps256_ps128(v),
+                           _mm256_extractf128_ps(v, 1));
+  half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+  half = _mm_add_ss(half, _mm_movehdup_ps(half));
+  return _mm_cvtss_f32(half);
+}
+
+__attribute__((target("avx2,fma"))) void
+layer_avx2(const f32 *weights, const f32 *bias, size_t outputs, size_t stride,
+           const f32 *x, f32 *y) {
+  size_t o = 0;
+  for (; o + kRows <= outputs; o += kRows) {
+    const f32 *row = weights + o * stride;
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps();
+    __m256 acc3 = _mm256_setzero_ps();
+    for (size_t i = 0; i < stride; i += kLanes) {
+      __m256 in = _mm256_loadu_ps(x + i);
+      acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(row + i), in, acc0);
+      acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(row + stride + i), in, acc1);
+      acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(row + 2 * stride + i), in, acc2);
+      acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(row + 3 * stride + i), in, acc3);
+    }
+    y[o] = horizontal_sum(acc0) + bias[o];
+    y[o + 1] = horizontal_sum(acc1) + bias[o + 1];
+    y[o + 2] = horizontal_sum(acc2) + bias[o + 2];
+    y[o + 3] = horizontal_sum(acc3) + bias[o + 3];
+  }
+  for (; o < outputs; o++) {
+    const f32 *row = weights + o * stride;
+    __m256 acc = _mm256_setzero_ps();
+    for (size_t i = 0; i < stride; i += kLanes) {
+      acc = _mm256_fmadd_ps(_mm256_loadu_ps(row + i), _mm256_loadu_ps(x + i),
+                            acc);
+    }
+    y[o] = horizontal_sum(acc) + bias[o];
+  }
+}
+#endif
+
+} // namespace
+
+auto plan_avx2_supported() -> bool { return cpu_has_avx2_fma(); }
+
+auto InferencePlan::compile(const MultiLayerPerceptron &mlp,
+                            PlanKernel kernel) -> InferencePlan {
+  if (kernel == PlanKernel::Avx2 && !plan_avx2_supported()) {
+    throw std::runtime_error("AVX2 kernel requested on a CPU without AVX2");
+  }
+  InferencePlan plan;
+  plan._kernel = kernel == PlanKernel::Auto
+                     ? (plan_avx2_supported() ? PlanKernel::Avx2
+                                              : PlanKernel::Scalar)
+                     : kernel;
+
+  size_t inputs = mlp.num_inputs();
+  for (size_t l = 0; l < mlp.num_layers(); l++) {
+    std::vector<ValuePtr> params = mlp.layer(l).parameters();
+    Layer layer;
+    layer.inputs = inputs;
+    layer.outputs = mlp.layer(l).size();
+    layer.stride = round_up(inputs);
+    layer.weights = plan._weights.size();
+    layer.bias = plan._bias.size();
+    layer.activation = mlp.layer(l).activation();
+
+    plan._weights.resize(layer.weights + layer.outputs * layer.stride, 0.0F);
+    f32 *rows = plan._weights.data() + layer.weights;
+    for (size_t o = 0; o < layer.outputs; o++) {
+      for (size_t i = 0; i < inputs; i++) {
+        rows[o * layer.stride + i] =
+            static_cast<f32>(params[o * (inputs + 1) + i]->get_value());
+      }
+      plan._bias.push_back(
+          static_cast<f32>(params[o * (inputs + 1) + inputs]->get_value()));
+    }
+
+    plan._width =
+        std::max({plan._width, layer.stride, round_up(layer.outputs)});
+    inputs = layer.outputs;
+    plan._layers.push_back(layer);
+  }
+  return plan;
+}
+
+auto InferencePlan::workspace() const -> Workspace {
+  return Workspace(2 * _width);
+}
+
+void InferencePlan::run(const f32 *inputs, f32 *outputs,
+                        Workspace &workspace) const {
+  if (workspace.size() < 2 * _width) {
+    throw std::invalid_argument("Workspace is too small for this plan");
+  }
+
+  // Kernels read whole padded rows, so the padding past each layer's width
+  // must hold zeros, not a wider layer's leftovers
+  f32 *current = workspace._buffer.data();
+  f32 *next = current + _width;
+  const Layer &first = _layers.front();
+  std::copy(inputs, inputs + first.inputs, current);
+  std::fill(current + first.inputs, current + first.stride, 0.0F);
+
+  for (const Layer &layer : _layers) {
+    const f32 *weights = _weights.data() + layer.weights;
+    const f32 *bias = _bias.data() + layer.bias;
+#if MICROGRAD_HAVE_AVX2
+    if (_kernel == PlanKernel::Avx2) {
+      layer_avx2(weights, bias, layer.outputs, layer.stride, current, next);
+    } else {
+      layer_scalar(weights, bias, layer.outputs, layer.stride, current, next);
+    }
+#else
+    layer_scalar(weights, bias, layer.outputs, layer.stride, current, next);
+#endif
+    for (size_t o = 0; o < layer.outputs; o++) {
+      next[o] = activate(layer.activation, next[o]);
+    }
+    std::fill(next + layer.outputs, next + round_up(layer.outputs), 0.0F);
+    std::swap(current, next);
+  }
+  std::copy(current, current + num_outputs(), outputs);
+}
+
+auto InferencePlan::weight_bytes() const -> size_t {
+  return (_weights.size() + _bias.size()) * sizeof(f32);
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "../Neuron.h"
+#include <vector>
+
+// An immutable f32 copy of a trained MultiLayerPerceptron for low-latency
+// serving, callable from any number of threads at once.
+//
+//   const InferencePlan plan = InferencePlan::compile(mlp);
+//   InferencePlan::Workspace workspace = plan.workspace();  // Per thread
+//   plan.run(x, y, workspace);                               // Any thread
+//
+// compile() packs every layer's weights into one contiguous buffer, one
+// neuron per row, rows padded with zeros to a multiple of eight floats so
+// the AVX2 kernel never needs a tail loop. Shapes, offsets and the kernel
+// choice are fixed then too, so run() only reads the plan.
+//
+// All mutable state is in the Workspace: two activation buffers as wide as
+// the widest padded layer. run() copies the input into one, ping-pongs
+// between them layer by layer and copies the last layer out. It builds no
+// graph, takes no lock and allocates nothing, so a thread with its own
+// Workspace never waits on another.
+//
+// The AVX2 kernel runs four neurons at a time with FMA, sharing each load
+// of the input. It sums in a different order than the f64 model, so outputs
+// match it to f32 rounding rather than bit for bit.
+
+enum class PlanKernel : u8 { Auto, Scalar, Avx2 };
+
+// * Whether this build and CPU can run PlanKernel::Avx2, which needs FMA too
+auto plan_avx2_supported() -> bool;
+
+class InferencePlan {
+public:
+  // Scratch for one thread's calls to run()
+  class Workspace {
+  public:
+    auto size() const -> size_t { return _buffer.size(); }
+
+  private:
+    friend class InferencePlan;
+    explicit Workspace(size_t floats) : _buffer(floats, 0.0F) {}
+    std::vector<f32> _buffer;
+  };
+
+  // * Copies the parameters, so training mlp afterwards does not change the
+  // * plan. Throws std::runtime_error for PlanKernel::Avx2 without AVX2.
+  static auto compile(const MultiLayerPerceptron &mlp,
+                      PlanKernel kernel = PlanKernel::Auto) -> InferencePlan;
+
+  // * A workspace large enough for this plan. Allocates; make one per
+  // * thread up front.
+  auto workspace() const -> Workspace;
+
+  // * Reads num_inputs() and writes num_outputs() floats. Thread-safe for
+  // * distinct workspaces. Throws std::invalid_argument for a workspace made
+  // * by a smaller plan.
+  void run(const f32 *inputs, f32 *outputs, Workspace &workspace) const;
+
+  auto num_inputs() const -> size_t { return _layers.front().inputs; }
+  auto num_outputs() const -> size_t { return _layers.back().outputs; }
+  auto kernel() const -> PlanKernel { return _kernel; }
+
+  // * Bytes of packed weights and biases, padding included
+  auto weight_bytes() const -> size_t;
+
+private:
+  struct Layer {
+    size_t inputs = 0;
+    size_t outputs = 0;
+    size_t stride = 0; // Inputs padded to a multiple of eight
+    size_t weights = 0; // Offset of the first row in _weights
+    size_t bias = 0;    // Offset in _bias
+    Activation activation = Activation::Relu;
+  };
+
+  std::vector<Layer> _layers;
+  std::vector<f32> _weights; // Every layer's rows, back to back
+  std::vector<f32> _bias;
+  size_t _width = 0; // Widest padded layer input or output
+  PlanKernel _kernel = PlanKernel::Scalar;
+};
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <chrono>
+
+using Clock = std::chrono::steady_clock;
+
+// * Wall time since start, in seconds
+inline auto seconds_since(Clock::time_point start) -> double {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
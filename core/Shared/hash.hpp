@@ -0,0 +1,24 @@
+#pragma once
+
+#include "types.hpp"
+#include <cstddef>
+
+// 64-bit FNV-1a. Stable across builds and hosts, so it keys on-disk caches
+// and checksums files; not meant to resist deliberate collisions.
+constexpr u64 kFnvOffset = 14695981039346656037ULL;
+constexpr u64 kFnvPrime = 1099511628211ULL;
+
+// * Folds size bytes into hash, which starts at kFnvOffset
+inline void fnv1a(u64 &hash, const void *data, size_t size) {
+  const auto *bytes = static_cast<const u8 *>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * kFnvPrime;
+  }
+}
+
+// * Hash of size bytes on their own
+inline auto fnv1a(const void *data, size_t size) -> u64 {
+  u64 hash = kFnvOffset;
+  fnv1a(hash, data, size);
+  return hash;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+// x86 SIMD kernels are compiled one function at a time with
+// __attribute__((target("avx2"))), the rest of the build keeps its flags,
+// and are picked at run time from what the CPU reports. MICROGRAD_HAVE_AVX2
+// says whether this compiler can build them at all.
+#if (defined(__x86_64__) || defined(__i386__)) &&                              \
+    (defined(__GNUC__) || defined(__clang__))
+#define MICROGRAD_HAVE_AVX2 1
+#include <immintrin.h>
+#else
+#define MICROGRAD_HAVE_AVX2 0
+#endif
+
+// * Whether this CPU runs AVX2 code, checked once
+inline auto cpu_has_avx2() -> bool {
+#if MICROGRAD_HAVE_AVX2
+  static const bool supported = __builtin_cpu_supports("avx2");
+  return supported;
+#else
+  return false;
+#endif
+}
+
+// * Whether this CPU runs AVX2 code with FMA, checked once
+inline auto cpu_has_avx2_fma() -> bool {
+#if MICROGRAD_HAVE_AVX2
+  static const bool supported =
+      __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  return supported;
+#else
+  return false;
+#endif
+}
@@ -0,0 +1,447 @@
+#include "Sparse.hpp"
+#include "../Shared/simd.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+constexpr size_t kLanes = 4; // Doubles per AVX2 register
+
+auto round_up(size_t n, size_t block) -> size_t {
+  return (n + block - 1) / block * block;
+}
+
+// Inputs and outputs rounded up to whole tiles, as the buffers hold them
+auto padded_inputs(const SparseLayer &layer) -> size_t {
+  return round_up(layer.inputs, layer.block);
+}
+
+auto padded_outputs(const SparseLayer &layer) -> size_t {
+  return round_up(layer.outputs, layer.block);
+}
+
+auto activate(Activation activation, double z) -> double {
+  return activation == Activation::Relu ? std::max(z, 0.0)
+                                        : apply_activation(activation, z);
+}
+
+// y[0, n) += w * x[0, n)
+void axpy_scalar(double w, const double *x, double *y, size_t n) {
+  for (size_t j = 0; j < n; j++) {
+    y[j] += w * x[j];
+  }
+}
+
+auto csr_row_scalar(const double *values, const u32 *columns, size_t n,
+                    const double *x) -> double {
+  double sum = 0.0;
+  for (size_t k = 0; k < n; k++) {
+    sum += values[k] * x[columns[k]];
+  }
+  return sum;
+}
+
+// acc[0, b) += tile * x[0, b), the tile column-major
+void bsr_tile_scalar(const double *tile, const double *x, double *acc,
+                     size_t block) {
+  for (size_t c = 0; c < block; c++) {
+    axpy_scalar(x[c], tile + c * block, acc, block);
+  }
+}
+
+#if MICROGRAD_HAVE_AVX2
+__attribute__((target("avx2"))) void axpy_avx2(double w, const double *x,
+                                               double *y, size_t n) {
+  __m256d scale = _mm256_set1_pd(w);
+  size_t j = 0;
+  for (; j + kLanes <= n; j += kLanes) {
+    __m256d acc = _mm256_loadu_pd(y + j);
+    acc = _mm256_add_pd(acc, _mm256_mul_pd(scale, _mm256_loadu_pd(x + j)));
+    _mm256_storeu_pd(y + j, acc);
+  }
+  for (; j < n; j++) {
+    y[j] += w * x[j];
+  }
+}
+
+// Four products per step, the inputs fetched with a gather
+__attribute__((target("avx2"))) auto
+csr_row_avx2(const double *values, const u32 *columns, size_t n,
+             const double *x) -> double {
+  __m256d sum = _mm256_setzero_pd();
+  size_t k = 0;
+  for (; k + kLanes <= n; k += kLanes) {
+    __m128i index =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(columns + k));
+    // The masked form with a zero source, the plain one leaves the source
+    // undefined and GCC warns about it
+    __m256d gathered = _mm256_mask_i32gather_pd(
+        _mm256_setzero_pd(), x, index,
+        _mm256_castsi256_pd(_mm256_set1_epi64x(-1)), sizeof(double));
+    sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_loadu_pd(values + k),
+                                           gathered));
+  }
+  __m128d half = _mm_add_pd(_mm256_castpd256_pd128(sum),
+                            _mm256_extractf128_pd(sum, 1));
+  half = _mm_add_sd(half, _mm_unpackhi_pd(half, half));
+  double total = _mm_cvtsd_f64(half);
+  for (; k < n; k++) {
+    total += values[k] * x[columns[k]];
+  }
+  return total;
+}
+
+// block is a multiple of four
+__attribute__((target("avx2"))) void bsr_tile_avx2(const double *tile,
+                                                   const double *x,
+                                                   double *acc, size_t block) {
+  for (size_t r = 0; r < block; r += kLanes) {
+    __m256d sum = _mm256_loadu_pd(acc + r);
+    for (size_t c = 0; c < block; c++) {
+      sum = _mm256_add_pd(sum,
+                          _mm256_mul_pd(_mm256_loadu_pd(tile + c * block + r),
+                                        _mm256_set1_pd(x[c])));
+    }
+    _mm256_storeu_pd(acc + r, sum);
+  }
+}
+#endif
+
+// Weight (o, i) of a layer, parameters are neuron-major with the bias last
+auto weight_index(size_t inputs, size_t o, size_t i) -> size_t {
+  return o * (inputs + 1) + i;
+}
+
+} // namespace
+
+auto sparse_avx2_supported() -> bool { return cpu_has_avx2(); }
+
+void PruneMask::mask_gradients(const MultiLayerPerceptron &mlp) const {
+  std::vector<ValuePtr> params = mlp.parameters();
+  for (size_t p = 0; p < params.size(); p++) {
+    if (!_keep[p]) {
+      params[p]->set_gradient(0.0);
+    }
+  }
+}
+
+void PruneMask::apply(const MultiLayerPerceptron &mlp) const {
+  std::vector<ValuePtr> params = mlp.parameters();
+  for (size_t p = 0; p < params.size(); p++) {
+    if (!_keep[p]) {
+      params[p]->set_value(0.0);
+    }
+  }
+}
+
+auto PruneMask::kept() const -> size_t {
+  return static_cast<size_t>(std::count(_keep.begin(), _keep.end(), 1));
+}
+
+auto magnitude_prune(MultiLayerPerceptron &mlp, PruneOptions options)
+    -> PruneMask {
+  if (!(options.sparsity >= 0.0 && options.sparsity <= 1.0)) {
+    throw std::invalid_argument("Sparsity must be in [0, 1]");
+  }
+  if (options.block == 0) {
+    throw std::invalid_argument("Prune block must be positive");
+  }
+  size_t b = options.block;
+
+  std::vector<u8> keep;
+  for (size_t l = 0; l < mlp.num_layers(); l++) {
+    std::vector<ValuePtr> params = mlp.layer(l).parameters();
+    size_t outputs = mlp.layer(l).size();
+    size_t inputs = params.size() / outputs - 1;
+    size_t tile_rows = (outputs + b - 1) / b;
+    size_t tile_cols = (inputs + b - 1) / b;
+
+    // Tiles by mean magnitude, so partial edge tiles compete fairly
+    std::vector<double> score(tile_rows * tile_cols, 0.0);
+    std::vector<size_t> count(tile_rows * tile_cols, 0);
+    for (size_t o = 0; o < outputs; o++) {
+      for (size_t i = 0; i < inputs; i++) {
+        size_t t = o / b * tile_cols + i / b;
+        score[t] += std::abs(params[weight_index(inputs, o, i)]->get_value());
+        count[t]++;
+      }
+    }
+    for (size_t t = 0; t < score.size(); t++) {
+      score[t] /= static_cast<double>(count[t]);
+    }
+    std::vector<size_t> order(score.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t c) {
+      return score[a] < score[c];
+    });
+
+    // Smallest tiles first, never past the target
+    auto target = static_cast<size_t>(
+        std::llround(options.sparsity * static_cast<double>(outputs * inputs)));
+    std::vector<u8> pruned(score.size(), 0);
+    size_t removed = 0;
+    for (size_t t : order) {
+      if (removed + count[t] > target) {
+        break;
+      }
+      pruned[t] = 1;
+      removed += count[t];
+    }
+
+    size_t offset = keep.size();
+    keep.resize(offset + params.size(), 1);
+    for (size_t o = 0; o < outputs; o++) {
+      for (size_t i = 0; i < inputs; i++) {
+        if (pruned[o / b * tile_cols + i / b]) {
+          size_t p = weight_index(inputs, o, i);
+          keep[offset + p] = 0;
+          params[p]->set_value(0.0);
+        }
+      }
+    }
+  }
+  return PruneMask(std::move(keep));
+}
+
+auto SparseMLP::convert(const MultiLayerPerceptron &mlp, SparseFormat format,
+                        size_t block) -> SparseMLP {
+  if (format == SparseFormat::Csr) {
+    block = 1;
+  } else if (block == 0) {
+    throw std::invalid_argument("BSR block must be positive");
+  }
+
+  SparseMLP model;
+  size_t inputs = mlp.num_inputs();
+  for (size_t l = 0; l < mlp.num_layers(); l++) {
+    std::vector<ValuePtr> params = mlp.layer(l).parameters();
+    SparseLayer layer;
+    layer.inputs = inputs;
+    layer.outputs = mlp.layer(l).size();
+    layer.format = format;
+    layer.block = block;
+    layer.activation = mlp.layer(l).activation();
+    layer.bias.resize(layer.outputs);
+    for (size_t o = 0; o < layer.outputs; o++) {
+      layer.bias[o] = params[weight_index(inputs, o, inputs)]->get_value();
+    }
+    auto weight = [&](size_t o, size_t i) {
+      return o < layer.outputs && i < inputs
+                 ? params[weight_index(inputs, o, i)]->get_value()
+                 : 0.0;
+    };
+
+    layer.row_begin.push_back(0);
+    size_t tile_rows = padded_outputs(layer) / block;
+    size_t tile_cols = padded_inputs(layer) / block;
+    for (size_t r = 0; r < tile_rows; r++) {
+      for (size_t c = 0; c < tile_cols; c++) {
+        size_t nonzeros = 0;
+        for (size_t i = c * block; i < (c + 1) * block; i++) {
+          for (size_t o = r * block; o < (r + 1) * block; o++) {
+            nonzeros += weight(o, i) != 0.0;
+          }
+        }
+        if (nonzeros == 0) {
+          continue;
+        }
+        layer.nonzeros += nonzeros;
+        layer.columns.push_back(static_cast<u32>(c));
+        for (size_t i = c * block; i < (c + 1) * block; i++) {
+          for (size_t o = r * block; o < (r + 1) * block; o++) {
+            layer.values.push_back(weight(o, i));
+          }
+        }
+      }
+      layer.row_begin.push_back(static_cast<u32>(layer.columns.size()));
+    }
+
+    model._max_width = std::max(
+        {model._max_width, padded_inputs(layer), padded_outputs(layer)});
+    inputs = layer.outputs;
+    model._layers.push_back(std::move(layer));
+  }
+  return model;
+}
+
+auto SparseMLP::workspace(size_t batch) const -> Workspace {
+  return Workspace(2 * _max_width * std::max<size_t>(batch, 1));
+}
+
+void SparseMLP::run(const double *inputs, double *outputs,
+                    Workspace &workspace, SparseKernel kernel) const {
+  if (workspace.size() < 2 * _max_width) {
+    throw std::invalid_argument("Workspace is too small for this model");
+  }
+  bool avx2 = kernel == SparseKernel::Avx2 ||
+              (kernel == SparseKernel::Auto && sparse_avx2_supported());
+  if (avx2 && !sparse_avx2_supported()) {
+    throw std::runtime_error("AVX2 kernel requested on a CPU without AVX2");
+  }
+
+  // Ping-pong buffers, zero past each layer's width so BSR edge tiles read
+  // zeros
+  double *current = workspace._buffer.data();
+  double *next = current + _max_width;
+  std::copy(inputs, inputs + num_inputs(), current);
+  std::fill(current + num_inputs(), current + _max_width, 0.0);
+
+  for (const SparseLayer &layer : _layers) {
+    const double *values = layer.values.data();
+    const u32 *columns = layer.columns.data();
+    size_t block = layer.block;
+
+    if (layer.format == SparseFormat::Csr) {
+      for (size_t o = 0; o < layer.outputs; o++) {
+        size_t begin = layer.row_begin[o];
+        size_t n = layer.row_begin[o + 1] - begin;
+#if MICROGRAD_HAVE_AVX2
+        double dot = avx2 ? csr_row_avx2(values + begin, columns + begin, n,
+                                         current)
+                          : csr_row_scalar(values + begin, columns + begin, n,
+                                           current);
+#else
+        double dot =
+            csr_row_scalar(values + begin, columns + begin, n, current);
+#endif
+        next[o] = dot + layer.bias[o];
+      }
+    } else {
+      size_t tile = block * block;
+      std::fill(next, next + padded_outputs(layer), 0.0);
+      for (size_t r = 0; r + 1 < layer.row_begin.size(); r++) {
+        double *acc = next + r * block;
+        for (size_t t = layer.row_begin[r]; t < layer.row_begin[r + 1]; t++) {
+          const double *x = current + columns[t] * block;
+#if MICROGRAD_HAVE_AVX2
+          if (avx2 && block % kLanes == 0) {
+            bsr_tile_avx2(values + t * tile, x, acc, block);
+            continue;
+          }
+#endif
+          bsr_tile_scalar(values + t * tile, x, acc, block);
+        }
+      }
+      for (size_t o = 0; o < layer.outputs; o++) {
+        next[o] += layer.bias[o];
+      }
+    }
+
+    for (size_t o = 0; o < layer.outputs; o++) {
+      next[o] = activate(layer.activation, next[o]);
+    }
+    std::fill(next + layer.outputs, next + _max_width, 0.0);
+    std::swap(current, next);
+  }
+  std::copy(current, current + num_outputs(), outputs);
+}
+
+void SparseMLP::run_batch(const double *inputs, size_t batch,
+                          double *outputs, Workspace &workspace,
+                          SparseKernel kernel) const {
+  // Activations are feature-major, row f holds feature f of every sample
+  size_t width = _max_width * batch;
+  if (workspace.size() < 2 * width) {
+    throw std::invalid_argument("Workspace is too small for this batch");
+  }
+  bool avx2 = kernel == SparseKernel::Avx2 ||
+              (kernel == SparseKernel::Auto && sparse_avx2_supported());
+  if (avx2 && !sparse_avx2_supported()) {
+    throw std::runtime_error("AVX2 kernel requested on a CPU without AVX2");
+  }
+  auto axpy = [avx2](double w, const double *x, double *y, size_t n) {
+#if MICROGRAD_HAVE_AVX2
+    if (avx2) {
+      axpy_avx2(w, x, y, n);
+      return;
+    }
+#endif
+    axpy_scalar(w, x, y, n);
+  };
+
+  double *current = workspace._buffer.data();
+  double *next = current + width;
+  size_t in = num_inputs();
+  for (size_t s = 0; s < batch; s++) {
+    for (size_t i = 0; i < in; i++) {
+      current[i * batch + s] = inputs[s * in + i];
+    }
+  }
+  std::fill(current + in * batch, current + width, 0.0);
+
+  for (const SparseLayer &layer : _layers) {
+    const double *values = layer.values.data();
+    const u32 *columns = layer.columns.data();
+    size_t block = layer.block;
+    size_t tile = block * block;
+
+    for (size_t o = 0; o < layer.outputs; o++) {
+      std::fill(next + o * batch, next + (o + 1) * batch, layer.bias[o]);
+    }
+    std::fill(next + layer.outputs * batch, next + width, 0.0);
+
+    // One stored weight, one contiguous row update
+    for (size_t r = 0; r + 1 < layer.row_begin.size(); r++) {
+      for (size_t t = layer.row_begin[r]; t < layer.row_begin[r + 1]; t++) {
+        const double *weights = values + t * tile;
+        for (size_t c = 0; c < block; c++) {
+          const double *x = current + (columns[t] * block + c) * batch;
+          for (size_t k = 0; k < block; k++) {
+            double w = weights[c * block + k];
+            if (w != 0.0) {
+              axpy(w, x, next + (r * block + k) * batch, batch);
+            }
+          }
+        }
+      }
+    }
+
+    for (size_t j = 0; j < layer.outputs * batch; j++) {
+      next[j] = activate(layer.activation, next[j]);
+    }
+    // Padding rows got no updates and still hold zeros
+    std::fill(next + layer.outputs * batch, next + width, 0.0);
+    std::swap(current, next);
+  }
+
+  size_t out = num_outputs();
+  for (size_t s = 0; s < batch; s++) {
+    for (size_t o = 0; o < out; o++) {
+      outputs[s * out + o] = current[o * batch + s];
+    }
+  }
+}
+
+auto SparseMLP::operator()(const std::vector<double> &inputs) const
+    -> std::vector<double> {
+  if (inputs.size() != num_inputs()) {
+    throw std::runtime_error("Input size mismatch");
+  }
+  std::vector<double> outputs(num_outputs());
+  Workspace scratch = workspace();
+  run(inputs.data(), outputs.data(), scratch);
+  return outputs;
+}
+
+auto SparseMLP::density() const -> double {
+  size_t nonzeros = 0;
+  size_t total = 0;
+  for (const SparseLayer &layer : _layers) {
+    nonzeros += layer.nonzeros;
+    total += layer.inputs * layer.outputs;
+  }
+  return total ? static_cast<double>(nonzeros) / static_cast<double>(total)
+               : 0.0;
+}
+
+auto SparseMLP::weight_bytes() const -> size_t {
+  size_t bytes = 0;
+  for (const SparseLayer &layer : _layers) {
+    bytes += layer.values.size() * sizeof(double) +
+             layer.columns.size() * sizeof(u32) +
+             layer.row_begin.size() * sizeof(u32);
+  }
+  return bytes;
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include "../Neuron.h"
+#include <vector>
+
+// Magnitude pruning of a MultiLayerPerceptron and a sparse copy of the
+// pruned model for inference.
+//
+//   PruneMask mask = magnitude_prune(mlp, {0.9});  // Zeroes 90% of weights
+//   ...fine-tune, calling mask.mask_gradients(mlp) after each backward...
+//   SparseMLP model = SparseMLP::convert(mlp);     // CSR, zeros dropped
+//   SparseMLP::Workspace ws = model.workspace(64); // One per thread
+//   model.run(x, y, ws);                           // One input
+//   model.run_batch(xs, 64, ys, ws);               // 64 inputs, row-major
+//
+// Pruning removes the smallest weights of each layer by magnitude. Biases
+// are never pruned. With PruneOptions::block = b the layer's weight matrix
+// (neurons x inputs) is cut into b x b tiles and whole tiles go by their
+// mean magnitude, which suits the BSR format.
+//
+// CSR keeps the nonzeros of each neuron's row with their input indices.
+// BSR keeps the b x b tiles that hold any nonzero as dense blocks with a
+// tile column index, so one index serves b * b weights. Tiles are stored
+// column by column: a column times one input updates b outputs at once,
+// which the AVX2 kernel does four at a time without horizontal sums.
+// Partial tiles at the edges are zero padded.
+//
+// A single input is a sparse matrix-vector product per layer. A batch is
+// transposed to inputs x batch first, so each stored weight w at (o, i)
+// becomes one contiguous y[o][:] += w * x[i][:] across the batch, which the
+// AVX2 kernel runs four lanes at a time.
+
+enum class SparseFormat : u8 { Csr, Bsr };
+
+enum class SparseKernel : u8 { Auto, Scalar, Avx2 };
+
+// * Whether this build and CPU can run SparseKernel::Avx2
+auto sparse_avx2_supported() -> bool;
+
+struct PruneOptions {
+  double sparsity = 0.9; // Fraction of each layer's weights set to zero
+  size_t block = 1;      // Tile side, 1 prunes single weights
+};
+
+// Which weights pruning kept, one entry per MultiLayerPerceptron parameter
+// in parameters() order. Biases are always kept.
+class PruneMask {
+public:
+  explicit PruneMask(std::vector<u8> keep) : _keep(std::move(keep)) {}
+
+  // * Zeroes the pruned weights' gradients. Call between backward and the
+  // * optimizer step so plain SGD leaves them at zero.
+  void mask_gradients(const MultiLayerPerceptron &mlp) const;
+
+  // * Zeroes the pruned weights, for optimizers that move them anyway
+  void apply(const MultiLayerPerceptron &mlp) const;
+
+  auto keep() const -> const std::vector<u8> & { return _keep; }
+  auto kept() const -> size_t;
+
+private:
+  std::vector<u8> _keep;
+};
+
+// * Zeroes the smallest weights of every layer in place and returns the
+// * mask. Throws std::invalid_argument for a sparsity outside [0, 1] or a
+// * zero block.
+auto magnitude_prune(MultiLayerPerceptron &mlp, PruneOptions options = {})
+    -> PruneMask;
+
+struct SparseLayer {
+  size_t inputs = 0;
+  size_t outputs = 0;
+  SparseFormat format = SparseFormat::Csr;
+  size_t block = 1; // BSR tile side
+
+  // CSR: row o's entries at [row_begin[o], row_begin[o + 1]). BSR: tile
+  // row r's tiles, each block * block values column-major.
+  std::vector<u32> row_begin;
+  std::vector<u32> columns; // Input index (CSR) or tile column (BSR)
+  std::vector<double> values;
+
+  std::vector<double> bias;
+  Activation activation = Activation::Relu;
+
+  // * Nonzero weights, stored padding excluded
+  size_t nonzeros = 0;
+};
+
+class SparseMLP {
+public:
+  // Activation buffers for one thread's calls to run() and run_batch()
+  class Workspace {
+  public:
+    auto size() const -> size_t { return _buffer.size(); }
+
+  private:
+    friend class SparseMLP;
+    explicit Workspace(size_t doubles) : _buffer(doubles, 0.0) {}
+    std::vector<double> _buffer;
+  };
+
+  // * Drops every zero weight of mlp. Throws std::invalid_argument for BSR
+  // * with a zero block.
+  static auto convert(const MultiLayerPerceptron &mlp,
+                      SparseFormat format = SparseFormat::Csr,
+                      size_t block = 4) -> SparseMLP;
+
+  // * A workspace for batches of up to `batch` inputs. Allocates; make one
+  // * per thread up front.
+  auto workspace(size_t batch = 1) const -> Workspace;
+
+  // * Reads num_inputs() and writes num_outputs() values. Thread-safe for
+  // * distinct workspaces. Throws std::invalid_argument for a workspace too
+  // * small for the model and std::runtime_error for SparseKernel::Avx2
+  // * without AVX2.
+  void run(const double *inputs, double *outputs, Workspace &workspace,
+           SparseKernel kernel = SparseKernel::Auto) const;
+
+  // * `batch` inputs and outputs, one row each. The workspace must come from
+  // * workspace(n) with n >= batch.
+  void run_batch(const double *inputs, size_t batch, double *outputs,
+                 Workspace &workspace,
+                 SparseKernel kernel = SparseKernel::Auto) const;
+
+  // * One input with a workspace of its own
+  auto operator()(const std::vector<double> &inputs) const
+      -> std::vector<double>;
+
+  auto num_inputs() const -> size_t { return _layers.front().inputs; }
+  auto num_outputs() const -> size_t { return _layers.back().outputs; }
+  auto layers() const -> const std::vector<SparseLayer> & { return _layers; }
+
+  // * Nonzero weights over all weights, biases excluded
+  auto density() const -> double;
+
+  // * Bytes of stored values and indices
+  auto weight_bytes() const -> size_t;
+
+private:
+  std::vector<SparseLayer> _layers;
+  size_t _max_width = 0;
+};
@@ -0,0 +1,365 @@
+#include "Autotune.hpp"
+#include "../Shared/clock.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <set>
+#include <sstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TUNE_HAVE_FLOCK 1
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define TUNE_HAVE_FLOCK 0
+#endif
+
+namespace {
+
+constexpr const char *kCacheHeader = "# micrograd GEMM tuning v1";
+
+auto next_power_of_two(size_t value) -> size_t {
+  size_t power = 1;
+  while (power < value) {
+    power *= 2;
+  }
+  return power;
+}
+
+auto default_cache_file() -> std::filesystem::path {
+  const char *env = std::getenv("MICROGRAD_TUNE_CACHE");
+  if (env && *env) {
+    return env;
+  }
+  const char *home = std::getenv("HOME");
+  std::filesystem::path base =
+      home && *home ? std::filesystem::path(home) / ".cache"
+                    : std::filesystem::temp_directory_path();
+  return base / "micrograd" / "gemm_tuning.tsv";
+}
+
+struct CacheLine {
+  std::string cpu;
+  std::string shape_class;
+  GemmBlocking blocking;
+};
+
+auto read_cache(const std::filesystem::path &path) -> std::vector<CacheLine> {
+  std::vector<CacheLine> lines;
+  std::ifstream in(path);
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    size_t first = line.find('\t');
+    size_t second = line.find('\t', first + 1);
+    if (first == std::string::npos || second == std::string::npos) {
+      continue;
+    }
+    CacheLine entry;
+    entry.cpu = line.substr(0, first);
+    entry.shape_class = line.substr(first + 1, second - first - 1);
+    std::istringstream fields(line.substr(second + 1));
+    GemmBlocking &b = entry.blocking;
+    if (fields >> b.mc >> b.nc >> b.kc >> b.mr >> b.nr) {
+      lines.push_back(entry);
+    }
+  }
+  return lines;
+}
+
+// Whether gemm() accepts the blocking on this build. A line written by a
+// build with other micro-kernels, or edited by hand, may not be.
+auto usable(const GemmBlocking &b) -> bool {
+  if (b.mc == 0 || b.nc == 0 || b.kc == 0) {
+    return false;
+  }
+  const auto &tiles = gemm_micro_tiles();
+  return std::find(tiles.begin(), tiles.end(), std::pair{b.mr, b.nr}) !=
+         tiles.end();
+}
+
+// Exclusive lock on <cache>.lock for as long as it lives, so processes
+// tuning at once take turns merging into the cache
+class CacheLock {
+public:
+  explicit CacheLock(const std::filesystem::path &path) {
+#if TUNE_HAVE_FLOCK
+    std::filesystem::path lock = path;
+    lock += ".lock";
+    _fd = ::open(lock.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (_fd >= 0) {
+      ::flock(_fd, LOCK_EX);
+    }
+#else
+    (void)path;
+#endif
+  }
+  ~CacheLock() {
+#if TUNE_HAVE_FLOCK
+    if (_fd >= 0) {
+      ::close(_fd); // Releases the lock
+    }
+#endif
+  }
+  CacheLock(const CacheLock &) = delete;
+  CacheLock &operator=(const CacheLock &) = delete;
+
+private:
+  int _fd = -1;
+};
+
+// A fresh file next to `path` that no other writer is using
+auto unique_temp(const std::filesystem::path &path) -> std::filesystem::path {
+  std::string name = path.string() + ".XXXXXX";
+#if TUNE_HAVE_FLOCK
+  int fd = ::mkstemp(name.data());
+  if (fd < 0) {
+    return {};
+  }
+  ::fchmod(fd, 0644); // mkstemp makes it 0600, the cache is shared
+  ::close(fd);
+  return name;
+#else
+  static std::atomic<u64> counter{0};
+  return path.string() + "." + std::to_string(counter++) + ".tmp";
+#endif
+}
+
+// Merges `tuned` into the cache as it is now, not as it was before tuning,
+// so classes other processes wrote meanwhile survive. The whole file goes to
+// a temporary name and is renamed over the old one, so readers never see
+// half a file.
+void update_cache(const std::filesystem::path &path, const std::string &cpu,
+                  const std::map<std::string, GemmBlocking> &tuned) {
+  std::error_code error;
+  if (path.has_parent_path()) {
+    std::filesystem::create_directories(path.parent_path(), error);
+  }
+  CacheLock lock(path);
+
+  std::vector<CacheLine> lines;
+  for (const CacheLine &line : read_cache(path)) {
+    if (line.cpu != cpu || !tuned.count(line.shape_class)) {
+      lines.push_back(line);
+    }
+  }
+  for (const auto &[name, blocking] : tuned) {
+    lines.push_back({cpu, name, blocking});
+  }
+
+  std::filesystem::path temp = unique_temp(path);
+  if (temp.empty()) {
+    return;
+  }
+  {
+    std::ofstream out(temp);
+    out << kCacheHeader << "\n";
+    for (const CacheLine &line : lines) {
+      out << line.cpu << "\t" << line.shape_class << "\t"
+          << to_string(line.blocking) << "\n";
+    }
+    if (!out) {
+      std::filesystem::remove(temp, error);
+      return;
+    }
+  }
+  std::filesystem::rename(temp, path, error);
+  if (error) {
+    std::filesystem::remove(temp, error);
+  }
+}
+
+auto round_up(size_t value, size_t multiple) -> size_t {
+  return (value + multiple - 1) / multiple * multiple;
+}
+
+// What gemm() actually runs for this shape, so candidates that only differ
+// beyond the problem's size are timed once
+auto effective(const GemmBlocking &b, const GemmShape &shape)
+    -> GemmBlocking {
+  return {round_up(std::min(b.mc, shape.m), b.mr),
+          round_up(std::min(b.nc, shape.n), b.nr), std::min(b.kc, shape.k),
+          b.mr, b.nr};
+}
+
+auto fastest(const GemmShape &shape, const std::vector<GemmBlocking> &grid,
+             double seconds_per_candidate) -> GemmBlocking {
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+  std::vector<double> a(shape.m * shape.k);
+  std::vector<double> b(shape.k * shape.n);
+  std::vector<double> c(shape.m * shape.n);
+  for (double &x : a) {
+    x = uniform(gen);
+  }
+  for (double &x : b) {
+    x = uniform(gen);
+  }
+  MatrixView va{a.data(), shape.k, 1};
+  MatrixView vb{b.data(), shape.n, 1};
+
+  std::set<std::string> timed;
+  GemmBlocking best = grid.front();
+  double best_seconds = -1.0;
+  for (const GemmBlocking &candidate : grid) {
+    if (!timed.insert(to_string(effective(candidate, shape))).second) {
+      continue;
+    }
+    // Warm up the packing buffers and caches first
+    gemm(shape.m, shape.n, shape.k, va, vb, c.data(), shape.n, candidate);
+    size_t runs = 0;
+    auto start = Clock::now();
+    double elapsed = 0.0;
+    do {
+      gemm(shape.m, shape.n, shape.k, va, vb, c.data(), shape.n, candidate);
+      runs++;
+      elapsed = seconds_since(start);
+    } while (elapsed < seconds_per_candidate);
+    double per_run = elapsed / runs;
+    if (best_seconds < 0.0 || per_run < best_seconds) {
+      best_seconds = per_run;
+      best = candidate;
+    }
+  }
+  return best;
+}
+
+} // namespace
+
+auto shape_class(const GemmShape &shape) -> std::string {
+  return std::to_string(next_power_of_two(shape.m)) + "x" +
+         std::to_string(next_power_of_two(shape.n)) + "x" +
+         std::to_string(next_power_of_two(shape.k));
+}
+
+auto mlp_gemm_shapes(const ModelShape &shape, size_t batch)
+    -> std::vector<GemmShape> {
+  std::vector<GemmShape> shapes;
+  size_t inputs = shape.inputs;
+  for (size_t outputs : shape.layer_sizes) {
+    shapes.push_back({batch, outputs, inputs});
+    inputs = outputs;
+  }
+  return shapes;
+}
+
+auto cpu_model() -> std::string {
+  std::ifstream in("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.rfind("model name", 0) == 0) {
+      size_t colon = line.find(':');
+      if (colon != std::string::npos) {
+        std::string model = line.substr(colon + 1);
+        model.erase(0, model.find_first_not_of(' '));
+        std::replace(model.begin(), model.end(), '\t', ' ');
+        return model;
+      }
+    }
+  }
+  return "unknown";
+}
+
+auto default_gemm_candidates() -> std::vector<GemmBlocking> {
+  std::vector<GemmBlocking> grid;
+  for (auto [mr, nr] : gemm_micro_tiles()) {
+    for (size_t mc : {32, 64, 128, 256}) {
+      for (size_t nc : {64, 256, 1024}) {
+        for (size_t kc : {64, 128, 256}) {
+          grid.push_back({mc, nc, kc, mr, nr});
+        }
+      }
+    }
+  }
+  return grid;
+}
+
+auto GemmTuner::tune(const std::vector<GemmShape> &shapes,
+                     const TuneOptions &options) -> TuneReport {
+  auto start = Clock::now();
+  TuneReport report;
+  report.cpu_model = cpu_model();
+  report.cache_file = options.cache_file.empty() ? default_cache_file()
+                                                 : options.cache_file;
+
+  // First shape of each class stands for it
+  std::map<std::string, GemmShape> classes;
+  for (const GemmShape &shape : shapes) {
+    if (shape.m && shape.n && shape.k) {
+      classes.emplace(shape_class(shape), shape);
+    }
+  }
+  report.classes = classes.size();
+
+  std::map<std::string, GemmBlocking> found;
+  for (const CacheLine &line : read_cache(report.cache_file)) {
+    // An unusable entry counts as missing, so the class is re-tuned and
+    // its line overwritten
+    if (line.cpu == report.cpu_model && usable(line.blocking)) {
+      found[line.shape_class] = line.blocking;
+    }
+  }
+
+  std::vector<GemmBlocking> grid = options.candidates.empty()
+                                       ? default_gemm_candidates()
+                                       : options.candidates;
+  std::map<std::string, GemmBlocking> tuned;
+  std::map<std::string, GemmBlocking> result;
+  for (const auto &[name, shape] : classes) {
+    auto cached = found.find(name);
+    if (!options.force && cached != found.end()) {
+      result[name] = cached->second;
+      report.cached++;
+    } else {
+      tuned[name] = fastest(shape, grid, options.seconds_per_candidate);
+      result[name] = tuned[name];
+      report.tuned++;
+    }
+  }
+
+  if (!tuned.empty()) {
+    update_cache(report.cache_file, report.cpu_model, tuned);
+  }
+
+  {
+    std::unique_lock lock(_mutex);
+    for (const auto &[name, blocking] : result) {
+      _blocking[name] = blocking;
+    }
+  }
+  report.seconds = seconds_since(start);
+  return report;
+}
+
+auto GemmTuner::blocking(const GemmShape &shape) const -> GemmBlocking {
+  std::shared_lock lock(_mutex);
+  auto found = _blocking.find(shape_class(shape));
+  return found == _blocking.end() ? GemmBlocking() : found->second;
+}
+
+auto GemmTuner::entries() const -> std::map<std::string, GemmBlocking> {
+  std::shared_lock lock(_mutex);
+  return _blocking;
+}
+
+void GemmTuner::clear() {
+  std::unique_lock lock(_mutex);
+  _blocking.clear();
+}
+
+auto gemm_tuner() -> GemmTuner & {
+  static GemmTuner tuner;
+  return tuner;
+}
+
+auto autotune_gemm(const ModelShape &shape, size_t batch,
+                   const TuneOptions &options) -> TuneReport {
+  return gemm_tuner().tune(mlp_gemm_shapes(shape, batch), options);
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "../Model/Format.hpp"
+#include "Gemm.hpp"
+#include <filesystem>
+#include <map>
+#include <shared_mutex>
+
+// Startup autotuning of GEMM block sizes for the shapes a model runs.
+//
+//   TuneReport report = autotune_gemm(mlp.shape(), 32);
+//   matmul(a, b); // Uses the blocking tuned for a's and b's shape class
+//
+// Shapes fall into classes by rounding m, n and k up to powers of two. For
+// each class the tuner times a grid of MC/NC/KC and micro-tile choices on
+// the actual shape and keeps the fastest. Results go to a text cache file
+// keyed by CPU model, one line per class:
+//
+//   <cpu model> TAB <m>x<n>x<k> TAB <mc> <nc> <kc> <mr> <nr>
+//
+// Later runs on the same CPU model read the cache and time nothing. Hosts
+// with other CPUs can share the file, since each reads only its own lines.
+// A line gemm() would reject, a zero block size or a micro-tile this build
+// lacks, counts as missing and is re-tuned.
+// A writer holds <cache>.lock while it merges its classes into the file as
+// it is at that moment, so processes tuning at once keep each other's lines.
+// TuneOptions::force re-times every class and overwrites its lines.
+
+struct GemmShape {
+  size_t m = 0;
+  size_t n = 0;
+  size_t k = 0;
+};
+
+// * "<m>x<n>x<k>" with every dimension rounded up to a power of two
+auto shape_class(const GemmShape &shape) -> std::string;
+
+// * One [batch, inputs] x [inputs, outputs] product per layer of the model
+auto mlp_gemm_shapes(const ModelShape &shape, size_t batch)
+    -> std::vector<GemmShape>;
+
+// * The "model name" of /proc/cpuinfo, or "unknown"
+auto cpu_model() -> std::string;
+
+struct TuneOptions {
+  // Empty means $MICROGRAD_TUNE_CACHE, else
+  // $HOME/.cache/micrograd/gemm_tuning.tsv
+  std::filesystem::path cache_file;
+  bool force = false; // Re-time classes the cache already has
+  // Empty means the default grid over every micro-tile
+  std::vector<GemmBlocking> candidates;
+  double seconds_per_candidate = 0.002; // Repeats until this much has run
+};
+
+struct TuneReport {
+  std::string cpu_model;
+  std::filesystem::path cache_file;
+  size_t classes = 0;
+  size_t tuned = 0;  // Classes timed on this run
+  size_t cached = 0; // Classes read from the cache
+  double seconds = 0.0;
+};
+
+// Blocking per shape class, thread-safe
+class GemmTuner {
+public:
+  // * Loads cached classes and times the rest. Never throws for an
+  // * unreadable or unwritable cache, tuning then just is not persisted.
+  auto tune(const std::vector<GemmShape> &shapes,
+            const TuneOptions &options = TuneOptions()) -> TuneReport;
+
+  // * The tuned blocking for the shape's class, else the default
+  auto blocking(const GemmShape &shape) const -> GemmBlocking;
+
+  auto entries() const -> std::map<std::string, GemmBlocking>;
+  void clear();
+
+private:
+  mutable std::shared_mutex _mutex;
+  std::map<std::string, GemmBlocking> _blocking;
+};
+
+// * The tuner matmul() reads
+auto gemm_tuner() -> GemmTuner &;
+
+// * gemm_tuner().tune(mlp_gemm_shapes(shape, batch), options)
+auto autotune_gemm(const ModelShape &shape, size_t batch,
+                   const TuneOptions &options = TuneOptions()) -> TuneReport;
+
+// * The grid tune() times when TuneOptions::candidates is empty
+auto default_gemm_candidates() -> std::vector<GemmBlocking>;
@@ -0,0 +1,343 @@
+#include "Conv.hpp"
+#include "../Random/Philox.hpp"
+#include "Autotune.hpp"
+#include "Gemm.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+auto pooled_size(size_t size, size_t kernel, size_t stride) -> size_t {
+  return size < kernel ? 0 : (size - kernel) / stride + 1;
+}
+
+// [N, C, H, W] or throws
+void check_images(const Tensor &input, const char *layer) {
+  if (input.rank() != 4) {
+    throw std::invalid_argument(std::string(layer) +
+                                " needs [batch, channels, height, width]");
+  }
+}
+
+} // namespace
+
+auto ConvGeometry::out_height() const -> size_t {
+  size_t span = options.dilation * (kernel - 1) + 1;
+  return pooled_size(height + 2 * options.padding, span, options.stride);
+}
+
+auto ConvGeometry::out_width() const -> size_t {
+  size_t span = options.dilation * (kernel - 1) + 1;
+  return pooled_size(width + 2 * options.padding, span, options.stride);
+}
+
+void im2col(const double *image, const ConvGeometry &g, double *cols) {
+  size_t out_height = g.out_height();
+  size_t out_width = g.out_width();
+  const Conv2DOptions &o = g.options;
+  for (size_t c = 0; c < g.channels; c++) {
+    const double *plane = image + c * g.height * g.width;
+    for (size_t ky = 0; ky < g.kernel; ky++) {
+      for (size_t kx = 0; kx < g.kernel; kx++) {
+        for (size_t oy = 0; oy < out_height; oy++) {
+          // Unsigned wrap-around makes every padded coordinate >= size
+          size_t iy = oy * o.stride + ky * o.dilation - o.padding;
+          if (iy >= g.height) {
+            std::fill_n(cols, out_width, 0.0);
+            cols += out_width;
+            continue;
+          }
+          const double *row = plane + iy * g.width;
+          for (size_t ox = 0; ox < out_width; ox++) {
+            size_t ix = ox * o.stride + kx * o.dilation - o.padding;
+            *cols++ = ix < g.width ? row[ix] : 0.0;
+          }
+        }
+      }
+    }
+  }
+}
+
+void col2im(const double *cols, const ConvGeometry &g, double *image) {
+  size_t out_height = g.out_height();
+  size_t out_width = g.out_width();
+  const Conv2DOptions &o = g.options;
+  for (size_t c = 0; c < g.channels; c++) {
+    double *plane = image + c * g.height * g.width;
+    for (size_t ky = 0; ky < g.kernel; ky++) {
+      for (size_t kx = 0; kx < g.kernel; kx++) {
+        for (size_t oy = 0; oy < out_height; oy++) {
+          size_t iy = oy * o.stride + ky * o.dilation - o.padding;
+          if (iy >= g.height) {
+            cols += out_width;
+            continue;
+          }
+          double *row = plane + iy * g.width;
+          for (size_t ox = 0; ox < out_width; ox++, cols++) {
+            size_t ix = ox * o.stride + kx * o.dilation - o.padding;
+            if (ix < g.width) {
+              row[ix] += *cols;
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+Conv2D::Conv2D(size_t in_channels, size_t out_channels, size_t kernel,
+               Conv2DOptions options, u64 seed)
+    : _in_channels(in_channels), _out_channels(out_channels),
+      _kernel(kernel), _options(options),
+      _weights({out_channels, in_channels, kernel, kernel}),
+      _bias({out_channels}),
+      _weight_gradient({out_channels, in_channels, kernel, kernel}),
+      _bias_gradient({out_channels}), _workspace(KB(64)) {
+  if (in_channels == 0 || out_channels == 0 || kernel == 0 ||
+      options.stride == 0 || options.dilation == 0) {
+    throw std::invalid_argument("Conv2D sizes, stride and dilation must be "
+                                "positive");
+  }
+  _workspace.enable_adaptive();
+
+  double bound = std::sqrt(6.0 / static_cast<double>(in_channels * kernel *
+                                                      kernel));
+  philox::Key key = philox::key(seed);
+  for (size_t i = 0; i < _weights.size(); i++) {
+    philox::Counter words = philox::generate(
+        philox::Counter{static_cast<u32>(i), static_cast<u32>(i >> 32), 0,
+                        0xC0417u},
+        key);
+    _weights.data()[i] = bound * (2.0 * philox::unit(words[0], words[1]) -
+                                  1.0);
+  }
+}
+
+auto Conv2D::geometry(size_t height, size_t width) const -> ConvGeometry {
+  return ConvGeometry{_in_channels, height, width, _kernel, _options};
+}
+
+auto Conv2D::forward(const Tensor &input) -> Tensor {
+  check_images(input, "Conv2D");
+  if (input.dim(1) != _in_channels) {
+    throw std::invalid_argument("Conv2D input has the wrong channel count");
+  }
+  ConvGeometry g = geometry(input.dim(2), input.dim(3));
+  size_t rows = g.rows();
+  size_t columns = g.columns();
+  if (columns == 0) {
+    throw std::invalid_argument("Conv2D kernel does not fit the image");
+  }
+
+  size_t batch = input.dim(0);
+  size_t image_size = _in_channels * g.height * g.width;
+  Tensor output({batch, _out_channels, g.out_height(), g.out_width()});
+  GemmBlocking blocking =
+      gemm_tuner().blocking(GemmShape{_out_channels, columns, rows});
+  double *cols = _workspace.push_array<double>(rows * columns, ARENA_SITE);
+  for (size_t n = 0; n < batch; n++) {
+    im2col(input.data() + n * image_size, g, cols);
+    double *out = output.data() + n * _out_channels * columns;
+    gemm(_out_channels, columns, rows, {_weights.data(), rows, 1},
+         {cols, columns, 1}, out, columns, blocking);
+    for (size_t o = 0; o < _out_channels; o++) {
+      double bias = _bias.data()[o];
+      for (size_t p = 0; p < columns; p++) {
+        out[o * columns + p] += bias;
+      }
+    }
+  }
+  _workspace.end_iteration();
+  _input = input;
+  return output;
+}
+
+auto Conv2D::backward(const Tensor &grad_output) -> Tensor {
+  if (_input.rank() != 4) {
+    throw std::invalid_argument("Conv2D backward needs a forward first");
+  }
+  ConvGeometry g = geometry(_input.dim(2), _input.dim(3));
+  size_t rows = g.rows();
+  size_t columns = g.columns();
+  size_t batch = _input.dim(0);
+  if (grad_output.shape() !=
+      std::vector<size_t>{batch, _out_channels, g.out_height(),
+                          g.out_width()}) {
+    throw std::invalid_argument("Conv2D gradient does not match the output");
+  }
+
+  size_t image_size = _in_channels * g.height * g.width;
+  Tensor grad_input(_input.shape());
+  double *dw = _weight_gradient.data();
+  double *db = _bias_gradient.data();
+  std::fill_n(dw, _weight_gradient.size(), 0.0);
+  std::fill_n(db, _bias_gradient.size(), 0.0);
+
+  GemmBlocking weight_blocking =
+      gemm_tuner().blocking(GemmShape{_out_channels, rows, columns});
+  GemmBlocking input_blocking =
+      gemm_tuner().blocking(GemmShape{rows, columns, _out_channels});
+  double *cols = _workspace.push_array<double>(rows * columns, ARENA_SITE);
+  double *grad_cols =
+      _workspace.push_array<double>(rows * columns, ARENA_SITE);
+  for (size_t n = 0; n < batch; n++) {
+    const double *dout = grad_output.data() + n * _out_channels * columns;
+    im2col(_input.data() + n * image_size, g, cols);
+    // dW += dout x cols^T, the transpose read through strides
+    gemm(_out_channels, rows, columns, {dout, columns, 1}, {cols, 1, columns},
+         dw, rows, weight_blocking, true);
+    for (size_t o = 0; o < _out_channels; o++) {
+      for (size_t p = 0; p < columns; p++) {
+        db[o] += dout[o * columns + p];
+      }
+    }
+    // dcols = W^T x dout
+    gemm(rows, columns, _out_channels, {_weights.data(), 1, rows},
+         {dout, columns, 1}, grad_cols, columns, input_blocking);
+    col2im(grad_cols, g, grad_input.data() + n * image_size);
+  }
+  _workspace.end_iteration();
+  return grad_input;
+}
+
+MaxPool2D::MaxPool2D(size_t kernel, size_t stride)
+    : _kernel(kernel), _stride(stride ? stride : kernel) {
+  if (kernel == 0) {
+    throw std::invalid_argument("MaxPool2D kernel must be positive");
+  }
+}
+
+auto MaxPool2D::forward(const Tensor &input) -> Tensor {
+  check_images(input, "MaxPool2D");
+  size_t planes = input.dim(0) * input.dim(1);
+  size_t height = input.dim(2);
+  size_t width = input.dim(3);
+  size_t out_height = pooled_size(height, _kernel, _stride);
+  size_t out_width = pooled_size(width, _kernel, _stride);
+  if (out_height == 0 || out_width == 0) {
+    throw std::invalid_argument("MaxPool2D window does not fit the image");
+  }
+
+  Tensor output({input.dim(0), input.dim(1), out_height, out_width});
+  _input_shape = input.shape();
+  _argmax.resize(output.size());
+  double *out = output.data();
+  u32 *argmax = _argmax.data();
+  for (size_t plane = 0; plane < planes; plane++) {
+    const double *in = input.data() + plane * height * width;
+    for (size_t oy = 0; oy < out_height; oy++) {
+      for (size_t ox = 0; ox < out_width; ox++) {
+        size_t best = oy * _stride * width + ox * _stride;
+        for (size_t ky = 0; ky < _kernel; ky++) {
+          for (size_t kx = 0; kx < _kernel; kx++) {
+            size_t at = (oy * _stride + ky) * width + ox * _stride + kx;
+            if (in[at] > in[best]) {
+              best = at;
+            }
+          }
+        }
+        *out++ = in[best];
+        *argmax++ = static_cast<u32>(best);
+      }
+    }
+  }
+  return output;
+}
+
+auto MaxPool2D::backward(const Tensor &grad_output) -> Tensor {
+  if (_input_shape.size() != 4) {
+    throw std::invalid_argument("MaxPool2D backward needs a forward first");
+  }
+  if (grad_output.shape() !=
+      std::vector<size_t>{_input_shape[0], _input_shape[1],
+                          pooled_size(_input_shape[2], _kernel, _stride),
+                          pooled_size(_input_shape[3], _kernel, _stride)}) {
+    throw std::invalid_argument("MaxPool2D gradient does not match the "
+                                "output");
+  }
+  Tensor grad_input(_input_shape);
+  size_t plane_size = _input_shape[2] * _input_shape[3];
+  size_t outputs = grad_output.size() / (_input_shape[0] * _input_shape[1]);
+  for (size_t i = 0; i < grad_output.size(); i++) {
+    grad_input.data()[(i / outputs) * plane_size + _argmax[i]] +=
+        grad_output.data()[i];
+  }
+  return grad_input;
+}
+
+AvgPool2D::AvgPool2D(size_t kernel, size_t stride)
+    : _kernel(kernel), _stride(stride ? stride : kernel) {
+  if (kernel == 0) {
+    throw std::invalid_argument("AvgPool2D kernel must be positive");
+  }
+}
+
+auto AvgPool2D::forward(const Tensor &input) -> Tensor {
+  check_images(input, "AvgPool2D");
+  size_t planes = input.dim(0) * input.dim(1);
+  size_t height = input.dim(2);
+  size_t width = input.dim(3);
+  size_t out_height = pooled_size(height, _kernel, _stride);
+  size_t out_width = pooled_size(width, _kernel, _stride);
+  if (out_height == 0 || out_width == 0) {
+    throw std::invalid_argument("AvgPool2D window does not fit the image");
+  }
+
+  Tensor output({input.dim(0), input.dim(1), out_height, out_width});
+  _input_shape = input.shape();
+  double scale = 1.0 / static_cast<double>(_kernel * _kernel);
+  double *out = output.data();
+  for (size_t plane = 0; plane < planes; plane++) {
+    const double *in = input.data() + plane * height * width;
+    for (size_t oy = 0; oy < out_height; oy++) {
+      for (size_t ox = 0; ox < out_width; ox++) {
+        double sum = 0.0;
+        for (size_t ky = 0; ky < _kernel; ky++) {
+          const double *row = in + (oy * _stride + ky) * width + ox * _stride;
+          for (size_t kx = 0; kx < _kernel; kx++) {
+            sum += row[kx];
+          }
+        }
+        *out++ = sum * scale;
+      }
+    }
+  }
+  return output;
+}
+
+auto AvgPool2D::backward(const Tensor &grad_output) -> Tensor {
+  if (_input_shape.size() != 4) {
+    throw std::invalid_argument("AvgPool2D backward needs a forward first");
+  }
+  if (grad_output.shape() !=
+      std::vector<size_t>{_input_shape[0], _input_shape[1],
+                          pooled_size(_input_shape[2], _kernel, _stride),
+                          pooled_size(_input_shape[3], _kernel, _stride)}) {
+    throw std::invalid_argument("AvgPool2D gradient does not match the "
+                                "output");
+  }
+  Tensor grad_input(_input_shape);
+  size_t planes = _input_shape[0] * _input_shape[1];
+  size_t height = _input_shape[2];
+  size_t width = _input_shape[3];
+  size_t out_height = grad_output.dim(2);
+  size_t out_width = grad_output.dim(3);
+  double scale = 1.0 / static_cast<double>(_kernel * _kernel);
+  const double *dout = grad_output.data();
+  for (size_t plane = 0; plane < planes; plane++) {
+    double *din = grad_input.data() + plane * height * width;
+    for (size_t oy = 0; oy < out_height; oy++) {
+      for (size_t ox = 0; ox < out_width; ox++) {
+        double share = *dout++ * scale;
+        for (size_t ky = 0; ky < _kernel; ky++) {
+          double *row = din + (oy * _stride + ky) * width + ox * _stride;
+          for (size_t kx = 0; kx < _kernel; kx++) {
+            row[kx] += share;
+          }
+        }
+      }
+    }
+  }
+  return grad_input;
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include "../Arena/Arena.hpp"
+#include "Tensor.h"
+#include <utility>
+
+// 2D convolution and pooling over [batch, channels, height, width] tensors.
+//
+// Conv2D lowers each image to a GEMM. im2col lays the receptive field of
+// every output pixel out as one column, so the convolution is
+//
+//   out[O, P]     = W[O, C*K*K] x cols[C*K*K, P]       P = out height * width
+//   dW[O, C*K*K] += dout[O, P] x cols^T
+//   dcols         = W^T x dout,  then col2im adds dcols back onto dinput
+//
+// all through the blocked gemm() with the blocking gemm_tuner() holds for
+// the shape. The columns of one image live in a scratch arena owned by the
+// layer. It sizes itself to the first call and is reused after that, so
+// steady-state forward and backward passes allocate only their results.
+//
+// Padding is zeros. A dilation d spreads the K taps of a kernel row d
+// pixels apart.
+
+struct Conv2DOptions {
+  size_t stride = 1;
+  size_t padding = 0;
+  size_t dilation = 1;
+};
+
+// Where a K x K kernel lands on one C x H x W image
+struct ConvGeometry {
+  size_t channels;
+  size_t height;
+  size_t width;
+  size_t kernel;
+  Conv2DOptions options;
+
+  // * 0 when the dilated kernel does not fit the padded image
+  auto out_height() const -> size_t;
+  auto out_width() const -> size_t;
+  auto rows() const -> size_t { return channels * kernel * kernel; }
+  auto columns() const -> size_t { return out_height() * out_width(); }
+};
+
+// * cols is rows() x columns() row-major, row (c * K + ky) * K + kx
+void im2col(const double *image, const ConvGeometry &geometry, double *cols);
+
+// * Adds every column entry back onto the image pixel it was read from
+void col2im(const double *cols, const ConvGeometry &geometry, double *image);
+
+class Conv2D {
+public:
+  // * Weights He-uniform from the seed, biases zero
+  Conv2D(size_t in_channels, size_t out_channels, size_t kernel,
+         Conv2DOptions options = {}, u64 seed = 0);
+
+  Conv2D(const Conv2D &) = delete;
+  Conv2D &operator=(const Conv2D &) = delete;
+
+  // * [N, C, H, W] -> [N, O, OH, OW], keeping the input for backward().
+  // * Throws std::invalid_argument for another rank or channel count, or
+  // * an image the kernel does not fit.
+  auto forward(const Tensor &input) -> Tensor;
+
+  // * Gradient of the last forward()'s input. Overwrites weight_gradient()
+  // * and bias_gradient().
+  auto backward(const Tensor &grad_output) -> Tensor;
+
+  // * [O, C, K, K] and [O]
+  auto weights() -> Tensor & { return _weights; }
+  auto bias() -> Tensor & { return _bias; }
+  auto weight_gradient() const -> const Tensor & { return _weight_gradient; }
+  auto bias_gradient() const -> const Tensor & { return _bias_gradient; }
+
+  auto geometry(size_t height, size_t width) const -> ConvGeometry;
+  auto workspace() const -> const MemoryArena & { return _workspace; }
+
+private:
+  size_t _in_channels;
+  size_t _out_channels;
+  size_t _kernel;
+  Conv2DOptions _options;
+  Tensor _weights;
+  Tensor _bias;
+  Tensor _weight_gradient;
+  Tensor _bias_gradient;
+  Tensor _input;
+  MemoryArena _workspace;
+};
+
+// Windows of kernel x kernel pixels every `stride` pixels, no padding
+class MaxPool2D {
+public:
+  // * stride 0 means stride = kernel
+  explicit MaxPool2D(size_t kernel, size_t stride = 0);
+
+  // * [N, C, H, W] -> [N, C, OH, OW], remembering each window's argmax
+  auto forward(const Tensor &input) -> Tensor;
+
+  // * Routes each output gradient to its window's first maximum
+  auto backward(const Tensor &grad_output) -> Tensor;
+
+private:
+  size_t _kernel;
+  size_t _stride;
+  std::vector<size_t> _input_shape;
+  std::vector<u32> _argmax; // Per output element, offset in its image plane
+};
+
+class AvgPool2D {
+public:
+  // * stride 0 means stride = kernel
+  explicit AvgPool2D(size_t kernel, size_t stride = 0);
+
+  auto forward(const Tensor &input) -> Tensor;
+
+  // * Spreads each output gradient evenly over its window
+  auto backward(const Tensor &grad_output) -> Tensor;
+
+private:
+  size_t _kernel;
+  size_t _stride;
+  std::vector<size_t> _input_shape;
+};
@@ -0,0 +1,165 @@
+#include "Gemm.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+using MicroKernel = void (*)(size_t kc, const double *a, const double *b,
+                             double *c, size_t ldc, size_t rows, size_t cols,
+                             bool accumulate);
+
+// One mr x nr tile of C from packed panels, a holding mr values and b nr
+// values per step of k. The fixed trip counts let the compiler keep acc in
+// registers. Edge tiles compute padding and store only rows x cols.
+template <size_t MR, size_t NR>
+void micro_kernel(size_t kc, const double *a, const double *b, double *c,
+                  size_t ldc, size_t rows, size_t cols, bool accumulate) {
+  double acc[MR][NR] = {};
+  for (size_t p = 0; p < kc; p++) {
+    for (size_t i = 0; i < MR; i++) {
+      for (size_t j = 0; j < NR; j++) {
+        acc[i][j] += a[i] * b[j];
+      }
+    }
+    a += MR;
+    b += NR;
+  }
+  for (size_t i = 0; i < rows; i++) {
+    for (size_t j = 0; j < cols; j++) {
+      c[i * ldc + j] = accumulate ? c[i * ldc + j] + acc[i][j] : acc[i][j];
+    }
+  }
+}
+
+struct Kernel {
+  size_t mr;
+  size_t nr;
+  MicroKernel function;
+};
+
+const Kernel kKernels[] = {
+    {2, 4, micro_kernel<2, 4>}, {4, 4, micro_kernel<4, 4>},
+    {4, 8, micro_kernel<4, 8>}, {8, 4, micro_kernel<8, 4>},
+    {6, 8, micro_kernel<6, 8>},
+};
+
+auto find_kernel(size_t mr, size_t nr) -> MicroKernel {
+  for (const Kernel &kernel : kKernels) {
+    if (kernel.mr == mr && kernel.nr == nr) {
+      return kernel.function;
+    }
+  }
+  return nullptr;
+}
+
+// rows x depth of A into panels of mr rows, zero padded, each panel laid
+// out step by step of k
+void pack_a(MatrixView a, size_t row, size_t rows, size_t col, size_t depth,
+            size_t mr, double *out) {
+  for (size_t panel = 0; panel < rows; panel += mr) {
+    size_t height = std::min(mr, rows - panel);
+    for (size_t p = 0; p < depth; p++) {
+      const double *src = a.data + (row + panel) * a.row_stride +
+                          (col + p) * a.col_stride;
+      for (size_t i = 0; i < height; i++) {
+        out[i] = src[i * a.row_stride];
+      }
+      std::fill(out + height, out + mr, 0.0);
+      out += mr;
+    }
+  }
+}
+
+// depth x cols of B into panels of nr columns
+void pack_b(MatrixView b, size_t row, size_t depth, size_t col, size_t cols,
+            size_t nr, double *out) {
+  for (size_t panel = 0; panel < cols; panel += nr) {
+    size_t width = std::min(nr, cols - panel);
+    for (size_t p = 0; p < depth; p++) {
+      const double *src = b.data + (row + p) * b.row_stride +
+                          (col + panel) * b.col_stride;
+      for (size_t j = 0; j < width; j++) {
+        out[j] = src[j * b.col_stride];
+      }
+      std::fill(out + width, out + nr, 0.0);
+      out += nr;
+    }
+  }
+}
+
+auto round_up(size_t value, size_t multiple) -> size_t {
+  return (value + multiple - 1) / multiple * multiple;
+}
+
+} // namespace
+
+auto to_string(const GemmBlocking &blocking) -> std::string {
+  return std::to_string(blocking.mc) + " " + std::to_string(blocking.nc) +
+         " " + std::to_string(blocking.kc) + " " +
+         std::to_string(blocking.mr) + " " + std::to_string(blocking.nr);
+}
+
+auto gemm_micro_tiles() -> const std::vector<std::pair<size_t, size_t>> & {
+  static const std::vector<std::pair<size_t, size_t>> tiles = [] {
+    std::vector<std::pair<size_t, size_t>> all;
+    for (const Kernel &kernel : kKernels) {
+      all.emplace_back(kernel.mr, kernel.nr);
+    }
+    return all;
+  }();
+  return tiles;
+}
+
+void gemm(size_t m, size_t n, size_t k, MatrixView a, MatrixView b, double *c,
+          size_t ldc, const GemmBlocking &blocking, bool accumulate) {
+  MicroKernel kernel = find_kernel(blocking.mr, blocking.nr);
+  if (!kernel) {
+    throw std::invalid_argument("No GEMM micro-kernel for " +
+                                std::to_string(blocking.mr) + "x" +
+                                std::to_string(blocking.nr));
+  }
+  if (blocking.mc == 0 || blocking.nc == 0 || blocking.kc == 0) {
+    throw std::invalid_argument("GEMM block sizes must be positive");
+  }
+  if (k == 0 && !accumulate) {
+    for (size_t i = 0; i < m; i++) {
+      std::fill(c + i * ldc, c + i * ldc + n, 0.0);
+    }
+  }
+
+  // Blocks are whole micro-tiles, and no larger than the problem
+  size_t mr = blocking.mr;
+  size_t nr = blocking.nr;
+  size_t mc = round_up(std::min(blocking.mc, m), mr);
+  size_t nc = round_up(std::min(blocking.nc, n), nr);
+  size_t kc = std::min(blocking.kc, k);
+
+  // Reused by every call on the thread
+  thread_local std::vector<double> packed_a;
+  thread_local std::vector<double> packed_b;
+  packed_a.resize(std::max(packed_a.size(), mc * kc));
+  packed_b.resize(std::max(packed_b.size(), kc * nc));
+
+  for (size_t jc = 0; jc < n; jc += nc) {
+    size_t cols = std::min(nc, n - jc);
+    for (size_t pc = 0; pc < k; pc += kc) {
+      size_t depth = std::min(kc, k - pc);
+      bool add = accumulate || pc > 0;
+      pack_b(b, pc, depth, jc, cols, nr, packed_b.data());
+
+      for (size_t ic = 0; ic < m; ic += mc) {
+        size_t rows = std::min(mc, m - ic);
+        pack_a(a, ic, rows, pc, depth, mr, packed_a.data());
+
+        for (size_t jr = 0; jr < cols; jr += nr) {
+          const double *panel_b = packed_b.data() + jr * depth;
+          for (size_t ir = 0; ir < rows; ir += mr) {
+            kernel(depth, packed_a.data() + ir * depth, panel_b,
+                   c + (ic + ir) * ldc + jc + jr, ldc,
+                   std::min(mr, rows - ir), std::min(nr, cols - jr), add);
+          }
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "../Shared/types.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Blocked double precision GEMM, C = A * B (or C += A * B), in the usual
+// three level scheme:
+//
+//   for jc in n by nc        B panel kc x nc packed once, stays in L3
+//     for pc in k by kc
+//       for ic in m by mc    A block mc x kc packed once, stays in L2
+//         for jr, ir         mr x nr micro-tile of C kept in registers
+//
+// A and B are read through row and column strides, so a transposed operand
+// costs nothing beyond the packing every block pays anyway. The best block
+// sizes depend on the host's caches, see Autotune.hpp.
+
+struct GemmBlocking {
+  size_t mc = 64;
+  size_t nc = 256;
+  size_t kc = 128;
+  size_t mr = 4;
+  size_t nr = 4;
+
+  bool operator==(const GemmBlocking &other) const {
+    return mc == other.mc && nc == other.nc && kc == other.kc &&
+           mr == other.mr && nr == other.nr;
+  }
+  bool operator!=(const GemmBlocking &other) const {
+    return !(*this == other);
+  }
+};
+
+// * "mc nc kc mr nr", as the tuning cache stores it
+auto to_string(const GemmBlocking &blocking) -> std::string;
+
+// Element (i, j) at data[i * row_stride + j * col_stride]
+struct MatrixView {
+  const double *data;
+  size_t row_stride;
+  size_t col_stride;
+};
+
+// * Micro-tiles the kernel is instantiated for, as {mr, nr} pairs
+auto gemm_micro_tiles() -> const std::vector<std::pair<size_t, size_t>> &;
+
+// * c is m x n row-major with row stride ldc. Throws std::invalid_argument
+// * for a micro-tile gemm_micro_tiles() lacks or a zero block size.
+void gemm(size_t m, size_t n, size_t k, MatrixView a, MatrixView b, double *c,
+          size_t ldc, const GemmBlocking &blocking, bool accumulate = false);
@@ -0,0 +1,57 @@
+#include "Tensor.h"
+#include "Autotune.hpp"
+#include <stdexcept>
+
+namespace {
+
+auto element_count(const std::vector<size_t> &shape) -> size_t {
+  size_t count = 1;
+  for (size_t dim : shape) {
+    count *= dim;
+  }
+  return count;
+}
+
+} // namespace
+
+Tensor::Tensor(std::vector<size_t> shape, double fill)
+    : _shape(std::move(shape)), _strides(compute_strides(_shape)),
+      _data(element_count(_shape), fill) {}
+
+Tensor::Tensor(std::vector<size_t> shape, std::vector<double> data)
+    : _shape(std::move(shape)), _strides(compute_strides(_shape)),
+      _data(std::move(data)) {
+  if (_data.size() != element_count(_shape)) {
+    throw std::invalid_argument("Tensor data does not match its shape");
+  }
+}
+
+auto Tensor::compute_strides(const std::vector<size_t> &shape)
+    -> std::vector<size_t> {
+  std::vector<size_t> strides(shape.size());
+  size_t stride = 1;
+  for (size_t i = shape.size(); i-- > 0;) {
+    strides[i] = stride;
+    stride *= shape[i];
+  }
+  return strides;
+}
+
+auto Tensor::reshape(std::vector<size_t> shape) const -> Tensor {
+  if (element_count(shape) != size()) {
+    throw std::invalid_argument("Reshape changes the element count");
+  }
+  return Tensor(std::move(shape), _data);
+}
+
+auto matmul(const Tensor &a, const Tensor &b) -> Tensor {
+  if (a.rank() != 2 || b.rank() != 2 || a.dim(1) != b.dim(0)) {
+    throw std::invalid_argument("matmul needs [m, k] and [k, n] matrices");
+  }
+  GemmShape shape{a.dim(0), b.dim(1), a.dim(1)};
+  Tensor c({shape.m, shape.n});
+  gemm(shape.m, shape.n, shape.k, {a.data(), shape.k, 1},
+       {b.data(), shape.n, 1}, c.data(), shape.n,
+       gemm_tuner().blocking(shape));
+  return c;
+}
@@ -1,39 +1,69 @@
-"""
-Representing data in n dimensional spaces
-
-
-Scalar -> 1d vector
-
-Vector -> vector of 1d vectors
-
-Matrices -> vector of vectors
-
-But this is not true 
-
-R^1 -= [1]
-
-R^2 = [1,2,2,3,3]
-
-R^3 = [1,2,3]
-
-"""
+#pragma once
+#include "../Shared/types.hpp"
+#include <cstddef>
+#include <initializer_list>
+#include <vector>
+
+// Dense n-dimensional array of doubles, row-major (the last index moves
+// fastest). A scalar has shape {}, a vector {n}, a matrix {rows, cols}.
+//
+//   Tensor a({2, 3}, {1, 2, 3, 4, 5, 6});
+//   a(1, 2) == 6;
+//   a.strides() == {3, 1};
 
 class Tensor {
-public: 
-
-
-
-
-private: 
-
-std::vector<size_t> compute_strides(std::vector<size_t> shape){
-    std::vector<size_t> strides(shape.size()); 
-    strides[strides.size() - 1] = 1; 
-    for (int i = strides.size() - 1; i >= 0; i--){
-        strides[i - 1] = strides[i] * shape[i]; 
+public:
+  Tensor() : Tensor(std::vector<size_t>{}) {}
+
+  // * Every element set to fill
+  explicit Tensor(std::vector<size_t> shape, double fill = 0.0);
+
+  // * Throws std::invalid_argument if data does not hold exactly the
+  // * product of shape elements
+  Tensor(std::vector<size_t> shape, std::vector<double> data);
+
+  auto shape() const -> const std::vector<size_t> & { return _shape; }
+  auto strides() const -> const std::vector<size_t> & { return _strides; }
+  auto rank() const -> size_t { return _shape.size(); }
+  auto dim(size_t axis) const -> size_t { return _shape[axis]; }
+  auto size() const -> size_t { return _data.size(); }
+
+  auto data() -> double * { return _data.data(); }
+  auto data() const -> const double * { return _data.data(); }
+  auto values() const -> const std::vector<double> & { return _data; }
+
+  // * Unchecked element access, one index per axis
+  template <typename... Index> auto operator()(Index... index) -> double & {
+    return _data[offset({static_cast<size_t>(index)...})];
+  }
+  template <typename... Index>
+  auto operator()(Index... index) const -> double {
+    return _data[offset({static_cast<size_t>(index)...})];
+  }
+
+  // * Same elements under another shape. Throws std::invalid_argument if the
+  // * element counts differ.
+  auto reshape(std::vector<size_t> shape) const -> Tensor;
+
+  static auto compute_strides(const std::vector<size_t> &shape)
+      -> std::vector<size_t>;
+
+private:
+  auto offset(std::initializer_list<size_t> index) const -> size_t {
+    size_t at = 0;
+    const size_t *stride = _strides.data();
+    for (size_t i : index) {
+      at += i * *stride++;
     }
-    return strides; 
-}
-
-
-}
\ No newline at end of file
+    return at;
+  }
+
+  std::vector<size_t> _shape;
+  std::vector<size_t> _strides;
+  std::vector<double> _data;
+};
+
+// * [m, k] x [k, n] -> [m, n] with the blocking gemm_tuner() holds for the
+// * shape. Throws std::invalid_argument unless both are matrices with
+// * matching inner dimensions.
+auto matmul(const Tensor &a, const Tensor &b) -> Tensor;
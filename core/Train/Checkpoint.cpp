@@ -0,0 +1,356 @@
+#include "Checkpoint.hpp"
+#include "../Shared/clock.hpp"
+#include "../Shared/hash.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char kMagic[8] = {'M', 'G', 'C', 'K', 'P', 'T', '0', '1'};
+constexpr const char *kExtension = ".ckpt";
+constexpr const char *kTempExtension = ".ckpt.tmp";
+
+// Past these a length field is corruption, not a real checkpoint
+constexpr u64 kMaxMoments = 1 << 10;
+constexpr u64 kMaxLength = u64(1) << 32;
+
+void write_u64(std::string &out, u64 value) {
+  for (int i = 0; i < 8; i++) {
+    out.push_back(static_cast<char>(value >> (8 * i)));
+  }
+}
+
+auto read_u64(std::istream &is) -> u64 {
+  u8 bytes[8];
+  if (!is.read(reinterpret_cast<char *>(bytes), sizeof(bytes))) {
+    throw std::runtime_error("Truncated checkpoint");
+  }
+  u64 value = 0;
+  for (int i = 0; i < 8; i++) {
+    value |= static_cast<u64>(bytes[i]) << (8 * i);
+  }
+  return value;
+}
+
+auto file_name(const std::string &prefix, u64 step) -> std::string {
+  std::string digits = std::to_string(step);
+  return prefix + "-" + std::string(20 - digits.size(), '0') + digits +
+         kExtension;
+}
+
+// The step of <prefix>-<20 digits><ext>, nullopt for any other name
+auto parse_step(const std::string &name, const std::string &prefix,
+                const std::string &ext = kExtension) -> std::optional<u64> {
+  if (name.size() != prefix.size() + 1 + 20 + ext.size() ||
+      name.compare(0, prefix.size(), prefix) != 0 ||
+      name[prefix.size()] != '-' ||
+      name.compare(name.size() - ext.size(), ext.size(), ext) != 0) {
+    return std::nullopt;
+  }
+  u64 step = 0;
+  for (size_t i = prefix.size() + 1; i < prefix.size() + 21; i++) {
+    if (name[i] < '0' || name[i] > '9') {
+      return std::nullopt;
+    }
+    step = step * 10 + static_cast<u64>(name[i] - '0');
+  }
+  return step;
+}
+
+void throw_errno(const std::string &what, const std::string &path) {
+  throw std::system_error(errno, std::generic_category(), what + " " + path);
+}
+
+// fsync of a directory makes a rename inside it durable
+void sync_directory(const std::string &directory) {
+  int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0) {
+    throw_errno("Cannot open", directory);
+  }
+  int result = ::fsync(fd);
+  ::close(fd);
+  if (result != 0) {
+    throw_errno("Cannot sync", directory);
+  }
+}
+
+void write_file(const std::string &path, const std::string &bytes,
+                bool sync) {
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    throw_errno("Cannot create", path);
+  }
+  size_t done = 0;
+  while (done < bytes.size()) {
+    ssize_t n = ::write(fd, bytes.data() + done, bytes.size() - done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      int error = errno;
+      ::close(fd);
+      errno = error;
+      throw_errno("Cannot write", path);
+    }
+    done += static_cast<size_t>(n);
+  }
+  if (sync && ::fsync(fd) != 0) {
+    int error = errno;
+    ::close(fd);
+    errno = error;
+    throw_errno("Cannot sync", path);
+  }
+  if (::close(fd) != 0) {
+    throw_errno("Cannot close", path);
+  }
+}
+
+auto serialize(const TrainingState &state) -> std::string {
+  std::ostringstream model;
+  write_model(model, state.shape, state.parameters);
+
+  std::string out(kMagic, sizeof(kMagic));
+  write_u64(out, state.step);
+  out += model.str();
+  write_u64(out, state.moments.size());
+  for (const std::vector<double> &moment : state.moments) {
+    write_u64(out, moment.size());
+    for (double value : moment) {
+      u64 bits = 0;
+      std::memcpy(&bits, &value, sizeof(bits));
+      write_u64(out, bits);
+    }
+  }
+  write_u64(out, state.rng.size());
+  out += state.rng;
+  write_u64(out, fnv1a(out.data(), out.size()));
+  return out;
+}
+
+} // namespace
+
+Checkpointer::Checkpointer(CheckpointOptions options)
+    : _options(std::move(options)) {
+  if (_options.directory.empty()) {
+    throw std::invalid_argument("Checkpoint directory is empty");
+  }
+  fs::create_directories(_options.directory);
+  // Leftovers of a crash mid-write, never renamed into place. Parsed as
+  // strictly as finished files, so prefix "run" leaves "run-b"'s alone.
+  for (const fs::directory_entry &entry :
+       fs::directory_iterator(_options.directory)) {
+    if (parse_step(entry.path().filename().string(), _options.prefix,
+                   kTempExtension)) {
+      fs::remove(entry.path());
+    }
+  }
+  _writer = std::thread([this] { run(); });
+}
+
+Checkpointer::~Checkpointer() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopping = true;
+  }
+  _changed.notify_all();
+  _writer.join();
+}
+
+void Checkpointer::save(const TrainingState &state) {
+  auto start = Clock::now();
+  std::unique_lock<std::mutex> lock(_mutex);
+  if (_error) {
+    std::exception_ptr error = std::exchange(_error, nullptr);
+    std::rethrow_exception(error);
+  }
+  // assign() reuses the staging buffer's storage, so after the first save
+  // this is a copy per array and no allocation
+  _staged.step = state.step;
+  _staged.shape = state.shape;
+  _staged.parameters.assign(state.parameters.begin(), state.parameters.end());
+  _staged.moments.resize(state.moments.size());
+  for (size_t i = 0; i < state.moments.size(); i++) {
+    _staged.moments[i].assign(state.moments[i].begin(),
+                              state.moments[i].end());
+  }
+  _staged.rng.assign(state.rng);
+  if (_has_staged) {
+    _stats.superseded++;
+  }
+  _has_staged = true;
+
+  double stall = seconds_since(start);
+  _stats.saves++;
+  _stats.stall_seconds += stall;
+  _stats.max_stall_seconds = std::max(_stats.max_stall_seconds, stall);
+  lock.unlock();
+  _changed.notify_all();
+}
+
+void Checkpointer::wait() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _changed.wait(lock, [this] { return !_has_staged && !_busy; });
+  if (_error) {
+    std::exception_ptr error = std::exchange(_error, nullptr);
+    std::rethrow_exception(error);
+  }
+}
+
+auto Checkpointer::stats() const -> CheckpointStats {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _stats;
+}
+
+void Checkpointer::run() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  for (;;) {
+    _changed.wait(lock, [this] { return _has_staged || _stopping; });
+    if (!_has_staged) {
+      return; // Stopping with nothing left to write
+    }
+    std::swap(_staged, _writing);
+    _has_staged = false;
+    _busy = true;
+    lock.unlock();
+
+    auto start = Clock::now();
+    std::exception_ptr error;
+    try {
+      write(_writing);
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    lock.lock();
+    _busy = false;
+    _stats.write_seconds += seconds_since(start);
+    if (error) {
+      _error = error;
+    } else {
+      _stats.written++;
+    }
+    _changed.notify_all();
+  }
+}
+
+void Checkpointer::write(const TrainingState &state) {
+  std::string bytes = serialize(state);
+  std::string path =
+      (fs::path(_options.directory) / file_name(_options.prefix, state.step))
+          .string();
+  std::string temp = path.substr(0, path.size() - std::strlen(kExtension)) +
+                     kTempExtension;
+  write_file(temp, bytes, _options.fsync);
+  fs::rename(temp, path);
+  if (_options.fsync) {
+    sync_directory(_options.directory);
+  }
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stats.bytes = bytes.size();
+  }
+
+  if (_options.keep > 0) {
+    std::vector<std::string> files = list(_options.directory, _options.prefix);
+    for (size_t i = 0; i + _options.keep < files.size(); i++) {
+      fs::remove(files[i]);
+    }
+  }
+}
+
+auto Checkpointer::list(const std::string &directory,
+                        const std::string &prefix)
+    -> std::vector<std::string> {
+  std::vector<std::pair<u64, std::string>> found;
+  if (!fs::is_directory(directory)) {
+    return {};
+  }
+  for (const fs::directory_entry &entry : fs::directory_iterator(directory)) {
+    std::optional<u64> step =
+        parse_step(entry.path().filename().string(), prefix);
+    if (step) {
+      found.emplace_back(*step, entry.path().string());
+    }
+  }
+  std::sort(found.begin(), found.end());
+  std::vector<std::string> paths;
+  for (auto &[step, path] : found) {
+    paths.push_back(std::move(path));
+  }
+  return paths;
+}
+
+auto Checkpointer::load(const std::string &path) -> TrainingState {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("Cannot open checkpoint " + path);
+  }
+  std::string bytes((std::istreambuf_iterator<char>(file)),
+                    std::istreambuf_iterator<char>());
+  if (bytes.size() < sizeof(kMagic) + 8 ||
+      std::memcmp(bytes.data(), kMagic, sizeof(kMagic)) != 0) {
+    throw std::runtime_error("Not a checkpoint: " + path);
+  }
+  std::istringstream tail(bytes.substr(bytes.size() - 8));
+  if (read_u64(tail) != fnv1a(bytes.data(), bytes.size() - 8)) {
+    throw std::runtime_error("Checkpoint checksum mismatch: " + path);
+  }
+
+  std::istringstream is(bytes.substr(0, bytes.size() - 8));
+  is.seekg(sizeof(kMagic));
+  TrainingState state;
+  state.step = read_u64(is);
+  ModelData model = read_model(is);
+  state.shape = std::move(model.shape);
+  state.parameters = std::move(model.parameters);
+
+  u64 moments = read_u64(is);
+  if (moments > kMaxMoments) {
+    throw std::runtime_error("Invalid moment count in checkpoint");
+  }
+  state.moments.resize(moments);
+  for (std::vector<double> &moment : state.moments) {
+    u64 length = read_u64(is);
+    if (length > kMaxLength) {
+      throw std::runtime_error("Invalid moment length in checkpoint");
+    }
+    moment.resize(length);
+    for (double &value : moment) {
+      u64 bits = read_u64(is);
+      std::memcpy(&value, &bits, sizeof(bits));
+    }
+  }
+  u64 rng = read_u64(is);
+  if (rng > kMaxLength) {
+    throw std::runtime_error("Invalid generator state in checkpoint");
+  }
+  state.rng.resize(rng);
+  if (!is.read(state.rng.data(), static_cast<std::streamsize>(rng))) {
+    throw std::runtime_error("Truncated checkpoint");
+  }
+  return state;
+}
+
+auto Checkpointer::load_latest(const std::string &directory,
+                               const std::string &prefix)
+    -> std::optional<TrainingState> {
+  std::vector<std::string> files = list(directory, prefix);
+  for (size_t i = files.size(); i-- > 0;) {
+    try {
+      return load(files[i]);
+    } catch (const std::runtime_error &) {
+      // Damaged, fall back to the one before
+    }
+  }
+  return std::nullopt;
+}
@@ -0,0 +1,137 @@
+#pragma once
+#include "../Model/Format.hpp"
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Crash-safe training checkpoints written off the training thread.
+//
+//   Checkpointer checkpoints({"runs/a", "ckpt", 3});
+//   checkpoints.save(state);   // Copies into a staging buffer, returns
+//   ...                        // The writer thread persists it meanwhile
+//
+// save() copies the state into a staging buffer, a memcpy per array into
+// storage reused from the last save, and wakes the writer thread. The writer
+// serializes it, writes <prefix>-<step>.ckpt.tmp (the step zero-padded to 20
+// digits), fsyncs it, renames it to <prefix>-<step>.ckpt and fsyncs the
+// directory, so a checkpoint file either exists complete or not at all. It
+// then deletes all but the newest `keep`. If save() is called again before
+// the writer picked up the last state, the newer state replaces it and the
+// older one is counted as superseded.
+//
+// A file is little-endian binary:
+//   "MGCKPT01"        8 byte magic
+//   u64 step
+//   model             as written by write_model (Format.hpp)
+//   u64 moment count  then per moment: u64 length, f64 values
+//   u64 rng length    then the generator state bytes
+//   u64 checksum      FNV-1a of everything before it
+//
+// load_latest() skips files that fail to parse or verify, and the
+// constructor removes .tmp files left by a crash, so a run can always
+// resume from the newest intact checkpoint.
+
+struct TrainingState {
+  u64 step = 0;
+  ModelShape shape;
+  std::vector<double> parameters;
+  // Optimizer state, for example a momentum buffer or Adam's m and v
+  std::vector<std::vector<double>> moments;
+  std::string rng; // See rng_state()
+};
+
+struct CheckpointOptions {
+  std::string directory;
+  std::string prefix = "checkpoint";
+  size_t keep = 3;   // Newest checkpoints retained, 0 keeps every one
+  bool fsync = true; // Off only for benchmarks of the write itself
+};
+
+struct CheckpointStats {
+  size_t saves = 0;      // save() calls
+  size_t written = 0;    // Renamed into place
+  size_t superseded = 0; // Replaced in staging before the writer got to them
+  size_t bytes = 0;      // Size of the last file written
+  double stall_seconds = 0.0;     // Spent inside save(), the training stall
+  double max_stall_seconds = 0.0; // Longest single save()
+  double write_seconds = 0.0;     // Spent by the writer thread
+
+  auto mean_stall_ms() const -> double {
+    return saves ? stall_seconds * 1e3 / saves : 0.0;
+  }
+};
+
+// * The exact state of a standard random engine, for TrainingState::rng
+template <typename Engine> auto rng_state(const Engine &engine) -> std::string {
+  std::ostringstream os;
+  os << engine;
+  return os.str();
+}
+
+// * Throws std::runtime_error if the state does not parse
+template <typename Engine>
+void restore_rng(Engine &engine, const std::string &state) {
+  std::istringstream is(state);
+  if (!(is >> engine)) {
+    throw std::runtime_error("Invalid random engine state");
+  }
+}
+
+class Checkpointer {
+public:
+  // * Creates the directory if needed and starts the writer thread
+  explicit Checkpointer(CheckpointOptions options);
+
+  // * Finishes the pending write. Errors are dropped, call wait() first to
+  // * see them.
+  ~Checkpointer();
+
+  Checkpointer(const Checkpointer &) = delete;
+  Checkpointer &operator=(const Checkpointer &) = delete;
+
+  // * Stages a copy of the state and returns without touching the disk.
+  // * Rethrows the error of a failed earlier write.
+  void save(const TrainingState &state);
+
+  // * Blocks until everything saved is on disk, rethrows a write error
+  void wait();
+
+  auto stats() const -> CheckpointStats;
+
+  // * Checkpoint files under directory with this prefix, oldest step first
+  static auto list(const std::string &directory,
+                   const std::string &prefix = "checkpoint")
+      -> std::vector<std::string>;
+
+  // * Throws std::runtime_error for a truncated, corrupt or foreign file
+  static auto load(const std::string &path) -> TrainingState;
+
+  // * The newest checkpoint that loads, or nullopt
+  static auto load_latest(const std::string &directory,
+                          const std::string &prefix = "checkpoint")
+      -> std::optional<TrainingState>;
+
+private:
+  void run();
+  void write(const TrainingState &state);
+
+  CheckpointOptions _options;
+
+  mutable std::mutex _mutex;
+  std::condition_variable _changed;
+  TrainingState _staged;  // Filled by save(), swapped out by the writer
+  TrainingState _writing; // The writer's, outside the lock
+  bool _has_staged = false;
+  bool _busy = false;
+  bool _stopping = false;
+  std::exception_ptr _error;
+  CheckpointStats _stats;
+
+  // Started by the constructor once everything above exists
+  std::thread _writer;
+};
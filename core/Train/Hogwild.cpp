@@ -0,0 +1,274 @@
+#include "Hogwild.hpp"
+#include "../Shared/clock.hpp"
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+namespace {
+
+// Per-worker tallies, summed once the workers are done
+struct WorkerTally {
+  size_t samples = 0;
+  size_t steps = 0;
+  std::vector<double> loss_sums;
+  std::vector<size_t> loss_counts;
+};
+
+// One private copy of the model per worker, made here because the default
+// initialization draws from a shared generator
+auto replicas(const MultiLayerPerceptron &mlp, size_t threads)
+    -> std::vector<MultiLayerPerceptron> {
+  std::vector<MultiLayerPerceptron> copies;
+  for (size_t t = 0; t < threads; t++) {
+    copies.emplace_back(mlp.shape());
+    copies.back().set_parameters(mlp.parameter_values());
+  }
+  return copies;
+}
+
+auto merge(const std::vector<WorkerTally> &tallies, size_t epochs)
+    -> HogwildStats {
+  HogwildStats stats;
+  std::vector<double> sums(epochs, 0.0);
+  std::vector<size_t> counts(epochs, 0);
+  for (const WorkerTally &tally : tallies) {
+    stats.samples += tally.samples;
+    stats.steps += tally.steps;
+    for (size_t e = 0; e < epochs; e++) {
+      sums[e] += tally.loss_sums[e];
+      counts[e] += tally.loss_counts[e];
+    }
+  }
+  for (size_t e = 0; e < epochs; e++) {
+    stats.epoch_losses.push_back(counts[e] ? sums[e] / counts[e] : 0.0);
+  }
+  return stats;
+}
+
+} // namespace
+
+HogwildTrainer::HogwildTrainer(MultiLayerPerceptron &mlp,
+                               HogwildOptions options)
+    : _mlp(mlp), _options(options) {
+  if (_options.threads == 0 || _options.batch == 0) {
+    throw std::invalid_argument("Hogwild needs at least one thread and "
+                                "one sample per batch");
+  }
+  _options.flush_interval = std::max<size_t>(_options.flush_interval, 1);
+}
+
+auto HogwildTrainer::run(const TrainBatch &data, const LossBuilder &loss)
+    -> HogwildStats {
+  if (data.size == 0 || data.inputs.size() % data.size != 0 ||
+      data.targets.size() % data.size != 0) {
+    throw std::invalid_argument("Training data does not split into samples");
+  }
+  std::vector<std::vector<u32>> orders(_options.epochs);
+  std::mt19937_64 gen(_options.seed);
+  for (std::vector<u32> &order : orders) {
+    order.resize(data.size);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), gen);
+  }
+  return _options.synchronous ? run_synchronous(data, loss, orders)
+                              : run_async(data, loss, orders);
+}
+
+void HogwildTrainer::slice(const TrainBatch &data,
+                           const std::vector<u32> &order, size_t round,
+                           size_t thread, TrainBatch &out) const {
+  size_t input_width = data.inputs.size() / data.size;
+  size_t target_width = data.targets.size() / data.size;
+  size_t begin = (round * _options.threads + thread) * _options.batch;
+  size_t end = std::min(begin + _options.batch, order.size());
+  out.size = end > begin ? end - begin : 0;
+  out.inputs.resize(out.size * input_width);
+  out.targets.resize(out.size * target_width);
+  for (size_t i = 0; i < out.size; i++) {
+    size_t sample = order[begin + i];
+    std::copy_n(data.inputs.begin() + sample * input_width, input_width,
+                out.inputs.begin() + i * input_width);
+    std::copy_n(data.targets.begin() + sample * target_width, target_width,
+                out.targets.begin() + i * target_width);
+  }
+}
+
+auto HogwildTrainer::run_async(const TrainBatch &data,
+                               const LossBuilder &loss,
+                               const std::vector<std::vector<u32>> &orders)
+    -> HogwildStats {
+  size_t threads = _options.threads;
+  size_t rounds = (data.size + threads * _options.batch - 1) /
+                  (threads * _options.batch);
+  SharedAccumulator<double> weights(_mlp.parameter_values(), threads,
+                                    _options.mode);
+  std::vector<MultiLayerPerceptron> locals = replicas(_mlp, threads);
+  std::vector<WorkerTally> tallies(threads);
+  std::vector<std::exception_ptr> errors(threads);
+  std::atomic<bool> stopping{false};
+
+  auto work = [&](size_t thread) {
+    WorkerTally &tally = tallies[thread];
+    tally.loss_sums.assign(_options.epochs, 0.0);
+    tally.loss_counts.assign(_options.epochs, 0);
+    MultiLayerPerceptron &local = locals[thread];
+    std::vector<ValuePtr> params = local.parameters();
+    MemoryArena arena(_options.arena_bytes);
+    arena.enable_adaptive();
+    TrainBatch batch;
+
+    try {
+      for (size_t epoch = 0; epoch < _options.epochs; epoch++) {
+        for (size_t round = 0; round < rounds && !stopping; round++) {
+          slice(data, orders[epoch], round, thread, batch);
+          if (batch.size == 0) {
+            break;
+          }
+          for (size_t i = 0; i < params.size(); i++) {
+            params[i]->set_value(weights.load(thread, i));
+          }
+          {
+            ScratchScope scope(&arena);
+            ValuePtr root = loss(local, batch);
+            root->backpropagate();
+            tally.loss_sums[epoch] += root->get_value();
+            tally.loss_counts[epoch]++;
+            for (size_t i = 0; i < params.size(); i++) {
+              double gradient = params[i]->get_gradient();
+              if (gradient != 0.0) {
+                weights.add(thread, i, -_options.learning_rate * gradient);
+              }
+            }
+          }
+          arena.end_iteration();
+          tally.samples += batch.size;
+          tally.steps++;
+          if (tally.steps % _options.flush_interval == 0) {
+            weights.flush(thread);
+          }
+        }
+      }
+    } catch (...) {
+      errors[thread] = std::current_exception();
+      stopping = true;
+    }
+    weights.flush(thread);
+  };
+
+  auto start = Clock::now();
+  {
+    std::vector<std::jthread> workers;
+    for (size_t t = 0; t < threads; t++) {
+      workers.emplace_back(work, t);
+    }
+  }
+  HogwildStats stats = merge(tallies, _options.epochs);
+  stats.seconds = seconds_since(start);
+
+  for (const std::exception_ptr &error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+  std::vector<double> final_weights;
+  weights.snapshot(final_weights);
+  _mlp.set_parameters(final_weights);
+  return stats;
+}
+
+auto HogwildTrainer::run_synchronous(
+    const TrainBatch &data, const LossBuilder &loss,
+    const std::vector<std::vector<u32>> &orders) -> HogwildStats {
+  size_t threads = _options.threads;
+  size_t rounds = (data.size + threads * _options.batch - 1) /
+                  (threads * _options.batch);
+  std::vector<double> weights = _mlp.parameter_values();
+  std::vector<std::vector<double>> gradients(
+      threads, std::vector<double>(weights.size(), 0.0));
+  std::vector<MultiLayerPerceptron> locals = replicas(_mlp, threads);
+  std::vector<WorkerTally> tallies(threads);
+  std::vector<std::exception_ptr> errors(threads);
+  std::atomic<bool> stopping{false};
+  bool stopped = false; // Only changes between rounds
+
+  // The all-reduce: runs on one thread once every worker has arrived
+  auto reduce = [&]() noexcept {
+    stopped = stopping;
+    for (size_t i = 0; i < weights.size(); i++) {
+      double sum = 0.0;
+      for (size_t t = 0; t < threads; t++) {
+        sum += gradients[t][i];
+      }
+      weights[i] -= _options.learning_rate * sum;
+    }
+  };
+  std::barrier round_done(static_cast<std::ptrdiff_t>(threads), reduce);
+
+  // Every worker arrives once per round, even with an empty batch or after
+  // an error, and all of them see `stopped` change after the same barrier
+  auto work = [&](size_t thread) {
+    WorkerTally &tally = tallies[thread];
+    tally.loss_sums.assign(_options.epochs, 0.0);
+    tally.loss_counts.assign(_options.epochs, 0);
+    MultiLayerPerceptron &local = locals[thread];
+    std::vector<ValuePtr> params = local.parameters();
+    std::vector<double> &gradient = gradients[thread];
+    MemoryArena arena(_options.arena_bytes);
+    arena.enable_adaptive();
+    TrainBatch batch;
+
+    for (size_t epoch = 0; epoch < _options.epochs; epoch++) {
+      for (size_t round = 0; round < rounds; round++) {
+        std::fill(gradient.begin(), gradient.end(), 0.0);
+        slice(data, orders[epoch], round, thread, batch);
+        if (batch.size > 0 && !stopping) {
+          try {
+            local.set_parameters(weights);
+            {
+              ScratchScope scope(&arena);
+              ValuePtr root = loss(local, batch);
+              root->backpropagate();
+              tally.loss_sums[epoch] += root->get_value();
+              tally.loss_counts[epoch]++;
+              for (size_t i = 0; i < params.size(); i++) {
+                gradient[i] = params[i]->get_gradient();
+              }
+            }
+            arena.end_iteration();
+            tally.samples += batch.size;
+            tally.steps++;
+          } catch (...) {
+            errors[thread] = std::current_exception();
+            std::fill(gradient.begin(), gradient.end(), 0.0);
+            stopping = true;
+          }
+        }
+        round_done.arrive_and_wait();
+        if (stopped) {
+          return;
+        }
+      }
+    }
+  };
+
+  auto start = Clock::now();
+  {
+    std::vector<std::jthread> workers;
+    for (size_t t = 0; t < threads; t++) {
+      workers.emplace_back(work, t);
+    }
+  }
+  HogwildStats stats = merge(tallies, _options.epochs);
+  stats.seconds = seconds_since(start);
+
+  for (const std::exception_ptr &error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+  _mlp.set_parameters(weights);
+  return stats;
+}
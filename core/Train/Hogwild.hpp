@@ -0,0 +1,75 @@
+#pragma once
+#include "Pipeline.hpp"
+#include "SharedAccumulator.hpp"
+
+// Asynchronous data-parallel SGD without locks (Hogwild).
+//
+// Every worker thread holds a private copy of the MLP. A step pulls the
+// shared weights into it, builds and backpropagates the loss of one batch,
+// and adds -learning_rate * gradient straight into the shared weights
+// through a SharedAccumulator. Nothing waits: a worker may read weights
+// halfway through another worker's update, and its own update lands on
+// weights that moved since it read them. Zero gradients (dead relus, unused
+// inputs) are skipped, so sparse workloads touch only what they use.
+//
+// The samples of an epoch are shuffled and dealt out in rounds of
+// threads * batch: in round r worker t takes the t-th batch. Setting
+// HogwildOptions::synchronous runs the same rounds as a synchronous
+// all-reduce baseline instead. The workers meet at a barrier after each
+// round, their gradients are summed in worker order and applied once, so
+// every batch contributes the same step as under Hogwild, without the
+// staleness and deterministically.
+//
+// Graphs are built on each worker in its own scratch arena. The loss
+// builder runs on all workers at once and must only touch its arguments.
+
+struct HogwildOptions {
+  double learning_rate = 0.01;
+  size_t threads = 4;
+  size_t batch = 1; // Samples per worker step
+  size_t epochs = 1;
+  AccumulateMode mode = AccumulateMode::Atomic;
+  size_t flush_interval = 2; // Striped: worker steps between flushes
+  bool synchronous = false;
+  u64 seed = 0; // Sample order
+  u64 arena_bytes = KB(64);
+};
+
+struct HogwildStats {
+  size_t samples = 0; // Across workers and epochs
+  size_t steps = 0;   // Worker steps, each one batch
+  double seconds = 0.0;
+  std::vector<double> epoch_losses; // Mean batch loss per epoch
+
+  auto samples_per_second() const -> double {
+    return seconds > 0 ? static_cast<double>(samples) / seconds : 0.0;
+  }
+};
+
+class HogwildTrainer {
+public:
+  HogwildTrainer(MultiLayerPerceptron &mlp, HogwildOptions options);
+
+  HogwildTrainer(const HogwildTrainer &) = delete;
+  HogwildTrainer &operator=(const HogwildTrainer &) = delete;
+
+  // * Trains on every sample of `data` for options.epochs epochs. The MLP
+  // * holds the final weights afterwards. An exception from the loss builder
+  // * stops every worker and is rethrown here.
+  auto run(const TrainBatch &data, const LossBuilder &loss) -> HogwildStats;
+
+private:
+  // Samples of worker `thread`'s batch in `round`, as a TrainBatch
+  void slice(const TrainBatch &data, const std::vector<u32> &order,
+             size_t round, size_t thread, TrainBatch &out) const;
+
+  auto run_async(const TrainBatch &data, const LossBuilder &loss,
+                 const std::vector<std::vector<u32>> &orders)
+      -> HogwildStats;
+  auto run_synchronous(const TrainBatch &data, const LossBuilder &loss,
+                       const std::vector<std::vector<u32>> &orders)
+      -> HogwildStats;
+
+  MultiLayerPerceptron &_mlp;
+  HogwildOptions _options;
+};
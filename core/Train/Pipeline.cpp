@@ -0,0 +1,187 @@
+#include "Pipeline.hpp"
+#include "../Shared/clock.hpp"
+#include <atomic>
+#include <memory>
+
+PipelinedTrainer::PipelinedTrainer(MultiLayerPerceptron &mlp,
+                                   PipelineOptions options)
+    : _mlp(mlp), _options(options), _params(mlp.parameters()) {}
+
+auto PipelinedTrainer::run(const BatchLoader &load, const LossBuilder &loss)
+    -> PipelineStats {
+  return _options.pipelined ? run_pipelined(load, loss)
+                            : run_serial(load, loss);
+}
+
+void PipelinedTrainer::publish_weights(const std::vector<double> &weights) {
+  for (size_t i = 0; i < _params.size(); i++) {
+    _params[i]->set_value(weights[i]);
+  }
+}
+
+void PipelinedTrainer::copy_gradients(std::vector<double> &out) const {
+  out.resize(_params.size());
+  for (size_t i = 0; i < _params.size(); i++) {
+    out[i] = _params[i]->get_gradient();
+  }
+}
+
+void PipelinedTrainer::apply(const std::vector<double> &from,
+                             const std::vector<double> &grad,
+                             std::vector<double> &to) const {
+  to.resize(from.size());
+  for (size_t i = 0; i < from.size(); i++) {
+    to[i] = from[i] - _options.learning_rate * grad[i];
+  }
+}
+
+auto PipelinedTrainer::run_serial(const BatchLoader &load,
+                                  const LossBuilder &loss) -> PipelineStats {
+  PipelineStats stats;
+  MemoryArena arena(_options.arena_bytes);
+  arena.enable_adaptive();
+  TrainBatch batch;
+
+  auto start = Clock::now();
+  for (size_t step = 0;; step++) {
+    auto load_start = Clock::now();
+    if (!load(step, batch)) {
+      break;
+    }
+    stats.load_wait_seconds += seconds_since(load_start);
+    {
+      ScratchScope scope(&arena);
+      ValuePtr root = loss(_mlp, batch);
+      root->backpropagate();
+      stats.losses.push_back(root->get_value());
+      for (const ValuePtr &p : _params) {
+        p->set_value(p->get_value() -
+                     _options.learning_rate * p->get_gradient());
+      }
+    }
+    arena.end_iteration();
+    stats.steps++;
+  }
+  stats.seconds = seconds_since(start);
+  return stats;
+}
+
+auto PipelinedTrainer::run_pipelined(const BatchLoader &load,
+                                     const LossBuilder &loss)
+    -> PipelineStats {
+  PipelineStats stats;
+
+  // Declaration order is teardown order in reverse: the guard wakes both
+  // threads and the threads join before anything they use goes away
+  MemoryArena arena(_options.arena_bytes);
+  arena.enable_adaptive();
+
+  TrainBatch batches[kSlots];
+  bool loaded[kSlots] = {};
+  std::exception_ptr load_error;
+  std::counting_semaphore<> slot_free(kSlots);
+  std::counting_semaphore<> slot_loaded(0);
+
+  // weights[s % 2] holds the weights after step s, so update s reads the
+  // other buffer. The initial weights stand in for step -1.
+  std::vector<double> gradients[kSlots];
+  std::vector<double> weights[kSlots];
+  weights[1] = _mlp.parameter_values();
+  std::counting_semaphore<> update_ready(0);
+  std::counting_semaphore<> update_done(0);
+
+  std::atomic<bool> stopping{false};
+
+  std::jthread loader([&] {
+    for (size_t step = 0;; step++) {
+      slot_free.acquire();
+      if (stopping) {
+        return;
+      }
+      size_t slot = step % kSlots;
+      try {
+        loaded[slot] = load(step, batches[slot]);
+      } catch (...) {
+        load_error = std::current_exception();
+        loaded[slot] = false;
+      }
+      slot_loaded.release();
+      if (!loaded[slot]) {
+        return;
+      }
+    }
+  });
+
+  std::jthread updater([&] {
+    for (size_t step = 0;; step++) {
+      update_ready.acquire();
+      if (stopping) {
+        return;
+      }
+      size_t slot = step % kSlots;
+      apply(weights[(step + 1) % kSlots], gradients[slot], weights[slot]);
+      update_done.release();
+    }
+  });
+
+  struct Stop {
+    std::atomic<bool> &stopping;
+    std::counting_semaphore<> &slot_free;
+    std::counting_semaphore<> &update_ready;
+    ~Stop() {
+      stopping = true;
+      slot_free.release();
+      update_ready.release();
+    }
+  } stop{stopping, slot_free, update_ready};
+
+  auto start = Clock::now();
+  size_t completed = 0; // Updates waited for
+  for (size_t step = 0;; step++) {
+    size_t slot = step % kSlots;
+
+    auto wait_start = Clock::now();
+    slot_loaded.acquire();
+    stats.load_wait_seconds += seconds_since(wait_start);
+    if (!loaded[slot]) {
+      break;
+    }
+
+    // Update step - 2 holds the weights to use and frees its gradient buffer
+    if (step >= kSlots) {
+      wait_start = Clock::now();
+      update_done.acquire();
+      completed++;
+      stats.update_wait_seconds += seconds_since(wait_start);
+      publish_weights(weights[slot]);
+    }
+
+    {
+      ScratchScope scope(&arena);
+      ValuePtr root = loss(_mlp, batches[slot]);
+      slot_free.release(); // The graph holds copies of the batch
+      root->backpropagate();
+      stats.losses.push_back(root->get_value());
+      copy_gradients(gradients[slot]);
+    }
+    update_ready.release();
+
+    // Freeing the graph stays on this thread, its nodes' input lists come
+    // from this thread's malloc caches
+    arena.end_iteration();
+    stats.steps++;
+  }
+
+  for (; completed < stats.steps; completed++) {
+    update_done.acquire();
+  }
+  if (stats.steps > 0) {
+    publish_weights(weights[(stats.steps - 1) % kSlots]);
+  }
+  stats.seconds = seconds_since(start);
+
+  if (load_error) {
+    std::rethrow_exception(load_error);
+  }
+  return stats;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include "../Arena/Arena.hpp"
+#include "../Neuron.h"
+#include <exception>
+#include <functional>
+#include <semaphore>
+#include <thread>
+#include <vector>
+
+// SGD training loop run as a three-stage pipeline.
+//
+//   loader thread    load N+2          load N+3          ...
+//   training thread  forward+backward N+1                forward+backward N+2
+//   update thread    SGD step N                          SGD step N+1
+//
+// The loader fills one of two batch slots ahead of the training thread.
+// After backward the training thread copies the gradients into one of two
+// buffers and hands the step to the update thread, which applies SGD to a
+// flat copy of the weights while the next forward pass runs.
+//
+// Because step N+1's forward pass runs while step N is being applied, it uses
+// the weights from after step N-1. The gradients are therefore one step stale
+// (delayed SGD). The schedule is fixed, so results are deterministic and do
+// not depend on timing.
+//
+// The pipelined mode is experimental and off by default. With
+// PipelineOptions::pipelined false, the default, the same stages run inline
+// with no staleness. Only turn it on when the loader and updater get cores
+// of their own; on a single core the three threads just compete and a step
+// is slower than inline (25-31 ms against 18-23 ms in pipeline_bench).
+//
+// Graphs are built and freed on the training thread in its scratch arena.
+// Handing a graph to another thread to free costs more than it saves, since
+// each node's input list comes from the training thread's malloc caches.
+//
+// Only the training thread creates Values.
+
+// One batch as the loader produced it, samples row-major
+struct TrainBatch {
+  std::vector<double> inputs;
+  std::vector<double> targets;
+  size_t size = 0;
+};
+
+// * Fills batch for `step` and returns true, or returns false once the data
+// * is exhausted. Runs on the loader thread when pipelined.
+using BatchLoader = std::function<bool(size_t step, TrainBatch &batch)>;
+
+// * Builds the loss graph of one batch, runs on the training thread
+using LossBuilder =
+    std::function<ValuePtr(MultiLayerPerceptron &mlp, const TrainBatch &batch)>;
+
+struct PipelineOptions {
+  double learning_rate = 0.01;
+  bool pipelined = false; // Experimental, see above
+  u64 arena_bytes = KB(64); // Initial size of the adaptive scratch arena
+};
+
+struct PipelineStats {
+  size_t steps = 0;
+  double seconds = 0.0;
+  double load_wait_seconds = 0.0;   // Training thread waiting for a batch
+  double update_wait_seconds = 0.0; // Training thread waiting on the updater
+  std::vector<double> losses;       // Per step
+
+  auto step_ms() const -> double {
+    return steps ? seconds * 1e3 / steps : 0.0;
+  }
+};
+
+class PipelinedTrainer {
+public:
+  PipelinedTrainer(MultiLayerPerceptron &mlp, PipelineOptions options);
+
+  PipelinedTrainer(const PipelinedTrainer &) = delete;
+  PipelinedTrainer &operator=(const PipelinedTrainer &) = delete;
+
+  // * Trains until load returns false. The MLP holds the final weights
+  // * afterwards. An exception from either callback stops the pipeline and
+  // * is rethrown here.
+  auto run(const BatchLoader &load, const LossBuilder &loss) -> PipelineStats;
+
+private:
+  static constexpr size_t kSlots = 2;
+
+  auto run_serial(const BatchLoader &load, const LossBuilder &loss)
+      -> PipelineStats;
+  auto run_pipelined(const BatchLoader &load, const LossBuilder &loss)
+      -> PipelineStats;
+
+  void publish_weights(const std::vector<double> &weights);
+  void copy_gradients(std::vector<double> &out) const;
+  void apply(const std::vector<double> &from, const std::vector<double> &grad,
+             std::vector<double> &to) const;
+
+  MultiLayerPerceptron &_mlp;
+  PipelineOptions _options;
+  std::vector<ValuePtr> _params;
+};
@@ -0,0 +1,115 @@
+#pragma once
+#include "../Shared/types.hpp"
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// One array that several threads add into without locks or a reduction
+// barrier, for Hogwild-style training where workers push updates straight
+// into shared parameters.
+//
+// Atomic mode adds into the shared array with a compare-and-swap loop per
+// element. Striped mode adds into the calling thread's private shadow, and
+// flush() moves the entries the thread touched over with the same CAS adds,
+// so a hot parameter sees one contended write per flush instead of one per
+// step, at the cost of the shadowed updates arriving late.
+//
+// Every access is relaxed. No add is lost, but a reader may see any mix of
+// old and new elements, which is what Hogwild tolerates.
+
+enum class AccumulateMode : u8 { Atomic, Striped };
+
+// * target += delta as one atomic step, for float and double
+template <typename T> void atomic_add(T &target, T delta) {
+  std::atomic_ref<T> ref(target);
+  T expected = ref.load(std::memory_order_relaxed);
+  while (!ref.compare_exchange_weak(expected, expected + delta,
+                                    std::memory_order_relaxed)) {
+  }
+}
+
+template <typename T> class SharedAccumulator {
+public:
+  static_assert(alignof(T) >= std::atomic_ref<T>::required_alignment);
+
+  // * Thread ids passed to add() and flush() run from 0 to threads - 1
+  SharedAccumulator(std::vector<T> initial, size_t threads,
+                    AccumulateMode mode)
+      : _data(std::move(initial)), _mode(mode) {
+    if (mode == AccumulateMode::Striped) {
+      _shadows.resize(threads);
+      for (Shadow &shadow : _shadows) {
+        shadow.values.assign(_data.size(), T(0));
+        shadow.marked.assign(_data.size(), 0);
+      }
+    }
+  }
+
+  // * Called by `thread` only, any number of threads at once
+  void add(size_t thread, size_t index, T delta) {
+    if (_mode == AccumulateMode::Atomic) {
+      atomic_add(_data[index], delta);
+      return;
+    }
+    Shadow &shadow = _shadows[thread];
+    if (!shadow.marked[index]) {
+      shadow.marked[index] = 1;
+      shadow.touched.push_back(static_cast<u32>(index));
+    }
+    shadow.values[index] += delta;
+  }
+
+  // * Publishes `thread`'s shadowed adds, a no-op in Atomic mode
+  void flush(size_t thread) {
+    if (_mode == AccumulateMode::Atomic) {
+      return;
+    }
+    Shadow &shadow = _shadows[thread];
+    for (u32 index : shadow.touched) {
+      atomic_add(_data[index], shadow.values[index]);
+      shadow.values[index] = T(0);
+      shadow.marked[index] = 0;
+    }
+    shadow.touched.clear();
+  }
+
+  // * Adds `thread` has made but not flushed
+  auto pending(size_t thread) const -> size_t {
+    return _mode == AccumulateMode::Atomic ? 0
+                                           : _shadows[thread].touched.size();
+  }
+
+  auto load(size_t index) const -> T {
+    return std::atomic_ref<T>(_data[index]).load(std::memory_order_relaxed);
+  }
+
+  // * The element as `thread` sees it, with its own unflushed adds
+  auto load(size_t thread, size_t index) const -> T {
+    T value = load(index);
+    return _mode == AccumulateMode::Atomic
+               ? value
+               : value + _shadows[thread].values[index];
+  }
+
+  void snapshot(std::vector<T> &out) const {
+    out.resize(_data.size());
+    for (size_t i = 0; i < _data.size(); i++) {
+      out[i] = load(i);
+    }
+  }
+
+  auto size() const -> size_t { return _data.size(); }
+  auto mode() const -> AccumulateMode { return _mode; }
+
+private:
+  // Aligned so neighbouring threads' bookkeeping never shares a cache line
+  struct alignas(64) Shadow {
+    std::vector<T> values;
+    std::vector<u8> marked;
+    std::vector<u32> touched;
+  };
+
+  mutable std::vector<T> _data; // atomic_ref needs a non-const referent
+  std::vector<Shadow> _shadows;
+  AccumulateMode _mode;
+};
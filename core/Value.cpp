@@ -1,164 +1,517 @@
 #include "Value.h"
-#include <algorithm>
+#include <cmath>
+#include <deque>
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+namespace {
+thread_local MemoryArena *t_scratch_arena = nullptr;
+}
+
+auto create_value(double value_in, std::source_location site) -> ValuePtr {
+  if (t_scratch_arena) {
+    return create_value(t_scratch_arena, value_in, site);
+  }
+  PROFILE_NODE();
+  return std::make_shared<Value>(value_in);
+}
+
+auto create_value(MemoryArena *arena, double value_in,
+                  std::source_location site) -> ValuePtr {
+  PROFILE_NODE();
+  // ArenaAllocator throws std::bad_alloc when the push fails, also under
+  // arena_oom_return_null, so the Value is never built at null.
+  // function_name() has static storage, so it can serve as the site tag.
+  return std::allocate_shared<Value>(
+      ArenaAllocator<Value>(arena, site.function_name()), value_in);
+}
+
+auto create_constant(double value_in, std::source_location site) -> ValuePtr {
+  auto output = create_value(value_in, site);
+  output->_op = ValueOp::Constant;
+  return output;
+}
+
+ScratchScope::ScratchScope(MemoryArena *arena) : _previous(t_scratch_arena) {
+  t_scratch_arena = arena;
+}
+
+ScratchScope::~ScratchScope() { t_scratch_arena = _previous; }
+
 // * ------------- Member Functions ---------------
 void Value::zero_all_gradients() {
   // TODO: Places to optimize -> Redundant zeros
   // TODO: What if they all pointed to some memory that was zeroed out
-  _gradient = 0.0;
-  for (ValuePtr &ptr : prev) {
-    ptr->zero_all_gradients();
+  for (Value *node : topological_order()) {
+    node->_gradient = 0.0;
   }
 }
 
 void Value::set_gradient_to_one() { _gradient = 1.0; }
 
 void Value::backpropagate() {
-  zero_all_gradients();
+  PROFILE_SCOPE("backward");
+  // A node shared by several consumers must see all of their contributions
+  // before it pushes its own gradient further, so walk a topological order
+  // instead of recursing once per path
+  std::vector<Value *> order = topological_order();
+  for (Value *node : order) {
+    node->_gradient = 0.0;
+  }
   set_gradient_to_one();
-  internal_backpropagate();
+  internal_backpropagate(order);
 }
 
 auto Value::get_value() const -> double { return _value; }
 
 auto Value::get_gradient() const -> double { return _gradient; }
 
-void Value::internal_backpropagate() {
+void Value::set_value(double value_in) { _value = value_in; }
+
+auto Value::is_leaf() const -> bool { return prev.empty(); }
+
+auto Value::get_op() const -> ValueOp { return _op; }
+
+auto Value::get_activation() const -> Activation { return _activation; }
+
+void Value::set_gradient(double gradient_in) { _gradient = gradient_in; }
+
+auto Value::topological_order() -> std::vector<Value *> {
+  return topological_order(std::vector<Value *>{this});
+}
+
+auto Value::topological_order(const std::vector<Value *> &roots)
+    -> std::vector<Value *> {
+  std::vector<Value *> order;
+  std::unordered_set<const Value *> visited;
+
+  // Iterative post-order DFS, deep graphs would overflow the call stack
+  std::vector<std::pair<Value *, size_t>> stack;
+  for (Value *root : roots) {
+    if (!visited.insert(root).second) {
+      continue;
+    }
+    stack.emplace_back(root, 0);
+
+    while (!stack.empty()) {
+      Value *node = stack.back().first;
+      size_t &next = stack.back().second;
+
+      if (next < node->prev.size()) {
+        Value *parent = node->prev[next++].get();
+        if (visited.insert(parent).second) {
+          stack.emplace_back(parent, 0);
+        }
+        continue;
+      }
+
+      order.push_back(node);
+      stack.pop_back();
+    }
+  }
+
+  return order;
+}
+
+void Value::backpropagate(const std::vector<ValuePtr> &roots,
+                          const std::vector<double> &seeds) {
+  PROFILE_SCOPE("backward");
+  std::vector<Value *> root_nodes;
+  root_nodes.reserve(roots.size());
+  for (const ValuePtr &root : roots) {
+    root_nodes.push_back(root.get());
+  }
 
-  if (gradient_func) {
-    gradient_func();
+  std::vector<Value *> order = topological_order(root_nodes);
+  for (Value *node : order) {
+    node->_gradient = 0.0;
+  }
+  for (size_t i = 0; i < roots.size(); i++) {
+    roots[i]->_gradient += seeds[i];
+  }
+  internal_backpropagate(order);
+}
+
+void Value::accumulate_backpropagate(const std::vector<ValuePtr> &roots,
+                                     const std::vector<double> &seeds) {
+  PROFILE_SCOPE("backward");
+  std::vector<Value *> root_nodes;
+  root_nodes.reserve(roots.size());
+  for (const ValuePtr &root : roots) {
+    root_nodes.push_back(root.get());
+  }
+
+  std::vector<Value *> order = topological_order(root_nodes);
+  for (Value *node : order) {
+    if (!node->prev.empty()) {
+      node->_gradient = 0.0;
+    }
+  }
+  for (size_t i = 0; i < roots.size(); i++) {
+    roots[i]->_gradient += seeds[i];
   }
+  internal_backpropagate(order);
+}
 
-  for (auto &p : prev) {
-    p->internal_backpropagate();
+void Value::internal_backpropagate(const std::vector<Value *> &order) {
+#if MICROGRAD_PROFILE
+  // Nodes of one layer are contiguous in the order, so a trace event is only
+  // emitted when the layer changes
+  profile::record_backward_pass();
+  size_t run_layer = order.empty() ? 0 : order.back()->_profile_layer;
+  u64 run_start = profile::now_ns();
+  for (auto it = order.rbegin(); it != order.rend(); ++it) {
+    Value *node = *it;
+    if (!node->gradient_func) {
+      continue;
+    }
+    if (node->_profile_layer != run_layer) {
+      profile::record_event(profile::layer_name(run_layer), run_start,
+                            profile::now_ns() - run_start);
+      run_layer = node->_profile_layer;
+      run_start = profile::now_ns();
+    }
+    u64 start = profile::now_ns();
+    node->gradient_func();
+    profile::record_backward(node->_profile_op, node->_profile_layer,
+                             profile::now_ns() - start);
+  }
+  profile::record_event(profile::layer_name(run_layer), run_start,
+                        profile::now_ns() - run_start);
+#else
+  for (auto it = order.rbegin(); it != order.rend(); ++it) {
+    if ((*it)->gradient_func) {
+      (*it)->gradient_func();
+    }
   }
+#endif
 }
 
 // * ------------- Operator Functions ---------------
 
 auto operator*(ValuePtr left, ValuePtr right) -> ValuePtr {
+  PROFILE_OP(profile::Op::Mul);
 
   auto output = create_value(left->get_value() * right->get_value());
+  PROFILE_TAG_NODE(output, profile::Op::Mul);
+  output->_op = ValueOp::Mul;
   output->prev.push_back(left);
   output->prev.push_back(right);
 
-  output->gradient_func = [output]() {
-    auto first = output->prev[0];
-    auto second = output->prev[1];
-    output->prev[0]->_gradient += (second->_value * output->_gradient);
-    output->prev[1]->_gradient += (first->_value * output->_gradient);
+  output->gradient_func = [out = output.get()]() {
+    auto first = out->prev[0];
+    auto second = out->prev[1];
+    out->prev[0]->_gradient += (second->_value * out->_gradient);
+    out->prev[1]->_gradient += (first->_value * out->_gradient);
   };
 
   return output;
 }
 
 auto operator-(ValuePtr value) -> ValuePtr {
-  return value * create_value(-1.0);
+  PROFILE_OP(profile::Op::Neg);
+
+  auto output = create_value(-value->_value);
+  PROFILE_TAG_NODE(output, profile::Op::Neg);
+  output->_op = ValueOp::Neg;
+  output->prev.push_back(value);
+
+  output->gradient_func = [out = output.get()]() {
+    out->prev[0]->_gradient -= out->_gradient;
+  };
+
+  return output;
 }
 
 auto operator+(ValuePtr left, ValuePtr right) -> ValuePtr {
+  PROFILE_OP(profile::Op::Add);
 
   auto output = create_value(left->_value + right->_value);
+  PROFILE_TAG_NODE(output, profile::Op::Add);
+  output->_op = ValueOp::Add;
   output->prev.push_back(left);
   output->prev.push_back(right);
 
-  output->gradient_func = [output]() {
-    output->prev[0]->_gradient += output->_gradient;
-    output->prev[1]->_gradient += output->_gradient;
+  output->gradient_func = [out = output.get()]() {
+    out->prev[0]->_gradient += out->_gradient;
+    out->prev[1]->_gradient += out->_gradient;
   };
 
   return output;
 }
 
 auto operator-(ValuePtr left, ValuePtr right) -> ValuePtr {
-  return left + (-right);
+  PROFILE_OP(profile::Op::Sub);
+
+  auto output = create_value(left->_value - right->_value);
+  PROFILE_TAG_NODE(output, profile::Op::Sub);
+  output->_op = ValueOp::Sub;
+  output->prev.push_back(left);
+  output->prev.push_back(right);
+
+  output->gradient_func = [out = output.get()]() {
+    out->prev[0]->_gradient += out->_gradient;
+    out->prev[1]->_gradient -= out->_gradient;
+  };
+
+  return output;
+}
+
+auto fma(ValuePtr a, ValuePtr b, ValuePtr c) -> ValuePtr {
+  PROFILE_OP(profile::Op::Fused);
+
+  auto output = create_value(a->_value * b->_value + c->_value);
+  PROFILE_TAG_NODE(output, profile::Op::Fused);
+  output->_op = ValueOp::Fma;
+  output->prev.push_back(a);
+  output->prev.push_back(b);
+  output->prev.push_back(c);
+
+  output->gradient_func = [out = output.get()]() {
+    double grad = out->_gradient;
+    out->prev[0]->_gradient += out->prev[1]->_value * grad;
+    out->prev[1]->_gradient += out->prev[0]->_value * grad;
+    out->prev[2]->_gradient += grad;
+  };
+
+  return output;
 }
 
 auto inverse(ValuePtr value) -> ValuePtr {
+  PROFILE_OP(profile::Op::Inverse);
   if (std::abs(value->_value) < 0.0001) {
     throw std::invalid_argument("Division by zero in inverse operation");
   }
 
   auto output = create_value(1.0 / value->_value);
+  PROFILE_TAG_NODE(output, profile::Op::Inverse);
+  output->_op = ValueOp::Inverse;
   output->prev.push_back(value);
 
-  output->gradient_func = [output]() {
+  output->gradient_func = [out = output.get()]() {
     // d/dx(1/x) = -1/x^2
-    // We can use output->_value = 1/x to simplify computation
-    double grad = -output->_value * output->_value * output->_gradient;
-    output->prev[0]->_gradient += grad;
+    // We can use out->_value = 1/x to simplify computation
+    double grad = -out->_value * out->_value * out->_gradient;
+    out->prev[0]->_gradient += grad;
   };
 
   return output;
 }
 
 auto relu(ValuePtr value) -> ValuePtr {
+  PROFILE_OP(profile::Op::Relu);
   auto output = create_value(value->_value > 0 ? value->_value : 0.0);
+  PROFILE_TAG_NODE(output, profile::Op::Relu);
+  output->_op = ValueOp::Relu;
   output->prev.push_back(value);
 
-  output->gradient_func = [output]() {
-    output->prev[0]->_gradient +=
-        (output->_value > 0 ? output->_gradient : 0.0);
+  output->gradient_func = [out = output.get()]() {
+    out->prev[0]->_gradient +=
+        (out->_value > 0 ? out->_gradient : 0.0);
   };
 
   return output;
 }
 
-auto Value::to_dot() const -> std::string {
-  std::stringstream ss;
-  ss << "digraph G {\n";
-  ss << "  rankdir=LR;\n";
-  ss << "  node [fontname=\"Arial\"];\n";
-  ss << "  edge [fontname=\"Arial\"];\n";
-  std::vector<const Value *> visited;
-  build_dot(ss, visited);
-  ss << "}\n";
-  return ss.str();
+auto activate(ValuePtr x, ValuePtr w, ValuePtr c, Activation activation)
+    -> ValuePtr {
+  PROFILE_OP(profile::Op::Activate);
+  double z = x->_value * w->_value + c->_value;
+  auto output = create_value(apply_activation(activation, z));
+  PROFILE_TAG_NODE(output, profile::Op::Activate);
+  output->_op = ValueOp::FmaActivate;
+  output->_activation = activation;
+  output->prev.push_back(x);
+  output->prev.push_back(w);
+  output->prev.push_back(c);
+
+  output->gradient_func = [out = output.get()]() {
+    Value *x_in = out->prev[0].get();
+    Value *w_in = out->prev[1].get();
+    // Recomputing z is cheaper than storing it on every node
+    double z = x_in->_value * w_in->_value + out->prev[2]->_value;
+    double grad = out->_gradient *
+                  activation_derivative(out->_activation, z, out->_value);
+    x_in->_gradient += w_in->_value * grad;
+    w_in->_gradient += x_in->_value * grad;
+    out->prev[2]->_gradient += grad;
+  };
+
+  return output;
 }
 
-void Value::build_dot(std::stringstream &ss,
-                      std::vector<const Value *> &visited) const {
-  // Skip if already visited
-  if (std::find(visited.begin(), visited.end(), this) != visited.end()) {
-    return;
-  }
-  visited.push_back(this);
+auto activate(ValuePtr z, Activation activation) -> ValuePtr {
+  PROFILE_OP(profile::Op::Activate);
+  auto output = create_value(apply_activation(activation, z->_value));
+  PROFILE_TAG_NODE(output, profile::Op::Activate);
+  output->_op = ValueOp::Activate;
+  output->_activation = activation;
+  output->prev.push_back(z);
+
+  output->gradient_func = [out = output.get()]() {
+    out->prev[0]->_gradient +=
+        out->_gradient * activation_derivative(out->_activation,
+                                               out->prev[0]->_value,
+                                               out->_value);
+  };
 
-  // Create a clean node ID
-  std::stringstream node_id;
-  node_id << "node_" << visited.size();
+  return output;
+}
+
+// * ------------- Graph Export ---------------
 
-  // Create node label with value and gradient
-  std::stringstream label;
-  label << "Value: " << _value << "\\nGrad: " << _gradient;
+namespace {
+thread_local u32 t_graph_group = 0;
+thread_local u32 t_next_graph_group = 0;
+} // namespace
+
+GraphGroup::GraphGroup() : _previous(t_graph_group) {
+  t_graph_group = ++t_next_graph_group;
+}
 
-  // Add node with styling
-  ss << "  " << node_id.str() << " [label=\"" << label.str()
-     << "\", shape=box, style=filled, fillcolor=lightblue];\n";
+GraphGroup::~GraphGroup() { t_graph_group = _previous; }
 
-  // Add edges to previous nodes
-  for (const auto &prev_value : prev) {
-    std::stringstream prev_id;
-    prev_id << "node_"
-            << std::find(visited.begin(), visited.end(), prev_value.get()) -
-                   visited.begin() + 1;
-    ss << "  " << node_id.str() << " -> " << prev_id.str() << ";\n";
-    prev_value->build_dot(ss, visited);
+auto GraphGroup::current() -> u32 { return t_graph_group; }
+
+void Value::write_dot(std::ostream &os,
+                      const GraphExportOptions &options) const {
+  os << "digraph G {\n";
+  os << "  rankdir=LR;\n";
+  os << "  node [fontname=\"Arial\"];\n";
+  os << "  edge [fontname=\"Arial\"];\n";
+
+  // A collapsed group is keyed by its first node reached from the root, which
+  // is the group's output (the neuron's activation)
+  std::unordered_map<const Value *, u64> node_ids;
+  std::unordered_map<u32, u64> group_ids;
+  u64 next_id = 0;
+
+  auto collapsed = [&](const Value *node) {
+    return options.collapse_groups && node->_group != 0;
+  };
+
+  // Looks up or assigns the DOT id of a node, writing its declaration the
+  // first time. Returns false once the node budget is spent.
+  auto node_id = [&](const Value *node, u64 &id) {
+    if (collapsed(node)) {
+      auto it = group_ids.find(node->_group);
+      if (it != group_ids.end()) {
+        id = it->second;
+        return true;
+      }
+    } else {
+      auto it = node_ids.find(node);
+      if (it != node_ids.end()) {
+        id = it->second;
+        return true;
+      }
+    }
+    if (next_id >= options.max_nodes) {
+      return false;
+    }
+
+    id = next_id++;
+    if (collapsed(node)) {
+      group_ids.emplace(node->_group, id);
+      os << "  node_" << id << " [label=\"Neuron " << node->_group
+         << "\\nValue: " << node->_value << "\\nGrad: " << node->_gradient
+         << "\", shape=box, style=filled, fillcolor=lightyellow];\n";
+    } else {
+      node_ids.emplace(node, id);
+      os << "  node_" << id << " [label=\"Value: " << node->_value
+         << "\\nGrad: " << node->_gradient
+         << "\", shape=box, style=filled, fillcolor=lightblue];\n";
+    }
+    return true;
+  };
+
+  struct Pending {
+    const Value *node;
+    size_t depth;
+  };
+
+  // Breadth first so the depth limit cuts at a uniform distance from the
+  // root, and the queue only ever holds the current frontier
+  std::deque<Pending> queue;
+  std::unordered_set<const Value *> expanded;
+  u64 root_id = 0;
+  if (node_id(this, root_id)) {
+    queue.push_back(Pending{this, 0});
+    expanded.insert(this);
+  }
+
+  while (!queue.empty()) {
+    Pending pending = queue.front();
+    queue.pop_front();
+    const Value *node = pending.node;
+    if (pending.depth >= options.max_depth) {
+      continue;
+    }
+
+    u64 from = 0;
+    node_id(node, from);
+    for (const ValuePtr &prev_value : node->prev) {
+      const Value *parent = prev_value.get();
+      bool same_group = collapsed(node) && collapsed(parent) &&
+                        parent->_group == node->_group;
+
+      // Walking inside a collapsed group costs no depth and draws no edges
+      size_t depth = same_group ? pending.depth : pending.depth + 1;
+      if (!same_group) {
+        u64 to = 0;
+        if (!node_id(parent, to)) {
+          continue;
+        }
+        os << "  node_" << from << " -> node_" << to << ";\n";
+      }
+      if (expanded.insert(parent).second) {
+        queue.push_back(Pending{parent, depth});
+      }
+    }
   }
+
+  os << "}\n";
+}
+
+auto Value::to_dot(const GraphExportOptions &options) const -> std::string {
+  std::stringstream ss;
+  write_dot(ss, options);
+  return ss.str();
 }
 
-void Value::visualize(const std::string &filename) const {
-  // Generate DOT file
-  std::ofstream dot_file(filename + ".dot");
-  dot_file << to_dot();
-  dot_file.close();
+void Value::visualize(const std::string &filename,
+                      const GraphExportOptions &options) const {
+  // Generate DOT file, streamed rather than built in memory first
+  std::string dot_path = filename + ".dot";
+  {
+    std::vector<char> buffer(1 << 20);
+    std::ofstream dot_file;
+    dot_file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+    dot_file.open(dot_path);
+    write_dot(dot_file, options);
+  }
 
-  // Generate PNG using dot command
-  std::string command =
-      "dot -Tpng " + filename + ".dot -o " + filename + ".png";
-  system(command.c_str());
+  if (!options.render_png) {
+    return;
+  }
+
+  // Generate PNG using dot, spawned directly so the filename never reaches
+  // a shell
+  std::string png_path = filename + ".png";
+  std::string format = "-Tpng";
+  std::string output_flag = "-o";
+  char *argv[] = {const_cast<char *>("dot"), &format[0], &dot_path[0],
+                  &output_flag[0], &png_path[0], nullptr};
+  pid_t pid = 0;
+  if (posix_spawnp(&pid, "dot", nullptr, nullptr, argv, environ) == 0) {
+    int status = 0;
+    waitpid(pid, &status, 0);
+  }
 }
@@ -1,9 +1,98 @@
+#pragma once
+
+#include "Activation.hpp"
+#include "Arena/Arena.hpp"
+#include "Profile/Profile.hpp"
+#include <cstdint>
 #include <functional>
 #include <memory>
-#include <sstream>
+#include <ostream>
+#include <source_location>
 #include <string>
+#include <utility>
 #include <vector>
 
+class Value;
+class Tape;
+using ValuePtr = std::shared_ptr<Value>;
+
+// * What produced a Value, read by graph capture (see Graph/Tape.hpp)
+enum class ValueOp : u8 {
+  Leaf,     // Input or parameter, receives a gradient
+  Constant, // Literal from create_constant, never differentiated
+  Add,
+  Sub,
+  Mul,
+  Neg,
+  Fma, // prev[0] * prev[1] + prev[2]
+  Inverse,
+  Relu,
+  // activation(prev[0]), the activation is stored on the node
+  Activate,
+  // activation(prev[0] * prev[1] + prev[2]), a Neuron's last term and output
+  FmaActivate,
+  Custom, // Anything else, opaque to graph passes
+};
+
+// Arena pushes for a Value are tagged with the name of the function that
+// created it, e.g. the operator* or activate() behind a node, or the caller's
+// function for a leaf, so MemoryArena::sites splits graph bytes by op.
+
+// * Allocates from the active ScratchScope's arena if there is one
+auto create_value(double value_in,
+                  std::source_location site = std::source_location::current())
+    -> ValuePtr;
+
+// * Node and control block live in the arena. Clearing the arena while any
+// * ValuePtr to it is still alive is a use after free.
+auto create_value(MemoryArena *arena, double value_in,
+                  std::source_location site = std::source_location::current())
+    -> ValuePtr;
+
+// * A leaf that graph passes may fold, for literals such as a learning rate
+// * or a target. Its gradient is still written but means nothing.
+auto create_constant(double value_in,
+                     std::source_location site =
+                         std::source_location::current()) -> ValuePtr;
+
+// * Routes every Value created on this thread (including operator outputs)
+// * into an arena until the scope ends. Meant for per-step intermediates, keep
+// * model parameters out of it.
+class ScratchScope {
+public:
+  explicit ScratchScope(MemoryArena *arena);
+  ~ScratchScope();
+
+  ScratchScope(const ScratchScope &) = delete;
+  ScratchScope &operator=(const ScratchScope &) = delete;
+
+private:
+  MemoryArena *_previous;
+};
+
+// * Values created while a GraphGroup is alive share a group id, which the
+// * graph exporter can collapse into one node. Neuron::operator() opens one.
+class GraphGroup {
+public:
+  GraphGroup();
+  ~GraphGroup();
+
+  GraphGroup(const GraphGroup &) = delete;
+  GraphGroup &operator=(const GraphGroup &) = delete;
+
+  static auto current() -> u32;
+
+private:
+  u32 _previous;
+};
+
+struct GraphExportOptions {
+  size_t max_depth = SIZE_MAX;  // Edges followed from the root
+  size_t max_nodes = SIZE_MAX;  // Nodes written before truncating
+  bool collapse_groups = false; // One node per GraphGroup (neuron)
+  bool render_png = true;       // visualize() runs graphviz after
+};
+
 class Value {
 public:
   Value(double value_in) : _value(value_in) {}
@@ -14,36 +103,125 @@ public:
 
   void backpropagate();
 
+  // * Backpropagates from several outputs at once, roots[i] starting with
+  // * gradient seeds[i]. Gradients of the whole graph are zeroed first.
+  static void backpropagate(const std::vector<ValuePtr> &roots,
+                            const std::vector<double> &seeds);
+
+  // * Like backpropagate(roots, seeds), but only nodes with inputs are
+  // * zeroed. Leaves such as parameters and inputs keep their gradients and
+  // * the new contributions are added to them.
+  static void accumulate_backpropagate(const std::vector<ValuePtr> &roots,
+                                       const std::vector<double> &seeds);
+
   auto get_value() const -> double;
 
   auto get_gradient() const -> double;
 
+  auto is_leaf() const -> bool;
+
+  auto get_op() const -> ValueOp;
+
+  // * Only meaningful for ValueOp::Activate and ValueOp::FmaActivate
+  auto get_activation() const -> Activation;
+
+  void set_value(double value_in);
+
+  void set_gradient(double gradient_in);
+
+  // * For the backward of fused nodes, see create_fused
+  void accumulate_gradient(double gradient_in) { _gradient += gradient_in; }
+
+  // * Nodes reachable from this one, every parent before its children
+  auto topological_order() -> std::vector<Value *>;
+
+  static auto topological_order(const std::vector<Value *> &roots)
+      -> std::vector<Value *>;
+
+  // * Graph Visualization
+  // * Streams DOT straight to the output, O(1) work per node and edge
+  void write_dot(std::ostream &os,
+                 const GraphExportOptions &options = {}) const;
+
+  auto to_dot(const GraphExportOptions &options = {}) const -> std::string;
+
+  // * Writes filename.dot and, if asked, renders filename.png with graphviz
+  void visualize(const std::string &filename,
+                 const GraphExportOptions &options = {}) const;
+
 private:
   double _value;
   double _gradient = 0;
 
-  void internal_backpropagate();
+  static void internal_backpropagate(const std::vector<Value *> &order);
 
   std::function<void()> gradient_func = nullptr;
-  std::vector<Value *> prev;
+  std::vector<ValuePtr> prev;
+  u32 _group = GraphGroup::current();
+  ValueOp _op = ValueOp::Leaf;
+  Activation _activation = Activation::Identity;
+
+#if MICROGRAD_PROFILE
+  profile::Op _profile_op = profile::Op::Fused;
+  size_t _profile_layer = profile::current_layer();
+#endif
 
   // * Friend Functions
-  // friend auto operator*(ValuePtr, ValuePtr) -> ValuePtr;
-  // friend auto operator+(ValuePtr, ValuePtr) -> ValuePtr;
-  // friend auto inverse(ValuePtr) -> ValuePtr;
-  // friend auto relu(ValuePtr) -> ValuePtr;
+  friend auto operator*(ValuePtr, ValuePtr) -> ValuePtr;
+  friend auto operator+(ValuePtr, ValuePtr) -> ValuePtr;
+  friend auto operator-(ValuePtr) -> ValuePtr;
+  friend auto operator-(ValuePtr, ValuePtr) -> ValuePtr;
+  friend auto fma(ValuePtr, ValuePtr, ValuePtr) -> ValuePtr;
+  friend auto inverse(ValuePtr) -> ValuePtr;
+  friend auto relu(ValuePtr) -> ValuePtr;
+  friend auto activate(ValuePtr, ValuePtr, ValuePtr, Activation) -> ValuePtr;
+  friend auto activate(ValuePtr, Activation) -> ValuePtr;
+  friend auto create_constant(double, std::source_location) -> ValuePtr;
+  friend class Tape;
+  template <typename Backward>
+  friend auto create_fused(double, std::vector<ValuePtr>, Backward)
+      -> ValuePtr;
 };
 
-// auto operator*(ValuePtr left, ValuePtr right) -> ValuePtr;
-
-// // * ------------- Friend Operations ---------------
-//
-// auto operator-(ValuePtr value) -> ValuePtr;
-//
-// auto operator+(ValuePtr left, ValuePtr right) -> ValuePtr;
-//
-// auto operator-(ValuePtr left, ValuePtr right) -> ValuePtr;
-//
-// auto inverse(ValuePtr value) -> ValuePtr;
-//
-// auto relu(ValuePtr value) -> ValuePtr;
+// * Extension point for fused operations (expression templates, losses): a
+// * single Custom node with the given value over `inputs`. During
+// * backpropagation backward(gradient) is called with the node's gradient and
+// * must accumulate_gradient() into the inputs itself. Graph passes treat the
+// * node as opaque.
+template <typename Backward>
+auto create_fused(double value_in, std::vector<ValuePtr> inputs,
+                  Backward backward) -> ValuePtr {
+  auto output = create_value(value_in);
+  PROFILE_TAG_NODE(output, profile::Op::Fused);
+  output->_op = ValueOp::Custom;
+  output->prev = std::move(inputs);
+  output->gradient_func = [out = output.get(),
+                           backward = std::move(backward)]() mutable {
+    backward(out->_gradient);
+  };
+  return output;
+}
+
+auto operator*(ValuePtr left, ValuePtr right) -> ValuePtr;
+
+// * ------------- Friend Operations ---------------
+
+auto operator-(ValuePtr value) -> ValuePtr;
+
+auto operator+(ValuePtr left, ValuePtr right) -> ValuePtr;
+
+auto operator-(ValuePtr left, ValuePtr right) -> ValuePtr;
+
+// * a * b + c as a single node
+auto fma(ValuePtr a, ValuePtr b, ValuePtr c) -> ValuePtr;
+
+auto inverse(ValuePtr value) -> ValuePtr;
+
+auto relu(ValuePtr value) -> ValuePtr;
+
+// * activation(x * w + c) as a single node, the output of a Neuron
+auto activate(ValuePtr x, ValuePtr w, ValuePtr c, Activation activation)
+    -> ValuePtr;
+
+// * activation(z) as a single node
+auto activate(ValuePtr z, Activation activation) -> ValuePtr;
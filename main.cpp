@@ -1,12 +1,33 @@
 #include "core/Neuron.h"
+#include "core/Tensor/Autotune.hpp"
 #include <iostream>
+#include <string>
 
-int main() {
+int main(int argc, char **argv) {
+  // --retune times the GEMM blockings for this model again. The demo runs
+  // on Values, not Tensors, so it does not tune otherwise.
+  bool retune = false;
+  for (int i = 1; i < argc; i++) {
+    if (std::string(argv[i]) == "--retune") {
+      retune = true;
+    } else {
+      std::cerr << "usage: " << argv[0] << " [--retune]\n";
+      return 1;
+    }
+  }
 
   std::vector<ValuePtr> input = {create_value(1.0), create_value(2.0),
                                  create_value(3.0)};
 
   MultiLayerPerceptron cool(3, {3, 2, 1});
+  if (retune) {
+    TuneOptions tune;
+    tune.force = true;
+    TuneReport report = autotune_gemm(cool.shape(), 32, tune);
+    std::cout << "GEMM tuning: " << report.tuned << " tuned in "
+              << report.cache_file.string() << std::endl;
+  }
+
   auto output = cool(input);
   std::cout << "size is " << output.size() << std::endl;
 
@@ -1,6 +1,9 @@
 #include <gtest/gtest.h>
 #include "../core/Arena/Arena.hpp"
 #include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <new>
 
 // Test basic allocation
 TEST(ArenaTest, BasicAllocation) {
@@ -55,6 +58,19 @@ TEST(ArenaTest, VariousAlignments) {
     EXPECT_EQ(reinterpret_cast<uintptr_t>(ptr64) % 64, 0);
 }
 
+// Test alignments above malloc's guarantee, the address must be aligned
+// and not just the offset into the buffer
+TEST(ArenaTest, AlignmentAboveMallocGuarantee) {
+    MemoryArena arena(KB(16));
+    for (u64 align : {32, 64, 128, 4096}) {
+        arena.push(1);
+        void* ptr = arena.push(8, align);
+        ASSERT_NE(ptr, nullptr);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(ptr) % align, 0u)
+            << "Pointer is not " << align << "-byte aligned";
+    }
+}
+
 // Test push_array template
 TEST(ArenaTest, PushArray) {
     MemoryArena arena(KB(1));
@@ -211,7 +227,15 @@ TEST(ArenaTest, Clear) {
 TEST(ArenaTest, OutOfMemory) {
     MemoryArena arena(64);  // Small arena
 
-    void* ptr = arena.push(128);  // Request more than capacity
+    // Request more than capacity, the default handler throws
+    EXPECT_THROW(arena.push(128), std::bad_alloc);
+}
+
+TEST(ArenaTest, OutOfMemoryReturnNull) {
+    MemoryArena arena(64);
+    arena.set_oom_handler(arena_oom_return_null);
+
+    void* ptr = arena.push(128);
     EXPECT_EQ(ptr, nullptr);
 }
 
@@ -219,8 +243,8 @@ TEST(ArenaTest, OutOfMemoryWithAlignment) {
     MemoryArena arena(64);
 
     arena.push(60);  // Fill most of the arena
-    void* ptr = arena.push(8, 16);  // Would need alignment padding
-    EXPECT_EQ(ptr, nullptr);
+    // Would need alignment padding
+    EXPECT_THROW(arena.push(8, 16), std::bad_alloc);
 }
 
 TEST(ArenaTest, ExactFit) {
@@ -231,8 +255,18 @@ TEST(ArenaTest, ExactFit) {
     EXPECT_EQ(arena.get_pos(), 64);
 
     // Now arena is full
-    void* ptr2 = arena.push(1);
-    EXPECT_EQ(ptr2, nullptr);
+    EXPECT_THROW(arena.push(1), std::bad_alloc);
+}
+
+TEST(ArenaTest, CustomOutOfMemoryHandler) {
+    static u8 fallback[256];
+    MemoryArena arena(64);
+    arena.set_oom_handler([](MemoryArena*, u64, u64) -> void* {
+        return fallback;
+    });
+
+    EXPECT_EQ(arena.push(128), fallback);
+    EXPECT_EQ(arena.get_pos(), 0);
 }
 
 // Test edge cases
@@ -295,7 +329,7 @@ TEST(ArenaTest, ClearAndReuse) {
     // Fill the arena
     void* ptr1 = arena.push(128);
     ASSERT_NE(ptr1, nullptr);
-    EXPECT_EQ(arena.push(1), nullptr);  // Full
+    EXPECT_THROW(arena.push(1), std::bad_alloc);  // Full
 
     // Clear and reuse
     arena.clear();
@@ -305,3 +339,143 @@ TEST(ArenaTest, ClearAndReuse) {
     // Should get same memory region
     EXPECT_EQ(ptr1, ptr2);
 }
+
+
+// Test telemetry
+TEST(ArenaTest, HighWaterAndCounts) {
+    MemoryArena arena(KB(1));
+
+    Arena scope = arena.mark();
+    arena.push(256);
+    arena.push(128);
+    scope.end();
+    arena.push(64);
+
+    EXPECT_EQ(arena.get_high_water(), 384);
+    EXPECT_EQ(arena.alloc_count, 3);
+    EXPECT_EQ(arena.bytes_pushed, 448);
+}
+
+TEST(ArenaTest, PerSiteBytes) {
+    MemoryArena arena(KB(1));
+    const char* weights = "weights";
+    const char* inputs = "inputs";
+
+    arena.push(64, 16, weights);
+    arena.push(32, 16, inputs);
+    arena.push(64, 16, weights);
+    arena.push_array<double>(4, ARENA_SITE);
+
+    EXPECT_EQ(arena.site_bytes("weights"), 128);
+    EXPECT_EQ(arena.site_bytes("inputs"), 32);
+    EXPECT_EQ(arena.site_bytes("unknown"), 0);
+    EXPECT_EQ(arena.site_count, 3u);
+}
+
+TEST(ArenaTest, FailedPushNotCounted) {
+    MemoryArena arena(128);
+    arena.set_oom_handler(arena_oom_return_null);
+    const char* weights = "weights";
+
+    arena.push(64, 16, weights);
+    EXPECT_EQ(arena.push(256, 16, weights), nullptr);
+
+    EXPECT_EQ(arena.alloc_count, 1);
+    EXPECT_EQ(arena.bytes_pushed, 64);
+    EXPECT_EQ(arena.site_bytes("weights"), 64);
+}
+
+TEST(ArenaTest, SitesPastLimitShareOther) {
+    MemoryArena arena(KB(4));
+    static char names[kMaxArenaSites + 8][8];
+
+    for (size_t i = 0; i < kMaxArenaSites + 8; i++) {
+        std::snprintf(names[i], sizeof(names[i]), "s%zu", i);
+        arena.push(16, 16, names[i]);
+    }
+
+    EXPECT_EQ(arena.site_count, kMaxArenaSites);
+    EXPECT_EQ(arena.site_bytes("s0"), 16);
+    EXPECT_EQ(arena.site_bytes("s31"), 0);
+    EXPECT_EQ(arena.site_bytes("other"), 16 * 9);
+    EXPECT_EQ(arena.alloc_count, kMaxArenaSites + 8);
+}
+
+// Test adaptive sizing
+TEST(ArenaTest, AdaptiveGrowsToPeak) {
+    MemoryArena arena(KB(1));
+    ArenaSizingPolicy policy;
+    policy.min_capacity = 256;
+    arena.enable_adaptive(policy);
+
+    // Overflow is served from side blocks instead of failing
+    for (int i = 0; i < 4; i++) {
+        ASSERT_NE(arena.push(KB(1)), nullptr);
+    }
+    EXPECT_EQ(arena.iteration_peak, KB(4));
+
+    arena.end_iteration();
+    EXPECT_EQ(arena.get_pos(), 0);
+    EXPECT_EQ(arena.capacity, KB(5));  // 4 KB peak with 25% headroom
+    EXPECT_TRUE(arena.overflow_blocks.empty());
+
+    // The next iteration of the same size fits without overflow
+    for (int i = 0; i < 4; i++) {
+        arena.push(KB(1));
+    }
+    EXPECT_EQ(arena.overflow_bytes, 0);
+}
+
+TEST(ArenaTest, AdaptiveShrinksAfterWindow) {
+    MemoryArena arena(MB(1));
+    ArenaSizingPolicy policy;
+    policy.window = 4;
+    policy.min_capacity = 256;
+    arena.enable_adaptive(policy);
+
+    // Keeps its size until a whole window has been observed
+    for (int i = 0; i < 3; i++) {
+        arena.push(KB(2));
+        arena.end_iteration();
+        EXPECT_EQ(arena.capacity, MB(1));
+    }
+    arena.push(KB(2));
+    arena.end_iteration();
+    // Then shrinks once the window's peak fits in half the buffer
+    EXPECT_EQ(arena.capacity, KB(2) + KB(2) / 4);
+
+    // A small iteration inside the window does not shrink further
+    arena.push(64);
+    arena.end_iteration();
+    EXPECT_EQ(arena.capacity, KB(2) + KB(2) / 4);
+
+    // reset_stats starts a new window
+    arena.reset_stats();
+    for (int i = 0; i < 3; i++) {
+        arena.push(64);
+        arena.end_iteration();
+        EXPECT_EQ(arena.capacity, KB(2) + KB(2) / 4);
+    }
+}
+
+TEST(ArenaTest, ResizeOnlyWhenEmpty) {
+    MemoryArena arena(KB(1));
+
+    arena.push(16);
+    EXPECT_FALSE(arena.resize(KB(2)));
+
+    arena.clear();
+    EXPECT_TRUE(arena.resize(KB(2)));
+    EXPECT_EQ(arena.capacity, KB(2));
+    EXPECT_NE(arena.push(KB(2)), nullptr);
+}
+
+TEST(ArenaTest, AllocatorForSharedPtr) {
+    MemoryArena arena(KB(1));
+    {
+        auto value = std::allocate_shared<double>(
+            ArenaAllocator<double>(&arena, "shared"), 3.5);
+        EXPECT_DOUBLE_EQ(*value, 3.5);
+    }
+    EXPECT_GT(arena.site_bytes("shared"), sizeof(double));
+}
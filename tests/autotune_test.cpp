@@ -0,0 +1,158 @@
+#include "../core/Tensor/Autotune.hpp"
+#include "../core/Tensor/Tensor.h"
+#include <fstream>
+#include <gtest/gtest.h>
+#include <thread>
+
+namespace {
+
+// A cache file of the test's own and a small grid, so tuning is quick
+auto fresh_options(const std::string &name) -> TuneOptions {
+  TuneOptions options;
+  options.cache_file =
+      std::filesystem::path(::testing::TempDir()) / ("tune_" + name + ".tsv");
+  std::filesystem::remove(options.cache_file);
+  options.candidates = {{64, 256, 128, 4, 4}, {32, 64, 64, 2, 4},
+                        {64, 64, 64, 4, 8}};
+  options.seconds_per_candidate = 0.0001;
+  return options;
+}
+
+} // namespace
+
+// Test that shapes are bucketed by powers of two.
+TEST(AutotuneTest, ShapeClasses) {
+  EXPECT_EQ(shape_class({32, 17, 1}), "32x32x1");
+  EXPECT_EQ(shape_class({33, 64, 100}), "64x64x128");
+
+  ModelShape shape{8, {16, 4}, {}};
+  std::vector<GemmShape> shapes = mlp_gemm_shapes(shape, 32);
+  ASSERT_EQ(shapes.size(), 2u);
+  EXPECT_EQ(shapes[0].m, 32u);
+  EXPECT_EQ(shapes[0].n, 16u);
+  EXPECT_EQ(shapes[0].k, 8u);
+  EXPECT_EQ(shapes[1].n, 4u);
+  EXPECT_EQ(shapes[1].k, 16u);
+}
+
+// Test that tuning persists, a second run reads the cache and force
+// re-tunes.
+TEST(AutotuneTest, CachesPerCpuModel) {
+  TuneOptions options = fresh_options("CachesPerCpuModel");
+  ModelShape shape{16, {16, 16, 1}, {}};
+
+  GemmTuner tuner;
+  TuneReport first = tuner.tune(mlp_gemm_shapes(shape, 16), options);
+  EXPECT_EQ(first.classes, 2u); // The two hidden layers share a class
+  EXPECT_EQ(first.tuned, 2u);
+  EXPECT_EQ(first.cached, 0u);
+  ASSERT_TRUE(std::filesystem::exists(options.cache_file));
+
+  GemmTuner fresh;
+  TuneReport second = fresh.tune(mlp_gemm_shapes(shape, 16), options);
+  EXPECT_EQ(second.tuned, 0u);
+  EXPECT_EQ(second.cached, 2u);
+  EXPECT_EQ(fresh.entries(), tuner.entries());
+
+  options.force = true;
+  TuneReport forced = fresh.tune(mlp_gemm_shapes(shape, 16), options);
+  EXPECT_EQ(forced.tuned, 2u);
+  EXPECT_EQ(forced.cached, 0u);
+}
+
+// Test that lines for other CPU models are kept but not used.
+TEST(AutotuneTest, OtherCpuModelsIgnored) {
+  TuneOptions options = fresh_options("OtherCpuModelsIgnored");
+  {
+    std::ofstream out(options.cache_file);
+    out << "Some Other CPU\t16x16x8\t1 2 3 4 4\n";
+  }
+  GemmTuner tuner;
+  TuneReport report = tuner.tune({{16, 16, 8}}, options);
+  EXPECT_EQ(report.tuned, 1u);
+  EXPECT_NE(tuner.blocking({16, 16, 8}), (GemmBlocking{1, 2, 3, 4, 4}));
+
+  std::ifstream in(options.cache_file);
+  std::string text((std::istreambuf_iterator<char>(in)),
+                   std::istreambuf_iterator<char>());
+  EXPECT_NE(text.find("Some Other CPU\t16x16x8\t1 2 3 4 4"),
+            std::string::npos);
+  EXPECT_NE(text.find(report.cpu_model + "\t16x16x8\t"), std::string::npos);
+}
+
+// Test that corrupt lines for this CPU are re-tuned, not handed to gemm().
+TEST(AutotuneTest, CorruptLinesRetuned) {
+  TuneOptions options = fresh_options("CorruptLinesRetuned");
+  std::string cpu = cpu_model();
+  {
+    std::ofstream out(options.cache_file);
+    out << cpu << "\t16x16x8\t64 64 64 3 5\n";
+    out << cpu << "\t32x32x32\t0 64 64 4 4\n";
+  }
+  GemmTuner tuner;
+  TuneReport report = tuner.tune({{16, 16, 8}, {32, 32, 32}}, options);
+  EXPECT_EQ(report.tuned, 2u);
+  EXPECT_EQ(report.cached, 0u);
+
+  std::vector<double> a(16 * 8, 1.0);
+  std::vector<double> b(8 * 16, 1.0);
+  std::vector<double> c(16 * 16);
+  EXPECT_NO_THROW(gemm(16, 16, 8, {a.data(), 8, 1}, {b.data(), 16, 1},
+                       c.data(), 16, tuner.blocking({16, 16, 8})));
+  EXPECT_DOUBLE_EQ(c[0], 8.0);
+
+  GemmTuner fresh;
+  TuneReport again = fresh.tune({{16, 16, 8}, {32, 32, 32}}, options);
+  EXPECT_EQ(again.cached, 2u);
+  EXPECT_EQ(fresh.entries(), tuner.entries());
+}
+
+// Test that tuners writing one cache at once keep each other's classes.
+TEST(AutotuneTest, ConcurrentWritersMerge) {
+  TuneOptions options = fresh_options("ConcurrentWritersMerge");
+  options.candidates = {{8, 8, 4, 2, 4}};
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < 6; t++) {
+    threads.emplace_back([&options, t] {
+      GemmTuner tuner;
+      tuner.tune({{size_t{2} << t, 4, 4}}, options);
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  GemmTuner reader;
+  std::vector<GemmShape> shapes;
+  for (size_t t = 0; t < 6; t++) {
+    shapes.push_back({size_t{2} << t, 4, 4});
+  }
+  TuneReport report = reader.tune(shapes, options);
+  EXPECT_EQ(report.cached, 6u);
+  EXPECT_EQ(report.tuned, 0u);
+  // No temporary files are left behind
+  std::string prefix = options.cache_file.filename().string() + ".";
+  for (const auto &entry : std::filesystem::directory_iterator(
+           options.cache_file.parent_path())) {
+    std::string name = entry.path().filename().string();
+    if (name.rfind(prefix, 0) == 0) {
+      EXPECT_EQ(name, prefix + "lock");
+    }
+  }
+}
+
+// Test that matmul picks up the global tuner's choice and stays exact.
+TEST(AutotuneTest, MatmulUsesTunedBlocking) {
+  TuneOptions options = fresh_options("MatmulUsesTunedBlocking");
+  options.candidates = {{8, 8, 4, 2, 4}};
+  autotune_gemm(ModelShape{3, {5}, {}}, 6, options);
+  EXPECT_EQ(gemm_tuner().blocking({6, 5, 3}), (GemmBlocking{8, 8, 4, 2, 4}));
+  // Unknown classes get the default
+  EXPECT_EQ(gemm_tuner().blocking({1000, 5, 3}), GemmBlocking());
+
+  Tensor a({6, 3}, std::vector<double>(18, 1.0));
+  Tensor b({3, 5}, std::vector<double>(15, 2.0));
+  Tensor c = matmul(a, b);
+  EXPECT_DOUBLE_EQ(c(5, 4), 6.0);
+  gemm_tuner().clear();
+}
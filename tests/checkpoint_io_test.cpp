@@ -0,0 +1,186 @@
+#include "../core/Train/Checkpoint.hpp"
+#include "../core/Neuron.h"
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <random>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+auto fresh_directory(const std::string &name) -> std::string {
+  fs::path dir = fs::path(::testing::TempDir()) / ("checkpoint_" + name);
+  fs::remove_all(dir);
+  return dir.string();
+}
+
+auto sample_state(u64 step) -> TrainingState {
+  ModelShape shape{2, {3, 1}, {Activation::Tanh, Activation::Identity}};
+  TrainingState state;
+  state.step = step;
+  state.shape = shape;
+  state.parameters = initial_parameters(shape, step);
+  state.moments = {std::vector<double>(state.parameters.size(), 0.5 * step),
+                   {1e-300, -0.0, 3.25}};
+  std::mt19937_64 gen(step);
+  gen.discard(7);
+  state.rng = rng_state(gen);
+  return state;
+}
+
+void expect_same(const TrainingState &a, const TrainingState &b) {
+  EXPECT_EQ(a.step, b.step);
+  EXPECT_EQ(a.shape, b.shape);
+  EXPECT_EQ(a.parameters, b.parameters);
+  EXPECT_EQ(a.moments, b.moments);
+  EXPECT_EQ(a.rng, b.rng);
+}
+
+// Momentum SGD on y = x0 * x1, sampling from a seeded generator, so resume
+// has parameters, one moment and an RNG to restore
+struct TrainingRun {
+  MultiLayerPerceptron mlp{ModelShape{2, {4, 1}, {}}, 5};
+  std::vector<double> velocity =
+      std::vector<double>(mlp.shape().parameter_count(), 0.0);
+  std::mt19937_64 gen{9};
+  u64 step = 0;
+
+  void train(u64 until) {
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+    std::vector<ValuePtr> params = mlp.parameters();
+    for (; step < until; step++) {
+      double x0 = uniform(gen);
+      double x1 = uniform(gen);
+      ValuePtr diff = mlp({create_value(x0), create_value(x1)})[0] -
+                      create_value(x0 * x1);
+      (diff * diff)->backpropagate();
+      for (size_t i = 0; i < params.size(); i++) {
+        velocity[i] = 0.9 * velocity[i] + params[i]->get_gradient();
+        params[i]->set_value(params[i]->get_value() - 0.05 * velocity[i]);
+      }
+    }
+  }
+
+  auto state() const -> TrainingState {
+    return {step, mlp.shape(), mlp.parameter_values(), {velocity},
+            rng_state(gen)};
+  }
+
+  void restore(const TrainingState &state) {
+    step = state.step;
+    mlp.set_parameters(state.parameters);
+    velocity = state.moments.at(0);
+    restore_rng(gen, state.rng);
+  }
+};
+
+} // namespace
+
+// Test that a checkpoint reads back bit for bit.
+TEST(CheckpointIoTest, RoundTrip) {
+  std::string dir = fresh_directory("round_trip");
+  TrainingState state = sample_state(42);
+  {
+    Checkpointer checkpoints({dir, "run", 3});
+    checkpoints.save(state);
+    checkpoints.wait();
+    CheckpointStats stats = checkpoints.stats();
+    EXPECT_EQ(stats.saves, 1u);
+    EXPECT_EQ(stats.written, 1u);
+    EXPECT_GT(stats.bytes, 0u);
+  }
+  ASSERT_EQ(Checkpointer::list(dir, "run").size(), 1u);
+  std::optional<TrainingState> loaded = Checkpointer::load_latest(dir, "run");
+  ASSERT_TRUE(loaded);
+  expect_same(*loaded, state);
+  EXPECT_FALSE(Checkpointer::load_latest(dir, "other"));
+}
+
+// Test that only the newest `keep` checkpoints stay on disk.
+TEST(CheckpointIoTest, Retention) {
+  std::string dir = fresh_directory("retention");
+  Checkpointer checkpoints({dir, "run", 3});
+  for (u64 step : {1, 2, 10, 11, 100}) {
+    checkpoints.save(sample_state(step));
+    checkpoints.wait();
+  }
+  std::vector<std::string> files = Checkpointer::list(dir, "run");
+  ASSERT_EQ(files.size(), 3u);
+  EXPECT_EQ(Checkpointer::load(files[0]).step, 10u);
+  EXPECT_EQ(Checkpointer::load(files[2]).step, 100u);
+}
+
+// Test that torn writes and damaged files are never resumed from.
+TEST(CheckpointIoTest, SkipsDamagedFiles) {
+  std::string dir = fresh_directory("damaged");
+  {
+    Checkpointer checkpoints({dir, "run", 0});
+    checkpoints.save(sample_state(1));
+    checkpoints.save(sample_state(2)); // May supersede step 1
+    checkpoints.wait();
+    checkpoints.save(sample_state(3));
+    checkpoints.wait();
+  }
+  std::vector<std::string> files = Checkpointer::list(dir, "run");
+  ASSERT_GE(files.size(), 2u);
+
+  // Flip one byte of the newest
+  {
+    std::fstream file(files.back(),
+                      std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(40);
+    file.put('\x7f');
+  }
+  EXPECT_THROW(Checkpointer::load(files.back()), std::runtime_error);
+  EXPECT_EQ(Checkpointer::load_latest(dir, "run")->step, 2u);
+
+  // A crash between write and rename leaves a .tmp the next run removes
+  std::string torn = dir + "/run-00000000000000000009.ckpt.tmp";
+  std::ofstream(torn) << "partial";
+  // but leaves another run's, even one whose prefix starts with "run-"
+  std::string other = dir + "/run-b-00000000000000000009.ckpt.tmp";
+  std::ofstream(other) << "in flight";
+  Checkpointer checkpoints({dir, "run", 0});
+  EXPECT_FALSE(fs::exists(torn));
+  EXPECT_TRUE(fs::exists(other));
+}
+
+// Test that resuming from a checkpoint continues the run exactly.
+TEST(CheckpointIoTest, ExactResume) {
+  TrainingRun straight;
+  straight.train(40);
+
+  std::string dir = fresh_directory("resume");
+  {
+    TrainingRun first;
+    Checkpointer checkpoints({dir, "run", 2});
+    for (u64 until : {10, 20, 25}) {
+      first.train(until);
+      checkpoints.save(first.state());
+    }
+    first.train(33); // Lost in the "crash"
+  }
+
+  TrainingRun resumed;
+  std::optional<TrainingState> state = Checkpointer::load_latest(dir, "run");
+  ASSERT_TRUE(state);
+  EXPECT_EQ(state->step, 25u);
+  resumed.restore(*state);
+  resumed.train(40);
+  EXPECT_EQ(resumed.mlp.parameter_values(), straight.mlp.parameter_values());
+  EXPECT_EQ(resumed.velocity, straight.velocity);
+}
+
+// Test that a failed write surfaces on the training thread.
+TEST(CheckpointIoTest, ReportsWriteErrors) {
+  std::string dir = fresh_directory("errors");
+  Checkpointer checkpoints({dir, "run", 3});
+  fs::remove_all(dir);
+  checkpoints.save(sample_state(1));
+  EXPECT_THROW(checkpoints.wait(), std::system_error);
+  fs::create_directories(dir);
+  checkpoints.save(sample_state(2));
+  EXPECT_NO_THROW(checkpoints.wait());
+  EXPECT_THROW(Checkpointer({"", "run", 3}), std::invalid_argument);
+}
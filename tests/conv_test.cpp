@@ -0,0 +1,207 @@
+#include "../core/Tensor/Conv.hpp"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+auto ramp(std::vector<size_t> shape, double scale) -> Tensor {
+  Tensor t(std::move(shape));
+  for (size_t i = 0; i < t.size(); i++) {
+    t.data()[i] = std::sin(scale * static_cast<double>(i + 1));
+  }
+  return t;
+}
+
+// Direct definition of the convolution, the reference for Conv2D
+auto naive_conv(const Tensor &x, Conv2D &conv, const Conv2DOptions &o)
+    -> Tensor {
+  const Tensor &w = conv.weights();
+  ConvGeometry g = conv.geometry(x.dim(2), x.dim(3));
+  size_t k = w.dim(2);
+  Tensor out({x.dim(0), w.dim(0), g.out_height(), g.out_width()});
+  for (size_t n = 0; n < x.dim(0); n++) {
+    for (size_t f = 0; f < w.dim(0); f++) {
+      for (size_t oy = 0; oy < g.out_height(); oy++) {
+        for (size_t ox = 0; ox < g.out_width(); ox++) {
+          double sum = conv.bias()(f);
+          for (size_t c = 0; c < x.dim(1); c++) {
+            for (size_t ky = 0; ky < k; ky++) {
+              for (size_t kx = 0; kx < k; kx++) {
+                long iy = static_cast<long>(oy * o.stride + ky * o.dilation) -
+                          static_cast<long>(o.padding);
+                long ix = static_cast<long>(ox * o.stride + kx * o.dilation) -
+                          static_cast<long>(o.padding);
+                if (iy >= 0 && ix >= 0 && iy < static_cast<long>(x.dim(2)) &&
+                    ix < static_cast<long>(x.dim(3))) {
+                  sum += w(f, c, ky, kx) * x(n, c, iy, ix);
+                }
+              }
+            }
+          }
+          out(n, f, oy, ox) = sum;
+        }
+      }
+    }
+  }
+  return out;
+}
+
+// sum(forward(x) * r), the scalar the gradient checks differentiate
+template <typename Layer>
+auto weighted_sum(Layer &layer, const Tensor &x, const Tensor &r) -> double {
+  Tensor y = layer.forward(x);
+  double sum = 0.0;
+  for (size_t i = 0; i < y.size(); i++) {
+    sum += y.data()[i] * r.data()[i];
+  }
+  return sum;
+}
+
+template <typename Layer>
+void expect_input_gradient(Layer &layer, Tensor x, double tolerance) {
+  Tensor r = ramp(layer.forward(x).shape(), 0.37);
+  Tensor grad = layer.backward(r);
+  const double h = 1e-6;
+  for (size_t i = 0; i < x.size(); i++) {
+    double saved = x.data()[i];
+    x.data()[i] = saved + h;
+    double up = weighted_sum(layer, x, r);
+    x.data()[i] = saved - h;
+    double down = weighted_sum(layer, x, r);
+    x.data()[i] = saved;
+    EXPECT_NEAR(grad.data()[i], (up - down) / (2 * h), tolerance) << i;
+  }
+}
+
+} // namespace
+
+// Test output sizes with stride, padding and dilation.
+TEST(ConvTest, Geometry) {
+  ConvGeometry g{3, 28, 28, 5, {1, 2, 1}};
+  EXPECT_EQ(g.out_height(), 28u);
+  EXPECT_EQ(g.rows(), 75u);
+  g.options = {2, 1, 2}; // Span 9 over 30 padded pixels
+  EXPECT_EQ(g.out_width(), 11u);
+  g.options = {1, 0, 8}; // Span 33 does not fit
+  EXPECT_EQ(g.columns(), 0u);
+}
+
+// Test that im2col then a GEMM equals the direct convolution.
+TEST(ConvTest, ForwardMatchesDirect) {
+  for (Conv2DOptions options : {Conv2DOptions{1, 0, 1}, Conv2DOptions{2, 1, 1},
+                                Conv2DOptions{1, 2, 2}}) {
+    Conv2D conv(3, 4, 3, options, 7);
+    for (size_t i = 0; i < 4; i++) {
+      conv.bias()(i) = 0.1 * static_cast<double>(i);
+    }
+    Tensor x = ramp({2, 3, 7, 6}, 0.3);
+    Tensor y = conv.forward(x);
+    Tensor expected = naive_conv(x, conv, options);
+    ASSERT_EQ(y.shape(), expected.shape());
+    for (size_t i = 0; i < y.size(); i++) {
+      EXPECT_NEAR(y.data()[i], expected.data()[i], 1e-12) << i;
+    }
+  }
+}
+
+// Test the convolution's input, weight and bias gradients numerically.
+TEST(ConvTest, BackwardMatchesFiniteDifferences) {
+  Conv2DOptions options{2, 1, 2};
+  Conv2D conv(2, 3, 3, options, 5);
+  Tensor x = ramp({2, 2, 6, 7}, 0.21);
+  expect_input_gradient(conv, x, 1e-7);
+
+  Tensor r = ramp(conv.forward(x).shape(), 0.37);
+  conv.backward(r);
+  Tensor dw = conv.weight_gradient();
+  Tensor db = conv.bias_gradient();
+  const double h = 1e-6;
+  for (size_t i = 0; i < conv.weights().size(); i++) {
+    double saved = conv.weights().data()[i];
+    conv.weights().data()[i] = saved + h;
+    double up = weighted_sum(conv, x, r);
+    conv.weights().data()[i] = saved - h;
+    double down = weighted_sum(conv, x, r);
+    conv.weights().data()[i] = saved;
+    EXPECT_NEAR(dw.data()[i], (up - down) / (2 * h), 1e-7) << i;
+  }
+  for (size_t f = 0; f < 3; f++) {
+    double expected = 0.0;
+    for (size_t n = 0; n < 2; n++) {
+      for (size_t p = 0; p < r.dim(2) * r.dim(3); p++) {
+        expected += r.data()[(n * 3 + f) * r.dim(2) * r.dim(3) + p];
+      }
+    }
+    EXPECT_NEAR(db(f), expected, 1e-12);
+  }
+}
+
+// Test that the workspace stops growing after the first passes.
+TEST(ConvTest, ReusesWorkspace) {
+  Conv2D conv(1, 6, 5, {1, 2, 1});
+  Tensor x = ramp({4, 1, 28, 28}, 0.1);
+  conv.backward(conv.forward(x));
+  u64 capacity = conv.workspace().capacity;
+  for (int i = 0; i < 3; i++) {
+    conv.backward(conv.forward(x));
+    EXPECT_EQ(conv.workspace().capacity, capacity);
+    EXPECT_EQ(conv.workspace().overflow_bytes, 0u);
+  }
+  EXPECT_GE(capacity, 2 * 25 * 28 * 28 * sizeof(double));
+}
+
+// Test max pooling values and that gradients reach only the maxima.
+TEST(ConvTest, MaxPool) {
+  Tensor x({1, 1, 4, 4}, {1, 5, 2, 0,   //
+                          3, 4, 8, 1,   //
+                          0, 0, 1, 1,   //
+                          -1, 9, 1, 2});
+  MaxPool2D pool(2);
+  Tensor y = pool.forward(x);
+  EXPECT_EQ(y.values(), (std::vector<double>{5, 8, 9, 2}));
+  Tensor dx = pool.backward(Tensor({1, 1, 2, 2}, {1, 2, 3, 4}));
+  EXPECT_EQ(dx.values(), (std::vector<double>{0, 1, 0, 0, //
+                                              0, 0, 2, 0, //
+                                              0, 0, 0, 0, //
+                                              0, 3, 0, 4}));
+
+  MaxPool2D overlapping(3, 2);
+  expect_input_gradient(overlapping, ramp({2, 3, 7, 7}, 0.7), 1e-7);
+}
+
+// Test average pooling and its gradient.
+TEST(ConvTest, AvgPool) {
+  Tensor x({1, 1, 2, 4}, {1, 2, 3, 4, 5, 6, 7, 8});
+  AvgPool2D pool(2);
+  EXPECT_EQ(pool.forward(x).values(), (std::vector<double>{3.5, 5.5}));
+  AvgPool2D overlapping(3, 2);
+  expect_input_gradient(overlapping, ramp({2, 2, 7, 8}, 0.4), 1e-8);
+}
+
+// Test that mismatched shapes are rejected.
+TEST(ConvTest, RejectsBadShapes) {
+  Conv2D conv(3, 4, 5);
+  EXPECT_THROW(conv.forward(Tensor({3, 8, 8})), std::invalid_argument);
+  EXPECT_THROW(conv.forward(Tensor({1, 2, 8, 8})), std::invalid_argument);
+  EXPECT_THROW(conv.forward(Tensor({1, 3, 4, 8})), std::invalid_argument);
+  EXPECT_THROW(conv.backward(Tensor({1, 4, 4, 4})), std::invalid_argument);
+  conv.forward(Tensor({1, 3, 8, 8}));
+  EXPECT_THROW(conv.backward(Tensor({1, 4, 3, 3})), std::invalid_argument);
+  EXPECT_THROW(Conv2D(1, 1, 3, {0, 0, 1}), std::invalid_argument);
+  EXPECT_THROW(MaxPool2D(3).forward(Tensor({1, 1, 2, 2})),
+               std::invalid_argument);
+
+  // Pool backward before any forward, then with the right size but the
+  // wrong shape
+  MaxPool2D max_pool(2);
+  AvgPool2D avg_pool(2);
+  EXPECT_THROW(max_pool.backward(Tensor()), std::invalid_argument);
+  EXPECT_THROW(avg_pool.backward(Tensor()), std::invalid_argument);
+  max_pool.forward(Tensor({1, 2, 4, 4}));
+  avg_pool.forward(Tensor({1, 2, 4, 4}));
+  EXPECT_THROW(max_pool.backward(Tensor({2, 1, 2, 2})),
+               std::invalid_argument);
+  EXPECT_THROW(avg_pool.backward(Tensor({2, 1, 2, 2})),
+               std::invalid_argument);
+}
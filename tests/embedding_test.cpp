@@ -0,0 +1,126 @@
+#include "../core/Embedding/Embedding.hpp"
+#include "../core/Neuron.h"
+#include <gtest/gtest.h>
+
+// Test that lookups copy the row into leaves and reject bad rows.
+TEST(EmbeddingTest, LookupGathersRows) {
+  MemoryArena arena(KB(64));
+  Embedding embedding(arena, 10, 4, 1);
+
+  auto leaves = embedding(3);
+  ASSERT_EQ(leaves.size(), 4u);
+  for (size_t j = 0; j < 4; j++) {
+    EXPECT_EQ(leaves[j]->get_value(), embedding.row(3)[j]);
+    EXPECT_GE(leaves[j]->get_value(), -1.0);
+    EXPECT_LE(leaves[j]->get_value(), 1.0);
+  }
+  EXPECT_EQ(embedding({1, 2, 1}).size(), 12u);
+  EXPECT_THROW(embedding(10), std::out_of_range);
+}
+
+// Test that tables too large for u32 row indices are refused up front.
+TEST(EmbeddingTest, RejectsTooManyRows) {
+  MemoryArena arena(KB(1));
+  EXPECT_THROW(Embedding(arena, size_t(UINT32_MAX) + 1, 1, 1),
+               std::invalid_argument);
+  EXPECT_EQ(arena.get_pos(), 0u);
+}
+
+// Test that rows come from the seeded Philox stream the dense layers use.
+TEST(EmbeddingTest, SeededLikeDenseParameters) {
+  MemoryArena arena(KB(64));
+  Embedding first(arena, 10, 4, 9);
+  Embedding second(arena, 10, 4, 9);
+  Embedding other(arena, 10, 4, 10);
+  for (size_t r = 0; r < 10; r++) {
+    for (size_t j = 0; j < 4; j++) {
+      EXPECT_EQ(first.row(r)[j],
+                initial_parameter(9, InitScheme::Uniform, 0, r, j, 4, 10));
+      EXPECT_EQ(first.row(r)[j], second.row(r)[j]);
+    }
+  }
+  EXPECT_NE(first.row(0)[0], other.row(0)[0]);
+}
+
+// Test that repeated rows are merged and only touched rows appear.
+TEST(EmbeddingTest, SparseGradientsMergeRows) {
+  MemoryArena arena(KB(64));
+  Embedding embedding(arena, 100, 2, 1);
+
+  auto features = embedding({7, 42, 7});
+  // loss = 1 * f0 + 2 * f1 + 3 * f2 + ... over the six features
+  ValuePtr loss = create_value(0.0);
+  for (size_t i = 0; i < features.size(); i++) {
+    loss = loss + features[i] * create_value(static_cast<double>(i + 1));
+  }
+  loss->backpropagate();
+
+  SparseGradient gradient = embedding.collect_gradients();
+  ASSERT_EQ(gradient.rows, (std::vector<u32>{7, 42}));
+  // Row 7 was used at features 0-1 and 4-5
+  EXPECT_DOUBLE_EQ(gradient.row_gradient(0)[0], 1.0 + 5.0);
+  EXPECT_DOUBLE_EQ(gradient.row_gradient(0)[1], 2.0 + 6.0);
+  EXPECT_DOUBLE_EQ(gradient.row_gradient(1)[0], 3.0);
+  EXPECT_DOUBLE_EQ(gradient.row_gradient(1)[1], 4.0);
+
+  // The lookups are forgotten once collected
+  EXPECT_TRUE(embedding.collect_gradients().rows.empty());
+}
+
+// Test that the optimizers leave untouched rows alone.
+TEST(EmbeddingTest, OptimizersTouchOnlyGradientRows) {
+  MemoryArena arena(KB(64));
+  Embedding embedding(arena, 8, 3, 2);
+  std::vector<double> before(embedding.row(0), embedding.row(0) + 8 * 3);
+
+  SparseGradient gradient;
+  gradient.dim = 3;
+  gradient.rows = {5};
+  gradient.values = {1.0, -2.0, 0.5};
+
+  SparseSGD(0.1).step(embedding, gradient);
+  for (size_t r = 0; r < 8; r++) {
+    for (size_t j = 0; j < 3; j++) {
+      double expected = before[r * 3 + j];
+      if (r == 5) {
+        expected -= 0.1 * gradient.values[j];
+      }
+      EXPECT_DOUBLE_EQ(embedding.row(r)[j], expected);
+    }
+  }
+
+  SparseAdagrad adagrad(arena, embedding, 0.5);
+  double value = embedding.row(5)[1];
+  adagrad.step(embedding, gradient);
+  // First Adagrad step moves each coordinate by the learning rate
+  EXPECT_NEAR(embedding.row(5)[1], value + 0.5, 1e-6);
+  EXPECT_DOUBLE_EQ(embedding.row(4)[1], before[4 * 3 + 1]);
+}
+
+// Test that an embedding feeding an MLP learns to separate two categories.
+TEST(EmbeddingTest, TrainsThroughMlp) {
+  MemoryArena arena(KB(64));
+  Embedding embedding(arena, 2, 4, 3);
+  MultiLayerPerceptron mlp(4, {8, 1}, 3);
+  SparseSGD sgd(0.05);
+  std::vector<ValuePtr> params = mlp.parameters();
+
+  auto loss_of = [&](size_t row, double target) {
+    ValuePtr diff = mlp(embedding(row))[0] - create_value(target);
+    return diff * diff;
+  };
+
+  double first = 0.0;
+  double last = 0.0;
+  for (size_t step = 0; step < 200; step++) {
+    ValuePtr loss = loss_of(0, 0.0) + loss_of(1, 1.0);
+    loss->backpropagate();
+    sgd.step(embedding, embedding.collect_gradients());
+    for (const ValuePtr &p : params) {
+      p->set_value(p->get_value() - 0.05 * p->get_gradient());
+    }
+    (step == 0 ? first : last) = loss->get_value();
+  }
+  EXPECT_LT(last, first);
+  EXPECT_LT(last, 0.05);
+}
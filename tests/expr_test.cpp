@@ -0,0 +1,73 @@
+#include "../core/Expr/Expr.hpp"
+#include <gtest/gtest.h>
+
+// Test that a squared error becomes one node with the eager gradients.
+TEST(ExprTest, SquaredErrorMatchesEager) {
+  auto y = create_value(1.5);
+  auto t = create_value(-0.5);
+
+  auto d = expr::var(y) - expr::var(t);
+  ValuePtr fused = expr::evaluate(d * d);
+  EXPECT_EQ(fused->get_op(), ValueOp::Custom);
+  // The node itself plus its two distinct inputs
+  EXPECT_EQ(fused->topological_order().size(), 3u);
+
+  fused->backpropagate();
+  double fused_y = y->get_gradient();
+  double fused_t = t->get_gradient();
+
+  ValuePtr eager = (y - t) * (y - t);
+  eager->backpropagate();
+  EXPECT_DOUBLE_EQ(fused->get_value(), eager->get_value());
+  EXPECT_DOUBLE_EQ(fused_y, y->get_gradient());
+  EXPECT_DOUBLE_EQ(fused_t, t->get_gradient());
+}
+
+// Test every operation against finite differences.
+TEST(ExprTest, GradientsMatchFiniteDifferences) {
+  auto a = create_value(0.7);
+  auto b = create_value(-1.3);
+  auto c = create_value(2.1);
+
+  auto build = [&]() {
+    auto x = expr::var(a);
+    auto y = expr::var(b);
+    return expr::evaluate(expr::relu(x * y + 3.0) / c - (-y) * 0.5 +
+                          2.0 * x / (y - 4.0));
+  };
+
+  ValuePtr out = build();
+  out->backpropagate();
+
+  const double h = 1e-6;
+  for (const ValuePtr &input : {a, b, c}) {
+    double original = input->get_value();
+    input->set_value(original + h);
+    double up = build()->get_value();
+    input->set_value(original - h);
+    double down = build()->get_value();
+    input->set_value(original);
+    EXPECT_NEAR(input->get_gradient(), (up - down) / (2 * h), 1e-6);
+  }
+}
+
+// Test that fused nodes compose with eager operations.
+TEST(ExprTest, MixesWithValuePtr) {
+  auto w = create_value(3.0);
+  auto x = create_value(2.0);
+  ValuePtr y = w * x;
+
+  ValuePtr loss =
+      expr::evaluate((expr::var(y) - 4.0) * (y - create_value(4.0)));
+  EXPECT_DOUBLE_EQ(loss->get_value(), 4.0);
+
+  loss->backpropagate();
+  // d/dw (wx - 4)^2 = 2 (wx - 4) x
+  EXPECT_DOUBLE_EQ(w->get_gradient(), 8.0);
+}
+
+// Test that the divide-by-zero guard matches inverse().
+TEST(ExprTest, DivisionByZeroThrows) {
+  auto x = create_value(1.0);
+  EXPECT_THROW(expr::evaluate(expr::var(x) / 0.0), std::invalid_argument);
+}
@@ -0,0 +1,93 @@
+#include "../core/Forward/Jvp.hpp"
+#include <gtest/gtest.h>
+
+// Test the dual arithmetic against the analytic derivative.
+TEST(ForwardTest, DualDerivative) {
+  // f(x) = 3x^2 - x + 1/x + relu(x - 1), f'(x) = 6x - 1 - 1/x^2 + 1
+  auto f = [](Dual<double> x) {
+    return 3.0 * x * x - x + inverse(x) + relu(x - 1.0);
+  };
+  Dual<double> y = f(Dual<double>::variable(2.0, 0));
+  EXPECT_DOUBLE_EQ(y.value, 12.0 - 2.0 + 0.5 + 1.0);
+  EXPECT_DOUBLE_EQ(y.tangent[0], 12.0 - 1.0 - 0.25 + 1.0);
+}
+
+// Test that the MLP runs on duals and matches reverse-mode input gradients.
+TEST(ForwardTest, MlpJvpMatchesReverseMode) {
+  MultiLayerPerceptron mlp(3, {8, 8, 1}, 5);
+  std::vector<double> x = {0.3, -0.2, 0.9};
+
+  std::vector<ValuePtr> inputs;
+  for (double xi : x) {
+    inputs.push_back(create_value(xi));
+  }
+  ValuePtr output = mlp(inputs)[0];
+  output->backpropagate();
+
+  // One lane per input gives the whole gradient in one pass
+  std::vector<BatchDual<double, 3>> duals;
+  for (size_t i = 0; i < x.size(); i++) {
+    duals.push_back(BatchDual<double, 3>::variable(x[i], i));
+  }
+  BatchDual<double, 3> forward = mlp(duals)[0];
+
+  EXPECT_DOUBLE_EQ(forward.value, output->get_value());
+  for (size_t i = 0; i < x.size(); i++) {
+    EXPECT_NEAR(forward.tangent[i], inputs[i]->get_gradient(), 1e-12);
+  }
+}
+
+// Test that a dual forward pass leaves the parameters' gradients alone.
+TEST(ForwardTest, DualForwardRecordsNothing) {
+  MultiLayerPerceptron mlp(2, {4, 1}, 1);
+  for (const ValuePtr &p : mlp.parameters()) {
+    p->set_gradient(0.0);
+  }
+  auto out = mlp(std::vector<Dual<double>>{Dual<double>::variable(1.0, 0),
+                                           Dual<double>(2.0)});
+  EXPECT_EQ(out.size(), 1u);
+  for (const ValuePtr &p : mlp.parameters()) {
+    EXPECT_EQ(p->get_gradient(), 0.0);
+    EXPECT_TRUE(p->is_leaf());
+  }
+}
+
+// Test that batched lanes agree with one Dual per direction.
+TEST(ForwardTest, BatchedLanesMatchSingleDuals) {
+  MultiLayerPerceptron mlp(2, {6, 3}, 9);
+  const double x[2] = {0.4, 0.7};
+  // directions[i * 4 + k]
+  const double directions[8] = {1.0, 0.0, 0.5, -2.0, 0.0, 1.0, 0.5, 3.0};
+
+  Jvp<4> jvp(mlp);
+  double outputs[3];
+  double tangents[12];
+  jvp(x, directions, outputs, tangents);
+
+  for (size_t k = 0; k < 4; k++) {
+    std::vector<Dual<double>> in(2);
+    for (size_t i = 0; i < 2; i++) {
+      in[i].value = x[i];
+      in[i].tangent[0] = directions[i * 4 + k];
+    }
+    std::vector<Dual<double>> out = mlp(in);
+    for (size_t o = 0; o < 3; o++) {
+      EXPECT_DOUBLE_EQ(outputs[o], out[o].value);
+      EXPECT_DOUBLE_EQ(tangents[o * 4 + k], out[o].tangent[0]);
+    }
+  }
+}
+
+// Test that duals follow non-relu activations.
+TEST(ForwardTest, ActivationsMatchReverseMode) {
+  ModelShape shape{2, {5, 1}, {Activation::Tanh, Activation::Sigmoid}};
+  MultiLayerPerceptron mlp(shape, 2);
+  std::vector<ValuePtr> inputs = {create_value(0.1), create_value(-0.6)};
+  mlp(inputs)[0]->backpropagate();
+
+  auto forward = mlp(std::vector<BatchDual<double, 2>>{
+      BatchDual<double, 2>::variable(0.1, 0),
+      BatchDual<double, 2>::variable(-0.6, 1)})[0];
+  EXPECT_NEAR(forward.tangent[0], inputs[0]->get_gradient(), 1e-12);
+  EXPECT_NEAR(forward.tangent[1], inputs[1]->get_gradient(), 1e-12);
+}
@@ -0,0 +1,172 @@
+#include "../core/Graph/Optimize.hpp"
+#include "../core/Graph/Tape.hpp"
+#include "../core/Neuron.h"
+#include <gtest/gtest.h>
+
+// Test that a captured tape replays the graph's value and gradients.
+TEST(GraphTest, TapeMatchesGraph) {
+  auto a = create_value(2.0);
+  auto b = create_value(-3.0);
+  auto c = relu(a * b + a) - inverse(b) * -a;
+
+  c->backpropagate();
+  double expected_a = a->get_gradient();
+  double expected_b = b->get_gradient();
+
+  Tape tape = Tape::capture(c);
+  EXPECT_DOUBLE_EQ(tape.value(tape.root()), c->get_value());
+
+  a->set_gradient(0.0);
+  b->set_gradient(0.0);
+  tape.backward();
+  EXPECT_DOUBLE_EQ(a->get_gradient(), expected_a);
+  EXPECT_DOUBLE_EQ(b->get_gradient(), expected_b);
+}
+
+// Test that forward() picks up new leaf values.
+TEST(GraphTest, TapeForwardRereadsLeaves) {
+  auto a = create_value(2.0);
+  auto b = a * a + create_constant(1.0);
+
+  Tape tape = Tape::capture(b);
+  a->set_value(3.0);
+  tape.forward();
+  EXPECT_DOUBLE_EQ(tape.value(tape.root()), 10.0);
+}
+
+// Test that native negation and subtraction are single nodes.
+TEST(GraphTest, NativeNegAndSub) {
+  auto a = create_value(5.0);
+  auto b = create_value(3.0);
+
+  Tape tape = Tape::capture(a - b);
+  EXPECT_EQ(tape.size(), 3u);
+  EXPECT_EQ(tape.count(ValueOp::Sub), 1u);
+
+  Tape neg = Tape::capture(-a);
+  EXPECT_EQ(neg.size(), 2u);
+}
+
+TEST(GraphTest, ConstantFolding) {
+  auto x = create_value(4.0);
+  auto scale = create_constant(2.0) * create_constant(0.25);  // 0.5
+  auto y = x * scale + create_constant(1.0) * create_constant(0.0);
+
+  OptimizeStats stats;
+  Tape tape = optimize(Tape::capture(y), &stats);
+
+  EXPECT_GT(stats.folded, 0u);
+  EXPECT_EQ(tape.count(ValueOp::Constant), 1u);  // Only 0.5 survives
+  EXPECT_EQ(tape.size(), 3u);                    // x, 0.5, x * 0.5
+  EXPECT_DOUBLE_EQ(tape.value(tape.root()), 2.0);
+}
+
+TEST(GraphTest, NegSubRewrites) {
+  auto a = create_value(5.0);
+  auto b = create_value(3.0);
+  auto c = a + b * create_constant(-1.0);  // Old style a - b
+  auto d = c - (-(-a));
+
+  OptimizeStats stats;
+  Tape tape = optimize(Tape::capture(d), &stats);
+
+  EXPECT_EQ(tape.count(ValueOp::Mul), 0u);
+  EXPECT_EQ(tape.count(ValueOp::Neg), 0u);
+  EXPECT_EQ(tape.count(ValueOp::Sub), 2u);
+  EXPECT_DOUBLE_EQ(tape.value(tape.root()), -3.0);
+
+  tape.backward();
+  EXPECT_DOUBLE_EQ(a->get_gradient(), 0.0);
+  EXPECT_DOUBLE_EQ(b->get_gradient(), -1.0);
+}
+
+TEST(GraphTest, FmaFusion) {
+  auto a = create_value(2.0);
+  auto b = create_value(3.0);
+  auto c = create_value(4.0);
+  auto shared = a * c;  // Used twice, must not be fused away
+  auto y = (a * b + c) * (shared + b) + shared;
+
+  OptimizeStats stats;
+  Tape tape = optimize(Tape::capture(y), &stats);
+  // a * b + c and the outer product plus shared
+  EXPECT_EQ(stats.fma, 2u);
+  EXPECT_EQ(tape.count(ValueOp::Fma), 2u);
+  EXPECT_EQ(tape.count(ValueOp::Mul), 1u);
+  EXPECT_DOUBLE_EQ(tape.value(tape.root()), y->get_value());
+
+  y->backpropagate();
+  double expected[] = {a->get_gradient(), b->get_gradient(),
+                       c->get_gradient()};
+  tape.backward();
+  EXPECT_DOUBLE_EQ(a->get_gradient(), expected[0]);
+  EXPECT_DOUBLE_EQ(b->get_gradient(), expected[1]);
+  EXPECT_DOUBLE_EQ(c->get_gradient(), expected[2]);
+}
+
+TEST(GraphTest, CommonSubexpressions) {
+  auto a = create_value(2.0);
+  auto b = create_value(3.0);
+  auto y = (a * b) * (b * a) + relu(a + b) * relu(b + a);
+
+  OptimizeStats stats;
+  Tape tape = optimize(Tape::capture(y), &stats);
+  EXPECT_EQ(stats.cse, 3u);  // b * a, b + a, relu(b + a)
+
+  y->backpropagate();
+  double expected_a = a->get_gradient();
+  tape.backward();
+  EXPECT_DOUBLE_EQ(a->get_gradient(), expected_a);
+}
+
+// Test that an optimized MLP loss tape is smaller and exact.
+TEST(GraphTest, OptimizedNetworkGradients) {
+  MultiLayerPerceptron mlp(3, {4, 4, 1});
+  std::vector<ValuePtr> inputs = {create_value(0.5), create_value(-1.0),
+                                  create_value(2.0)};
+  auto diff = mlp(inputs)[0] - create_constant(1.0);
+  auto loss = diff * diff * create_constant(0.5);
+
+  loss->backpropagate();
+  std::vector<double> expected;
+  for (const ValuePtr &p : mlp.parameters()) {
+    expected.push_back(p->get_gradient());
+  }
+
+  Tape captured = Tape::capture(loss);
+  OptimizeStats stats;
+  Tape tape = optimize(captured, &stats);
+  EXPECT_LT(tape.size(), captured.size());
+  EXPECT_GT(stats.fma, 0u);
+
+  tape.forward();
+  tape.backward();
+  EXPECT_DOUBLE_EQ(tape.value(tape.root()), loss->get_value());
+  std::vector<ValuePtr> params = mlp.parameters();
+  for (size_t i = 0; i < params.size(); i++) {
+    EXPECT_NEAR(params[i]->get_gradient(), expected[i], 1e-12);
+  }
+}
+
+// Test that tapes capture and replay non-relu neuron outputs.
+TEST(GraphTest, ActivationNodes) {
+  ModelShape shape{2, {3, 1}, {Activation::Gelu, Activation::Sigmoid}};
+  MultiLayerPerceptron mlp(shape, 4);
+  std::vector<ValuePtr> inputs = {create_value(0.4), create_value(-1.2)};
+  ValuePtr output = mlp(inputs)[0];
+  output->backpropagate();
+  std::vector<double> expected;
+  for (const ValuePtr &p : mlp.parameters()) {
+    expected.push_back(p->get_gradient());
+  }
+
+  Tape tape = optimize(Tape::capture(output));
+  EXPECT_EQ(tape.count(ValueOp::FmaActivate), 4u);
+  tape.forward();
+  tape.backward();
+  EXPECT_DOUBLE_EQ(tape.value(tape.root()), output->get_value());
+  std::vector<ValuePtr> params = mlp.parameters();
+  for (size_t i = 0; i < params.size(); i++) {
+    EXPECT_NEAR(params[i]->get_gradient(), expected[i], 1e-12);
+  }
+}
@@ -0,0 +1,204 @@
+#include "../core/Train/Hogwild.hpp"
+#include "test_helpers.hpp"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+constexpr size_t kSamples = 24;
+
+// y = |x0 - x1|
+auto dataset() -> TrainBatch {
+  TrainBatch data;
+  data.size = kSamples;
+  for (size_t i = 0; i < kSamples; i++) {
+    double x0 = 0.1 * static_cast<double>(i % 7);
+    double x1 = 0.05 * static_cast<double>((3 * i) % 5);
+    data.inputs.push_back(x0);
+    data.inputs.push_back(x1);
+    data.targets.push_back(std::abs(x0 - x1));
+  }
+  return data;
+}
+
+// One epoch of plain SGD in the trainer's sample order
+auto manual_sgd(const ModelShape &shape, double lr, size_t batch_size,
+                u64 seed) -> std::vector<double> {
+  MultiLayerPerceptron mlp(shape, 3);
+  std::vector<ValuePtr> params = mlp.parameters();
+  TrainBatch data = dataset();
+  std::vector<u32> order(kSamples);
+  std::iota(order.begin(), order.end(), 0);
+  std::mt19937_64 gen(seed);
+  std::shuffle(order.begin(), order.end(), gen);
+
+  for (size_t begin = 0; begin < kSamples; begin += batch_size) {
+    TrainBatch batch;
+    for (size_t i = begin; i < std::min(begin + batch_size, kSamples); i++) {
+      batch.inputs.push_back(data.inputs[2 * order[i]]);
+      batch.inputs.push_back(data.inputs[2 * order[i] + 1]);
+      batch.targets.push_back(data.targets[order[i]]);
+      batch.size++;
+    }
+    mse(mlp, batch)->backpropagate();
+    for (const ValuePtr &p : params) {
+      p->set_value(p->get_value() - lr * p->get_gradient());
+    }
+  }
+  return mlp.parameter_values();
+}
+
+} // namespace
+
+// Test that concurrent CAS adds lose nothing, for float and double.
+TEST(HogwildTest, AtomicAdd) {
+  double total = 0.0;
+  float total_f32 = 0.0f;
+  {
+    std::vector<std::jthread> threads;
+    for (int t = 0; t < 4; t++) {
+      threads.emplace_back([&]() {
+        for (int i = 0; i < 10000; i++) {
+          atomic_add(total, 1.0);
+          atomic_add(total_f32, 0.5f);
+        }
+      });
+    }
+  }
+  EXPECT_EQ(total, 40000.0);
+  EXPECT_EQ(total_f32, 20000.0f);
+}
+
+// Test that striped adds stay private until flushed.
+TEST(HogwildTest, StripedFlush) {
+  SharedAccumulator<double> shared({1.0, 2.0, 3.0}, 2, AccumulateMode::Striped);
+  shared.add(0, 1, 0.5);
+  shared.add(0, 1, 0.25);
+  shared.add(1, 2, -1.0);
+  EXPECT_EQ(shared.load(1), 2.0);
+  EXPECT_EQ(shared.load(0, 1), 2.75); // Its own adds
+  EXPECT_EQ(shared.load(1, 1), 2.0);
+  EXPECT_EQ(shared.pending(0), 1u);
+
+  shared.flush(0);
+  EXPECT_EQ(shared.load(1), 2.75);
+  EXPECT_EQ(shared.load(2), 3.0);
+  EXPECT_EQ(shared.pending(0), 0u);
+  shared.flush(1);
+  std::vector<double> values;
+  shared.snapshot(values);
+  EXPECT_EQ(values, (std::vector<double>{1.0, 2.75, 2.0}));
+
+  // Concurrent flushes into the same elements
+  SharedAccumulator<double> counts({0.0, 0.0}, 4, AccumulateMode::Striped);
+  {
+    std::vector<std::jthread> threads;
+    for (size_t t = 0; t < 4; t++) {
+      threads.emplace_back([&counts, t]() {
+        for (int i = 0; i < 5000; i++) {
+          counts.add(t, i % 2, 1.0);
+          if (i % 7 == 0) {
+            counts.flush(t);
+          }
+        }
+        counts.flush(t);
+      });
+    }
+  }
+  EXPECT_EQ(counts.load(0) + counts.load(1), 20000.0);
+}
+
+// Test that one worker, in either mode, is plain SGD.
+TEST(HogwildTest, OneWorkerIsSgd) {
+  ModelShape shape{2, {6, 1}, {}};
+  std::vector<double> expected = manual_sgd(shape, 0.05, 4, 11);
+  for (bool synchronous : {false, true}) {
+    for (AccumulateMode mode :
+         {AccumulateMode::Atomic, AccumulateMode::Striped}) {
+      MultiLayerPerceptron mlp(shape, 3);
+      HogwildOptions options;
+      options.learning_rate = 0.05;
+      options.threads = 1;
+      options.batch = 4;
+      options.mode = mode;
+      options.flush_interval = 3;
+      options.synchronous = synchronous;
+      options.seed = 11;
+      HogwildStats stats = HogwildTrainer(mlp, options).run(dataset(), mse);
+      EXPECT_EQ(stats.samples, kSamples);
+      EXPECT_EQ(stats.steps, kSamples / 4);
+      std::vector<double> trained = mlp.parameter_values();
+      for (size_t i = 0; i < expected.size(); i++) {
+        EXPECT_NEAR(trained[i], expected[i], 1e-12) << i;
+      }
+    }
+  }
+}
+
+// Test that the all-reduce baseline does not depend on thread timing.
+TEST(HogwildTest, SynchronousIsDeterministic) {
+  ModelShape shape{2, {6, 1}, {}};
+  HogwildOptions options;
+  options.threads = 3;
+  options.batch = 2;
+  options.epochs = 2;
+  options.synchronous = true;
+  std::vector<double> first;
+  for (int run = 0; run < 3; run++) {
+    MultiLayerPerceptron mlp(shape, 3);
+    HogwildStats stats = HogwildTrainer(mlp, options).run(dataset(), mse);
+    EXPECT_EQ(stats.samples, 2 * kSamples);
+    if (run == 0) {
+      first = mlp.parameter_values();
+    } else {
+      EXPECT_EQ(mlp.parameter_values(), first);
+    }
+  }
+}
+
+// Test that several asynchronous workers still converge.
+TEST(HogwildTest, AsyncConverges) {
+  for (AccumulateMode mode :
+       {AccumulateMode::Atomic, AccumulateMode::Striped}) {
+    MultiLayerPerceptron mlp(
+        ModelShape{2, {8, 1}, {Activation::Tanh, Activation::Identity}}, 3);
+    HogwildOptions options;
+    options.learning_rate = 0.05;
+    options.threads = 4;
+    options.epochs = 30;
+    options.mode = mode;
+    options.flush_interval = 2;
+    HogwildStats stats = HogwildTrainer(mlp, options).run(dataset(), mse);
+    EXPECT_EQ(stats.samples, 30 * kSamples);
+    ASSERT_EQ(stats.epoch_losses.size(), 30u);
+    EXPECT_LT(stats.epoch_losses.back(), 0.5 * stats.epoch_losses.front());
+  }
+}
+
+// Test that a failing loss builder stops every worker and is rethrown.
+TEST(HogwildTest, RethrowsErrors) {
+  for (bool synchronous : {false, true}) {
+    MultiLayerPerceptron mlp(ModelShape{2, {4, 1}, {}}, 3);
+    HogwildOptions options;
+    options.threads = 3;
+    options.epochs = 4;
+    options.synchronous = synchronous;
+    std::atomic<int> calls{0};
+    LossBuilder failing = [&](MultiLayerPerceptron &model,
+                              const TrainBatch &batch) {
+      if (++calls == 10) {
+        throw std::runtime_error("bad batch");
+      }
+      return mse(model, batch);
+    };
+    EXPECT_THROW(HogwildTrainer(mlp, options).run(dataset(), failing),
+                 std::runtime_error);
+  }
+  MultiLayerPerceptron mlp(ModelShape{2, {1}, {}}, 3);
+  EXPECT_THROW(HogwildTrainer(mlp, HogwildOptions{0.01, 0}),
+               std::invalid_argument);
+}
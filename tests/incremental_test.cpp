@@ -0,0 +1,123 @@
+#include "../core/Graph/Incremental.hpp"
+#include "../core/Graph/Optimize.hpp"
+#include "../core/Neuron.h"
+#include <gtest/gtest.h>
+
+namespace {
+
+struct Network {
+  MultiLayerPerceptron mlp;
+  std::vector<ValuePtr> inputs;
+  ValuePtr loss;
+};
+
+auto make_network() -> Network {
+  ModelShape shape{4, {8, 8, 1}, {Activation::Relu, Activation::Tanh,
+                                  Activation::Identity}};
+  Network net{MultiLayerPerceptron(shape, 9), {}, nullptr};
+  for (double x : {0.5, -1.0, 2.0, 0.1}) {
+    net.inputs.push_back(create_value(x));
+  }
+  ValuePtr diff = net.mlp(net.inputs)[0] - create_constant(0.3);
+  net.loss = diff * diff;
+  return net;
+}
+
+// Full tape replay, the reference for every incremental update
+void expect_matches_full(Tape &tape, IncrementalTape &graph,
+                         const std::vector<ValuePtr> &leaves) {
+  std::vector<double> incremental;
+  for (const ValuePtr &leaf : leaves) {
+    incremental.push_back(leaf->get_gradient());
+  }
+  tape.forward();
+  tape.backward();
+  EXPECT_NEAR(graph.value(graph.root()), tape.value(tape.root()), 1e-12);
+  for (size_t i = 0; i < leaves.size(); i++) {
+    EXPECT_NEAR(incremental[i], leaves[i]->get_gradient(), 1e-12) << i;
+  }
+}
+
+} // namespace
+
+// Test that changing leaves one at a time tracks a full recompute.
+TEST(IncrementalTest, MatchesFullRecompute) {
+  Network net = make_network();
+  Tape tape = optimize(Tape::capture(net.loss));
+  IncrementalTape graph(tape);
+  std::vector<ValuePtr> leaves = net.mlp.parameters();
+  leaves.insert(leaves.end(), net.inputs.begin(), net.inputs.end());
+  expect_matches_full(tape, graph, leaves);
+
+  graph.set_value(graph.leaf(net.inputs[2]), -0.7);
+  graph.forward();
+  graph.backward();
+  expect_matches_full(tape, graph, leaves);
+
+  std::vector<ValuePtr> params = net.mlp.parameters();
+  graph.set_value(graph.leaf(params[20]), 0.9);
+  graph.set_value(graph.leaf(params.back()), -0.2);
+  graph.backward(); // Runs forward() itself
+  expect_matches_full(tape, graph, leaves);
+}
+
+// Test that a change near the output recomputes only its cone.
+TEST(IncrementalTest, CostFollowsCone) {
+  Network net = make_network();
+  IncrementalTape graph(Tape::capture(net.loss));
+  size_t full = graph.stats().forward_nodes;
+
+  // The output neuron's bias reaches its 8-term sum and the loss only
+  ValuePtr bias = net.mlp.parameters().back();
+  graph.set_value(graph.leaf(bias), bias->get_value() + 0.5);
+  graph.forward();
+  size_t late = graph.stats().forward_nodes;
+  EXPECT_LE(late, 12u);
+  EXPECT_LT(late * 10, full);
+
+  // An input feeds every first-layer neuron
+  graph.set_value(graph.leaf(net.inputs[0]), 1.5);
+  graph.forward();
+  EXPECT_GT(graph.stats().forward_nodes, late);
+
+  // Setting the same value again dirties nothing
+  graph.set_value(graph.leaf(bias), bias->get_value());
+  graph.forward();
+  EXPECT_EQ(graph.stats().forward_nodes, 0u);
+}
+
+// Test that an unchanged value stops propagation at a dead relu.
+TEST(IncrementalTest, StopsAtUnchangedValues) {
+  auto a = create_value(-2.0);
+  auto b = create_value(1.0);
+  auto y = relu(a * b) + b;
+  IncrementalTape graph(Tape::capture(y));
+
+  graph.set_value(graph.leaf(a), -3.0); // Relu stays 0
+  EXPECT_DOUBLE_EQ(graph.forward(), 1.0);
+  EXPECT_EQ(graph.stats().forward_nodes, 2u); // a * b and the relu
+  graph.backward();
+  EXPECT_DOUBLE_EQ(a->get_gradient(), 0.0);
+  EXPECT_DOUBLE_EQ(b->get_gradient(), 1.0);
+
+  graph.set_value(graph.leaf(a), 4.0);
+  EXPECT_DOUBLE_EQ(graph.forward(), 5.0);
+  graph.backward();
+  EXPECT_DOUBLE_EQ(a->get_gradient(), 1.0);
+  EXPECT_DOUBLE_EQ(b->get_gradient(), 5.0);
+}
+
+// Test that leaves set on their Values are picked up by sync_leaves().
+TEST(IncrementalTest, SyncLeaves) {
+  auto a = create_value(2.0);
+  auto b = create_value(3.0);
+  IncrementalTape graph(Tape::capture(a * b));
+  EXPECT_THROW(graph.leaf(create_value(1.0)), std::invalid_argument);
+
+  a->set_value(5.0);
+  EXPECT_DOUBLE_EQ(graph.forward(), 6.0); // Not seen yet
+  graph.sync_leaves();
+  EXPECT_DOUBLE_EQ(graph.forward(), 15.0);
+  graph.backward();
+  EXPECT_DOUBLE_EQ(b->get_gradient(), 5.0);
+}
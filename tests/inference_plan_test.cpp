@@ -0,0 +1,151 @@
+#include "../core/Serve/InferencePlan.hpp"
+#include "test_helpers.hpp"
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <new>
+#include <thread>
+
+// Counts every allocation in this binary, for the zero allocation test
+namespace {
+std::atomic<size_t> allocations{0};
+} // namespace
+
+void *operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+auto test_mlp() -> MultiLayerPerceptron {
+  ModelShape shape{21, {37, 16, 3},
+                   {Activation::Relu, Activation::Tanh, Activation::Identity}};
+  return MultiLayerPerceptron(shape, 4, InitScheme::HeUniform);
+}
+
+auto kernels() -> std::vector<PlanKernel> {
+  std::vector<PlanKernel> result = {PlanKernel::Scalar};
+  if (plan_avx2_supported()) {
+    result.push_back(PlanKernel::Avx2);
+  }
+  return result;
+}
+
+} // namespace
+
+// Test that the plan computes the f64 model's function to f32 precision.
+TEST(InferencePlanTest, MatchesModel) {
+  MultiLayerPerceptron mlp = test_mlp();
+  std::vector<f32> inputs = samples<f32>(50, 21, 1);
+  std::vector<double> scratch(2 * mlp.max_width());
+  for (PlanKernel kernel : kernels()) {
+    InferencePlan plan = InferencePlan::compile(mlp, kernel);
+    EXPECT_EQ(plan.kernel(), kernel);
+    InferencePlan::Workspace workspace = plan.workspace();
+    for (size_t s = 0; s < 50; s++) {
+      std::vector<double> x(inputs.begin() + s * 21,
+                            inputs.begin() + (s + 1) * 21);
+      std::vector<double> expected(3);
+      mlp.evaluate(x.data(), expected.data(), scratch.data());
+      f32 actual[3];
+      plan.run(inputs.data() + s * 21, actual, workspace);
+      for (size_t o = 0; o < 3; o++) {
+        EXPECT_NEAR(actual[o], expected[o], 1e-4);
+      }
+    }
+  }
+}
+
+// Test that run() allocates nothing once the workspace exists.
+TEST(InferencePlanTest, RunDoesNotAllocate) {
+  MultiLayerPerceptron mlp = test_mlp();
+  std::vector<f32> inputs = samples<f32>(20, 21, 2);
+  for (PlanKernel kernel : kernels()) {
+    InferencePlan plan = InferencePlan::compile(mlp, kernel);
+    size_t before = allocations.load();
+    InferencePlan::Workspace workspace = plan.workspace();
+    EXPECT_GT(allocations.load(), before); // The counter does count
+    f32 outputs[3];
+    before = allocations.load();
+    for (size_t s = 0; s < 20; s++) {
+      plan.run(inputs.data() + s * 21, outputs, workspace);
+    }
+    EXPECT_EQ(allocations.load(), before);
+  }
+}
+
+// Test that concurrent calls with their own workspaces agree with serial
+// calls, bit for bit.
+TEST(InferencePlanTest, ConcurrentRuns) {
+  const InferencePlan plan = InferencePlan::compile(test_mlp());
+  constexpr size_t kThreads = 6;
+  constexpr size_t kSamples = 200;
+  std::vector<f32> inputs = samples<f32>(kSamples, 21, 3);
+
+  std::vector<f32> expected(kSamples * 3);
+  InferencePlan::Workspace serial = plan.workspace();
+  for (size_t s = 0; s < kSamples; s++) {
+    plan.run(inputs.data() + s * 21, expected.data() + s * 3, serial);
+  }
+
+  std::vector<std::vector<f32>> results(kThreads,
+                                        std::vector<f32>(kSamples * 3));
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < kThreads; t++) {
+    threads.emplace_back([&, t] {
+      InferencePlan::Workspace workspace = plan.workspace();
+      for (size_t r = 0; r < 5; r++) {
+        for (size_t s = 0; s < kSamples; s++) {
+          plan.run(inputs.data() + s * 21, results[t].data() + s * 3,
+                   workspace);
+        }
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  for (const std::vector<f32> &result : results) {
+    EXPECT_EQ(result, expected);
+  }
+}
+
+// Test that the plan keeps its own copy of the weights.
+TEST(InferencePlanTest, ImmuneToTraining) {
+  MultiLayerPerceptron mlp = test_mlp();
+  InferencePlan plan = InferencePlan::compile(mlp);
+  InferencePlan::Workspace workspace = plan.workspace();
+  std::vector<f32> x = samples<f32>(1, 21, 4);
+  f32 before[3];
+  plan.run(x.data(), before, workspace);
+
+  for (const ValuePtr &param : mlp.parameters()) {
+    param->set_value(param->get_value() + 1.0);
+  }
+  f32 after[3];
+  plan.run(x.data(), after, workspace);
+  EXPECT_EQ(std::vector<f32>(before, before + 3),
+            std::vector<f32>(after, after + 3));
+  EXPECT_EQ(plan.weight_bytes(),
+            (37 * 24 + 16 * 40 + 3 * 16 + 37 + 16 + 3) * sizeof(f32));
+}
+
+// Test that a workspace from a narrower plan is rejected.
+TEST(InferencePlanTest, RejectsSmallWorkspace) {
+  InferencePlan wide = InferencePlan::compile(test_mlp());
+  MultiLayerPerceptron small(ModelShape{2, {3, 1}, {}}, 1);
+  InferencePlan narrow = InferencePlan::compile(small);
+  InferencePlan::Workspace workspace = narrow.workspace();
+  std::vector<f32> x(21, 0.5F);
+  f32 y[3];
+  EXPECT_THROW(wide.run(x.data(), y, workspace), std::invalid_argument);
+}
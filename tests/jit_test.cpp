@@ -0,0 +1,202 @@
+#include "../core/Graph/Jit.hpp"
+#include "../core/Graph/Optimize.hpp"
+#include "../core/Neuron.h"
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+
+namespace {
+
+// An empty cache of the test's own
+auto fresh_options(const std::string &name) -> JitOptions {
+  JitOptions options;
+  options.cache_dir =
+      std::filesystem::path(::testing::TempDir()) / ("jit_test_" + name);
+  std::filesystem::remove_all(options.cache_dir);
+  return options;
+}
+
+auto mse_loss(MultiLayerPerceptron &mlp, const std::vector<ValuePtr> &inputs,
+              double target) -> ValuePtr {
+  ValuePtr diff = mlp(inputs)[0] - create_constant(target);
+  return diff * diff * create_constant(0.5);
+}
+
+} // namespace
+
+// Test that the compiled tape matches the interpreter on an MLP loss.
+TEST(JitTest, MatchesInterpreter) {
+  ModelShape shape{3, {4, 4, 1}, {Activation::Tanh, Activation::Gelu,
+                                  Activation::Sigmoid}};
+  MultiLayerPerceptron mlp(shape, 11);
+  std::vector<ValuePtr> inputs = {create_value(0.5), create_value(-1.0),
+                                  create_value(2.0)};
+  Tape tape = optimize(Tape::capture(mse_loss(mlp, inputs, 0.3)));
+  CompiledTape jit =
+      CompiledTape::compile(tape, fresh_options("MatchesInterpreter"));
+  ASSERT_EQ(jit.backend(), JitBackend::Native) << jit.fallback_reason();
+  EXPECT_FALSE(jit.cache_hit());
+
+  std::vector<ValuePtr> params = mlp.parameters();
+  for (double x : {0.5, -0.7}) {
+    inputs[0]->set_value(x);
+    tape.forward();
+    tape.backward();
+    std::vector<double> expected;
+    for (const ValuePtr &p : params) {
+      expected.push_back(p->get_gradient());
+      p->set_gradient(0.0);
+    }
+
+    jit.run();
+    EXPECT_DOUBLE_EQ(jit.value(), tape.value(tape.root()));
+    for (size_t i = 0; i < params.size(); i++) {
+      EXPECT_NEAR(params[i]->get_gradient(), expected[i], 1e-12);
+    }
+  }
+}
+
+// Test that a second compile of the same graph loads the cached object.
+TEST(JitTest, CachesByGraphHash) {
+  JitOptions options = fresh_options("CachesByGraphHash");
+  auto a = create_value(2.0);
+  auto b = create_value(3.0);
+  CompiledTape first = CompiledTape::compile(
+      Tape::capture(relu(a * b - create_constant(1.0))), options);
+  ASSERT_EQ(first.backend(), JitBackend::Native) << first.fallback_reason();
+  EXPECT_FALSE(first.cache_hit());
+
+  // Same structure over other leaves and values hits
+  auto c = create_value(-4.0);
+  auto d = create_value(0.5);
+  CompiledTape second = CompiledTape::compile(
+      Tape::capture(relu(c * d - create_constant(1.0))), options);
+  EXPECT_TRUE(second.cache_hit());
+  EXPECT_EQ(second.hash(), first.hash());
+  second.run();
+  EXPECT_DOUBLE_EQ(second.value(), 0.0);
+  EXPECT_DOUBLE_EQ(c->get_gradient(), 0.0);
+
+  // Another constant misses
+  CompiledTape third = CompiledTape::compile(
+      Tape::capture(relu(c * d - create_constant(-3.0))), options);
+  EXPECT_FALSE(third.cache_hit());
+  EXPECT_NE(third.hash(), first.hash());
+  third.run();
+  EXPECT_DOUBLE_EQ(third.value(), 1.0);
+  EXPECT_DOUBLE_EQ(c->get_gradient(), 0.5);
+  EXPECT_DOUBLE_EQ(d->get_gradient(), -4.0);
+}
+
+// Test that the hash sees structure and constants but not leaf values.
+TEST(JitTest, TapeHash) {
+  auto a = create_value(1.0);
+  auto b = create_value(2.0);
+  u64 sum = tape_hash(Tape::capture(a + b));
+  a->set_value(5.0);
+  EXPECT_EQ(tape_hash(Tape::capture(a + b)), sum);
+  EXPECT_NE(tape_hash(Tape::capture(a * b)), sum);
+  EXPECT_NE(tape_hash(Tape::capture(activate(a + b, Activation::Tanh))),
+            tape_hash(Tape::capture(activate(a + b, Activation::Sigmoid))));
+}
+
+// Test that a missing compiler falls back to the interpreter.
+TEST(JitTest, FallsBackWithoutCompiler) {
+  JitOptions options = fresh_options("FallsBackWithoutCompiler");
+  options.compiler = "/nonexistent/c++";
+  auto a = create_value(2.0);
+  auto b = create_value(-3.0);
+  CompiledTape jit = CompiledTape::compile(Tape::capture(a * b + a), options);
+  EXPECT_EQ(jit.backend(), JitBackend::Interpreter);
+  EXPECT_FALSE(jit.fallback_reason().empty());
+
+  jit.run();
+  EXPECT_DOUBLE_EQ(jit.value(), -4.0);
+  EXPECT_DOUBLE_EQ(a->get_gradient(), -2.0);
+  EXPECT_DOUBLE_EQ(b->get_gradient(), 2.0);
+}
+
+// Test that an object built under a group-writable umask is still cached.
+TEST(JitTest, CachesUnderPermissiveUmask) {
+  JitOptions options = fresh_options("CachesUnderPermissiveUmask");
+  auto a = create_value(2.0);
+  auto b = create_value(-3.0);
+  mode_t previous = ::umask(002);
+  CompiledTape first = CompiledTape::compile(Tape::capture(a * b), options);
+  CompiledTape second = CompiledTape::compile(Tape::capture(a * b), options);
+  ::umask(previous);
+  ASSERT_EQ(first.backend(), JitBackend::Native) << first.fallback_reason();
+  EXPECT_FALSE(first.cache_hit());
+  EXPECT_EQ(second.backend(), JitBackend::Native) << second.fallback_reason();
+  EXPECT_TRUE(second.cache_hit());
+}
+
+// Test that a cached object others can write is rebuilt rather than loaded,
+// and that a cache directory others can write is not used.
+TEST(JitTest, RefusesWritableCache) {
+  JitOptions options = fresh_options("RefusesWritableCache");
+  auto a = create_value(2.0);
+  auto b = create_value(-3.0);
+  CompiledTape first = CompiledTape::compile(Tape::capture(a * b), options);
+  ASSERT_EQ(first.backend(), JitBackend::Native) << first.fallback_reason();
+  EXPECT_EQ(std::filesystem::status(options.cache_dir).permissions() &
+                std::filesystem::perms::all,
+            std::filesystem::perms::owner_all);
+
+  std::filesystem::path library;
+  for (const auto &entry :
+       std::filesystem::directory_iterator(options.cache_dir)) {
+    if (entry.path().extension() == ".so") {
+      library = entry.path();
+    }
+  }
+  ASSERT_FALSE(library.empty());
+  std::filesystem::permissions(library, std::filesystem::perms::others_write,
+                               std::filesystem::perm_options::add);
+  CompiledTape second = CompiledTape::compile(Tape::capture(a * b), options);
+  ASSERT_EQ(second.backend(), JitBackend::Native) << second.fallback_reason();
+  EXPECT_FALSE(second.cache_hit());
+  EXPECT_EQ(std::filesystem::status(library).permissions() &
+                std::filesystem::perms::others_write,
+            std::filesystem::perms::none);
+  second.run();
+  EXPECT_DOUBLE_EQ(second.value(), -6.0);
+  EXPECT_DOUBLE_EQ(a->get_gradient(), -3.0);
+
+  std::filesystem::permissions(options.cache_dir,
+                               std::filesystem::perms::group_write,
+                               std::filesystem::perm_options::add);
+  CompiledTape third = CompiledTape::compile(Tape::capture(a * b), options);
+  EXPECT_EQ(third.backend(), JitBackend::Interpreter);
+  EXPECT_NE(third.fallback_reason().find("writable"), std::string::npos);
+}
+
+// Test that flags are split into arguments and never reach a shell.
+TEST(JitTest, FlagsAreNotShellCommands) {
+  auto a = create_value(2.0);
+  auto b = create_value(-3.0);
+  JitOptions options = fresh_options("FlagsAreNotShellCommands");
+  options.flags = "-O0  -DMICROGRAD_UNUSED=1";
+  CompiledTape jit = CompiledTape::compile(Tape::capture(a * b), options);
+  ASSERT_EQ(jit.backend(), JitBackend::Native) << jit.fallback_reason();
+
+  std::filesystem::path marker = options.cache_dir / "marker";
+  options.flags = "-O1;touch " + marker.string() + " $(touch " +
+                  marker.string() + ")";
+  CompiledTape injected = CompiledTape::compile(Tape::capture(a * b), options);
+  EXPECT_EQ(injected.backend(), JitBackend::Interpreter);
+  EXPECT_FALSE(std::filesystem::exists(marker));
+}
+
+// Test that compiled code reports division by zero like the interpreter.
+TEST(JitTest, InverseOfZeroThrows) {
+  auto a = create_value(2.0);
+  CompiledTape jit = CompiledTape::compile(
+      Tape::capture(inverse(a)), fresh_options("InverseOfZeroThrows"));
+  ASSERT_EQ(jit.backend(), JitBackend::Native) << jit.fallback_reason();
+  jit.run();
+  EXPECT_DOUBLE_EQ(jit.value(), 0.5);
+  EXPECT_DOUBLE_EQ(a->get_gradient(), -0.25);
+
+  a->set_value(0.0);
+  EXPECT_THROW(jit.run(), std::invalid_argument);
+}
@@ -0,0 +1,120 @@
+#include "../core/Loss/Loss.hpp"
+#include <cmath>
+#include <gtest/gtest.h>
+
+namespace {
+
+auto values(std::initializer_list<double> list) -> std::vector<ValuePtr> {
+  std::vector<ValuePtr> result;
+  for (double v : list) {
+    result.push_back(create_value(v));
+  }
+  return result;
+}
+
+// Central differences of loss_of() against each input's gradient
+template <typename LossOf>
+void expect_gradients(const std::vector<ValuePtr> &inputs, LossOf loss_of) {
+  loss_of()->backpropagate();
+  std::vector<double> gradients;
+  for (const ValuePtr &input : inputs) {
+    gradients.push_back(input->get_gradient());
+  }
+
+  const double h = 1e-6;
+  for (size_t i = 0; i < inputs.size(); i++) {
+    double original = inputs[i]->get_value();
+    inputs[i]->set_value(original + h);
+    double up = loss_of()->get_value();
+    inputs[i]->set_value(original - h);
+    double down = loss_of()->get_value();
+    inputs[i]->set_value(original);
+    EXPECT_NEAR(gradients[i], (up - down) / (2 * h), 1e-6) << "input " << i;
+  }
+}
+
+} // namespace
+
+// Test that MSE is a single node with the right value and gradients.
+TEST(LossTest, MseIsOneNode) {
+  auto y = values({0.5, -1.0, 2.0});
+  std::vector<double> t = {1.0, -1.5, 0.0};
+
+  ValuePtr loss = mse_loss(y, t);
+  EXPECT_EQ(loss->get_op(), ValueOp::Custom);
+  EXPECT_EQ(loss->topological_order().size(), 4u);
+  EXPECT_DOUBLE_EQ(loss->get_value(), (0.25 + 0.25 + 4.0) / 3.0);
+
+  expect_gradients(y, [&]() { return mse_loss(y, t); });
+}
+
+// Test binary cross-entropy on probabilities and on logits.
+TEST(LossTest, BinaryCrossEntropy) {
+  auto p = values({0.2, 0.9, 0.5});
+  std::vector<double> t = {0.0, 1.0, 1.0};
+  double expected = -(std::log(0.8) + std::log(0.9) + std::log(0.5)) / 3.0;
+  EXPECT_NEAR(bce_loss(p, t)->get_value(), expected, 1e-12);
+  expect_gradients(p, [&]() { return bce_loss(p, t); });
+
+  auto x = values({-2.0, 0.3, 4.0});
+  auto sigmoid = [](double v) { return 1.0 / (1.0 + std::exp(-v)); };
+  double expected_logits = -(std::log(1.0 - sigmoid(-2.0)) +
+                             std::log(sigmoid(0.3)) + std::log(sigmoid(4.0))) /
+                           3.0;
+  EXPECT_NEAR(bce_with_logits_loss(x, t)->get_value(), expected_logits, 1e-12);
+  expect_gradients(x, [&]() { return bce_with_logits_loss(x, t); });
+}
+
+// Test that saturated inputs stay finite.
+TEST(LossTest, SaturatedInputsAreFinite) {
+  auto p = values({0.0, 1.0});
+  ValuePtr clamped = bce_loss(p, {1.0, 0.0});
+  EXPECT_TRUE(std::isfinite(clamped->get_value()));
+
+  auto x = values({800.0, -800.0});
+  ValuePtr logits = bce_with_logits_loss(x, {0.0, 1.0});
+  EXPECT_NEAR(logits->get_value(), 800.0, 1e-9);
+  logits->backpropagate();
+  EXPECT_NEAR(x[0]->get_gradient(), 0.5, 1e-12);
+  EXPECT_NEAR(x[1]->get_gradient(), -0.5, 1e-12);
+}
+
+// Test softmax cross-entropy, including logits that overflow exp().
+TEST(LossTest, SoftmaxCrossEntropy) {
+  auto z = values({1.0, 2.0, 0.5});
+  double sum = std::exp(1.0) + std::exp(2.0) + std::exp(0.5);
+  EXPECT_NEAR(softmax_cross_entropy(z, 1)->get_value(),
+              -std::log(std::exp(2.0) / sum), 1e-12);
+  expect_gradients(z, [&]() { return softmax_cross_entropy(z, 1); });
+
+  auto big = values({1000.0, 1001.0, 999.0});
+  ValuePtr stable = softmax_cross_entropy(big, 1);
+  EXPECT_NEAR(stable->get_value(),
+              softmax_cross_entropy(values({1.0, 2.0, 0.0}), 1)->get_value(),
+              1e-9);
+}
+
+// Test that the batched softmax is the mean of per-sample losses.
+TEST(LossTest, BatchedSoftmaxCrossEntropy) {
+  auto a = values({0.1, -0.4, 0.3});
+  auto b = values({2.0, 1.0, -1.0});
+  ValuePtr batched = softmax_cross_entropy({a, b}, {2, 0});
+  double mean = (softmax_cross_entropy(a, 2)->get_value() +
+                 softmax_cross_entropy(b, 0)->get_value()) /
+                2.0;
+  EXPECT_NEAR(batched->get_value(), mean, 1e-12);
+
+  std::vector<ValuePtr> all(a);
+  all.insert(all.end(), b.begin(), b.end());
+  expect_gradients(all,
+                   [&]() { return softmax_cross_entropy({a, b}, {2, 0}); });
+}
+
+// Test that mismatched shapes are rejected.
+TEST(LossTest, InvalidShapesThrow) {
+  auto y = values({1.0, 2.0});
+  EXPECT_THROW(mse_loss(y, {1.0}), std::invalid_argument);
+  EXPECT_THROW(mse_loss({}, {}), std::invalid_argument);
+  EXPECT_THROW(softmax_cross_entropy(y, 2), std::invalid_argument);
+  EXPECT_THROW(softmax_cross_entropy({y}, {0, 1}), std::invalid_argument);
+}
@@ -1,6 +1,8 @@
 #include "../core/Neuron.h"
+#include <cmath>
 #include <gtest/gtest.h>
 #include <iostream>
+#include <sstream>
 
 // Example test
 TEST(NeuronTest, ExampleTest) {
@@ -71,3 +73,214 @@ TEST(NeuronTest, ZeroInputs) {
   ASSERT_GE(out_value, 0.0)
       << "Output must be non-negative even for a neuron with zero inputs.";
 }
+
+// Test that parameters() exposes every weight and bias exactly once.
+TEST(NeuronTest, ParameterCount) {
+  Neuron n(3);
+  EXPECT_EQ(n.parameters().size(), 4u);
+
+  Layer layer(3, 2);
+  EXPECT_EQ(layer.parameters().size(), 8u);
+
+  MultiLayerPerceptron mlp(3, {4, 2, 1});
+  // (3 + 1) * 4 + (4 + 1) * 2 + (2 + 1) * 1
+  EXPECT_EQ(mlp.parameters().size(), 29u);
+}
+
+// Test that graph export can collapse each neuron into a single node.
+TEST(NeuronTest, CollapsedGraphExport) {
+  Neuron n(2);
+  auto output = n({create_value(1.0), create_value(2.0)});
+
+  GraphExportOptions options;
+  options.collapse_groups = true;
+  std::string dot = output->to_dot(options);
+
+  // One neuron node plus two weights, the bias and two inputs
+  size_t nodes = 0;
+  for (size_t pos = dot.find("[label="); pos != std::string::npos;
+       pos = dot.find("[label=", pos + 1)) {
+    nodes++;
+  }
+  EXPECT_EQ(nodes, 6u);
+  EXPECT_NE(dot.find("Neuron"), std::string::npos);
+}
+
+// Test that checkpointed backward reproduces the plain parameter gradients
+// exactly.
+TEST(NeuronTest, CheckpointedGradientsMatch) {
+  MultiLayerPerceptron mlp(ModelShape{3, {4, 4, 4, 4, 4, 2}, {}}, 12);
+  std::vector<ValuePtr> params = mlp.parameters();
+  std::vector<ValuePtr> inputs = {create_value(0.5), create_value(-1.0),
+                                  create_value(2.0)};
+
+  auto plain = mlp(inputs);
+  auto plain_loss = plain[0] * plain[0] + plain[1];
+  plain_loss->backpropagate();
+
+  std::vector<double> expected;
+  for (const ValuePtr &p : params) {
+    expected.push_back(p->get_gradient());
+  }
+  double expected_input_grad = inputs[2]->get_gradient();
+
+  for (size_t interval : {1, 2, 4, 6}) {
+    auto checkpointed = mlp.forward_checkpointed(inputs, interval);
+    const auto &outputs = checkpointed.outputs();
+    EXPECT_DOUBLE_EQ(outputs[0]->get_value(), plain[0]->get_value());
+
+    auto loss = outputs[0] * outputs[0] + outputs[1];
+    loss->backpropagate();
+    checkpointed.backward();
+
+    for (size_t i = 0; i < params.size(); i++) {
+      EXPECT_DOUBLE_EQ(params[i]->get_gradient(), expected[i])
+          << "interval " << interval << ", parameter " << i;
+    }
+    // The input's contributions arrive through the first segment's
+    // boundary, summed in another order than in the plain graph
+    EXPECT_NEAR(inputs[2]->get_gradient(), expected_input_grad,
+                1e-12 * std::abs(expected_input_grad));
+  }
+}
+
+// Test that gradients the loss gives an input outside the model survive
+// the checkpointed backward.
+TEST(NeuronTest, CheckpointedKeepsOutsideInputGradients) {
+  MultiLayerPerceptron mlp(ModelShape{2, {3, 3, 3, 1}, {}}, 5);
+  std::vector<ValuePtr> inputs = {create_value(0.7), create_value(-0.4)};
+
+  // A skip term on inputs[0], plain graph first
+  auto plain_loss = mlp(inputs)[0] + inputs[0] * inputs[0];
+  plain_loss->backpropagate();
+  double expected = inputs[0]->get_gradient();
+  double expected_other = inputs[1]->get_gradient();
+
+  auto checkpointed = mlp.forward_checkpointed(inputs, 2);
+  auto loss = checkpointed.outputs()[0] + inputs[0] * inputs[0];
+  loss->backpropagate();
+  checkpointed.backward();
+  EXPECT_NEAR(inputs[0]->get_gradient(), expected, 1e-12);
+  EXPECT_NEAR(inputs[1]->get_gradient(), expected_other, 1e-12);
+}
+
+// Test that the checkpointed object survives moving the MLP.
+TEST(NeuronTest, CheckpointedSurvivesMovedModel) {
+  MultiLayerPerceptron mlp(ModelShape{2, {3, 3, 1}, {}}, 6);
+  std::vector<ValuePtr> params = mlp.parameters();
+  std::vector<ValuePtr> inputs = {create_value(0.3), create_value(1.1)};
+  mlp(inputs)[0]->backpropagate();
+  std::vector<double> expected;
+  for (const ValuePtr &p : params) {
+    expected.push_back(p->get_gradient());
+  }
+
+  auto checkpointed = mlp.forward_checkpointed(inputs, 1);
+  MultiLayerPerceptron moved = std::move(mlp);
+  checkpointed.outputs()[0]->backpropagate();
+  checkpointed.backward();
+  for (size_t i = 0; i < params.size(); i++) {
+    EXPECT_DOUBLE_EQ(params[i]->get_gradient(), expected[i]);
+  }
+}
+
+// Test that checkpointing shrinks the live graph of a deep network.
+TEST(NeuronTest, CheckpointedPeakNodes) {
+  MultiLayerPerceptron mlp(4, std::vector<size_t>(16, 4));
+  std::vector<ValuePtr> inputs(4, create_value(1.0));
+
+  auto full = mlp.forward_checkpointed(inputs, 16, true);
+  auto sqrt_depth = mlp.forward_checkpointed(inputs, 0, true);
+
+  EXPECT_EQ(sqrt_depth.interval(), 4u);
+  EXPECT_LT(sqrt_depth.peak_nodes() * 3, full.peak_nodes());
+}
+
+// Test that every neuron of a layer owns its own weights.
+TEST(NeuronTest, LayerNeuronsAreIndependent) {
+  Layer layer(3, 4);
+  std::vector<ValuePtr> params = layer.parameters();
+  for (size_t i = 0; i < params.size(); i++) {
+    for (size_t j = i + 1; j < params.size(); j++) {
+      EXPECT_NE(params[i], params[j]);
+    }
+  }
+}
+
+// Test that a seeded MLP survives a save and load unchanged.
+TEST(NeuronTest, SaveLoadRoundTrip) {
+  MultiLayerPerceptron mlp(3, {4, 2}, 7);
+  EXPECT_EQ(mlp.parameter_values(),
+            MultiLayerPerceptron(3, {4, 2}, 7).parameter_values());
+
+  std::stringstream file;
+  mlp.save(file);
+  MultiLayerPerceptron loaded = MultiLayerPerceptron::load(file);
+
+  EXPECT_EQ(loaded.shape(), mlp.shape());
+  EXPECT_EQ(loaded.parameter_values(), mlp.parameter_values());
+}
+
+// Test every activation against its definition and finite differences.
+TEST(NeuronTest, ConfigurableActivations) {
+  const Activation activations[] = {
+      Activation::Relu,    Activation::LeakyRelu, Activation::Tanh,
+      Activation::Sigmoid, Activation::Gelu,      Activation::Identity};
+  for (Activation activation : activations) {
+    Neuron n(3, activation);
+    std::vector<ValuePtr> params = n.parameters();
+    std::vector<ValuePtr> inputs = {create_value(0.3), create_value(-0.7),
+                                    create_value(0.2)};
+
+    double z = params[3]->get_value();
+    for (size_t i = 0; i < 3; i++) {
+      z += inputs[i]->get_value() * params[i]->get_value();
+    }
+    ValuePtr output = n(inputs);
+    EXPECT_DOUBLE_EQ(output->get_value(), apply_activation(activation, z))
+        << activation_name(activation);
+    EXPECT_EQ(output->get_op(), ValueOp::FmaActivate);
+
+    output->backpropagate();
+    const double h = 1e-6;
+    for (size_t i = 0; i < 3; i++) {
+      double original = inputs[i]->get_value();
+      inputs[i]->set_value(original + h);
+      double up = n(inputs)->get_value();
+      inputs[i]->set_value(original - h);
+      double down = n(inputs)->get_value();
+      inputs[i]->set_value(original);
+      EXPECT_NEAR(inputs[i]->get_gradient(), (up - down) / (2 * h), 1e-6)
+          << activation_name(activation) << ", input " << i;
+    }
+  }
+}
+
+// Test that the activation costs no node of its own.
+TEST(NeuronTest, ActivationIsFused) {
+  Neuron n(3);
+  ValuePtr output =
+      n({create_value(1.0), create_value(2.0), create_value(3.0)});
+  // 3 inputs, 3 weights and the bias, then 2 Mul, 2 Add and the output
+  EXPECT_EQ(output->topological_order().size(), 12u);
+
+  Neuron bias_only(0, Activation::Sigmoid);
+  ValuePtr constant_output = bias_only(std::vector<ValuePtr>{});
+  EXPECT_EQ(constant_output->get_op(), ValueOp::Activate);
+}
+
+// Test per-layer activations and that they survive a save and load.
+TEST(NeuronTest, MlpLayerActivations) {
+  ModelShape shape{2, {4, 1}, {Activation::Tanh, Activation::Identity}};
+  MultiLayerPerceptron mlp(shape, 3);
+  EXPECT_EQ(mlp.shape().activation(1), Activation::Identity);
+
+  std::stringstream file;
+  mlp.save(file);
+  MultiLayerPerceptron loaded = MultiLayerPerceptron::load(file);
+  EXPECT_EQ(loaded.shape(), shape);
+
+  std::vector<ValuePtr> inputs = {create_value(0.5), create_value(-2.0)};
+  EXPECT_DOUBLE_EQ(loaded(inputs)[0]->get_value(),
+                   mlp(inputs)[0]->get_value());
+}
@@ -0,0 +1,128 @@
+#include "../core/Train/Pipeline.hpp"
+#include "test_helpers.hpp"
+#include <gtest/gtest.h>
+#include <stdexcept>
+
+namespace {
+
+constexpr size_t kSteps = 12;
+constexpr size_t kBatch = 4;
+
+// y = |x0 - x1|, deterministic per step
+auto loader(size_t steps) -> BatchLoader {
+  return [steps](size_t step, TrainBatch &batch) {
+    if (step >= steps) {
+      return false;
+    }
+    batch.size = kBatch;
+    batch.inputs.resize(2 * kBatch);
+    batch.targets.resize(kBatch);
+    for (size_t i = 0; i < kBatch; i++) {
+      double x0 = 0.1 * static_cast<double>((step + i) % 7);
+      double x1 = 0.05 * static_cast<double>((3 * step + i) % 5);
+      batch.inputs[2 * i] = x0;
+      batch.inputs[2 * i + 1] = x1;
+      batch.targets[i] = std::abs(x0 - x1);
+    }
+    return true;
+  };
+}
+
+// Delayed SGD by hand: step s applies the gradient taken at the weights
+// from after step s - 2
+auto delayed_sgd(const ModelShape &shape, double lr) -> std::vector<double> {
+  MultiLayerPerceptron mlp(shape, 3);
+  std::vector<ValuePtr> params = mlp.parameters();
+  std::vector<std::vector<double>> history = {mlp.parameter_values(),
+                                              mlp.parameter_values()};
+  BatchLoader load = loader(kSteps);
+  TrainBatch batch;
+  for (size_t step = 0; step < kSteps; step++) {
+    load(step, batch);
+    mlp.set_parameters(history[history.size() - 2]);
+    mse(mlp, batch)->backpropagate();
+    std::vector<double> next = history.back();
+    for (size_t i = 0; i < params.size(); i++) {
+      next[i] -= lr * params[i]->get_gradient();
+    }
+    history.push_back(next);
+  }
+  return history.back();
+}
+
+} // namespace
+
+// Test that the serial mode is plain SGD.
+TEST(PipelineTest, SerialIsSgd) {
+  ModelShape shape{2, {6, 1}, {}};
+  MultiLayerPerceptron trained(shape, 3);
+  PipelinedTrainer trainer(trained, PipelineOptions{0.05, false});
+  PipelineStats stats = trainer.run(loader(kSteps), mse);
+  EXPECT_EQ(stats.steps, kSteps);
+  EXPECT_EQ(stats.losses.size(), kSteps);
+
+  MultiLayerPerceptron manual(shape, 3);
+  std::vector<ValuePtr> params = manual.parameters();
+  BatchLoader load = loader(kSteps);
+  TrainBatch batch;
+  for (size_t step = 0; step < kSteps; step++) {
+    load(step, batch);
+    mse(manual, batch)->backpropagate();
+    for (const ValuePtr &p : params) {
+      p->set_value(p->get_value() - 0.05 * p->get_gradient());
+    }
+  }
+  EXPECT_EQ(trained.parameter_values(), manual.parameter_values());
+}
+
+// Test that the pipeline computes delayed SGD exactly, run after run.
+TEST(PipelineTest, PipelinedIsDelayedSgd) {
+  ModelShape shape{2, {6, 1}, {}};
+  std::vector<double> expected = delayed_sgd(shape, 0.05);
+  for (int run = 0; run < 3; run++) {
+    MultiLayerPerceptron mlp(shape, 3);
+    PipelinedTrainer trainer(mlp, PipelineOptions{0.05, true});
+    PipelineStats stats = trainer.run(loader(kSteps), mse);
+    EXPECT_EQ(stats.steps, kSteps);
+    EXPECT_EQ(mlp.parameter_values(), expected) << "run " << run;
+  }
+}
+
+// Test that both modes still learn.
+TEST(PipelineTest, LossDecreases) {
+  for (bool pipelined : {false, true}) {
+    MultiLayerPerceptron mlp(
+        ModelShape{2, {8, 1}, {Activation::Relu, Activation::Identity}}, 4);
+    PipelinedTrainer trainer(mlp, PipelineOptions{0.05, pipelined});
+    PipelineStats stats = trainer.run(loader(200), mse);
+    double first = 0.0;
+    double last = 0.0;
+    for (size_t i = 0; i < 20; i++) {
+      first += stats.losses[i];
+      last += stats.losses[stats.losses.size() - 1 - i];
+    }
+    EXPECT_LT(last, first) << (pipelined ? "pipelined" : "serial");
+  }
+}
+
+// Test that a failing stage stops the pipeline and reaches the caller.
+TEST(PipelineTest, Errors) {
+  MultiLayerPerceptron mlp(ModelShape{2, {3, 1}, {}}, 5);
+  PipelinedTrainer trainer(mlp, PipelineOptions{0.05, true});
+
+  BatchLoader good = loader(kSteps);
+  BatchLoader failing = [&](size_t step, TrainBatch &batch) -> bool {
+    if (step == 5) {
+      throw std::runtime_error("bad shard");
+    }
+    return good(step, batch);
+  };
+  EXPECT_THROW(trainer.run(failing, mse), std::runtime_error);
+
+  LossBuilder throwing = [](MultiLayerPerceptron &, const TrainBatch &)
+      -> ValuePtr { throw std::invalid_argument("bad batch"); };
+  EXPECT_THROW(trainer.run(loader(kSteps), throwing), std::invalid_argument);
+
+  PipelineStats empty = trainer.run(loader(0), mse);
+  EXPECT_EQ(empty.steps, 0u);
+}
@@ -0,0 +1,125 @@
+#include "../core/Graph/Optimize.hpp"
+#include "../core/Graph/Plan.hpp"
+#include "../core/Neuron.h"
+#include <gtest/gtest.h>
+
+namespace {
+
+// Runs the tape and the plan from the same leaves and compares them
+void expect_same_as_tape(Tape &tape, PlannedTape &planned,
+                         const std::vector<ValuePtr> &leaves) {
+  tape.forward();
+  tape.backward();
+  std::vector<double> expected;
+  for (const ValuePtr &leaf : leaves) {
+    expected.push_back(leaf->get_gradient());
+    leaf->set_gradient(-1.0);
+  }
+  planned.run();
+  EXPECT_DOUBLE_EQ(planned.value(), tape.value(tape.root()));
+  for (size_t i = 0; i < leaves.size(); i++) {
+    EXPECT_DOUBLE_EQ(leaves[i]->get_gradient(), expected[i]) << i;
+  }
+}
+
+} // namespace
+
+// Test that a planned MLP loss replays exactly and needs less memory.
+TEST(PlanTest, MatchesTapeOnNetwork) {
+  ModelShape shape{3, {6, 6, 1}, {Activation::Relu, Activation::Tanh,
+                                  Activation::Sigmoid}};
+  MultiLayerPerceptron mlp(shape, 5);
+  std::vector<ValuePtr> inputs = {create_value(0.5), create_value(-1.0),
+                                  create_value(2.0)};
+  ValuePtr diff = mlp(inputs)[0] - create_constant(0.25);
+  Tape tape = optimize(Tape::capture(diff * diff));
+  PlannedTape planned = PlannedTape::plan(tape);
+
+  const MemoryPlanStats &stats = planned.stats();
+  EXPECT_EQ(stats.naive_bytes, 2 * tape.size() * sizeof(double));
+  EXPECT_LT(stats.planned_bytes, stats.naive_bytes);
+
+  std::vector<ValuePtr> leaves = mlp.parameters();
+  leaves.insert(leaves.end(), inputs.begin(), inputs.end());
+  expect_same_as_tape(tape, planned, leaves);
+
+  // Replays with new leaf values too
+  inputs[1]->set_value(0.75);
+  mlp.parameters()[4]->set_value(-0.3);
+  expect_same_as_tape(tape, planned, leaves);
+}
+
+// Test that a relu over a value nothing else reads runs in place.
+TEST(PlanTest, ReluRunsInPlace) {
+  auto a = create_value(2.0);
+  auto b = create_value(-3.0);
+  auto sum = a + b;
+  auto y = relu(sum) * a;
+  Tape tape = Tape::capture(y);
+  PlannedTape planned = PlannedTape::plan(tape);
+
+  u32 sum_node = tape.node(tape.root()).inputs[0] - 1;
+  ASSERT_EQ(tape.node(sum_node).op, ValueOp::Add);
+  u32 relu_node = sum_node + 1;
+  ASSERT_EQ(tape.node(relu_node).op, ValueOp::Relu);
+  EXPECT_EQ(planned.value_slot(relu_node), planned.value_slot(sum_node));
+  EXPECT_GE(planned.stats().in_place, 1u);
+  expect_same_as_tape(tape, planned, {a, b});
+
+  a->set_value(5.0);
+  expect_same_as_tape(tape, planned, {a, b});
+}
+
+// Test that a value the backward pass needs is not overwritten in place.
+TEST(PlanTest, KeepsValuesBackwardReads) {
+  auto a = create_value(1.5);
+  auto square = a * a;             // Backward reads a
+  auto y = inverse(square) * a;    // Backward reads inverse's output and a
+  Tape tape = Tape::capture(y);
+  PlannedTape planned = PlannedTape::plan(tape);
+  for (u32 i = 0; i < tape.size(); i++) {
+    if (tape.node(i).op == ValueOp::Mul && tape.node(i).inputs[0] == 0) {
+      EXPECT_NE(planned.value_slot(i), planned.value_slot(0));
+    }
+  }
+  expect_same_as_tape(tape, planned, {a});
+}
+
+// Test that leaves the root does not depend on get a zero gradient.
+TEST(PlanTest, UnreachedLeaves) {
+  auto a = create_value(2.0);
+  auto b = create_value(3.0);
+  Tape tape;
+  u32 la = tape.push_leaf(a);
+  u32 lb = tape.push_leaf(b);
+  u32 unused = tape.push(ValueOp::Mul, {lb, lb});
+  (void)unused;
+  u32 root = tape.push(ValueOp::Mul, {la, la});
+  tape.set_root(root);
+  PlannedTape planned = PlannedTape::plan(tape);
+  EXPECT_EQ(planned.gradient_slot(lb), PlannedTape::kNoSlot);
+
+  b->set_gradient(7.0);
+  planned.run();
+  EXPECT_DOUBLE_EQ(planned.value(), 4.0);
+  EXPECT_DOUBLE_EQ(a->get_gradient(), 4.0);
+  EXPECT_DOUBLE_EQ(b->get_gradient(), 0.0);
+}
+
+// Test that the root's gradient does not clobber an operand its own backward
+// step reads when their slots coincide.
+TEST(PlanTest, RootGradientKeepsOperands) {
+  auto a = create_value(1.5);
+  auto b = create_value(0.7);
+  auto n2 = a + b;
+  auto n3 = b + a;
+  auto n4 = n2 + b;
+  auto n5 = n3 + n4;
+  Tape tape = Tape::capture(n5 * n5);
+  PlannedTape planned = PlannedTape::plan(tape);
+  expect_same_as_tape(tape, planned, {a, b});
+
+  a->set_value(2.0);
+  b->set_value(-0.4);
+  expect_same_as_tape(tape, planned, {a, b});
+}
@@ -0,0 +1,136 @@
+#include "../core/Neuron.h"
+#include "../core/Profile/Profile.hpp"
+#include <gtest/gtest.h>
+#include <sstream>
+#include <thread>
+
+// The recording functions are always available, the macros that call them
+// from the engine only exist in MICROGRAD_PROFILE builds.
+
+TEST(ProfileTest, RecordsOpCounters) {
+  profile::reset();
+  profile::record_op(profile::Op::Add, 100);
+  profile::record_op(profile::Op::Add, 50);
+  profile::record_op(profile::Op::Relu, 10);
+  profile::record_backward(profile::Op::Add, 2, 30);
+
+  const profile::Stats &stats = profile::stats();
+  const profile::OpStats &add = stats.ops[static_cast<size_t>(profile::Op::Add)];
+  EXPECT_EQ(add.count, 2u);
+  EXPECT_EQ(add.forward_ns, 150u);
+  EXPECT_EQ(add.backward_ns, 30u);
+  EXPECT_EQ(stats.backward_layer_ns[2], 30u);
+  EXPECT_EQ(stats.ops[static_cast<size_t>(profile::Op::Relu)].count, 1u);
+}
+
+TEST(ProfileTest, ArenaHighWater) {
+  profile::reset();
+  profile::record_arena_push(64, 64);
+  profile::record_arena_push(32, 96);
+  profile::record_arena_push(16, 16);
+
+  EXPECT_EQ(profile::stats().arena_bytes_pushed, 112u);
+  EXPECT_EQ(profile::stats().arena_high_water, 96u);
+}
+
+TEST(ProfileTest, ChromeTraceFormat) {
+  profile::reset();
+  profile::record_event("forward", profile::now_ns(), 2000);
+  profile::record_counter("forward nodes", 42);
+
+  std::stringstream ss;
+  profile::write_chrome_trace(ss);
+  std::string trace = ss.str();
+  EXPECT_NE(trace.find("\"traceEvents\""), std::string::npos);
+  EXPECT_NE(trace.find("\"ph\": \"X\""), std::string::npos);
+  EXPECT_NE(trace.find("\"dur\": 2.000"), std::string::npos);
+  EXPECT_NE(trace.find("\"args\": {\"value\": 42}"), std::string::npos);
+}
+
+TEST(ProfileTest, SummaryTable) {
+  profile::reset();
+  profile::record_op(profile::Op::Mul, 1000);
+  profile::record_forward_pass(7);
+
+  std::stringstream ss;
+  profile::write_summary(ss);
+  EXPECT_NE(ss.str().find("mul"), std::string::npos);
+  EXPECT_NE(ss.str().find("nodes/pass 7"), std::string::npos);
+}
+
+// Test that threads record into their own buffers and stats() merges them.
+TEST(ProfileTest, MergesThreads) {
+  profile::reset();
+  constexpr size_t kThreads = 4;
+  constexpr u64 kOps = 10000;
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < kThreads; t++) {
+    threads.emplace_back([t] {
+      profile::set_current_layer(t + 1);
+      for (u64 i = 0; i < kOps; i++) {
+        profile::record_op(profile::Op::Add, 1);
+        profile::record_backward(profile::Op::Add, profile::current_layer(),
+                                 2);
+      }
+      profile::record_arena_push(8, 100 * (t + 1));
+      profile::record_event("step", profile::now_ns(), 1000);
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  profile::Stats stats = profile::stats();
+  const profile::OpStats &add = stats.ops[static_cast<size_t>(profile::Op::Add)];
+  EXPECT_EQ(add.count, kThreads * kOps);
+  EXPECT_EQ(add.forward_ns, kThreads * kOps);
+  EXPECT_EQ(add.backward_ns, 2 * kThreads * kOps);
+  for (size_t layer = 1; layer <= kThreads; layer++) {
+    EXPECT_EQ(stats.backward_layer_ns[layer], 2 * kOps);
+  }
+  EXPECT_EQ(stats.max_layer, kThreads);
+  EXPECT_EQ(stats.arena_bytes_pushed, 8 * kThreads);
+  EXPECT_EQ(stats.arena_high_water, 100 * kThreads);
+  // The main thread's layer is its own
+  EXPECT_EQ(profile::current_layer(), 0u);
+
+  std::stringstream ss;
+  profile::write_chrome_trace(ss);
+  size_t steps = 0;
+  for (size_t at = ss.str().find("\"step\""); at != std::string::npos;
+       at = ss.str().find("\"step\"", at + 1)) {
+    steps++;
+  }
+  EXPECT_EQ(steps, kThreads);
+}
+
+#if MICROGRAD_PROFILE
+TEST(ProfileTest, EngineInstrumentation) {
+  profile::reset();
+  MultiLayerPerceptron mlp(2, {3, 1});
+  auto output = mlp({create_value(1.0), create_value(2.0)});
+  output[0]->backpropagate();
+
+  const profile::Stats &stats = profile::stats();
+  // Every input but a neuron's last is a Mul, the last one is fused into
+  // the activation: 3 neurons x 1 + 1 neuron x 2
+  EXPECT_EQ(stats.ops[static_cast<size_t>(profile::Op::Mul)].count, 5u);
+  EXPECT_EQ(stats.ops[static_cast<size_t>(profile::Op::Activate)].count, 4u);
+  EXPECT_EQ(stats.forward_passes, 1u);
+  // 2n - 1 nodes for an n-input neuron
+  EXPECT_EQ(stats.max_forward_nodes, 14u);
+  EXPECT_EQ(stats.backward_passes, 1u);
+  EXPECT_GT(stats.backward_layer_ns[1] + stats.backward_layer_ns[2], 0u);
+}
+#else
+TEST(ProfileTest, CompiledOut) {
+  profile::reset();
+  auto a = create_value(1.0);
+  auto b = a * a + a;
+  b->backpropagate();
+
+  EXPECT_EQ(profile::stats().nodes_created, 0u);
+  EXPECT_EQ(profile::stats().ops[static_cast<size_t>(profile::Op::Mul)].count,
+            0u);
+}
+#endif
@@ -0,0 +1,149 @@
+#include "../core/Quant/Quantize.hpp"
+#include "test_helpers.hpp"
+#include <cmath>
+#include <gtest/gtest.h>
+
+namespace {
+
+// Mean absolute error against the f64 model, relative to the output range
+auto relative_error(const MultiLayerPerceptron &mlp, const QuantizedMLP &q,
+                    const std::vector<std::vector<double>> &test) -> double {
+  std::vector<double> scratch(2 * mlp.max_width());
+  std::vector<double> expected(mlp.num_outputs());
+  std::vector<f32> input(mlp.num_inputs());
+  std::vector<f32> actual(mlp.num_outputs());
+  QuantizedMLP::Workspace workspace = q.workspace();
+  double error = 0.0;
+  double low = 0.0;
+  double high = 0.0;
+  for (const std::vector<double> &x : test) {
+    mlp.evaluate(x.data(), expected.data(), scratch.data());
+    std::copy(x.begin(), x.end(), input.begin());
+    q.run(input.data(), actual.data(), workspace);
+    for (size_t o = 0; o < expected.size(); o++) {
+      error += std::abs(actual[o] - expected[o]);
+      low = std::min(low, expected[o]);
+      high = std::max(high, expected[o]);
+    }
+  }
+  return error / (test.size() * mlp.num_outputs()) / (high - low);
+}
+
+} // namespace
+
+// Test that the quantized model tracks the f64 model.
+TEST(QuantTest, CloseToFloat) {
+  ModelShape shape{20, {48, 33, 4},
+                   {Activation::Relu, Activation::Tanh, Activation::Identity}};
+  MultiLayerPerceptron mlp(shape, 3, InitScheme::HeUniform);
+  QuantizedMLP per_channel =
+      QuantizedMLP::quantize(mlp, sample_rows(256, 20, 1));
+  QuantizedMLP per_layer = QuantizedMLP::quantize(
+      mlp, sample_rows(256, 20, 1), QuantGranularity::PerLayer);
+
+  auto test = sample_rows(64, 20, 2);
+  double channel_error = relative_error(mlp, per_channel, test);
+  double layer_error = relative_error(mlp, per_layer, test);
+  EXPECT_LT(channel_error, 0.01);
+  EXPECT_LT(layer_error, 0.02);
+}
+
+// Test that per-channel scales keep a neuron with small weights, which a
+// shared scale rounds to almost nothing.
+TEST(QuantTest, PerChannelKeepsSmallRows) {
+  ModelShape shape{8, {2}, {Activation::Identity}};
+  MultiLayerPerceptron mlp(shape, 9);
+  std::vector<double> params = mlp.parameter_values();
+  for (size_t i = 9; i < 17; i++) {
+    params[i] *= 0.001;
+  }
+  mlp.set_parameters(params);
+
+  auto calibration = sample_rows(64, 8, 10);
+  QuantizedMLP per_channel = QuantizedMLP::quantize(mlp, calibration);
+  QuantizedMLP per_layer =
+      QuantizedMLP::quantize(mlp, calibration, QuantGranularity::PerLayer);
+
+  // Errors relative to the neuron's weighted sum, the bias is kept in f32
+  // either way
+  double channel_error = 0.0;
+  double layer_error = 0.0;
+  double magnitude = 0.0;
+  std::vector<double> scratch(2 * mlp.max_width());
+  for (const std::vector<double> &x : sample_rows(32, 8, 11)) {
+    double expected[2];
+    mlp.evaluate(x.data(), expected, scratch.data());
+    std::vector<f32> input(x.begin(), x.end());
+    channel_error += std::abs(per_channel(input)[1] - expected[1]);
+    layer_error += std::abs(per_layer(input)[1] - expected[1]);
+    magnitude += std::abs(expected[1] - params[17]);
+  }
+  EXPECT_LT(channel_error / magnitude, 0.1);
+  EXPECT_GT(layer_error / magnitude, 0.5);
+}
+
+// Test that both kernels give the same bits.
+TEST(QuantTest, KernelsAgree) {
+  if (!avx2_supported()) {
+    GTEST_SKIP() << "no AVX2 on this CPU";
+  }
+  MultiLayerPerceptron mlp(ModelShape{70, {40, 5}, {}}, 4);
+  QuantizedMLP q = QuantizedMLP::quantize(mlp, sample_rows(32, 70, 5));
+  std::vector<f32> scalar(5);
+  std::vector<f32> avx2(5);
+  QuantizedMLP::Workspace workspace = q.workspace();
+  for (const std::vector<double> &x : sample_rows(16, 70, 6)) {
+    std::vector<f32> input(x.begin(), x.end());
+    q.run(input.data(), scalar.data(), workspace, QuantKernel::Scalar);
+    q.run(input.data(), avx2.data(), workspace, QuantKernel::Avx2);
+    EXPECT_EQ(scalar, avx2);
+  }
+}
+
+// Test the layout: padded int8 rows, 7-bit codes, zero point at zero for
+// relu outputs.
+TEST(QuantTest, Layout) {
+  MultiLayerPerceptron mlp(ModelShape{3, {8, 2}, {}}, 7);
+  QuantizedMLP q = QuantizedMLP::quantize(mlp, sample_rows(16, 3, 8));
+  ASSERT_EQ(q.layers().size(), 2u);
+
+  const QuantizedLayer &first = q.layers()[0];
+  EXPECT_EQ(first.stride, 32u);
+  EXPECT_EQ(q.weight_bytes(), 8u * 32 + 2u * 32);
+  EXPECT_GT(first.input_zero_point, 0);
+  EXPECT_EQ(q.layers()[1].input_zero_point, 0);
+
+  for (size_t o = 0; o < first.outputs; o++) {
+    i32 sum = 0;
+    i32 largest = 0;
+    for (size_t i = 0; i < first.stride; i++) {
+      i8 w = first.weights[o * first.stride + i];
+      sum += w;
+      largest = std::max(largest, std::abs(static_cast<i32>(w)));
+      if (i >= first.inputs) {
+        EXPECT_EQ(w, 0);
+      }
+    }
+    EXPECT_EQ(sum, first.weight_sums[o]);
+    // Per channel, every row reaches the end of the code range
+    EXPECT_EQ(largest, 127);
+  }
+}
+
+// Test argument checking.
+TEST(QuantTest, Errors) {
+  MultiLayerPerceptron mlp(ModelShape{3, {2}, {}}, 1);
+  EXPECT_THROW(QuantizedMLP::quantize(mlp, {}), std::invalid_argument);
+  EXPECT_THROW(QuantizedMLP::quantize(mlp, {{1.0, 2.0}}),
+               std::invalid_argument);
+  QuantizedMLP q = QuantizedMLP::quantize(mlp, {{1.0, 2.0, 3.0}});
+  EXPECT_THROW(q({1.0F}), std::runtime_error);
+
+  // A workspace from a narrower model is refused
+  MultiLayerPerceptron wide(ModelShape{3, {40}, {}}, 1);
+  QuantizedMLP large = QuantizedMLP::quantize(wide, {{1.0, 2.0, 3.0}});
+  QuantizedMLP::Workspace small = q.workspace();
+  std::vector<f32> in(3);
+  std::vector<f32> out(40);
+  EXPECT_THROW(large.run(in.data(), out.data(), small), std::invalid_argument);
+}
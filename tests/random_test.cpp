@@ -0,0 +1,108 @@
+#include "../core/Model/StaticMLP.hpp"
+#include "../core/Neuron.h"
+#include "../core/Random/Philox.hpp"
+#include <cmath>
+#include <gtest/gtest.h>
+
+// Test against the Random123 known-answer vectors for Philox4x32-10.
+TEST(RandomTest, PhiloxKnownAnswers) {
+  philox::Counter zero =
+      philox::generate(philox::Counter{0, 0, 0, 0}, philox::Key{0, 0});
+  EXPECT_EQ(zero, (philox::Counter{0x6627e8d5, 0xe169c58d, 0xbc57ac4c,
+                                   0x9b00dbd8}));
+
+  philox::Counter ones = philox::generate(
+      philox::Counter{0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+      philox::Key{0xffffffff, 0xffffffff});
+  EXPECT_EQ(ones, (philox::Counter{0x408f276d, 0x41c83b0e, 0xa20bc7c6,
+                                   0x6d5451fd}));
+}
+
+// Test that the thread count does not change a single bit.
+TEST(RandomTest, ThreadCountIndependent) {
+  ModelShape shape{300, {400, 200, 10}, {}};
+  for (InitScheme scheme : {InitScheme::Uniform, InitScheme::HeNormal}) {
+    std::vector<double> serial = initial_parameters(shape, 9, scheme, 1);
+    for (size_t threads : {2, 3, 8}) {
+      EXPECT_EQ(initial_parameters(shape, 9, scheme, threads), serial)
+          << threads << " threads";
+    }
+  }
+}
+
+// Test that any parameter can be drawn on its own.
+TEST(RandomTest, RandomAccess) {
+  ModelShape shape{3, {4, 2}, {}};
+  std::vector<double> parameters =
+      initial_parameters(shape, 5, InitScheme::XavierUniform);
+  // Layer 1, neuron 1, weight 2: after 4 * 4 + 5 parameters
+  EXPECT_EQ(parameters[4 * 4 + 5 + 2],
+            initial_parameter(5, InitScheme::XavierUniform, 1, 1, 2, 4, 2));
+  EXPECT_NE(initial_parameters(shape, 6, InitScheme::XavierUniform),
+            parameters);
+}
+
+// Test the scale of each scheme on a wide layer.
+TEST(RandomTest, SchemeStatistics) {
+  const size_t fan_in = 500;
+  const size_t fan_out = 300;
+  ModelShape shape{fan_in, {fan_out, 1}, {}};
+
+  struct Case {
+    InitScheme scheme;
+    double variance;
+  };
+  const Case cases[] = {
+      {InitScheme::Uniform, 1.0 / 3.0},
+      {InitScheme::XavierUniform, 2.0 / (fan_in + fan_out)},
+      {InitScheme::XavierNormal, 2.0 / (fan_in + fan_out)},
+      {InitScheme::HeUniform, 2.0 / fan_in},
+      {InitScheme::HeNormal, 2.0 / fan_in},
+  };
+  for (const Case &c : cases) {
+    std::vector<double> parameters = initial_parameters(shape, 1, c.scheme);
+    double sum = 0.0;
+    double squares = 0.0;
+    size_t count = 0;
+    for (size_t n = 0; n < fan_out; n++) {
+      for (size_t i = 0; i < fan_in; i++) {
+        double w = parameters[n * (fan_in + 1) + i];
+        sum += w;
+        squares += w * w;
+        count++;
+      }
+      double bias = parameters[n * (fan_in + 1) + fan_in];
+      if (c.scheme != InitScheme::Uniform) {
+        EXPECT_EQ(bias, 0.0);
+      }
+    }
+    double mean = sum / count;
+    EXPECT_NEAR(mean, 0.0, 0.01 * std::sqrt(c.variance) * 10);
+    EXPECT_NEAR(squares / count, c.variance, 0.02 * c.variance)
+        << static_cast<int>(c.scheme);
+  }
+}
+
+// Test that seeded models of both kinds take the buffer as is.
+TEST(RandomTest, ModelsUseScheme) {
+  ModelShape shape{3, {8, 4, 2}, {}};
+  std::vector<double> expected =
+      initial_parameters(shape, 11, InitScheme::HeUniform);
+  MultiLayerPerceptron dynamic(shape, 11, InitScheme::HeUniform);
+  EXPECT_EQ(dynamic.parameter_values(), expected);
+
+  StaticMLP<3, 8, 4, 2> fixed(11, {}, InitScheme::HeUniform);
+  EXPECT_EQ(fixed.parameters(), expected);
+}
+
+// Test that unseeded neurons draw distinct weights in [-1, 1].
+TEST(RandomTest, UnseededNeuronsDiffer) {
+  Layer layer(4, 3);
+  std::vector<ValuePtr> params = layer.parameters();
+  for (const ValuePtr &p : params) {
+    EXPECT_GE(p->get_value(), -1.0);
+    EXPECT_LT(p->get_value(), 1.0);
+  }
+  EXPECT_NE(params[0]->get_value(), params[5]->get_value());
+  EXPECT_NE(params[5]->get_value(), params[10]->get_value());
+}
@@ -0,0 +1,120 @@
+#include "../core/Serve/BatchEngine.hpp"
+#include <gtest/gtest.h>
+#include <sstream>
+
+namespace {
+
+auto expected_output(const MultiLayerPerceptron &mlp,
+                     const std::vector<double> &input) -> std::vector<double> {
+  std::vector<double> scratch(2 * mlp.max_width());
+  std::vector<double> output(mlp.num_outputs());
+  mlp.evaluate(input.data(), output.data(), scratch.data());
+  return output;
+}
+
+} // namespace
+
+// Test that the batched forward pass is the MLP's function, bit for bit.
+TEST(ServeTest, BatchedForwardMatches) {
+  ModelShape shape{3, {6, 4, 2},
+                   {Activation::Tanh, Activation::Relu, Activation::Identity}};
+  MultiLayerPerceptron mlp(shape, 5);
+  BatchedMLP batched(mlp);
+
+  std::vector<double> inputs = {0.1, -0.2, 0.3, 1.5, 0.0, -2.0, 0.7, 0.7, 0.7};
+  std::vector<double> outputs(3 * 2);
+  batched.forward(inputs.data(), 3, outputs.data());
+  for (size_t b = 0; b < 3; b++) {
+    std::vector<double> expected = expected_output(
+        mlp, std::vector<double>(inputs.begin() + 3 * b,
+                                 inputs.begin() + 3 * b + 3));
+    EXPECT_EQ(outputs[2 * b], expected[0]);
+    EXPECT_EQ(outputs[2 * b + 1], expected[1]);
+  }
+}
+
+// Test concurrent submitters each get their own result back.
+TEST(ServeTest, ConcurrentSubmit) {
+  MultiLayerPerceptron mlp(ModelShape{2, {8, 1}, {}}, 6);
+  InferenceEngine engine(mlp, BatchingOptions{8, std::chrono::microseconds(200)});
+
+  const size_t kThreads = 4;
+  const size_t kPerThread = 50;
+  std::vector<std::thread> clients;
+  std::vector<int> mismatches(kThreads, 0);
+  for (size_t t = 0; t < kThreads; t++) {
+    clients.emplace_back([&, t] {
+      for (size_t i = 0; i < kPerThread; i++) {
+        std::vector<double> x = {0.01 * i, -0.1 * t};
+        std::vector<double> y = engine.submit(x).get();
+        mismatches[t] += y != expected_output(mlp, x) ? 1 : 0;
+      }
+    });
+  }
+  for (std::thread &client : clients) {
+    client.join();
+  }
+  EXPECT_EQ(mismatches, std::vector<int>(kThreads, 0));
+
+  InferenceStats stats = engine.stats();
+  EXPECT_EQ(stats.requests, kThreads * kPerThread);
+  u64 batched = 0;
+  for (size_t n = 0; n < stats.batch_sizes.size(); n++) {
+    batched += n * stats.batch_sizes[n];
+  }
+  EXPECT_EQ(batched, stats.requests);
+  EXPECT_LE(stats.p50_us, stats.p99_us);
+  EXPECT_LE(stats.p99_us, stats.max_us);
+}
+
+// Test that a full queue is served without waiting for the deadline.
+TEST(ServeTest, FullBatches) {
+  MultiLayerPerceptron mlp(ModelShape{2, {3}, {}}, 7);
+  InferenceEngine engine(mlp, BatchingOptions{4, std::chrono::seconds(10)});
+
+  std::vector<std::future<std::vector<double>>> results;
+  for (int i = 0; i < 8; i++) {
+    results.push_back(engine.submit({1.0 * i, 2.0}));
+  }
+  for (auto &result : results) {
+    EXPECT_EQ(result.get().size(), 3u);
+  }
+  InferenceStats stats = engine.stats();
+  EXPECT_EQ(stats.batches, 2u);
+  EXPECT_EQ(stats.batch_sizes[4], 2u);
+  EXPECT_DOUBLE_EQ(stats.mean_batch(), 4.0);
+
+  std::ostringstream json;
+  write_stats_json(json, stats);
+  EXPECT_NE(json.str().find("\"batch_sizes\": {\"4\": 2}"), std::string::npos);
+}
+
+// Test that a lone request leaves once its wait is up.
+TEST(ServeTest, MaxWaitFlushesPartialBatch) {
+  MultiLayerPerceptron mlp(ModelShape{2, {3}, {}}, 7);
+  InferenceEngine engine(mlp,
+                         BatchingOptions{64, std::chrono::microseconds(1000)});
+  auto result = engine.submit({0.5, 0.5});
+  ASSERT_EQ(result.wait_for(std::chrono::seconds(5)),
+            std::future_status::ready);
+  EXPECT_EQ(engine.stats().batch_sizes[1], 1u);
+  EXPECT_GE(engine.stats().p50_us, 1000.0);
+
+  engine.reset_stats();
+  EXPECT_EQ(engine.stats().requests, 0u);
+}
+
+// Test argument checking and that shutdown serves what is queued.
+TEST(ServeTest, Shutdown) {
+  MultiLayerPerceptron mlp(ModelShape{2, {3}, {}}, 7);
+  EXPECT_THROW(InferenceEngine(mlp, BatchingOptions{0, {}}),
+               std::invalid_argument);
+
+  InferenceEngine engine(mlp, BatchingOptions{64, std::chrono::seconds(10)});
+  EXPECT_THROW(engine.submit({1.0}), std::invalid_argument);
+  auto pending = engine.submit({1.0, 2.0});
+  engine.shutdown();
+  EXPECT_EQ(pending.wait_for(std::chrono::seconds(0)),
+            std::future_status::ready);
+  EXPECT_THROW(engine.submit({1.0, 2.0}), std::runtime_error);
+}
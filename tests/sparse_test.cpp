@@ -0,0 +1,203 @@
+#include "../core/Sparse/Sparse.hpp"
+#include "test_helpers.hpp"
+#include <cmath>
+#include <gtest/gtest.h>
+
+namespace {
+
+auto small_mlp() -> MultiLayerPerceptron {
+  ModelShape shape{19, {37, 22, 3},
+                   {Activation::Relu, Activation::Tanh, Activation::Identity}};
+  return MultiLayerPerceptron(shape, 5, InitScheme::HeUniform);
+}
+
+auto zero_weights(const MultiLayerPerceptron &mlp) -> size_t {
+  size_t zeros = 0;
+  for (size_t l = 0; l < mlp.num_layers(); l++) {
+    std::vector<ValuePtr> params = mlp.layer(l).parameters();
+    size_t stride = params.size() / mlp.layer(l).size();
+    for (size_t p = 0; p < params.size(); p++) {
+      zeros += p % stride != stride - 1 && params[p]->get_value() == 0.0;
+    }
+  }
+  return zeros;
+}
+
+auto total_weights(const MultiLayerPerceptron &mlp) -> size_t {
+  size_t weights = 0;
+  for (size_t l = 0; l < mlp.num_layers(); l++) {
+    weights += mlp.layer(l).parameters().size() - mlp.layer(l).size();
+  }
+  return weights;
+}
+
+// Largest difference from the dense model over a batch of inputs
+auto max_error(const MultiLayerPerceptron &mlp, const SparseMLP &sparse,
+               SparseKernel kernel, bool batched) -> double {
+  constexpr size_t kBatch = 13;
+  std::vector<double> inputs = samples(kBatch, mlp.num_inputs(), 7);
+  size_t out = mlp.num_outputs();
+  std::vector<double> actual(kBatch * out);
+  SparseMLP::Workspace workspace = sparse.workspace(kBatch);
+  if (batched) {
+    sparse.run_batch(inputs.data(), kBatch, actual.data(), workspace, kernel);
+  } else {
+    for (size_t s = 0; s < kBatch; s++) {
+      sparse.run(inputs.data() + s * mlp.num_inputs(), actual.data() + s * out,
+                 workspace, kernel);
+    }
+  }
+  std::vector<double> scratch(2 * mlp.max_width());
+  std::vector<double> expected(out);
+  double error = 0.0;
+  for (size_t s = 0; s < kBatch; s++) {
+    mlp.evaluate(inputs.data() + s * mlp.num_inputs(), expected.data(),
+                 scratch.data());
+    for (size_t o = 0; o < out; o++) {
+      error = std::max(error, std::abs(actual[s * out + o] - expected[o]));
+    }
+  }
+  return error;
+}
+
+} // namespace
+
+// Test that pruning zeroes the requested share of each layer's weights and
+// leaves the biases alone.
+TEST(SparseTest, PruneHitsSparsity) {
+  MultiLayerPerceptron mlp = small_mlp();
+  PruneMask mask = magnitude_prune(mlp, {0.8});
+  size_t weights = total_weights(mlp);
+  EXPECT_NEAR(static_cast<double>(zero_weights(mlp)) / weights, 0.8, 0.01);
+  EXPECT_EQ(mask.keep().size(), mlp.parameters().size());
+  EXPECT_EQ(mask.kept(), mlp.parameters().size() - zero_weights(mlp));
+
+  // Every kept weight is at least as large as any pruned one in its layer
+  MultiLayerPerceptron original = small_mlp();
+  std::vector<ValuePtr> before = original.layer(0).parameters();
+  double largest_pruned = 0.0;
+  double smallest_kept = INFINITY;
+  for (size_t p = 0; p < before.size(); p++) {
+    if (p % 20 == 19) {
+      EXPECT_TRUE(mask.keep()[p]);
+      continue;
+    }
+    double magnitude = std::abs(before[p]->get_value());
+    if (mask.keep()[p]) {
+      smallest_kept = std::min(smallest_kept, magnitude);
+    } else {
+      largest_pruned = std::max(largest_pruned, magnitude);
+    }
+  }
+  EXPECT_LE(largest_pruned, smallest_kept);
+}
+
+// Test that block pruning removes whole tiles.
+TEST(SparseTest, BlockPruneRemovesTiles) {
+  MultiLayerPerceptron mlp = small_mlp();
+  magnitude_prune(mlp, {0.75, 4});
+  EXPECT_NEAR(static_cast<double>(zero_weights(mlp)) / total_weights(mlp),
+              0.75, 0.05);
+
+  SparseMLP bsr = SparseMLP::convert(mlp, SparseFormat::Bsr, 4);
+  for (const SparseLayer &layer : bsr.layers()) {
+    size_t tile_rows = (layer.outputs + 3) / 4;
+    size_t tile_cols = (layer.inputs + 3) / 4;
+    // Interior tiles are either gone or complete
+    for (size_t r = 0; r < tile_rows; r++) {
+      for (u32 t = layer.row_begin[r]; t < layer.row_begin[r + 1]; t++) {
+        if ((r + 1) * 4 > layer.outputs ||
+            (layer.columns[t] + 1) * 4 > layer.inputs) {
+          continue;
+        }
+        for (size_t k = 0; k < 16; k++) {
+          EXPECT_NE(layer.values[t * 16 + k], 0.0);
+        }
+      }
+    }
+    EXPECT_LT(layer.columns.size(), tile_rows * tile_cols);
+  }
+}
+
+// Test that every format and kernel computes what the dense model does.
+TEST(SparseTest, MatchesDense) {
+  MultiLayerPerceptron mlp = small_mlp();
+  magnitude_prune(mlp, {0.7});
+  std::vector<SparseKernel> kernels = {SparseKernel::Scalar};
+  if (sparse_avx2_supported()) {
+    kernels.push_back(SparseKernel::Avx2);
+  }
+  for (SparseFormat format : {SparseFormat::Csr, SparseFormat::Bsr}) {
+    for (size_t block : {1, 3, 4, 8}) {
+      SparseMLP sparse = SparseMLP::convert(mlp, format, block);
+      EXPECT_NEAR(sparse.density(), 0.3, 0.01);
+      for (SparseKernel kernel : kernels) {
+        EXPECT_LT(max_error(mlp, sparse, kernel, false), 1e-12);
+        EXPECT_LT(max_error(mlp, sparse, kernel, true), 1e-12);
+      }
+    }
+  }
+}
+
+// Test that sparse storage shrinks with density.
+TEST(SparseTest, StorageFollowsDensity) {
+  MultiLayerPerceptron dense = small_mlp();
+  MultiLayerPerceptron pruned = small_mlp();
+  magnitude_prune(pruned, {0.9});
+  SparseMLP full = SparseMLP::convert(dense);
+  SparseMLP sparse = SparseMLP::convert(pruned);
+  EXPECT_DOUBLE_EQ(full.density(), 1.0);
+  EXPECT_LT(sparse.weight_bytes(), full.weight_bytes() / 5);
+  EXPECT_EQ(sparse(std::vector<double>(19, 0.5)).size(), 3u);
+}
+
+// Test that masked gradients keep pruned weights at zero through training.
+TEST(SparseTest, MaskedTrainingKeepsZeros) {
+  MultiLayerPerceptron mlp = small_mlp();
+  PruneMask mask = magnitude_prune(mlp, {0.9});
+  size_t zeros = zero_weights(mlp);
+  std::vector<ValuePtr> params = mlp.parameters();
+  std::vector<double> inputs = samples(8, 19, 3);
+
+  double first_loss = 0.0;
+  double last_loss = 0.0;
+  for (size_t step = 0; step < 30; step++) {
+    ValuePtr loss = create_value(0.0);
+    for (size_t s = 0; s < 8; s++) {
+      std::vector<ValuePtr> x;
+      for (size_t i = 0; i < 19; i++) {
+        x.push_back(create_value(inputs[s * 19 + i]));
+      }
+      std::vector<ValuePtr> y = mlp(x);
+      ValuePtr diff = y[0] - create_value(inputs[s * 19] > 0 ? 1.0 : -1.0);
+      loss = loss + diff * diff;
+    }
+    loss->backpropagate();
+    mask.mask_gradients(mlp);
+    for (const ValuePtr &param : params) {
+      param->set_value(param->get_value() - 0.01 * param->get_gradient());
+    }
+    (step == 0 ? first_loss : last_loss) = loss->get_value();
+  }
+  EXPECT_LT(last_loss, first_loss);
+  EXPECT_EQ(zero_weights(mlp), zeros);
+}
+
+// Test that bad options throw.
+TEST(SparseTest, RejectsBadOptions) {
+  MultiLayerPerceptron mlp = small_mlp();
+  EXPECT_THROW(magnitude_prune(mlp, {1.5}), std::invalid_argument);
+  EXPECT_THROW(magnitude_prune(mlp, {-0.1}), std::invalid_argument);
+  EXPECT_THROW(magnitude_prune(mlp, {0.5, 0}), std::invalid_argument);
+  EXPECT_THROW(SparseMLP::convert(mlp, SparseFormat::Bsr, 0),
+               std::invalid_argument);
+  SparseMLP sparse = SparseMLP::convert(mlp);
+  EXPECT_THROW(sparse(std::vector<double>(3)), std::runtime_error);
+
+  // A single-input workspace is too small for a batch
+  SparseMLP::Workspace workspace = sparse.workspace();
+  std::vector<double> inputs(4 * mlp.num_inputs());
+  std::vector<double> outputs(4 * mlp.num_outputs());
+  EXPECT_THROW(sparse.run_batch(inputs.data(), 4, outputs.data(), workspace),
+               std::invalid_argument);
+}
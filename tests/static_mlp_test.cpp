@@ -0,0 +1,81 @@
+#include "../core/Model/StaticMLP.hpp"
+#include <gtest/gtest.h>
+#include <sstream>
+
+using SmallMLP = StaticMLP<3, 8, 4, 2>;
+
+static_assert(SmallMLP::parameter_count == (3 + 1) * 8 + (8 + 1) * 4 +
+                                               (4 + 1) * 2,
+              "parameter count is known at compile time");
+static_assert(SmallMLP::outputs == 2, "output width comes from the last size");
+
+// Test that the same seed gives the dynamic MLP the same function.
+TEST(StaticMLPTest, MatchesDynamicMLP) {
+  SmallMLP fixed(42);
+  MultiLayerPerceptron dynamic(3, {8, 4, 2}, 42);
+  EXPECT_EQ(fixed.parameters(), dynamic.parameter_values());
+
+  for (double x : {-2.0, -0.5, 0.0, 0.75, 3.0}) {
+    auto expected = dynamic({create_value(x), create_value(1.0 - x),
+                             create_value(0.5 * x)});
+    auto actual = fixed({x, 1.0 - x, 0.5 * x});
+    for (size_t o = 0; o < SmallMLP::outputs; o++) {
+      EXPECT_DOUBLE_EQ(actual[o], expected[o]->get_value()) << "x = " << x;
+    }
+  }
+}
+
+// Test that files move between the static and dynamic models.
+TEST(StaticMLPTest, SharedFileFormat) {
+  MultiLayerPerceptron dynamic(3, {8, 4, 2}, 3);
+  std::stringstream from_dynamic;
+  dynamic.save(from_dynamic);
+  SmallMLP fixed = SmallMLP::load(from_dynamic);
+  EXPECT_EQ(fixed.parameters(), dynamic.parameter_values());
+
+  std::stringstream from_static;
+  fixed.save(from_static);
+  MultiLayerPerceptron reloaded = MultiLayerPerceptron::load(from_static);
+  EXPECT_EQ(reloaded.parameter_values(), dynamic.parameter_values());
+}
+
+// Test the direct conversions both ways.
+TEST(StaticMLPTest, Conversions) {
+  SmallMLP fixed(11);
+  MultiLayerPerceptron dynamic = fixed.to_dynamic();
+  EXPECT_EQ(dynamic.shape(), fixed.shape());
+  EXPECT_EQ(SmallMLP::from(dynamic).parameters(), fixed.parameters());
+
+  MultiLayerPerceptron other(3, {8, 2});
+  EXPECT_THROW(SmallMLP::from(other), std::runtime_error);
+}
+
+// Test that loading a different architecture is rejected.
+TEST(StaticMLPTest, LoadRejectsOtherShape) {
+  StaticMLP<3, 4, 2> other(1);
+  std::stringstream file;
+  other.save(file);
+  EXPECT_THROW(SmallMLP::load(file), std::runtime_error);
+
+  std::stringstream garbage("not a model");
+  EXPECT_THROW(SmallMLP::load(garbage), std::runtime_error);
+}
+
+// Test that activations carry over between the static and dynamic models.
+TEST(StaticMLPTest, Activations) {
+  SmallMLP fixed(8, {Activation::Gelu, Activation::LeakyRelu,
+                     Activation::Identity});
+  MultiLayerPerceptron dynamic = fixed.to_dynamic();
+  EXPECT_EQ(dynamic.shape().activation(2), Activation::Identity);
+
+  auto expected = dynamic(
+      {create_value(-1.0), create_value(0.25), create_value(2.0)});
+  auto actual = fixed({-1.0, 0.25, 2.0});
+  for (size_t o = 0; o < SmallMLP::outputs; o++) {
+    EXPECT_DOUBLE_EQ(actual[o], expected[o]->get_value());
+  }
+
+  std::stringstream file;
+  dynamic.save(file);
+  EXPECT_EQ(SmallMLP::load(file).shape(), fixed.shape());
+}
@@ -0,0 +1,109 @@
+#include "../core/Tensor/Gemm.hpp"
+#include "../core/Tensor/Tensor.h"
+#include <gtest/gtest.h>
+#include <random>
+
+namespace {
+
+auto random_matrix(size_t rows, size_t cols, u32 seed) -> std::vector<double> {
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+  std::vector<double> m(rows * cols);
+  for (double &x : m) {
+    x = uniform(gen);
+  }
+  return m;
+}
+
+// C = A * B the obvious way, A and B read through their views
+auto naive(size_t m, size_t n, size_t k, MatrixView a, MatrixView b)
+    -> std::vector<double> {
+  std::vector<double> c(m * n, 0.0);
+  for (size_t i = 0; i < m; i++) {
+    for (size_t j = 0; j < n; j++) {
+      for (size_t p = 0; p < k; p++) {
+        c[i * n + j] += a.data[i * a.row_stride + p * a.col_stride] *
+                        b.data[p * b.row_stride + j * b.col_stride];
+      }
+    }
+  }
+  return c;
+}
+
+} // namespace
+
+// Test that strides are row-major and element access follows them.
+TEST(TensorTest, ShapeAndStrides) {
+  Tensor t({2, 3, 4});
+  EXPECT_EQ(t.strides(), (std::vector<size_t>{12, 4, 1}));
+  EXPECT_EQ(t.size(), 24u);
+  t(1, 2, 3) = 7.0;
+  EXPECT_DOUBLE_EQ(t.data()[23], 7.0);
+
+  Tensor scalar;
+  EXPECT_EQ(scalar.rank(), 0u);
+  EXPECT_EQ(scalar.size(), 1u);
+
+  Tensor m = Tensor({2, 3}, {1, 2, 3, 4, 5, 6}).reshape({3, 2});
+  EXPECT_DOUBLE_EQ(m(2, 0), 5.0);
+  EXPECT_THROW(m.reshape({4, 2}), std::invalid_argument);
+  EXPECT_THROW(Tensor({2, 2}, {1, 2, 3}), std::invalid_argument);
+}
+
+// Test that every micro-tile and awkward block sizes match the naive
+// product, edges included.
+TEST(TensorTest, GemmMatchesNaive) {
+  const size_t m = 37;
+  const size_t n = 29;
+  const size_t k = 45;
+  std::vector<double> a = random_matrix(m, k, 1);
+  std::vector<double> b = random_matrix(k, n, 2);
+  MatrixView va{a.data(), k, 1};
+  MatrixView vb{b.data(), n, 1};
+  std::vector<double> expected = naive(m, n, k, va, vb);
+
+  for (auto [mr, nr] : gemm_micro_tiles()) {
+    for (GemmBlocking blocking : {GemmBlocking{64, 256, 128, mr, nr},
+                                  GemmBlocking{8, 12, 7, mr, nr}}) {
+      std::vector<double> c(m * n, -1.0);
+      gemm(m, n, k, va, vb, c.data(), n, blocking);
+      for (size_t i = 0; i < c.size(); i++) {
+        ASSERT_NEAR(c[i], expected[i], 1e-12) << to_string(blocking);
+      }
+    }
+  }
+}
+
+// Test that transposed views and accumulation work.
+TEST(TensorTest, GemmTransposedAndAccumulate) {
+  const size_t m = 5;
+  const size_t n = 6;
+  const size_t k = 7;
+  std::vector<double> at = random_matrix(k, m, 3); // A stored transposed
+  std::vector<double> bt = random_matrix(n, k, 4); // B stored transposed
+  MatrixView va{at.data(), 1, m};
+  MatrixView vb{bt.data(), 1, k};
+  std::vector<double> expected = naive(m, n, k, va, vb);
+
+  std::vector<double> c(m * n, 1.0);
+  gemm(m, n, k, va, vb, c.data(), n, GemmBlocking{4, 4, 3, 2, 4}, true);
+  for (size_t i = 0; i < c.size(); i++) {
+    EXPECT_NEAR(c[i], expected[i] + 1.0, 1e-12);
+  }
+
+  EXPECT_THROW(gemm(m, n, k, va, vb, c.data(), n, GemmBlocking{4, 4, 4, 3, 3}),
+               std::invalid_argument);
+}
+
+// Test matmul on tensors.
+TEST(TensorTest, Matmul) {
+  Tensor a({2, 3}, {1, 2, 3, 4, 5, 6});
+  Tensor b({3, 2}, {7, 8, 9, 10, 11, 12});
+  Tensor c = matmul(a, b);
+  EXPECT_EQ(c.shape(), (std::vector<size_t>{2, 2}));
+  EXPECT_DOUBLE_EQ(c(0, 0), 58.0);
+  EXPECT_DOUBLE_EQ(c(0, 1), 64.0);
+  EXPECT_DOUBLE_EQ(c(1, 0), 139.0);
+  EXPECT_DOUBLE_EQ(c(1, 1), 154.0);
+  EXPECT_THROW(matmul(a, a), std::invalid_argument);
+}
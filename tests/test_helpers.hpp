@@ -0,0 +1,45 @@
+#pragma once
+#include "../core/Neuron.h"
+#include "../core/Train/Pipeline.hpp"
+#include <random>
+#include <vector>
+
+// Inputs and losses several test binaries share. Header-only, so each test
+// target keeps its own link line.
+
+// count x width standard normal draws, row-major
+template <typename T = double>
+auto samples(size_t count, size_t width, u64 seed) -> std::vector<T> {
+  std::mt19937_64 gen(seed);
+  std::normal_distribution<double> dis(0.0, 1.0);
+  std::vector<T> result(count * width);
+  for (T &x : result) {
+    x = static_cast<T>(dis(gen));
+  }
+  return result;
+}
+
+// The draws of samples(), one vector per sample
+inline auto sample_rows(size_t count, size_t width, u64 seed)
+    -> std::vector<std::vector<double>> {
+  std::vector<double> flat = samples(count, width, seed);
+  std::vector<std::vector<double>> rows;
+  for (size_t s = 0; s < count; s++) {
+    rows.emplace_back(flat.begin() + s * width,
+                      flat.begin() + (s + 1) * width);
+  }
+  return rows;
+}
+
+// Mean squared error of a two-input, one-output model over the batch
+inline auto mse(MultiLayerPerceptron &mlp, const TrainBatch &batch)
+    -> ValuePtr {
+  ValuePtr loss = create_value(0.0);
+  for (size_t i = 0; i < batch.size; i++) {
+    std::vector<ValuePtr> x = {create_value(batch.inputs[2 * i]),
+                               create_value(batch.inputs[2 * i + 1])};
+    ValuePtr diff = mlp(x)[0] - create_value(batch.targets[i]);
+    loss = loss + diff * diff;
+  }
+  return loss * create_value(1.0 / batch.size);
+}
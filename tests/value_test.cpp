@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 #include "../core/Value.h"
+#include <cmath>
+#include <cstring>
 #include <iostream> 
 
 // Example test
@@ -135,4 +137,150 @@ TEST(ValueTest, ComplexExpression) {
     
     d->backpropagate();
     EXPECT_DOUBLE_EQ(a->get_gradient(), 16.0);  // d/da((a^2 + a)*a) = 3a^2 + a = 12 + 2 = 14
-}
\ No newline at end of file
+}
+TEST(ValueTest, SharedIntermediateGradient) {
+    // b feeds both c and d, so its gradient must be complete before it is
+    // pushed down to a
+    auto a = create_value(3.0);
+    auto b = a * a;      // 9
+    auto c = b + b;      // 18
+    auto d = c * b;      // 162 = 2a^4
+
+    d->backpropagate();
+    EXPECT_DOUBLE_EQ(a->get_gradient(), 216.0);  // d(2a^4)/da = 8a^3 = 216
+}
+
+TEST(ValueTest, RepeatedBackpropagate) {
+    auto a = create_value(2.0);
+    auto b = a * a;
+
+    b->backpropagate();
+    b->backpropagate();
+    EXPECT_DOUBLE_EQ(a->get_gradient(), 4.0);  // Gradients are re-zeroed
+}
+
+
+TEST(ValueTest, DeepSharedChainBackpropagate) {
+    // Each node uses the previous one twice, so walking every path instead
+    // of a topological order would run 2^60 gradient functions
+    auto a = create_value(1.0);
+    auto x = a;
+    for (int i = 0; i < 60; i++) {
+        x = x + x;
+    }
+
+    x->backpropagate();
+    EXPECT_DOUBLE_EQ(a->get_gradient(), std::ldexp(1.0, 60));
+}
+
+TEST(ValueTest, GraphReleasedAfterBackpropagate) {
+    // gradient_func must not own its node, or every graph would leak
+    auto a = create_value(2.0);
+    std::weak_ptr<Value> product;
+    std::weak_ptr<Value> sum;
+    {
+        auto b = a * a;
+        auto c = relu(b + a);
+        product = b;
+        sum = c;
+        c->backpropagate();
+    }
+    EXPECT_TRUE(product.expired());
+    EXPECT_TRUE(sum.expired());
+    EXPECT_EQ(a.use_count(), 1);
+}
+
+TEST(ValueTest, ScratchArenaAllocation) {
+    MemoryArena scratch(KB(16));
+    auto weight = create_value(2.0);  // Outside the scope, heap allocated
+    {
+        ScratchScope scope(&scratch);
+        auto x = create_value(3.0);
+        auto y = weight * x + x;
+
+        EXPECT_GT(scratch.get_pos(), 0);
+        EXPECT_EQ(scratch.alloc_count, 3);  // x, weight * x, the sum
+
+        y->backpropagate();
+        EXPECT_DOUBLE_EQ(weight->get_gradient(), 3.0);
+    }
+    scratch.end_iteration();
+    EXPECT_EQ(scratch.get_pos(), 0);
+}
+
+TEST(ValueTest, ScratchArenaSitesPerOp) {
+    MemoryArena scratch(KB(16));
+    {
+        ScratchScope scope(&scratch);
+        auto x = create_value(3.0);
+        auto y = x * x + x * x;
+        auto z = relu(y);
+    }
+    auto bytes_of = [&](const char* op) -> u64 {
+        for (size_t i = 0; i < scratch.site_count; i++) {
+            if (std::strstr(scratch.sites[i].name, op)) {
+                return scratch.sites[i].bytes;
+            }
+        }
+        return 0;
+    };
+    // Nodes are tagged by the function that made them, not one line of
+    // Value.cpp
+    u64 one_node = bytes_of("operator+");
+    EXPECT_GT(one_node, 0u);
+    EXPECT_EQ(bytes_of("operator*"), 2 * one_node);
+    EXPECT_EQ(bytes_of("relu"), one_node);
+    EXPECT_EQ(bytes_of("TestBody"), one_node);  // The leaf x
+    EXPECT_EQ(scratch.site_count, 4u);
+}
+
+TEST(ValueTest, ScratchArenaOutOfMemoryThrows) {
+    MemoryArena scratch(64);
+    ScratchScope scope(&scratch);
+    EXPECT_THROW(create_value(1.0), std::bad_alloc);
+}
+
+TEST(ValueTest, ScratchArenaReturnNullThrows) {
+    MemoryArena scratch(64);
+    scratch.set_oom_handler(arena_oom_return_null);
+    ScratchScope scope(&scratch);
+    EXPECT_THROW(create_value(1.0), std::bad_alloc);
+}
+
+static size_t count_occurrences(const std::string& text, const std::string& needle) {
+    size_t count = 0;
+    for (size_t pos = text.find(needle); pos != std::string::npos;
+         pos = text.find(needle, pos + 1)) {
+        count++;
+    }
+    return count;
+}
+
+TEST(ValueTest, DotExport) {
+    auto a = create_value(2.0);
+    auto b = a * a;
+    auto c = b + a;
+
+    std::string dot = c->to_dot();
+    EXPECT_EQ(count_occurrences(dot, "[label="), 3u);  // a, b, c once each
+    EXPECT_EQ(count_occurrences(dot, " -> "), 4u);     // c->b, c->a, b->a twice
+}
+
+TEST(ValueTest, DotExportLimits) {
+    auto x = create_value(1.0);
+    auto y = x;
+    for (int i = 0; i < 10; i++) {
+        y = y + create_value(1.0);
+    }
+
+    GraphExportOptions depth_limited;
+    depth_limited.max_depth = 2;
+    // Root, its two parents, and the two parents of the inner sum
+    EXPECT_EQ(count_occurrences(y->to_dot(depth_limited), "[label="), 5u);
+
+    GraphExportOptions node_limited;
+    node_limited.max_nodes = 4;
+    std::string dot = y->to_dot(node_limited);
+    EXPECT_EQ(count_occurrences(dot, "[label="), 4u);
+    EXPECT_EQ(dot.find("node_4"), std::string::npos);
+}